@@ -25,6 +25,7 @@ namespace BHPKG {
 namespace BPrivate {
 	class RepositoryWriterImpl;
 }
+class BPackageWriterParameters;
 using BPrivate::RepositoryWriterImpl;
 
 
@@ -59,6 +60,8 @@ public:
 								~BRepositoryWriter();
 
 			status_t			Init(const char* fileName);
+			status_t			Init(const char* fileName,
+									const BPackageWriterParameters& parameters);
 			status_t			AddPackage(const BEntry& packageEntry);
 			status_t			AddPackageInfo(const BPackageInfo& packageInfo);
 			status_t			Finish();
@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2009, Haiku, Inc. All Rights Reserved.
+ * Copyright 2002-2026, Haiku, Inc. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  */
 #ifndef _QUERY_H
@@ -17,6 +17,7 @@ struct entry_ref;
 namespace BPrivate {
 	namespace Storage {
 		class QueryNode;
+		class QueryReader;
 		class QueryStack;
 		class QueryTree;
 	};
@@ -61,6 +62,7 @@ public:
 			status_t		PushDate(const char* date);
 
 			status_t		SetVolume(const BVolume* volume);
+			status_t		SetAllVolumes();
 			status_t		SetPredicate(const char* expression);
 			status_t		SetTarget(BMessenger messenger);
 
@@ -106,7 +108,12 @@ private:
 			port_id			fPort;
 			long			fToken;
 			int				fQueryFd;
-			int32			_reservedData[4];
+			BPrivate::Storage::QueryReader* fReader;
+#ifdef B_HAIKU_64_BIT
+			uint32			_reservedData[2];
+#else
+			uint32			_reservedData[3];
+#endif
 };
 
 #endif	// _QUERY_H
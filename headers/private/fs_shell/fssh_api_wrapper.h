@@ -60,6 +60,13 @@
 #define atomic_and			fssh_atomic_and
 #define atomic_or			fssh_atomic_or
 #define atomic_get			fssh_atomic_get
+#define atomic_set64		fssh_atomic_set64
+#define atomic_get_and_set64	fssh_atomic_get_and_set64
+#define atomic_test_and_set64	fssh_atomic_test_and_set64
+#define atomic_add64		fssh_atomic_add64
+#define atomic_and64		fssh_atomic_and64
+#define atomic_or64			fssh_atomic_or64
+#define atomic_get64		fssh_atomic_get64
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -848,6 +855,7 @@
 #define block_cache_get_empty			fssh_block_cache_get_empty
 #define block_cache_get_etc				fssh_block_cache_get_etc
 #define block_cache_get					fssh_block_cache_get
+#define block_cache_prefetch			fssh_block_cache_prefetch
 #define block_cache_set_dirty			fssh_block_cache_set_dirty
 #define block_cache_put					fssh_block_cache_put
 
@@ -873,6 +881,7 @@
 #define entry_cache_add					fssh_entry_cache_add
 #define entry_cache_add_missing			fssh_entry_cache_add_missing
 #define entry_cache_remove				fssh_entry_cache_remove
+#define entry_cache_set_lookup_caching	fssh_entry_cache_set_lookup_caching
 
 ////////////////////////////////////////////////////////////////////////////////
 // #pragma mark - fssh_fs_index.h
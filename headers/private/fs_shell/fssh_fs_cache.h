@@ -86,6 +86,8 @@ extern const void *		fssh_block_cache_get_etc(void *_cache,
 							fssh_off_t length);
 extern const void *		fssh_block_cache_get(void *_cache,
 							fssh_off_t blockNumber);
+extern fssh_status_t	fssh_block_cache_prefetch(void *_cache,
+							fssh_off_t blockNumber, fssh_size_t *_numBlocks);
 extern fssh_status_t	fssh_block_cache_set_dirty(void *_cache,
 							fssh_off_t blockNumber, bool isDirty,
 							int32_t transaction);
@@ -130,6 +132,8 @@ extern fssh_status_t	fssh_entry_cache_add_missing(fssh_dev_t mountID,
 							fssh_ino_t dirID, const char* name);
 extern fssh_status_t	fssh_entry_cache_remove(fssh_dev_t mountID,
 							fssh_ino_t dirID, const char* name);
+extern fssh_status_t	fssh_entry_cache_set_lookup_caching(fssh_dev_t mountID,
+							bool enabled);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,8 @@ struct cache_module_info {
 	void (*node_closed)(struct vnode *vnode, int32 fdType, dev_t mountID,
 				ino_t vnodeID, int32 accessType);
 	void (*node_launched)(size_t argCount, char * const *args);
+	void (*node_read)(struct vnode *vnode, dev_t mountID, ino_t vnodeID,
+				off_t offset, size_t size);
 };
 
 #ifdef __cplusplus
@@ -42,6 +44,7 @@ extern void cache_node_opened(struct vnode *vnode, int32 fdType, VMCache *cache,
 extern void cache_node_closed(struct vnode *vnode, int32 fdType, VMCache *cache,
 				dev_t mountID, ino_t vnodeID);
 extern void cache_node_launched(size_t argCount, char * const *args);
+extern void cache_node_read(struct vnode *vnode, off_t offset, size_t size);
 extern void cache_prefetch_vnode(struct vnode *vnode, off_t offset, size_t size);
 extern void cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size);
 
@@ -128,6 +128,11 @@ status_t	vfs_unmount(dev_t mountID, uint32 flags);
 status_t	vfs_disconnect_vnode(dev_t mountID, ino_t vnodeID);
 status_t	vfs_resolve_parent(struct vnode* parent, dev_t* device,
 				ino_t* node);
+void		vfs_entry_cache_entry_created(dev_t mountID, ino_t dirID,
+				const char* name);
+void		vfs_entry_cache_entry_removed(dev_t mountID, ino_t dirID,
+				const char* name);
+void		vfs_node_permissions_changed(dev_t mountID, ino_t vnodeID);
 void		vfs_free_unused_vnodes(int32 level);
 
 status_t	vfs_read_stat(int fd, const char *path, bool traverseLeafLink,
@@ -187,6 +192,9 @@ status_t	_user_read_stat(int fd, const char *path, bool traverseLink,
 				struct stat *stat, size_t statSize);
 status_t	_user_write_stat(int fd, const char *path, bool traverseLink,
 				const struct stat *stat, size_t statSize, int statMask);
+ssize_t		_user_read_dir_stat(int fd, struct dirent_stat *buffer,
+				size_t bufferSize, uint32 maxCount, const char *attributes,
+				size_t attributesLength, size_t maxAttributeSize);
 off_t		_user_seek(int fd, off_t pos, int seekType);
 status_t	_user_create_dir_entry_ref(dev_t device, ino_t inode,
 				const char *name, int perms);
@@ -58,6 +58,12 @@ public:
 
 			void				IncrementFaultCount()
 									{ atomic_add(&fFaultCount, 1); }
+			void				AddFaultAroundPages(int32 count)
+									{ atomic_add(&fFaultAroundPages, count); }
+			int32				FaultCount() const
+									{ return fFaultCount; }
+			int32				FaultAroundPages() const
+									{ return fFaultAroundPages; }
 			void				IncrementChangeCount()
 									{ fChangeCount++; }
 
@@ -146,6 +152,7 @@ protected:
 			team_id				fID;
 			int32				fRefCount;
 			int32				fFaultCount;
+			int32				fFaultAroundPages;
 			int32				fChangeCount;
 			VMTranslationMap*	fTranslationMap;
 			bool				fRandomizingEnabled;
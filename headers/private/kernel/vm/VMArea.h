@@ -112,6 +112,8 @@ public:
 	uint32					cache_type;
 	VMAreaMappings			mappings;
 	uint8*					page_protections;
+	uint16					fault_around;
+		// number of resident pages to map around a faulting one
 
 	struct VMAddressSpace*	address_space;
 	struct VMArea*			cache_next;
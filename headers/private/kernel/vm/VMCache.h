@@ -117,6 +117,10 @@ public:
 	inline	void				IncrementWiredPagesCount();
 	inline	void				DecrementWiredPagesCount();
 
+	inline	void				PageAccessed(vm_page* page,
+									uint32 generation);
+	inline	uint32				WorkingSetSize(uint32 generation) const;
+
 	virtual	int32				GuardSize()	{ return 0; }
 
 			void				AddConsumer(VMCache* consumer);
@@ -218,6 +222,9 @@ private:
 			void*				fUserData;
 			VMCacheRef*			fCacheRef;
 			page_num_t			fWiredPagesCount;
+			uint32				fWorkingSetGeneration;
+			uint32				fAccessedPages;
+			uint32				fPreviousAccessedPages;
 };
 
 
@@ -354,6 +361,50 @@ VMCache::DecrementWiredPagesCount()
 }
 
 
+/*!	Called by the page daemon for each page of the cache it finds accessed.
+	The counts are kept per working set generation; the previous generation's
+	count is retained, older ones are dropped lazily. Each page is only counted
+	once per generation, no matter how often the scans find it accessed.
+	The caller must hold the cache lock.
+*/
+void
+VMCache::PageAccessed(vm_page* page, uint32 generation)
+{
+	if (fWorkingSetGeneration != generation) {
+		fPreviousAccessedPages = fWorkingSetGeneration + 1 == generation
+			? fAccessedPages : 0;
+		fAccessedPages = 0;
+		fWorkingSetGeneration = generation;
+	}
+
+	// The stamp only has the lower bits of the generation, so a page is
+	// rarely missed after a wrap-around -- that's good enough for an estimate.
+	if (page->working_set_generation == (uint8)generation)
+		return;
+
+	page->working_set_generation = (uint8)generation;
+	fAccessedPages++;
+}
+
+
+/*!	Returns the estimated number of pages of the cache that have been in use
+	recently, i.e. in the current or the previous working set generation.
+*/
+uint32
+VMCache::WorkingSetSize(uint32 generation) const
+{
+	uint32 accessedPages = 0;
+	if (fWorkingSetGeneration == generation) {
+		accessedPages = fAccessedPages > fPreviousAccessedPages
+			? fAccessedPages : fPreviousAccessedPages;
+	} else if (fWorkingSetGeneration + 1 == generation)
+		accessedPages = fAccessedPages;
+
+	// pages may have been removed from the cache since they were counted
+	return accessedPages < page_count ? accessedPages : page_count;
+}
+
+
 // vm_page methods implemented here to avoid VMCache.h inclusion in vm_types.h
 
 inline void
@@ -16,6 +16,8 @@
 struct kernel_args;
 
 extern int32 gMappedPagesCount;
+extern int32 gMappedLargePagesCount;
+extern int64 gLargePageDemotions;
 
 
 struct vm_page_reservation {
@@ -46,6 +48,7 @@ page_num_t vm_page_num_free_pages(void);
 page_num_t vm_page_num_available_pages(void);
 page_num_t vm_page_num_unused_pages(void);
 void vm_page_get_stats(system_info *info);
+void vm_page_get_daemon_stats(vm_stats* stats);
 phys_addr_t vm_page_max_address();
 
 status_t vm_page_write_modified_page_range(struct VMCache *cache,
@@ -154,6 +154,9 @@ public:
 	uint8					unused : 1;
 
 	uint8					usage_count;
+	uint8					working_set_generation;
+		// the last working set generation the page has been counted in,
+		// see VMCache::PageAccessed()
 
 	inline void Init(page_num_t pageNumber);
 
@@ -199,6 +202,11 @@ enum {
 #define VM_PAGE_ALLOC_STATE	0x00000007
 #define VM_PAGE_ALLOC_CLEAR	0x00000010
 #define VM_PAGE_ALLOC_BUSY	0x00000020
+#define VM_PAGE_ALLOC_DONT_WAIT	0x00000040
+
+// vm_page::working_set_generation of a page that hasn't been counted in any
+// generation yet; the page daemon never starts a generation matching it
+#define VM_PAGE_NO_WORKING_SET_GENERATION	0xff
 
 
 inline void
@@ -209,6 +217,7 @@ vm_page::Init(page_num_t pageNumber)
 	new(&mappings) vm_page_mappings();
 	fWiredCount = 0;
 	usage_count = 0;
+	working_set_generation = VM_PAGE_NO_WORKING_SET_GENERATION;
 	busy_writing = false;
 	SetCacheRef(NULL);
 	#if DEBUG_PAGE_QUEUE
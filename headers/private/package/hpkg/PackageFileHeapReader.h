@@ -39,11 +39,19 @@ public:
 			const OffsetArray&	Offsets() const
 									{ return fOffsets; }
 
+			bool				GetStoredUncompressedRange(uint64 offset,
+									size_t size, off_t& _fileOffset) const;
+
 protected:
 	virtual	status_t			ReadAndDecompressChunk(size_t chunkIndex,
 									void* compressedDataBuffer,
 									void* uncompressedDataBuffer);
 
+private:
+			void				_GetChunkSizes(size_t chunkIndex,
+									size_t& _compressedSize,
+									size_t& _uncompressedSize) const;
+
 private:
 			OffsetArray			fOffsets;
 };
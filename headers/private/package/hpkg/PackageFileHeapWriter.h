@@ -63,8 +63,11 @@ private:
 			struct Chunk;
 			struct ChunkSegment;
 			struct ChunkBuffer;
+			struct CompressionJob;
+			struct CompressionQueue;
 
 			friend struct ChunkBuffer;
+			friend struct CompressionQueue;
 
 private:
 			void				_Uninit();
@@ -72,11 +75,17 @@ private:
 			status_t			_FlushPendingData();
 			status_t			_WriteChunk(const void* data, size_t size,
 									bool mayCompress);
-			status_t			_WriteDataCompressed(const void* data,
-									size_t size);
+			status_t			_CompressChunk(const void* data,
+									size_t size, void* compressedData,
+									size_t& _compressedSize) const;
 			status_t			_WriteDataUncompressed(const void* data,
 									size_t size);
 
+			bool				_StartCompressionQueue();
+			status_t			_QueuePendingData();
+			status_t			_WriteQueuedChunk();
+			status_t			_WriteQueuedChunks();
+
 			void				_PushChunks(ChunkBuffer& chunkBuffer,
 									uint64 startOffset, uint64 endOffset);
 			void				_UnwriteLastPartialChunk();
@@ -87,6 +96,8 @@ private:
 			size_t				fPendingDataSize;
 			Array<uint64>		fOffsets;
 			CompressionAlgorithmOwner* fCompressionAlgorithm;
+			CompressionQueue*	fCompressionQueue;
+			bool				fParallelCompression;
 };
 
 
@@ -44,6 +44,8 @@ class PackageFileHeapReader;
 struct PackageFileSection {
 	uint32			uncompressedLength;
 	uint8*			data;
+						// owned by the reader, see
+						// ReaderImplBase::PrepareSections()
 	uint64			offset;
 	uint64			currentOffset;
 	uint64			stringsLength;
@@ -62,7 +64,6 @@ struct PackageFileSection {
 	~PackageFileSection()
 	{
 		delete[] strings;
-		delete[] data;
 	}
 };
 
@@ -136,7 +137,11 @@ protected:
 									uint64 endOffset, uint64 length,
 									uint64 maxSaneLength, uint64 stringsLength,
 									uint64 stringsCount);
-			status_t			PrepareSection(PackageFileSection& section);
+			status_t			PrepareSections(
+									PackageFileSection* const* sections,
+									int32 count);
+			void				SetFileDescriptor(int fd)
+									{ fFD = fd; }
 
 			status_t			ParseStrings();
 
@@ -154,7 +159,6 @@ protected:
 
 			status_t			ReadBuffer(off_t offset, void* buffer,
 									size_t size);
-			status_t			ReadSection(const PackageFileSection& section);
 
 	inline	AttributeHandler*	CurrentAttributeHandler() const;
 	inline	void				PushAttributeHandler(
@@ -187,6 +191,9 @@ private:
 			status_t			_ReadString(const char*& _string,
 									size_t* _stringLength = NULL);
 
+			uint8*				_MapSectionData(uint64 offset, size_t size);
+			void				_UnsetSectionData();
+
 private:
 			const char*			fFileType;
 			BErrorOutput*		fErrorOutput;
@@ -198,6 +205,13 @@ private:
 			PackageFileHeapReader* fRawHeapReader;
 			BAbstractBufferedDataReader* fHeapReader;
 
+			int					fFD;
+									// -1, if the file can't be mapped
+			uint8*				fSectionData;
+			void*				fMappedSectionData;
+			size_t				fMappedSectionDataSize;
+			bool				fSectionsPrepared;
+
 			PackageFileSection*	fCurrentSection;
 
 			AttributeHandlerList fAttributeHandlerStack;
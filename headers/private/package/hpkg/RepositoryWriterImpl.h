@@ -39,13 +39,15 @@ public:
 									BRepositoryInfo* repositoryInfo);
 								~RepositoryWriterImpl();
 
-			status_t			Init(const char* fileName);
+			status_t			Init(const char* fileName,
+									const BPackageWriterParameters& parameters);
 			status_t			AddPackage(const BEntry& packageEntry);
 			status_t			AddPackageInfo(const BPackageInfo& packageInfo);
 			status_t			Finish();
 
 private:
-			status_t			_Init(const char* fileName);
+			status_t			_Init(const char* fileName,
+									const BPackageWriterParameters& parameters);
 			status_t			_AddPackage(const BEntry& packageEntry);
 			status_t			_AddPackageInfo(
 									const BPackageInfo& packageInfo);
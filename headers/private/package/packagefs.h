@@ -24,7 +24,8 @@ enum PackageFSMountType {
 enum {
 	PACKAGE_FS_OPERATION_GET_VOLUME_INFO		= B_DEVICE_OP_CODES_END + 1,
 	PACKAGE_FS_OPERATION_GET_PACKAGE_INFOS,
-	PACKAGE_FS_OPERATION_CHANGE_ACTIVATION
+	PACKAGE_FS_OPERATION_CHANGE_ACTIVATION,
+	PACKAGE_FS_OPERATION_GET_MEMORY_USAGE
 };
 
 
@@ -104,4 +105,25 @@ struct PackageFSActivationChangeRequest {
 };
 
 
+// PACKAGE_FS_OPERATION_GET_MEMORY_USAGE
+
+struct PackageFSMemoryUsage {
+	// the activated packages of the volume and their nodes
+	uint32							packageCount;
+	uint32							nodeCount;
+	uint32							attributeCount;
+	uint64							nodeBytes;
+
+	// the distinct strings the packages refer to, and how often they do so;
+	// strings are shared with other volumes
+	uint32							stringCount;
+	uint32							stringReferenceCount;
+	uint64							stringBytes;
+
+	// all strings of all package FS volumes
+	uint32							poolStringCount;
+	uint64							poolStringBytes;
+};
+
+
 #endif	// _PACKAGE__PRIVATE__PACKAGE_FS_H_
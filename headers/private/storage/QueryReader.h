@@ -0,0 +1,73 @@
+/*
+ * Copyright 2026, Haiku, Inc. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _QUERY_READER_H
+#define _QUERY_READER_H
+
+
+#include <dirent.h>
+
+#include <Locker.h>
+#include <OS.h>
+
+
+namespace BPrivate {
+namespace Storage {
+
+
+/*!	Reads the entries of one or more open queries in batches.
+
+	With a single query, the entries are read synchronously, many of them
+	per syscall. For all volumes, one thread per volume reads the entries
+	of its query, and the batches are merged in the order they arrive.
+*/
+class QueryReader {
+public:
+								QueryReader();
+								~QueryReader();
+
+			status_t			SetTo(int fd);
+			status_t			SetToAllVolumes(const char* predicate,
+									size_t length, uint32 flags, port_id port,
+									int32 token);
+			void				Unset();
+
+			int32				GetNextDirents(struct dirent* buffer,
+									size_t length, int32 count);
+			status_t			GetNextDirent(struct dirent** _entry);
+			status_t			Rewind();
+
+private:
+			struct Chunk;
+			struct Reader;
+
+			status_t			_StartReaders();
+			void				_StopReaders();
+			void				_FreeChunks();
+			Chunk*				_NextChunk();
+			status_t			_ReadChunk(int fd, Chunk** _chunk);
+
+	static	status_t			_ReaderThread(void* data);
+
+private:
+			BLocker				fLock;
+			int					fFD;
+			Reader*				fReaders;
+			int32				fReaderCount;
+			int32				fFinishedReaders;
+			Chunk*				fFirstChunk;
+			Chunk*				fLastChunk;
+			Chunk*				fCurrent;
+			sem_id				fAvailableSem;
+			sem_id				fSpaceSem;
+			int32				fStopping;
+			status_t			fError;
+};
+
+
+}	// namespace Storage
+}	// namespace BPrivate
+
+
+#endif	// _QUERY_READER_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _LZ4_COMPRESSION_ALGORITHM_H_
+#define _LZ4_COMPRESSION_ALGORITHM_H_
+
+
+#include <CompressionAlgorithm.h>
+
+
+// acceleration
+enum {
+	B_LZ4_ACCELERATION_DEFAULT	= 1,
+	B_LZ4_ACCELERATION_MAX		= 64,
+};
+
+
+class BLz4CompressionParameters : public BCompressionParameters {
+public:
+								BLz4CompressionParameters(
+									int32 acceleration
+										= B_LZ4_ACCELERATION_DEFAULT);
+	virtual						~BLz4CompressionParameters();
+
+			int32				Acceleration() const;
+			void				SetAcceleration(int32 acceleration);
+
+private:
+			int32				fAcceleration;
+};
+
+
+class BLz4DecompressionParameters : public BDecompressionParameters {
+public:
+								BLz4DecompressionParameters();
+	virtual						~BLz4DecompressionParameters();
+};
+
+
+/*!	Implements the LZ4 block format, i.e. only single buffers can be
+	(de)compressed, there is no frame format and thus no stream support.
+*/
+class BLz4CompressionAlgorithm : public BCompressionAlgorithm {
+public:
+								BLz4CompressionAlgorithm();
+	virtual						~BLz4CompressionAlgorithm();
+
+	virtual	status_t			CompressBuffer(const void* input,
+									size_t inputSize, void* output,
+									size_t outputSize, size_t& _compressedSize,
+									const BCompressionParameters* parameters
+										= NULL);
+	virtual	status_t			DecompressBuffer(const void* input,
+									size_t inputSize, void* output,
+									size_t outputSize,
+									size_t& _uncompressedSize,
+									const BDecompressionParameters* parameters
+										= NULL);
+};
+
+
+#endif	// _LZ4_COMPRESSION_ALGORITHM_H_
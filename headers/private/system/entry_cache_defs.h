@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_ENTRY_CACHE_DEFS_H
+#define _SYSTEM_ENTRY_CACHE_DEFS_H
+
+
+#include <SupportDefs.h>
+
+
+/* generic syscall interface of the VFS entry cache */
+#define ENTRY_CACHE_SYSCALLS	"entry_cache"
+
+#define ENTRY_CACHE_GET_STATS	1
+#define ENTRY_CACHE_SET_LOCKLESS_PATH_WALK	2
+	/* expects an int32, 0 to disable the lockless path walk */
+
+
+typedef struct entry_cache_stats {
+	int64	lookups;
+	int64	hits;
+	int64	lockless_hits;		/* hits that did not need to lock the cache */
+	int64	negative_hits;		/* hits on missing entries */
+	int64	expired;			/* entries that were found expired */
+	int64	additions;
+	int64	negative_additions;
+	int64	removals;
+	int64	invalidations;		/* missing entries removed due to creation */
+	int64	evictions;			/* entries dropped with their generation */
+	int64	path_walks;			/* resolved paths */
+	int64	lockless_path_walks;	/* ...without referencing directories */
+
+	int32	entries;			/* current number of entries in all caches */
+	int32	negative_entries;	/* current number of missing entries */
+} entry_cache_stats;
+
+
+#endif	/* _SYSTEM_ENTRY_CACHE_DEFS_H */
@@ -23,6 +23,7 @@ extern "C" {
 
 struct attr_info;
 struct dirent;
+struct dirent_stat;
 struct fd_info;
 struct fd_set;
 struct fs_info;
@@ -39,7 +40,9 @@ struct sigaction;
 struct signal_frame_data;
 struct stat;
 struct system_profiler_parameters;
+struct team_vm_stats;
 struct user_timer_info;
+struct vm_stats;
 
 struct disk_device_job_progress_info;
 struct partitionable_space_data;
@@ -325,6 +328,10 @@ extern ssize_t		_kern_writev(int fd, off_t pos, const struct iovec *vecs,
 extern status_t		_kern_ioctl(int fd, uint32 cmd, void *data, size_t length);
 extern ssize_t		_kern_read_dir(int fd, struct dirent *buffer,
 						size_t bufferSize, uint32 maxCount);
+extern ssize_t		_kern_read_dir_stat(int fd, struct dirent_stat *buffer,
+						size_t bufferSize, uint32 maxCount,
+						const char *attributes, size_t attributesLength,
+						size_t maxAttributeSize);
 extern status_t		_kern_rewind_dir(int fd);
 extern status_t		_kern_read_stat(int fd, const char *path, bool traverseLink,
 						struct stat *stat, size_t statSize);
@@ -446,6 +453,9 @@ extern status_t		_kern_memory_advice(void *address, size_t size,
 
 extern status_t		_kern_get_memory_properties(team_id teamID,
 						const void *address, uint32* _protected, uint32* _lock);
+extern status_t		_kern_get_vm_stats(struct vm_stats *stats, size_t size);
+extern status_t		_kern_get_team_vm_stats(team_id team,
+						struct team_vm_stats *stats, size_t size);
 
 /* kernel port functions */
 extern port_id		_kern_create_port(int32 queue_length, const char *name);
@@ -10,6 +10,7 @@
 #define _SYSTEM_VFS_DEFS_H
 
 
+#include <dirent.h>
 #include <limits.h>
 #include <sys/stat.h>
 
@@ -23,6 +24,30 @@ struct fd_info {
 	ino_t	node;
 };
 
+/* entry returned by _kern_read_dir_stat(): it is followed by the values of
+   the requested attributes, each one a dirent_stat_attr structure starting
+   at an 8 byte aligned offset */
+struct dirent_stat {
+	uint32			reclen;			/* length of the whole record */
+	uint32			attr_offset;	/* offset of the first attribute */
+	status_t		status;			/* result of reading the stat */
+	uint32			_reserved;
+	struct stat		stat;
+	struct dirent	dirent;			/* must be last, it has a variable size */
+};
+
+struct dirent_stat_attr {
+	uint32			type;
+	int32			size;
+		/* size of the data following, or an error code if the attribute
+		   could not be read; values are truncated to the maximum size
+		   passed to _kern_read_dir_stat() */
+};
+
+/* limits of _kern_read_dir_stat() */
+#define VFS_READ_DIR_STAT_MAX_ATTRIBUTES		16
+#define VFS_READ_DIR_STAT_MAX_ATTRIBUTE_SIZE	1024
+
 
 /* maximum write size to a pipe/FIFO that is guaranteed not to be interleaved
    with other writes (aka {PIPE_BUF}; must be >= _POSIX_PIPE_BUF) */
@@ -34,8 +34,12 @@
 #define B_KERNEL_AREA			0x4000
 	// Usable from userland according to its protection flags, but the area
 	// itself is not deletable, resizable, etc from userland.
+#define B_LARGE_PAGES_AREA		0x8000
+	// The VM may back the area with large pages, if the architecture
+	// supports them. Only honored for anonymous B_NO_LOCK areas.
 
-#define B_USER_AREA_FLAGS		(B_USER_PROTECTION | B_OVERCOMMITTING_AREA)
+#define B_USER_AREA_FLAGS \
+	(B_USER_PROTECTION | B_OVERCOMMITTING_AREA | B_LARGE_PAGES_AREA)
 #define B_KERNEL_AREA_FLAGS \
 	(B_KERNEL_PROTECTION | B_USER_CLONEABLE_AREA | B_SHARED_AREA)
 
@@ -54,4 +58,31 @@ enum {
 #define MEMORY_TYPE_SHIFT		28
 
 
+// VM statistics, as returned by _kern_get_vm_stats()
+typedef struct vm_stats {
+	uint64	large_pages_mapped;
+	uint64	large_page_faults;
+	uint64	large_page_allocation_failures;
+	uint64	large_page_demotions;
+	uint64	fault_around_pages;
+	uint64	swap_pages_read;
+	uint64	swap_pages_written;
+	uint64	swap_read_ahead_pages;
+	uint64	compressed_swap_pages;
+	uint64	compressed_swap_size;
+	uint64	page_daemon_threads;
+	uint64	pages_scanned;
+	uint64	page_scan_time;			// in microseconds
+	uint64	pages_reclaimed;		// moved to the cached queue
+	uint64	reclaim_waits;
+	uint64	reclaim_wait_time;		// in microseconds
+} vm_stats;
+
+// per team VM statistics, as returned by _kern_get_team_vm_stats()
+typedef struct team_vm_stats {
+	uint64	page_faults;
+	uint64	fault_around_pages;
+} team_vm_stats;
+
+
 #endif	/* _SYSTEM_VM_DEFS_H */
@@ -77,7 +77,7 @@ typedef struct {
 
 #include "dma_resources.h"
 #include "IORequest.h"
-#include "IOSchedulerSimple.h"
+#include "IOSchedulerRoster.h"
 
 
 //#define TRACE_VIRTIO_BLOCK
@@ -517,7 +517,7 @@ virtio_block_set_capacity(virtio_block_driver_info* info, uint64 capacity,
 		if (status != B_OK)
 			panic("initializing DMAResource failed: %s", strerror(status));
 
-		info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
+		info->io_scheduler = IOSchedulerRoster::Default()->CreateScheduler(
 			info->dma_resource);
 		if (info->io_scheduler == NULL)
 			panic("allocating IOScheduler failed.");
@@ -5,8 +5,11 @@
 
 /** This module memorizes all opened files for a certain session. A session
  *	can be the start of an application or the boot process.
- *	When a session is started, it will prefetch all files from an earlier
- *	session in order to speed up the launching or booting process.
+ *	For every file, the parts that had to be read from disk are recorded, and
+ *	stored as a profile of the session when it ends.
+ *	When a session is started, it will prefetch the recorded parts of the
+ *	files from an earlier session in the order they were accessed in, in
+ *	order to speed up the launching or booting process.
  *
  *	Note: this module is using private kernel API and is definitely not
  *		meant to be an example on how to write modules.
@@ -49,9 +52,15 @@ extern dev_t gBootDevice;
 #define VNODE_HASH(mountid, vnodeid) (((uint32)((vnodeid) >> 32) \
 	+ (uint32)(vnodeid)) ^ (uint32)(mountid))
 
+static const int32 kMaxPartsPerNode = 64;
+static const off_t kMaxPartGap = 65536;
+	// reads that are closer together than this are merged into a single part
+static const off_t kMaxProfileSize = 1024 * 1024;
+
 struct data_part {
 	off_t		offset;
 	off_t		size;
+	bigtime_t	first_access;
 };
 
 struct node {
@@ -59,8 +68,9 @@ struct node {
 	node_ref	ref;
 	int32		ref_count;
 	bigtime_t	timestamp;
-	data_part	parts[5];
-	size_t		part_count;
+	data_part	*parts;
+	int32		part_count;
+	int32		part_capacity;
 };
 
 struct NodeHash {
@@ -108,6 +118,7 @@ class Session {
 
 		void AddNode(dev_t device, ino_t node);
 		void RemoveNode(dev_t device, ino_t node);
+		void AddRead(dev_t device, ino_t node, off_t offset, off_t size);
 
 		void Lock() { mutex_lock(&fLock); }
 		void Unlock() { mutex_unlock(&fLock); }
@@ -123,13 +134,16 @@ class Session {
 
 	private:
 		struct node *_FindNode(dev_t device, ino_t node);
+		int32 _CollectExtents(launch_speedup_extent *extents);
 
 		Session		*fNext;
 		char		fName[B_OS_NAME_LENGTH];
 		mutex		fLock;
 		NodeTable	*fNodeHash;
-		struct node	*fNodes;
+		launch_speedup_extent *fExtents;
+		int32		fExtentCount;
 		int32		fNodeCount;
+		int32		fPartCount;
 		team_id		fTeam;
 		node_ref	fNodeRef;
 		bigtime_t	fActiveUntil;
@@ -151,14 +165,6 @@ class SessionGetter {
 		Session	*fSession;
 };
 
-static Session *sMainSession;
-static SessionTable *sTeamHash;
-static PrefetchTable *sPrefetchHash;
-static Session *sMainPrefetchSessions;
-	// singly-linked list
-static recursive_lock sLock;
-
-
 node_ref::node_ref()
 {
 	// part of libbe.so
@@ -210,7 +216,7 @@ struct SessionHash {
 
 	bool Compare(KeyType key, ValueType* session) const
 	{
-		return session->Team == key;
+		return session->Team() == key;
 	}
 
 	ValueType*& GetLink(ValueType* value) const
@@ -222,6 +228,14 @@ struct SessionHash {
 typedef BOpenHashTable<SessionHash> SessionTable;
 
 
+static Session *sMainSession;
+static SessionTable *sTeamHash;
+static PrefetchTable *sPrefetchHash;
+static Session *sMainPrefetchSessions;
+	// singly-linked list
+static recursive_lock sLock;
+
+
 static void
 stop_session(Session *session)
 {
@@ -275,10 +289,8 @@ start_session(team_id team, dev_t device, ino_t node, const char *name,
 				break;
 			}
 		}
-	} else {
-		// ToDo: search for session by device/node ID
-		prefetchSession = NULL;
-	}
+	} else
+		prefetchSession = sPrefetchHash->Lookup(session->NodeRef());
 	if (prefetchSession != NULL) {
 		TRACE(("found prefetch session %s\n", prefetchSession->Name()));
 		prefetchSession->Prefetch();
@@ -328,16 +340,46 @@ new_node(dev_t device, ino_t id)
 
 	node->ref.device = device;
 	node->ref.node = id;
+	node->ref_count = 1;
 	node->timestamp = system_time();
+	node->parts = NULL;
+	node->part_count = 0;
+	node->part_capacity = 0;
 
 	return node;
 }
 
 
+static void
+delete_node(struct node *node)
+{
+	free(node->parts);
+	delete node;
+}
+
+
+static int
+compare_extents(const void *_a, const void *_b)
+{
+	const launch_speedup_extent *a = (const launch_speedup_extent *)_a;
+	const launch_speedup_extent *b = (const launch_speedup_extent *)_b;
+
+	if (a->first_access != b->first_access)
+		return a->first_access < b->first_access ? -1 : 1;
+	if (a->device != b->device)
+		return a->device < b->device ? -1 : 1;
+	if (a->node != b->node)
+		return a->node < b->node ? -1 : 1;
+	if (a->offset != b->offset)
+		return a->offset < b->offset ? -1 : 1;
+	return 0;
+}
+
+
 static void
 load_prefetch_data()
 {
-	DIR *dir = opendir("/etc/launch_cache");
+	DIR *dir = opendir(LAUNCH_SPEEDUP_PROFILE_DIRECTORY);
 	if (dir == NULL)
 		return;
 
@@ -371,8 +413,10 @@ load_prefetch_data()
 Session::Session(team_id team, const char *name, dev_t device,
 	ino_t node, int32 seconds)
 	:
-	fNodes(NULL),
+	fExtents(NULL),
+	fExtentCount(0),
 	fNodeCount(0),
+	fPartCount(0),
 	fTeam(team),
 	fClosing(false),
 	fIsWatchingTeam(false)
@@ -406,7 +450,10 @@ Session::Session(team_id team, const char *name, dev_t device,
 Session::Session(const char *name)
 	:
 	fNodeHash(NULL),
-	fNodes(NULL),
+	fExtents(NULL),
+	fExtentCount(0),
+	fNodeCount(0),
+	fPartCount(0),
 	fClosing(false),
 	fIsWatchingTeam(false)
 {
@@ -426,22 +473,17 @@ Session::~Session()
 	mutex_destroy(&fLock);
 
 	// free all nodes
-	struct node *node, *next = NULL;
-
-	if (fNodeHash) {
-		// ... from the hash
-		node = fNodeHash->Clear(true);
-	} else {
-		// ... from the list
-		node = fNodes;
-	}
-
-	for (; node != NULL; node = next) {
-		next = node->next;
-		free(node);
+	if (fNodeHash != NULL) {
+		struct node *node = fNodeHash->Clear(true);
+		while (node != NULL) {
+			struct node *next = node->next;
+			delete_node(node);
+			node = next;
+		}
 	}
 
 	delete fNodeHash;
+	free(fExtents);
 	StopWatchingTeam();
 }
 
@@ -492,7 +534,101 @@ Session::RemoveNode(dev_t device, ino_t id)
 	if (node != NULL && --node->ref_count <= 0) {
 		fNodeHash->Remove(node);
 		fNodeCount--;
+		fPartCount -= node->part_count;
+		delete_node(node);
+	}
+}
+
+
+/*!	Records that the given part of the file had to be read from disk. Parts
+	that are close to each other are merged, so that they can be read with
+	a single request later on.
+*/
+void
+Session::AddRead(dev_t device, ino_t id, off_t offset, off_t size)
+{
+	struct node *node = _FindNode(device, id);
+	if (node == NULL) {
+		// the file might have been opened before the session was started
+		AddNode(device, id);
+		node = _FindNode(device, id);
+		if (node == NULL)
+			return;
+	}
+
+	off_t end = offset + size;
+	data_part *closest = NULL;
+	off_t closestGap = 0;
+
+	for (int32 i = 0; i < node->part_count; i++) {
+		data_part &part = node->parts[i];
+		off_t gap = 0;
+		if (end < part.offset)
+			gap = part.offset - end;
+		else if (offset > part.offset + part.size)
+			gap = offset - (part.offset + part.size);
+
+		if (closest == NULL || gap < closestGap) {
+			closest = &part;
+			closestGap = gap;
+		}
+	}
+
+	if (closest == NULL || (closestGap > kMaxPartGap
+			&& node->part_count < kMaxPartsPerNode)) {
+		if (node->part_count == node->part_capacity) {
+			int32 capacity = max_c(4, node->part_capacity * 2);
+			data_part *parts = (data_part *)realloc(node->parts,
+				capacity * sizeof(data_part));
+			if (parts == NULL)
+				return;
+
+			node->parts = parts;
+			node->part_capacity = capacity;
+		}
+
+		data_part &part = node->parts[node->part_count++];
+		part.offset = offset;
+		part.size = size;
+		part.first_access = system_time();
+		fPartCount++;
+		return;
+	}
+
+	// extend the closest part to also cover this read
+	off_t partEnd = max_c(closest->offset + closest->size, end);
+	closest->offset = min_c(closest->offset, offset);
+	closest->size = partEnd - closest->offset;
+}
+
+
+/*!	Fills the \a extents array (which must be large enough for all parts) with
+	the parts of all nodes, and returns their count.
+*/
+int32
+Session::_CollectExtents(launch_speedup_extent *extents)
+{
+	int32 count = 0;
+
+	NodeTable::Iterator iterator(fNodeHash);
+	while (iterator.HasNext()) {
+		struct node *node = iterator.Next();
+
+		for (int32 i = 0; i < node->part_count; i++) {
+			data_part &part = node->parts[i];
+			bigtime_t firstAccess = (part.first_access - fTimestamp) / 1000;
+
+			launch_speedup_extent &extent = extents[count++];
+			extent.device = node->ref.device;
+			extent.first_access = (uint32)max_c(firstAccess, 0);
+			extent.node = node->ref.node;
+			extent.offset = part.offset;
+			extent.size = part.size;
+		}
 	}
+
+	qsort(extents, count, sizeof(launch_speedup_extent), &compare_extents);
+	return count;
 }
 
 
@@ -518,14 +654,35 @@ Session::StopWatchingTeam()
 }
 
 
+/*!	Prefetches the extents of the profile in the order they were accessed
+	in. Consecutive extents of the same file that are close to each other are
+	read with a single request.
+*/
 void
 Session::Prefetch()
 {
-	if (fNodes == NULL || fNodeHash != NULL)
+	if (fExtents == NULL || fNodeHash != NULL)
 		return;
 
-	for (struct node *node = fNodes; node != NULL; node = node->next) {
-		cache_prefetch(node->ref.device, node->ref.node, 0, ~0UL);
+	int32 index = 0;
+	while (index < fExtentCount) {
+		const launch_speedup_extent &first = fExtents[index++];
+		off_t offset = first.offset;
+		off_t end = first.offset + first.size;
+
+		while (index < fExtentCount) {
+			const launch_speedup_extent &next = fExtents[index];
+			if (next.device != first.device || next.node != first.node
+				|| next.offset > end + kMaxPartGap
+				|| next.offset + next.size < offset - kMaxPartGap)
+				break;
+
+			offset = min_c(offset, next.offset);
+			end = max_c(end, next.offset + next.size);
+			index++;
+		}
+
+		cache_prefetch(first.device, first.node, offset, end - offset);
 	}
 }
 
@@ -545,38 +702,34 @@ Session::LoadFromDirectory(int directoryFD)
 		return errno;
 	}
 
-	if (stat.st_size > 32768) {
-		// for safety reasons
-		// ToDo: make a bit larger later
+	launch_speedup_profile_header header;
+	if (stat.st_size > kMaxProfileSize
+		|| read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+		|| header.magic != LAUNCH_SPEEDUP_PROFILE_MAGIC
+		|| header.version != LAUNCH_SPEEDUP_PROFILE_VERSION
+		|| stat.st_size != (off_t)(sizeof(header)
+			+ header.extent_count * sizeof(launch_speedup_extent))) {
+		// this is not a profile we can use, it will be overwritten once
+		// the session ends
 		close(fd);
 		return B_BAD_DATA;
 	}
 
-	char *buffer = (char *)malloc(stat.st_size);
-	if (buffer == NULL) {
+	size_t size = header.extent_count * sizeof(launch_speedup_extent);
+	fExtents = (launch_speedup_extent *)malloc(size);
+	if (fExtents == NULL) {
 		close(fd);
 		return B_NO_MEMORY;
 	}
 
-	if (read(fd, buffer, stat.st_size) < stat.st_size) {
-		free(buffer);
+	if (read(fd, fExtents, size) != (ssize_t)size) {
 		close(fd);
 		return B_ERROR;
 	}
 
-	const char *line = buffer;
-	node_ref nodeRef;
-	while (parse_node_ref(line, nodeRef, &line)) {
-		struct node *node = new_node(nodeRef.device, nodeRef.node);
-		if (node != NULL) {
-			// note: this reverses the order of the nodes in the file
-			node->next = fNodes;
-			fNodes = node;
-		}
-		line++;
-	}
+	fExtentCount = header.extent_count;
+	fNodeCount = header.node_count;
 
-	free(buffer);
 	close(fd);
 	return B_OK;
 }
@@ -587,42 +740,40 @@ Session::Save()
 {
 	fClosing = true;
 
-	char name[B_OS_NAME_LENGTH + 25];
+	char name[B_OS_NAME_LENGTH + 64];
 	if (!IsMainSession()) {
-		snprintf(name, sizeof(name), "/etc/launch_cache/%ld:%Ld %s",
-			fNodeRef.device, fNodeRef.node, Name());
-	} else
-		snprintf(name, sizeof(name), "/etc/launch_cache/%s", Name());
+		snprintf(name, sizeof(name), LAUNCH_SPEEDUP_PROFILE_DIRECTORY
+			"/%ld:%Ld %s", fNodeRef.device, fNodeRef.node, Name());
+	} else {
+		snprintf(name, sizeof(name), LAUNCH_SPEEDUP_PROFILE_DIRECTORY "/%s",
+			Name());
+	}
+
+	size_t size = fPartCount * sizeof(launch_speedup_extent);
+	launch_speedup_extent *extents = (launch_speedup_extent *)malloc(size);
+	if (extents == NULL)
+		return B_NO_MEMORY;
+
+	launch_speedup_profile_header header;
+	header.magic = LAUNCH_SPEEDUP_PROFILE_MAGIC;
+	header.version = LAUNCH_SPEEDUP_PROFILE_VERSION;
+	header.extent_count = _CollectExtents(extents);
+	header.node_count = fNodeCount;
+	header.duration = system_time() - fTimestamp;
 
 	int fd = open(name, O_CREAT | O_TRUNC | O_WRONLY, 0644);
-	if (fd < B_OK)
+	if (fd < B_OK) {
+		free(extents);
 		return errno;
+	}
 
 	status_t status = B_OK;
-	off_t fileSize = 0;
-
-	// ToDo: order nodes by timestamp... (should improve launch speed)
-	// ToDo: test which parts of a file have been read (and save that as well)
-
-	// enlarge file, so that it can be written faster
-	ftruncate(fd, 512 * 1024);
-
-	NodeTable::Iterator iterator(fNodeHash);
-	while (iterator.HasNext()) {
-		struct node *node = iterator.Next();
-		snprintf(name, sizeof(name), "%ld:%Ld\n", node->ref.device, node->ref.node);
+	if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+		|| write(fd, extents, size) != (ssize_t)size)
+		status = errno;
 
-		ssize_t bytesWritten = write(fd, name, strlen(name));
-		if (bytesWritten < B_OK) {
-			status = bytesWritten;
-			break;
-		}
-
-		fileSize += bytesWritten;
-	}
-
-	ftruncate(fd, fileSize);
 	close(fd);
+	free(extents);
 
 	return status;
 }
@@ -633,11 +784,17 @@ Session::IsWorthSaving() const
 {
 	// ToDo: sort out entries with only very few nodes, and those that load
 	//	instantly, anyway
-	if (fNodeCount < 5 || system_time() - fTimestamp < 400000) {
+	if (fNodeCount < 5 || system_time() - fTimestamp < 400000
+		|| fPartCount == 0) {
 		// sort anything out that opens less than 5 files, or needs less
-		// than 0.4 seconds to load an run
+		// than 0.4 seconds to load an run -- and if nothing had to be read
+		// from disk, there is nothing to prefetch either
 		return false;
 	}
+	if ((off_t)(sizeof(launch_speedup_profile_header)
+			+ fPartCount * sizeof(launch_speedup_extent)) > kMaxProfileSize)
+		return false;
+
 	return true;
 }
 
@@ -758,6 +915,23 @@ node_closed(struct vnode *vnode, int32 fdType, dev_t device, ino_t node,
 }
 
 
+static void
+node_read(struct vnode *vnode, dev_t device, ino_t node, off_t offset,
+	size_t size)
+{
+	if (device < gBootDevice)
+		return;
+
+	Session *session;
+	SessionGetter getter(team_get_current_team_id(), &session);
+
+	if (session == NULL || !session->IsActive())
+		return;
+
+	session->AddRead(device, node, offset, size);
+}
+
+
 static status_t
 launch_speedup_control(const char *subsystem, uint32 function,
 	void *buffer, size_t bufferSize)
@@ -814,13 +988,13 @@ uninit()
 
 	Session *session = sTeamHash->Clear(true);
 	while (session != NULL) {
-		Session *next = session->next;
+		Session *next = session->Next();
 		delete session;
 		session = next;
 	}
 	session = sPrefetchHash->Clear(true);
 	while (session != NULL) {
-		Session *next = session->next;
+		Session *next = session->Next();
 		delete session;
 		session = next;
 	}
@@ -865,7 +1039,7 @@ init()
 
 	// read in prefetch knowledge base
 
-	mkdir("/etc/launch_cache", 0755);
+	mkdir(LAUNCH_SPEEDUP_PROFILE_DIRECTORY, 0755);
 	load_prefetch_data();
 
 	// start boot session
@@ -910,6 +1084,7 @@ static struct cache_module_info sLaunchSpeedupModule = {
 	node_opened,
 	node_closed,
 	NULL,
+	node_read,
 };
 
 
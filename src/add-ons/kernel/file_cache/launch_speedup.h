@@ -6,11 +6,39 @@
 #define LAUNCH_SPEEDUP_H
 
 
+#include <SupportDefs.h>
+
+
 // generic syscall interface
 #define LAUNCH_SPEEDUP_SYSCALLS "launch_speedup"
 
 #define LAUNCH_SPEEDUP_START_SESSION	1
 #define LAUNCH_SPEEDUP_STOP_SESSION		2
 
+// on-disk profile format, as stored in /etc/launch_cache
+
+#define LAUNCH_SPEEDUP_PROFILE_DIRECTORY	"/etc/launch_cache"
+#define LAUNCH_SPEEDUP_PROFILE_MAGIC		'LSpr'
+#define LAUNCH_SPEEDUP_PROFILE_VERSION		1
+
+struct launch_speedup_profile_header {
+	uint32	magic;
+	uint32	version;
+	uint32	extent_count;
+	uint32	node_count;
+	int64	duration;
+		// how long the session has been recorded, in microseconds
+};
+
+// The extents follow the header, ordered by the time of their first access
+struct launch_speedup_extent {
+	int32	device;
+	uint32	first_access;
+		// in milliseconds since the start of the session
+	int64	node;
+	int64	offset;
+	int64	size;
+};
+
 
 #endif	/* LAUNCH_SPEEDUP_H */
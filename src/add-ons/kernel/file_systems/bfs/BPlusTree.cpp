@@ -72,6 +72,12 @@ private:
 } _PACKED;
 
 
+#if !_BOOT_MODE
+static const off_t kPrefetchSize = 64 * 1024;
+	// how much of the tree's stream is read ahead of a TreeIterator
+#endif
+
+
 #ifdef DEBUG
 class NodeChecker {
 public:
@@ -404,6 +410,9 @@ CachedNode::SetToWritableHeader(Transaction& transaction)
 
 	InternalSetTo(&transaction, 0LL);
 
+	if (fNode != NULL)
+		fTree->_UpdateStatistics((bplustree_header*)fNode);
+
 	if (fNode != NULL && !fTree->fInTransaction) {
 		transaction.AddListener(fTree);
 		fTree->fInTransaction = true;
@@ -582,7 +591,8 @@ CachedNode::Allocate(Transaction& transaction, bplustree_node** _node,
 BPlusTree::BPlusTree(Transaction& transaction, Inode* stream, int32 nodeSize)
 	:
 	fStream(NULL),
-	fInTransaction(false)
+	fInTransaction(false),
+	fEntryCountChange(0)
 {
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
 	SetTo(transaction, stream);
@@ -597,6 +607,7 @@ BPlusTree::BPlusTree(Inode* stream)
 {
 #if !_BOOT_MODE
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
+	fEntryCountChange = 0;
 #endif
 
 	SetTo(stream);
@@ -613,6 +624,7 @@ BPlusTree::BPlusTree()
 {
 #if !_BOOT_MODE
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
+	fEntryCountChange = 0;
 #endif
 }
 
@@ -673,6 +685,7 @@ BPlusTree::SetTo(Transaction& transaction, Inode* stream, int32 nodeSize)
  	header->free_node_pointer
  		= HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
  	header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(nodeSize * 2);
+	_InitStatistics(header);
 
 	cached.Unset();
 
@@ -855,6 +868,7 @@ BPlusTree::MakeEmpty()
 		header->free_node_pointer
 			= HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
 	}
+	_InitStatistics(header);
 
 	bplustree_node* node = cached.SetToWritable(transaction, NodeSize(), false);
 	if (node == NULL)
@@ -944,6 +958,251 @@ BPlusTree::ModeToKeyType(mode_t mode)
 #endif // !_BOOT_MODE
 
 
+//	#pragma mark - statistics
+
+
+#if !_BOOT_MODE
+/*!	Collects the statistics of a tree from its keys, which have to be added
+	in ascending order.
+	For the histogram, a key is sampled every fStride entries. Whenever there
+	are twice as many samples as buckets, every other sample is dropped, and
+	the stride doubled. In the end, the buckets are chosen evenly from the
+	samples left, so that all of them contain about the same number of
+	entries, no matter how many there were.
+*/
+class StatisticsBuilder {
+public:
+								StatisticsBuilder();
+
+			void				Add(const uint8* key, uint16 keyLength,
+									bool newKey);
+			void				Finish(bplustree_statistics& statistics) const;
+
+private:
+	static	void				_SetBucket(bplustree_histogram_bucket& bucket,
+									int64 entries, const uint8* key,
+									uint16 keyLength);
+
+private:
+	static	const uint32		kMaxSamples = BPLUSTREE_HISTOGRAM_BUCKETS * 2;
+
+			bplustree_histogram_bucket fSamples[kMaxSamples];
+			bplustree_histogram_bucket fLast;
+			uint32				fSampleCount;
+			int64				fStride;
+			int64				fEntries;
+			int64				fKeys;
+};
+
+
+StatisticsBuilder::StatisticsBuilder()
+	:
+	fSampleCount(0),
+	fStride(1),
+	fEntries(0),
+	fKeys(0)
+{
+}
+
+
+void
+StatisticsBuilder::Add(const uint8* key, uint16 keyLength, bool newKey)
+{
+	fEntries++;
+	if (newKey)
+		fKeys++;
+
+	_SetBucket(fLast, fEntries, key, keyLength);
+
+	if (fEntries % fStride != 0)
+		return;
+
+	if (fSampleCount == kMaxSamples) {
+		for (uint32 i = 1; i < kMaxSamples; i += 2)
+			fSamples[i / 2] = fSamples[i];
+
+		fSampleCount = kMaxSamples / 2;
+		fStride *= 2;
+
+		if (fEntries % fStride != 0)
+			return;
+	}
+
+	_SetBucket(fSamples[fSampleCount++], fEntries, key, keyLength);
+}
+
+
+void
+StatisticsBuilder::Finish(bplustree_statistics& statistics) const
+{
+	memset(&statistics, 0, sizeof(bplustree_statistics));
+	statistics.magic = HOST_ENDIAN_TO_BFS_INT32(BPLUSTREE_STATISTICS_MAGIC);
+	statistics.entry_count = HOST_ENDIAN_TO_BFS_INT64(fEntries);
+	statistics.key_count = HOST_ENDIAN_TO_BFS_INT64(fKeys);
+	statistics.histogram_entries = HOST_ENDIAN_TO_BFS_INT64(fEntries);
+
+	if (fEntries == 0)
+		return;
+
+	// The last bucket always ends with the last key
+	uint32 samples = fSampleCount;
+	if (samples > 0 && fSamples[samples - 1].Entries() == fEntries)
+		samples--;
+
+	uint32 count = min_c(samples, BPLUSTREE_HISTOGRAM_BUCKETS - 1);
+	for (uint32 i = 0; i < count; i++)
+		statistics.buckets[i] = fSamples[(uint64)(i + 1) * samples / (count + 1)];
+
+	statistics.buckets[count] = fLast;
+	statistics.bucket_count = HOST_ENDIAN_TO_BFS_INT16(count + 1);
+}
+
+
+/*static*/ void
+StatisticsBuilder::_SetBucket(bplustree_histogram_bucket& bucket,
+	int64 entries, const uint8* key, uint16 keyLength)
+{
+	bucket.entries = HOST_ENDIAN_TO_BFS_INT64(entries);
+	bucket.key_length = HOST_ENDIAN_TO_BFS_INT16(keyLength);
+	memcpy(bucket.key, key, bucket.StoredKeyLength());
+}
+
+
+//	#pragma mark -
+
+
+/*!	Returns the statistics of the tree, if it has any. The entry count is
+	adjusted to the changes that have not been written back yet.
+*/
+status_t
+BPlusTree::GetStatistics(bplustree_statistics& statistics)
+{
+	CachedNode cached(this);
+	const bplustree_header* header = cached.SetToHeader();
+	if (header == NULL)
+		return B_IO_ERROR;
+
+	const bplustree_statistics* stored
+		= _Statistics(const_cast<bplustree_header*>(header));
+	if (stored == NULL || !stored->IsValid())
+		return B_ENTRY_NOT_FOUND;
+
+	memcpy(&statistics, stored, sizeof(bplustree_statistics));
+
+	int64 entries = statistics.EntryCount()
+		+ atomic_get64(&fEntryCountChange);
+	statistics.entry_count = HOST_ENDIAN_TO_BFS_INT64(max_c(entries, 0));
+	return B_OK;
+}
+
+
+/*!	Computes the statistics of the tree by iterating over all of its entries.
+	Use SetStatistics() to store them in the tree.
+*/
+status_t
+BPlusTree::CollectStatistics(bplustree_statistics& statistics)
+{
+	StatisticsBuilder* builder = new(std::nothrow) StatisticsBuilder;
+	if (builder == NULL)
+		return B_NO_MEMORY;
+	ObjectDeleter<StatisticsBuilder> builderDeleter(builder);
+
+	TreeIterator iterator(this);
+	iterator.SetPrefetch(true);
+
+	uint8 key[BPLUSTREE_MAX_KEY_LENGTH + 1];
+	uint16 keyLength;
+	uint16 duplicate;
+	off_t value;
+
+	status_t status;
+	while ((status = iterator.GetNextEntry(key, &keyLength, sizeof(key),
+			&value, &duplicate)) == B_OK) {
+		builder->Add(key, keyLength, duplicate < 2);
+	}
+	if (status != B_ENTRY_NOT_FOUND)
+		return status;
+
+	builder->Finish(statistics);
+	return B_OK;
+}
+
+
+status_t
+BPlusTree::SetStatistics(Transaction& transaction,
+	const bplustree_statistics& statistics)
+{
+	CachedNode cached(this);
+	bplustree_header* header = cached.SetToWritableHeader(transaction);
+	if (header == NULL)
+		return B_IO_ERROR;
+
+	bplustree_statistics* stored = _Statistics(header);
+	if (stored == NULL)
+		return B_NOT_SUPPORTED;
+
+	memcpy(stored, &statistics, sizeof(bplustree_statistics));
+	return B_OK;
+}
+
+
+/*!	The statistics follow the header in its node, if they fit. */
+bplustree_statistics*
+BPlusTree::_Statistics(bplustree_header* header) const
+{
+	if (header->NodeSize()
+			< sizeof(bplustree_header) + sizeof(bplustree_statistics)) {
+		return NULL;
+	}
+
+	return (bplustree_statistics*)((uint8*)header + sizeof(bplustree_header));
+}
+
+
+/*!	Starts empty statistics for an index, and clears the area for any other
+	tree.
+*/
+void
+BPlusTree::_InitStatistics(bplustree_header* header)
+{
+	atomic_set64(&fEntryCountChange, 0);
+
+	bplustree_statistics* statistics = _Statistics(header);
+	if (statistics == NULL)
+		return;
+
+	memset(statistics, 0, sizeof(bplustree_statistics));
+	if (fStream->IsIndex()) {
+		statistics->magic
+			= HOST_ENDIAN_TO_BFS_INT32(BPLUSTREE_STATISTICS_MAGIC);
+	}
+}
+
+
+/*!	Adds the entries that were inserted or removed since the last time to
+	the statistics. Since this is done whenever the header is changed anyway,
+	it doesn't cost an extra block in the transaction.
+*/
+void
+BPlusTree::_UpdateStatistics(bplustree_header* header)
+{
+	if (header->Magic() != BPLUSTREE_MAGIC)
+		return;
+
+	bplustree_statistics* statistics = _Statistics(header);
+	if (statistics == NULL || !statistics->IsValid())
+		return;
+
+	int64 change = atomic_get_and_set64(&fEntryCountChange, 0);
+	if (change == 0)
+		return;
+
+	int64 entries = max_c(statistics->EntryCount() + change, 0);
+	statistics->entry_count = HOST_ENDIAN_TO_BFS_INT64(entries);
+}
+#endif // !_BOOT_MODE
+
+
 //	#pragma mark - TransactionListener implementation
 
 
@@ -1677,6 +1936,18 @@ BPlusTree::_SplitNode(bplustree_node* node, off_t nodeOffset,
 status_t
 BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 	off_t value)
+{
+	status_t status = _Insert(transaction, key, keyLength, value);
+	if (status == B_OK)
+		atomic_add64(&fEntryCountChange, 1);
+
+	return status;
+}
+
+
+status_t
+BPlusTree::_Insert(Transaction& transaction, const uint8* key,
+	uint16 keyLength, off_t value)
 {
 	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
 		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
@@ -2097,6 +2368,18 @@ BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 status_t
 BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 	off_t value)
+{
+	status_t status = _Remove(transaction, key, keyLength, value);
+	if (status == B_OK)
+		atomic_add64(&fEntryCountChange, -1);
+
+	return status;
+}
+
+
+status_t
+BPlusTree::_Remove(Transaction& transaction, const uint8* key,
+	uint16 keyLength, off_t value)
 {
 	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
 		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
@@ -2561,6 +2844,9 @@ TreeIterator::TreeIterator(BPlusTree* tree)
 	fCurrentNodeOffset(BPLUSTREE_NULL)
 {
 #if !_BOOT_MODE
+	fPrefetch = false;
+	fPrefetchOffset = 0;
+
 	tree->_AddIterator(this);
 #endif
 }
@@ -2712,6 +2998,10 @@ TreeIterator::Traverse(int8 direction, void* key, uint16* keyLength,
 
 		// are there any more nodes?
 		if (fCurrentNodeOffset != BPLUSTREE_NULL) {
+#if !_BOOT_MODE
+			if (fPrefetch && forward)
+				_Prefetch(fCurrentNodeOffset);
+#endif
 			node = cached.SetTo(fCurrentNodeOffset);
 			if (!node)
 				RETURN_ERROR(B_ERROR);
@@ -2882,6 +3172,52 @@ TreeIterator::Stop()
 }
 
 
+#if !_BOOT_MODE
+/*!	Reads the part of the tree's stream that follows the node at
+	\a nodeOffset ahead, in the hope that it contains the next nodes to the
+	right. This is true for a tree that has been created via TreeBuilder, and
+	for all trees that grew mostly sequentially; for others, it will at least
+	bring in parts of the tree the iteration will need sooner or later.
+	The stream must be locked.
+*/
+void
+TreeIterator::_Prefetch(off_t nodeOffset)
+{
+	Inode* stream = fTree->fStream;
+	Volume* volume = stream->GetVolume();
+	uint32 blockShift = volume->BlockShift();
+
+	if (nodeOffset >= fPrefetchOffset
+		|| nodeOffset + 2 * kPrefetchSize < fPrefetchOffset) {
+		// we're outside of the current read ahead window, start a new one
+		fPrefetchOffset = nodeOffset & ~((off_t)volume->BlockSize() - 1);
+	} else if (fPrefetchOffset - nodeOffset >= kPrefetchSize / 2) {
+		// there is still enough left
+		return;
+	}
+
+	off_t end = min_c(nodeOffset + kPrefetchSize, stream->Size());
+	while (fPrefetchOffset < end) {
+		block_run run;
+		off_t runOffset;
+		if (stream->FindBlockRun(fPrefetchOffset, run, runOffset) != B_OK)
+			break;
+
+		off_t blockOffset = (fPrefetchOffset - runOffset) >> blockShift;
+		size_t count = min_c(run.Length() - blockOffset,
+			((end - fPrefetchOffset - 1) >> blockShift) + 1);
+		if (block_cache_prefetch(volume->BlockCache(),
+				volume->ToBlock(run) + blockOffset, &count) != B_OK
+			|| count == 0) {
+			break;
+		}
+
+		fPrefetchOffset += (off_t)count << blockShift;
+	}
+}
+#endif // !_BOOT_MODE
+
+
 #ifdef DEBUG
 void
 TreeIterator::Dump()
@@ -2900,6 +3236,500 @@ TreeIterator::Dump()
 #endif
 
 
+//	#pragma mark - TreeBuilder
+
+
+#if !_BOOT_MODE
+/*!	The node that is currently being filled on one level of the tree. The
+	keys, and values are collected in memory, and are only written to the
+	node at \c offset once it's complete.
+*/
+struct TreeBuilder::level {
+	off_t			offset;
+	off_t			leftLink;
+	uint16			count;
+	uint16			keyLength;
+	off_t*			values;
+	uint16*			keyEnds;
+	uint8*			keys;
+
+	uint8* KeyAt(uint16 index, uint16* _length) const
+	{
+		uint16 start = index > 0 ? keyEnds[index - 1] : 0;
+		*_length = keyEnds[index] - start;
+		return keys + start;
+	}
+
+	bool Fits(uint16 length, int32 limit) const
+	{
+		return int32(key_align(sizeof(bplustree_node) + keyLength + length)
+			+ (count + 1) * (sizeof(uint16) + sizeof(off_t))) < limit;
+	}
+
+	void Append(const uint8* key, uint16 length, off_t value)
+	{
+		memmove(keys + keyLength, key, length);
+		keyLength += length;
+		keyEnds[count] = keyLength;
+		values[count++] = value;
+	}
+};
+
+
+/*!	Builds the tree bottom up from keys that are added in sorted order; this
+	is much faster than inserting them one by one, as every node is written
+	only once, and there are no splits. The nodes are filled up to about 7/8,
+	so that later insertions don't immediately split all of them. The
+	statistics of the tree are computed on the way.
+
+	The tree must be empty. Its root node becomes the first leaf, and all
+	other nodes are allocated as needed, which takes them from the free list
+	in order first - this keeps the leaves mostly sequential in the stream
+	after BPlusTree::MakeEmpty().
+	No nodes are kept referenced between calls, so the caller may start a new
+	transaction between two of them, and should do so for large trees. The
+	stream must be write locked, though.
+	The tree is only valid again after Finish() succeeded; if anything fails,
+	it needs to be emptied again.
+*/
+TreeBuilder::TreeBuilder(BPlusTree* tree)
+	:
+	fTree(tree),
+	fNodeSize(tree->fNodeSize),
+	fStatistics(new(std::nothrow) StatisticsBuilder),
+	fLevelCount(0),
+	fValueCount(0),
+	fLastValue(0),
+	fFragmentOffset(BPLUSTREE_NULL),
+	fFragmentIndex(0),
+	fDuplicateCount(0),
+	fDuplicateOffset(BPLUSTREE_NULL),
+	fFirstDuplicateOffset(BPLUSTREE_NULL),
+	fPreviousDuplicateOffset(BPLUSTREE_NULL)
+{
+}
+
+
+TreeBuilder::~TreeBuilder()
+{
+	for (uint32 i = 0; i < fLevelCount; i++)
+		free(fLevels[i]);
+
+	delete fStatistics;
+}
+
+
+/*!	Adds the \a key with its \a value to the tree. Keys must be added in
+	ascending order; the values of duplicate keys must be ascending as well.
+*/
+status_t
+TreeBuilder::Add(Transaction& transaction, const uint8* key, uint16 keyLength,
+	off_t value)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	ASSERT_WRITE_LOCKED_INODE(fTree->fStream);
+
+	if (fLevelCount == 0) {
+		status_t status = _Start();
+		if (status != B_OK)
+			return status;
+	} else {
+		level& leaf = *fLevels[0];
+		uint16 lastLength;
+		uint8* lastKey = leaf.KeyAt(leaf.count - 1, &lastLength);
+
+		int32 compare = fTree->_CompareKeys(key, keyLength, lastKey,
+			lastLength);
+		if (compare < 0)
+			RETURN_ERROR(B_BAD_VALUE);
+		if (compare == 0) {
+			if (!fTree->fAllowDuplicates)
+				return B_NAME_IN_USE;
+			if (value <= fLastValue)
+				RETURN_ERROR(B_BAD_VALUE);
+
+			status_t status = _AddDuplicate(transaction, value);
+			if (status == B_OK && fStatistics != NULL)
+				fStatistics->Add(key, keyLength, false);
+			return status;
+		}
+
+		status_t status = _FlushDuplicates(transaction);
+		if (status != B_OK)
+			return status;
+	}
+
+	status_t status = _AddKey(transaction, 0, key, keyLength, value);
+	if (status != B_OK)
+		return status;
+
+	fValues[0] = value;
+	fValueCount = 1;
+	fLastValue = value;
+
+	if (fStatistics != NULL)
+		fStatistics->Add(key, keyLength, true);
+	return B_OK;
+}
+
+
+/*!	Writes out all nodes that are still pending, and makes the tree use its
+	new root.
+*/
+status_t
+TreeBuilder::Finish(Transaction& transaction)
+{
+	if (fLevelCount == 0) {
+		// nothing has been added, the tree is still empty
+		return B_OK;
+	}
+
+	status_t status = _FlushDuplicates(transaction);
+	if (status != B_OK)
+		return status;
+
+	// Closing a level adds its last node to the one above, which might even
+	// add another level
+	for (uint32 i = 0; i < fLevelCount; i++) {
+		status = _CloseNode(transaction, i, true);
+		if (status != B_OK)
+			return status;
+	}
+
+	CachedNode cached(fTree);
+	bplustree_header* header = cached.SetToWritableHeader(transaction);
+	if (header == NULL)
+		return B_IO_ERROR;
+
+	header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(
+		fLevels[fLevelCount - 1]->offset);
+	header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(fLevelCount);
+
+	// The statistics come for free; entries that have been inserted normally
+	// in the mean time are already part of the stored entry count
+	bplustree_statistics* statistics = fTree->_Statistics(header);
+	if (fStatistics != NULL && statistics != NULL) {
+		int64 entries = statistics->IsValid() ? statistics->EntryCount() : 0;
+		fStatistics->Finish(*statistics);
+		statistics->entry_count = HOST_ENDIAN_TO_BFS_INT64(
+			statistics->EntryCount() + entries);
+	}
+	return B_OK;
+}
+
+
+/*!	Makes sure the tree is empty, and uses its root node as the first leaf. */
+status_t
+TreeBuilder::_Start()
+{
+	off_t rootOffset = fTree->fHeader.RootNode();
+
+	CachedNode cached(fTree);
+	const bplustree_node* root = cached.SetTo(rootOffset);
+	if (root == NULL)
+		return B_IO_ERROR;
+	if (!root->IsLeaf() || root->NumKeys() != 0)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	return _AddLevel(rootOffset);
+}
+
+
+/*!	Adds another level on top of the tree, whose first node will be the one
+	at \a offset.
+*/
+status_t
+TreeBuilder::_AddLevel(off_t offset)
+{
+	if (fLevelCount == kMaxLevels)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	uint32 maxKeys = fNodeSize / (sizeof(uint16) + sizeof(off_t));
+	level* newLevel = (level*)malloc(sizeof(level)
+		+ maxKeys * (sizeof(off_t) + sizeof(uint16)) + fNodeSize);
+	if (newLevel == NULL)
+		return B_NO_MEMORY;
+
+	newLevel->offset = offset;
+	newLevel->leftLink = BPLUSTREE_NULL;
+	newLevel->count = 0;
+	newLevel->keyLength = 0;
+	newLevel->values = (off_t*)(newLevel + 1);
+	newLevel->keyEnds = (uint16*)(newLevel->values + maxKeys);
+	newLevel->keys = (uint8*)(newLevel->keyEnds + maxKeys);
+
+	fLevels[fLevelCount++] = newLevel;
+	return B_OK;
+}
+
+
+status_t
+TreeBuilder::_AllocateNode(Transaction& transaction, off_t* _offset)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node;
+	return cached.Allocate(transaction, &node, _offset);
+}
+
+
+/*!	Adds the \a key to the current node of the level at \a index; for index
+	nodes, the \a value is the child node that contains all keys up to, and
+	including this one.
+	If the key doesn't fit into the node anymore, the node is written, and
+	a new one is started.
+*/
+status_t
+TreeBuilder::_AddKey(Transaction& transaction, uint32 index, const uint8* key,
+	uint16 keyLength, off_t value)
+{
+	if (!fLevels[index]->Fits(keyLength, fNodeSize - fNodeSize / 8)) {
+		status_t status = _CloseNode(transaction, index, false);
+		if (status != B_OK)
+			return status;
+	}
+
+	fLevels[index]->Append(key, keyLength, value);
+	return B_OK;
+}
+
+
+/*!	Writes the current node of the level at \a index, and adds it to the
+	level above, creating that one if needed. Unless this is the \a last node
+	of its level, the next node is allocated, and started.
+
+	The last key of an index node is not stored in it, but its child becomes
+	the overflow link, and the key is moved up into the parent. When a full
+	index node is closed, its last child is moved to the next node as well, so
+	that every index node retains at least one key, even if the next one is
+	the last of its level.
+*/
+status_t
+TreeBuilder::_CloseNode(Transaction& transaction, uint32 index, bool last)
+{
+	level& current = *fLevels[index];
+	bool isLeaf = index == 0;
+	bool isRoot = last && index == fLevelCount - 1;
+
+	off_t nextOffset = BPLUSTREE_NULL;
+	if (!last) {
+		status_t status = _AllocateNode(transaction, &nextOffset);
+		if (status != B_OK)
+			return status;
+	}
+
+	// the keys that stay in this node
+	uint16 count = current.count;
+	if (!isLeaf)
+		count -= last ? 1 : 2;
+
+	if (!isLeaf && count == 0) {
+		// cannot happen as long as every node can hold at least three keys
+		RETURN_ERROR(B_ERROR);
+	}
+
+	status_t status = _WriteNode(transaction, current, count,
+		isLeaf ? BPLUSTREE_NULL : current.values[count], nextOffset);
+	if (status != B_OK)
+		return status;
+
+	if (isRoot)
+		return B_OK;
+
+	if (index + 1 == fLevelCount) {
+		off_t parentOffset;
+		status = _AllocateNode(transaction, &parentOffset);
+		if (status == B_OK)
+			status = _AddLevel(parentOffset);
+		if (status != B_OK)
+			return status;
+	}
+
+	// add the largest key of this node to its parent
+	uint16 separator = isLeaf ? count - 1 : count;
+	uint16 keyLength;
+	uint8* key = current.KeyAt(separator, &keyLength);
+
+	status = _AddKey(transaction, index + 1, key, keyLength, current.offset);
+	if (status != B_OK)
+		return status;
+
+	if (last)
+		return B_OK;
+
+	// start the next node
+
+	current.leftLink = current.offset;
+	current.offset = nextOffset;
+
+	if (isLeaf) {
+		current.count = 0;
+		current.keyLength = 0;
+	} else {
+		// keep the last child of the closed node
+		off_t child = current.values[current.count - 1];
+		key = current.KeyAt(current.count - 1, &keyLength);
+
+		current.count = 0;
+		current.keyLength = 0;
+		current.Append(key, keyLength, child);
+	}
+
+	return B_OK;
+}
+
+
+status_t
+TreeBuilder::_WriteNode(Transaction& transaction, const level& level,
+	uint16 count, off_t overflowLink, off_t rightLink)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node = cached.SetToWritable(transaction, level.offset,
+		false);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	uint16 keyLength = count > 0 ? level.keyEnds[count - 1] : 0;
+
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(level.leftLink);
+	node->right_link = HOST_ENDIAN_TO_BFS_INT64(rightLink);
+	node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(overflowLink);
+	node->all_key_count = HOST_ENDIAN_TO_BFS_INT16(count);
+	node->all_key_length = HOST_ENDIAN_TO_BFS_INT16(keyLength);
+
+	memcpy(node->Keys(), level.keys, keyLength);
+
+	uint16* keyLengths = node->KeyLengths();
+	off_t* values = node->Values();
+	for (uint16 i = 0; i < count; i++) {
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(level.keyEnds[i]);
+		values[i] = HOST_ENDIAN_TO_BFS_INT64(level.values[i]);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Adds another value to the last key. The first few are collected, and
+	put into a duplicate fragment once the key is complete; if there are more
+	than would fit in there, a list of duplicate nodes is written instead.
+*/
+status_t
+TreeBuilder::_AddDuplicate(Transaction& transaction, off_t value)
+{
+	fLastValue = value;
+
+	if (fValueCount < NUM_FRAGMENT_VALUES) {
+		fValues[fValueCount++] = value;
+		return B_OK;
+	}
+
+	if (fValueCount == NUM_FRAGMENT_VALUES) {
+		// the values don't fit into a fragment, switch to duplicate nodes
+		status_t status = _AllocateNode(transaction, &fDuplicateOffset);
+		if (status != B_OK)
+			return status;
+
+		fFirstDuplicateOffset = fDuplicateOffset;
+		fPreviousDuplicateOffset = BPLUSTREE_NULL;
+		memcpy(fDuplicates, fValues, sizeof(fValues));
+		fDuplicateCount = NUM_FRAGMENT_VALUES;
+	} else if (fDuplicateCount == NUM_DUPLICATE_VALUES) {
+		off_t nextOffset;
+		status_t status = _AllocateNode(transaction, &nextOffset);
+		if (status == B_OK)
+			status = _WriteDuplicateNode(transaction, nextOffset);
+		if (status != B_OK)
+			return status;
+
+		fPreviousDuplicateOffset = fDuplicateOffset;
+		fDuplicateOffset = nextOffset;
+		fDuplicateCount = 0;
+	}
+
+	fDuplicates[fDuplicateCount++] = value;
+	fValueCount++;
+	return B_OK;
+}
+
+
+/*!	Writes the values of the last key, if it had more than one, and links
+	them from the leaf.
+*/
+status_t
+TreeBuilder::_FlushDuplicates(Transaction& transaction)
+{
+	if (fValueCount < 2)
+		return B_OK;
+
+	off_t link;
+	if (fValueCount <= NUM_FRAGMENT_VALUES) {
+		if (fFragmentOffset == BPLUSTREE_NULL
+			|| fFragmentIndex >= bplustree_node::MaxFragments(fNodeSize)) {
+			CachedNode cached(fTree);
+			bplustree_node* fragment;
+			status_t status = cached.Allocate(transaction, &fragment,
+				&fFragmentOffset);
+			if (status != B_OK)
+				return status;
+
+			memset(fragment, 0, fNodeSize);
+			fFragmentIndex = 0;
+		}
+
+		CachedNode cached(fTree);
+		bplustree_node* fragment = cached.SetToWritable(transaction,
+			fFragmentOffset, false);
+		if (fragment == NULL)
+			return B_IO_ERROR;
+
+		duplicate_array* array = fragment->FragmentAt(fFragmentIndex);
+		array->count = HOST_ENDIAN_TO_BFS_INT64(fValueCount);
+		for (uint32 i = 0; i < fValueCount; i++)
+			array->SetValueAt(i, fValues[i]);
+
+		link = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_FRAGMENT,
+			fFragmentOffset, fFragmentIndex++);
+	} else {
+		status_t status = _WriteDuplicateNode(transaction, BPLUSTREE_NULL);
+		if (status != B_OK)
+			return status;
+
+		link = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_NODE,
+			fFirstDuplicateOffset);
+	}
+
+	level& leaf = *fLevels[0];
+	leaf.values[leaf.count - 1] = link;
+	fValueCount = 1;
+	return B_OK;
+}
+
+
+status_t
+TreeBuilder::_WriteDuplicateNode(Transaction& transaction, off_t rightLink)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node = cached.SetToWritable(transaction, fDuplicateOffset,
+		false);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(fPreviousDuplicateOffset);
+	node->right_link = HOST_ENDIAN_TO_BFS_INT64(rightLink);
+
+	duplicate_array* array = node->DuplicateArray();
+	array->count = HOST_ENDIAN_TO_BFS_INT64(fDuplicateCount);
+	for (uint32 i = 0; i < fDuplicateCount; i++)
+		array->SetValueAt(i, fDuplicates[i]);
+
+	return B_OK;
+}
+#endif // !_BOOT_MODE
+
+
 // #pragma mark -
 
 
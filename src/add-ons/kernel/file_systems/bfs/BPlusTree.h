@@ -60,6 +60,52 @@ struct bplustree_header {
 #define BPLUSTREE_MAX_KEY_LENGTH	256
 #define BPLUSTREE_MIN_KEY_LENGTH	1
 
+// Statistics about the keys of an index; they are stored in the otherwise
+// unused rest of the header node. They are only used to estimate the cost
+// of a query, and may be outdated.
+
+#define BPLUSTREE_STATISTICS_MAGIC		0x62737473
+#define BPLUSTREE_HISTOGRAM_BUCKETS		24
+#define BPLUSTREE_HISTOGRAM_KEY_LENGTH	22
+
+struct bplustree_histogram_bucket {
+	int64		entries;
+		// entries up to, and including the bucket's key
+	uint16		key_length;
+	uint8		key[BPLUSTREE_HISTOGRAM_KEY_LENGTH];
+		// only the start of longer keys is stored
+
+	int64 Entries() const { return BFS_ENDIAN_TO_HOST_INT64(entries); }
+	uint16 KeyLength() const { return BFS_ENDIAN_TO_HOST_INT16(key_length); }
+	uint16 StoredKeyLength() const
+		{ return KeyLength() < BPLUSTREE_HISTOGRAM_KEY_LENGTH
+			? KeyLength() : BPLUSTREE_HISTOGRAM_KEY_LENGTH; }
+} _PACKED;
+
+struct bplustree_statistics {
+	uint32		magic;
+	uint16		bucket_count;
+	uint16		_reserved;
+	int64		entry_count;
+	int64		key_count;
+		// the number of different keys at the time of the histogram
+	int64		histogram_entries;
+		// the number of entries at the time of the histogram
+	bplustree_histogram_bucket buckets[BPLUSTREE_HISTOGRAM_BUCKETS];
+
+	uint32 Magic() const { return BFS_ENDIAN_TO_HOST_INT32(magic); }
+	uint16 BucketCount() const
+		{ return BFS_ENDIAN_TO_HOST_INT16(bucket_count); }
+	int64 EntryCount() const { return BFS_ENDIAN_TO_HOST_INT64(entry_count); }
+	int64 KeyCount() const { return BFS_ENDIAN_TO_HOST_INT64(key_count); }
+	int64 HistogramEntries() const
+		{ return BFS_ENDIAN_TO_HOST_INT64(histogram_entries); }
+
+	bool IsValid() const
+		{ return Magic() == BPLUSTREE_STATISTICS_MAGIC
+			&& BucketCount() <= BPLUSTREE_HISTOGRAM_BUCKETS; }
+} _PACKED;
+
 enum bplustree_types {
 	BPLUSTREE_STRING_TYPE	= 0,
 	BPLUSTREE_INT32_TYPE	= 1,
@@ -149,6 +195,8 @@ enum bplustree_traversing {
 class BPlusTree;
 struct TreeCheck;
 class TreeIterator;
+class TreeBuilder;
+class StatisticsBuilder;
 
 
 #if !_BOOT_MODE
@@ -295,7 +343,19 @@ public:
 			status_t			Find(const uint8* key, uint16 keyLength,
 									off_t* value);
 
+			int32				CompareKeys(const void* key1, int keyLength1,
+									const void* key2, int keyLength2)
+									{ return _CompareKeys(key1, keyLength1,
+										key2, keyLength2); }
+
 #if !_BOOT_MODE
+			status_t			GetStatistics(
+									bplustree_statistics& statistics);
+			status_t			CollectStatistics(
+									bplustree_statistics& statistics);
+			status_t			SetStatistics(Transaction& transaction,
+									const bplustree_statistics& statistics);
+
 	static	int32				TypeCodeToKeyType(type_code code);
 	static	int32				ModeToKeyType(mode_t mode);
 
@@ -311,6 +371,18 @@ private:
 
 			int32				_CompareKeys(const void* key1, int keylength1,
 									const void* key2, int keylength2);
+#if !_BOOT_MODE
+			status_t			_Insert(Transaction& transaction,
+									const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_Remove(Transaction& transaction,
+									const uint8* key, uint16 keyLength,
+									off_t value);
+
+			bplustree_statistics* _Statistics(bplustree_header* header) const;
+			void				_InitStatistics(bplustree_header* header);
+			void				_UpdateStatistics(bplustree_header* header);
+#endif
 			status_t			_FindKey(const bplustree_node* node,
 									const uint8* key, uint16 keyLength,
 									uint16* index = NULL, off_t* next = NULL);
@@ -360,6 +432,7 @@ private:
 
 private:
 			friend class TreeIterator;
+			friend class TreeBuilder;
 			friend class CachedNode;
 			friend class TreeCheck;
 
@@ -373,6 +446,9 @@ private:
 #if !_BOOT_MODE
 			mutex				fIteratorLock;
 			SinglyLinkedList<TreeIterator> fIterators;
+
+			int64				fEntryCountChange;
+				// entries added since the statistics were written
 #endif
 };
 
@@ -400,6 +476,11 @@ public:
 									uint16* duplicate = NULL);
 			void				SkipDuplicates();
 
+#if !_BOOT_MODE
+			void				SetPrefetch(bool prefetch)
+									{ fPrefetch = prefetch; }
+#endif
+
 			BPlusTree*			Tree() const { return fTree; }
 
 #ifdef DEBUG
@@ -415,6 +496,10 @@ private:
 									int8 change);
 			void				Stop();
 
+#if !_BOOT_MODE
+			void				_Prefetch(off_t nodeOffset);
+#endif
+
 private:
 			BPlusTree*			fTree;
 			off_t				fCurrentNodeOffset;
@@ -424,7 +509,70 @@ private:
 			uint16				fDuplicate;
 			uint16				fNumDuplicates;
 			bool				fIsFragment;
+#if !_BOOT_MODE
+			bool				fPrefetch;
+			off_t				fPrefetchOffset;
+									// end of the stream range read ahead
+#endif
+};
+
+
+#if !_BOOT_MODE
+class TreeBuilder {
+public:
+								TreeBuilder(BPlusTree* tree);
+								~TreeBuilder();
+
+			status_t			Add(Transaction& transaction, const uint8* key,
+									uint16 keyLength, off_t value);
+			status_t			Finish(Transaction& transaction);
+
+private:
+			struct level;
+
+			status_t			_Start();
+			status_t			_AddLevel(off_t offset);
+			status_t			_AllocateNode(Transaction& transaction,
+									off_t* _offset);
+			status_t			_AddKey(Transaction& transaction,
+									uint32 index, const uint8* key,
+									uint16 keyLength, off_t value);
+			status_t			_CloseNode(Transaction& transaction,
+									uint32 index, bool last);
+			status_t			_WriteNode(Transaction& transaction,
+									const level& level, uint16 count,
+									off_t overflowLink, off_t rightLink);
+
+			status_t			_AddDuplicate(Transaction& transaction,
+									off_t value);
+			status_t			_FlushDuplicates(Transaction& transaction);
+			status_t			_WriteDuplicateNode(Transaction& transaction,
+									off_t rightLink);
+
+private:
+	static	const uint32		kMaxLevels = 16;
+
+			BPlusTree*			fTree;
+			int32				fNodeSize;
+			StatisticsBuilder*	fStatistics;
+			level*				fLevels[kMaxLevels];
+			uint32				fLevelCount;
+
+			// values of the last key added
+			off_t				fValues[NUM_FRAGMENT_VALUES];
+			uint32				fValueCount;
+			off_t				fLastValue;
+
+			off_t				fFragmentOffset;
+			uint32				fFragmentIndex;
+
+			off_t				fDuplicates[NUM_DUPLICATE_VALUES];
+			uint32				fDuplicateCount;
+			off_t				fDuplicateOffset;
+			off_t				fFirstDuplicateOffset;
+			off_t				fPreviousDuplicateOffset;
 };
+#endif // !_BOOT_MODE
 
 
 //	#pragma mark - BPlusTree's inline functions
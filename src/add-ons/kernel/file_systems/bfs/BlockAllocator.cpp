@@ -32,9 +32,17 @@
 // group can span several blocks in the block bitmap, the AllocationBlock
 // class is there to make handling those easier.
 
-// The current implementation is only slightly optimized and could probably
-// be improved a lot. Furthermore, the allocation policies used here should
-// have some real world tests.
+// To avoid reading the bitmap for every allocation, every allocation group
+// also keeps its free ranges in memory, as long as there aren't too many of
+// them: they are sorted by position, and by size, so that finding a range of
+// a certain size is logarithmic. Groups that are too fragmented, or whose
+// free ranges could not be trusted anymore, are searched in the bitmap.
+
+// Every allocation group has its own lock; only operations that work on the
+// bitmap as a whole (like initializing, trimming, and checking it) need the
+// allocator lock, and lock all groups as well.
+
+// The allocation policies used here should have some real world tests.
 
 #if BFS_TRACING && !defined(FS_SHELL)
 namespace BFSBlockTracing {
@@ -169,16 +177,111 @@ private:
 #endif
 
 
+static const int32 kMaxFreeExtents = 65536;
+	// the number of free extents the groups of a volume may use together
+static const int32 kMinGroupFreeExtents = 16;
+static const int32 kMaxGroupFreeExtents = 1024;
+
+static const int32 kMaxAllocationAttempts = 8;
+
+static const int32 kStreamGroupSpread = 8;
+static const bigtime_t kStreamIdleTime = 500000;
+	// files that haven't grown for that long don't keep others out of
+	// their allocation group anymore
+
+static const size_t kMaxIndexEntryMemory = 64 * 1024 * 1024;
+	// how much memory the index pass of checkfs may use to collect the
+	// entries of the indices it rebuilds
+static const uint32 kIndexEntriesPerTransaction = 4096;
+
+
+/*!	An entry collected for an index that is being rebuilt; they are stored
+	one after the other in the check_index::entries buffer.
+*/
+struct index_entry {
+	off_t				value;
+	uint16				key_length;
+	uint8				key[0];
+
+	static size_t Size(uint16 keyLength)
+	{
+		return (offsetof(index_entry, key) + keyLength + sizeof(off_t) - 1)
+			& ~(sizeof(off_t) - 1);
+	}
+
+	static size_t MaxCount(size_t capacity)
+	{
+		return capacity / Size(BPLUSTREE_MIN_KEY_LENGTH);
+	}
+};
+
+
 struct check_index {
 	check_index()
 		:
-		inode(NULL)
+		inode(NULL),
+		entries(NULL),
+		entries_size(0),
+		entries_capacity(0),
+		offsets(NULL),
+		count(0),
+		collecting(true)
+	{
+	}
+
+	~check_index()
 	{
+		free(entries);
+		free(offsets);
 	}
 
 	char				name[B_FILE_NAME_LENGTH];
 	block_run			run;
 	Inode*				inode;
+
+	// The entries are collected during the index pass, and then added to the
+	// emptied tree in sorted order. If that would need too much memory, the
+	// remaining entries are inserted one by one.
+	uint8*				entries;
+	size_t				entries_size;
+	size_t				entries_capacity;
+	uint32*				offsets;
+	uint32				count;
+	bool				collecting;
+
+	size_t MemoryUsage() const
+	{
+		return entries_capacity
+			+ index_entry::MaxCount(entries_capacity) * sizeof(uint32);
+	}
+};
+
+
+/*!	Orders the entries collected in a check_index by key, and value. */
+struct IndexEntryLess {
+	IndexEntryLess(BPlusTree* tree, const uint8* entries)
+		:
+		fTree(tree),
+		fEntries(entries)
+	{
+	}
+
+	bool operator()(uint32 offsetA, uint32 offsetB) const
+	{
+		const index_entry* a = (const index_entry*)(fEntries + offsetA);
+		const index_entry* b = (const index_entry*)(fEntries + offsetB);
+
+		int32 compare = fTree->CompareKeys(a->key, a->key_length, b->key,
+			b->key_length);
+		if (compare != 0)
+			return compare < 0;
+
+		return a->value < b->value;
+	}
+
+private:
+	BPlusTree*			fTree;
+	const uint8*		fEntries;
 };
 
 
@@ -195,6 +298,113 @@ struct check_cookie {
 	TreeIterator*		iterator;
 	check_control		control;
 	Stack<check_index*>	indices;
+	size_t				index_memory;
+};
+
+
+struct FreeExtentKey {
+	int32				length;
+	int32				start;
+};
+
+
+struct FreeExtent {
+	FreeExtentKey		key;
+	SplayTreeLink<FreeExtent> startLink;
+	SplayTreeLink<FreeExtent> lengthLink;
+
+	int32 Start() const { return key.start; }
+	int32 Length() const { return key.length; }
+	int32 End() const { return key.start + key.length; }
+};
+
+
+struct FreeExtentStartTreeDefinition {
+	typedef int32		KeyType;
+	typedef FreeExtent	NodeType;
+
+	static const KeyType& GetKey(const NodeType* node)
+	{
+		return node->key.start;
+	}
+
+	static SplayTreeLink<NodeType>* GetLink(NodeType* node)
+	{
+		return &node->startLink;
+	}
+
+	static int Compare(const KeyType& key, const NodeType* node)
+	{
+		if (key < node->key.start)
+			return -1;
+		return key == node->key.start ? 0 : 1;
+	}
+};
+
+
+struct FreeExtentLengthTreeDefinition {
+	typedef FreeExtentKey KeyType;
+	typedef FreeExtent	NodeType;
+
+	static const KeyType& GetKey(const NodeType* node)
+	{
+		return node->key;
+	}
+
+	static SplayTreeLink<NodeType>* GetLink(NodeType* node)
+	{
+		return &node->lengthLink;
+	}
+
+	static int Compare(const KeyType& key, const NodeType* node)
+	{
+		if (key.length != node->key.length)
+			return key.length < node->key.length ? -1 : 1;
+		if (key.start != node->key.start)
+			return key.start < node->key.start ? -1 : 1;
+		return 0;
+	}
+};
+
+
+typedef SplayTree<FreeExtentStartTreeDefinition> FreeExtentStartTree;
+typedef SplayTree<FreeExtentLengthTreeDefinition> FreeExtentLengthTree;
+
+
+/*!	The free ranges of an allocation group. As soon as the tree cannot follow
+	the block bitmap anymore (because it would need too many extents, or
+	there is not enough memory), it invalidates itself, and the group has to
+	be searched in the bitmap again.
+*/
+class FreeExtentTree {
+public:
+	FreeExtentTree();
+	~FreeExtentTree();
+
+	void Init(int32 maxCount);
+	void Invalidate();
+
+	bool IsValid() const { return fValid; }
+	int32 Count() const { return fCount; }
+
+	void AddRange(int32 start, int32 length);
+	void RemoveRange(int32 start, int32 length);
+
+	FreeExtent* FindAt(int32 start);
+	FreeExtent* FindBestFit(int32 length);
+	FreeExtent* FindLargest();
+	bool Contains(int32 start, int32 length);
+
+private:
+	FreeExtent* _Insert(int32 start, int32 length);
+	void _Remove(FreeExtent* extent);
+	void _Resize(FreeExtent* extent, int32 start, int32 length);
+
+	FreeExtentStartTree	fStartTree;
+	FreeExtentLengthTree fLengthTree;
+	int32	fCount;
+	int32	fMaxCount;
+	bool	fValid;
 };
 
 
@@ -225,20 +435,28 @@ private:
 class AllocationGroup {
 public:
 	AllocationGroup();
+	~AllocationGroup();
 
 	void AddFreeRange(int32 start, int32 blocks);
 	bool IsFull() const { return fFreeBits == 0; }
+	bool IsFree(Volume* volume, int32 start, int32 length);
 
 	status_t Allocate(Transaction& transaction, uint16 start, int32 length);
 	status_t Free(Transaction& transaction, uint16 start, int32 length);
 
+	void UpdateFreeExtents(Volume* volume, int32 maxCount);
+	void Invalidate();
+
 	uint32 NumBits() const { return fNumBits; }
 	uint32 NumBlocks() const { return fNumBlocks; }
 	int32 Start() const { return fStart; }
 
+	mutex& Lock() { return fLock; }
+
 private:
 	friend class BlockAllocator;
 
+	mutex	fLock;
 	uint32	fNumBits;
 	uint32	fNumBlocks;
 	int32	fStart;
@@ -248,6 +466,96 @@ private:
 	int32	fLargestStart;
 	int32	fLargestLength;
 	bool	fLargestValid;
+
+	FreeExtentTree fFreeExtents;
+	int32	fRebuildFreeBits;
+		// the free bits at the time the free extents could not be built,
+		// or -1 if they should be rebuilt as soon as possible
+
+	ino_t	fStreamInode;
+	bigtime_t fStreamTime;
+		// the file that has last grown in this group, and when
+};
+
+
+/*!	Locks all allocation groups in order. It's used by those operations that
+	work on the whole bitmap.
+*/
+class AllocationGroupsLocker {
+public:
+	AllocationGroupsLocker(AllocationGroup* groups, int32 count,
+		bool alreadyLocked = false)
+		:
+		fGroups(groups),
+		fCount(count),
+		fLocked(alreadyLocked)
+	{
+		if (!fLocked) {
+			for (int32 i = 0; i < fCount; i++)
+				mutex_lock(&fGroups[i].Lock());
+			fLocked = true;
+		}
+	}
+
+	~AllocationGroupsLocker()
+	{
+		Unlock();
+	}
+
+	void Unlock()
+	{
+		if (!fLocked)
+			return;
+
+		for (int32 i = fCount; i-- > 0;)
+			mutex_unlock(&fGroups[i].Lock());
+		fLocked = false;
+	}
+
+private:
+	AllocationGroup*	fGroups;
+	int32				fCount;
+	bool				fLocked;
+};
+
+
+/*!	Invalidates the in-memory state of the allocation groups, and returns
+	the blocks the transaction allocated to the used blocks count when a
+	transaction that changed the bitmap fails, as the block cache then
+	reverts the bitmap blocks behind our back.
+*/
+class BitmapTransactionListener : public TransactionListener {
+public:
+	BitmapTransactionListener(BlockAllocator* allocator)
+		:
+		fAllocator(allocator),
+		fListening(false)
+	{
+	}
+
+	void Listen(Transaction& transaction)
+	{
+		// The journal only runs one transaction at a time, and we're always
+		// called with it locked.
+		if (!fListening) {
+			transaction.AddListener(this);
+			fListening = true;
+		}
+	}
+
+	virtual void TransactionDone(bool success)
+	{
+		fAllocator->_TransactionDone(success);
+	}
+
+	virtual void RemovedFromTransaction()
+	{
+		fListening = false;
+	}
+
+private:
+	BlockAllocator*		fAllocator;
+	bool				fListening;
 };
 
 
@@ -369,6 +677,201 @@ AllocationBlock::Free(uint16 start, uint16 numBlocks)
 //	#pragma mark -
 
 
+FreeExtentTree::FreeExtentTree()
+	:
+	fCount(0),
+	fMaxCount(0),
+	fValid(false)
+{
+}
+
+
+FreeExtentTree::~FreeExtentTree()
+{
+	Invalidate();
+}
+
+
+/*!	Empties the tree, and makes it valid again. */
+void
+FreeExtentTree::Init(int32 maxCount)
+{
+	Invalidate();
+
+	fMaxCount = maxCount;
+	fValid = true;
+}
+
+
+void
+FreeExtentTree::Invalidate()
+{
+	while (FreeExtent* extent = fStartTree.FindMin()) {
+		fStartTree.Remove(extent);
+		fLengthTree.Remove(extent);
+		delete extent;
+	}
+
+	fCount = 0;
+	fValid = false;
+}
+
+
+/*!	Adds the range to the tree, and merges it with its neighbours. */
+void
+FreeExtentTree::AddRange(int32 start, int32 length)
+{
+	if (!fValid)
+		return;
+
+	int32 end = start + length;
+	FreeExtent* previous = fStartTree.FindClosest(start, false, true);
+	FreeExtent* next = fStartTree.FindClosest(start, true, false);
+
+	if ((previous != NULL && previous->End() > start)
+		|| (next != NULL && next->Start() < end)) {
+		// the range is already free, at least partially -- we cannot trust
+		// our data anymore
+		Invalidate();
+		return;
+	}
+
+	if (previous != NULL && previous->End() == start) {
+		if (next != NULL && next->Start() == end) {
+			end = next->End();
+			_Remove(next);
+		}
+		_Resize(previous, previous->Start(), end - previous->Start());
+	} else if (next != NULL && next->Start() == end)
+		_Resize(next, start, next->End() - start);
+	else
+		_Insert(start, length);
+}
+
+
+/*!	Removes the range from the tree; it does not need to be completely free.
+*/
+void
+FreeExtentTree::RemoveRange(int32 start, int32 length)
+{
+	if (!fValid)
+		return;
+
+	int32 end = start + length;
+	FreeExtent* extent = FindAt(start);
+
+	while (extent != NULL && extent->Start() < end) {
+		FreeExtent* next = NULL;
+		if (extent->End() < end)
+			next = fStartTree.FindClosest(extent->Start(), true, false);
+
+		int32 extentStart = extent->Start();
+		int32 extentEnd = extent->End();
+
+		if (extentStart < start) {
+			// keep the head, and maybe the tail as another extent
+			_Resize(extent, extentStart, start - extentStart);
+			if (extentEnd > end)
+				_Insert(end, extentEnd - end);
+		} else if (extentEnd > end)
+			_Resize(extent, end, extentEnd - end);
+		else
+			_Remove(extent);
+
+		extent = next;
+	}
+}
+
+
+/*!	Returns the extent that contains \a start, or the first one after it.
+*/
+FreeExtent*
+FreeExtentTree::FindAt(int32 start)
+{
+	FreeExtent* extent = fStartTree.FindClosest(start, false, true);
+	if (extent != NULL && extent->End() > start)
+		return extent;
+
+	return fStartTree.FindClosest(start, true, false);
+}
+
+
+/*!	Returns the smallest extent that can hold \a length blocks. */
+FreeExtent*
+FreeExtentTree::FindBestFit(int32 length)
+{
+	FreeExtentKey key = { length, 0 };
+	return fLengthTree.FindClosest(key, true, true);
+}
+
+
+FreeExtent*
+FreeExtentTree::FindLargest()
+{
+	return fLengthTree.FindMax();
+}
+
+
+bool
+FreeExtentTree::Contains(int32 start, int32 length)
+{
+	FreeExtent* extent = fStartTree.FindClosest(start, false, true);
+	return extent != NULL && extent->End() >= start + length;
+}
+
+
+FreeExtent*
+FreeExtentTree::_Insert(int32 start, int32 length)
+{
+	if (fCount >= fMaxCount) {
+		Invalidate();
+		return NULL;
+	}
+
+	FreeExtent* extent = new(std::nothrow) FreeExtent;
+	if (extent == NULL) {
+		Invalidate();
+		return NULL;
+	}
+
+	extent->key.start = start;
+	extent->key.length = length;
+
+	fStartTree.Insert(extent);
+	fLengthTree.Insert(extent);
+	fCount++;
+	return extent;
+}
+
+
+void
+FreeExtentTree::_Remove(FreeExtent* extent)
+{
+	fStartTree.Remove(extent);
+	fLengthTree.Remove(extent);
+	fCount--;
+
+	delete extent;
+}
+
+
+void
+FreeExtentTree::_Resize(FreeExtent* extent, int32 start, int32 length)
+{
+	fStartTree.Remove(extent);
+	fLengthTree.Remove(extent);
+
+	extent->key.start = start;
+	extent->key.length = length;
+
+	fStartTree.Insert(extent);
+	fLengthTree.Insert(extent);
+}
+
+
+//	#pragma mark -
+
+
 /*!	The allocation groups are created and initialized in
 	BlockAllocator::Initialize() and BlockAllocator::InitializeAndClearBitmap()
 	respectively.
@@ -377,8 +880,18 @@ AllocationGroup::AllocationGroup()
 	:
 	fFirstFree(-1),
 	fFreeBits(0),
-	fLargestValid(false)
+	fLargestValid(false),
+	fRebuildFreeBits(-1),
+	fStreamInode(-1),
+	fStreamTime(0)
+{
+	mutex_init(&fLock, "bfs allocation group");
+}
+
+
+AllocationGroup::~AllocationGroup()
 {
+	mutex_destroy(&fLock);
 }
 
 
@@ -398,14 +911,45 @@ AllocationGroup::AddFreeRange(int32 start, int32 blocks)
 	}
 
 	fFreeBits += blocks;
+	fFreeExtents.AddRange(start, blocks);
+}
+
+
+/*!	Checks whether the given range is still completely free.
+	Assumes that the group lock is held.
+*/
+bool
+AllocationGroup::IsFree(Volume* volume, int32 start, int32 length)
+{
+	if (fFreeExtents.IsValid())
+		return fFreeExtents.Contains(start, length);
+
+	uint32 bitsPerBlock = volume->BlockSize() << 3;
+	uint32 block = start / bitsPerBlock;
+	uint32 bit = start % bitsPerBlock;
+
+	AllocationBlock cached(volume);
+
+	for (; block < fNumBlocks && length > 0; block++, bit = 0) {
+		if (cached.SetTo(*this, block) != B_OK)
+			return false;
+
+		for (; bit < cached.NumBlockBits() && length > 0; bit++, length--) {
+			if (cached.IsUsed(bit))
+				return false;
+		}
+	}
+
+	return length == 0;
 }
 
 
 /*!	Allocates the specified run in the allocation group.
 	Doesn't check if the run is valid or already allocated partially, nor
-	does it maintain the free ranges hints or the volume's used blocks count.
-	It only does the low-level work of allocating some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	does it maintain the volume's used blocks count.
+	It does the low-level work of allocating some bits in the block bitmap,
+	and keeps the free extents up to date.
+	Assumes that the group lock is held.
 */
 status_t
 AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
@@ -413,11 +957,12 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 	ASSERT(start + length <= (int32)fNumBits);
 
 	// Update the allocation group info
-	// TODO: this info will be incorrect if something goes wrong later
-	// Note, the fFirstFree block doesn't have to be really free
+	// Note, the fFirstFree block doesn't have to be really free; if the
+	// transaction fails, the BitmapTransactionListener invalidates the info
 	if (start == fFirstFree)
 		fFirstFree = start + length;
 	fFreeBits -= length;
+	fFreeExtents.RemoveRange(start, length);
 
 	if (fLargestValid) {
 		bool cut = false;
@@ -472,9 +1017,10 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 
 /*!	Frees the specified run in the allocation group.
 	Doesn't check if the run is valid or was not completely allocated, nor
-	does it maintain the free ranges hints or the volume's used blocks count.
-	It only does the low-level work of freeing some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	does it maintain the volume's used blocks count.
+	It does the low-level work of freeing some bits in the block bitmap, and
+	keeps the free extents up to date.
+	Assumes that the group lock is held.
 */
 status_t
 AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
@@ -482,10 +1028,10 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 	ASSERT(start + length <= (int32)fNumBits);
 
 	// Update the allocation group info
-	// TODO: this info will be incorrect if something goes wrong later
 	if (fFirstFree > start)
 		fFirstFree = start;
 	fFreeBits += length;
+	fFreeExtents.AddRange(start, length);
 
 	// The range to be freed cannot be part of the valid largest range
 	ASSERT(!fLargestValid || start + length <= fLargestStart
@@ -530,25 +1076,123 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 }
 
 
-//	#pragma mark -
-
-
-BlockAllocator::BlockAllocator(Volume* volume)
-	:
-	fVolume(volume),
-	fGroups(NULL),
-	fCheckBitmap(NULL),
-	fCheckCookie(NULL)
+/*!	Rebuilds the free extents from the block bitmap if they have been
+	invalidated, and corrects the other allocation group info on the way.
+	If the group was too fragmented the last time, this is only tried again
+	once its number of free blocks has changed considerably.
+	Assumes that the group lock is held.
+*/
+void
+AllocationGroup::UpdateFreeExtents(Volume* volume, int32 maxCount)
 {
-	recursive_lock_init(&fLock, "bfs allocator");
-}
+	if (fFreeExtents.IsValid())
+		return;
 
+	if (fRebuildFreeBits >= 0) {
+		int32 change = fFreeBits - fRebuildFreeBits;
+		if (change < 0)
+			change = -change;
+		if (change < int32(fNumBits >> 4))
+			return;
+	}
 
-BlockAllocator::~BlockAllocator()
-{
-	recursive_lock_destroy(&fLock);
-	delete[] fGroups;
-}
+	fFreeExtents.Init(maxCount);
+
+	AllocationBlock cached(volume);
+	int32 freeBits = 0;
+	int32 firstFree = -1;
+	int32 largestStart = -1;
+	int32 largestLength = 0;
+	int32 start = -1;
+	int32 range = 0;
+	int32 bit = 0;
+
+	for (uint32 block = 0; block < fNumBlocks; block++) {
+		if (cached.SetTo(*this, block) != B_OK) {
+			fFreeExtents.Invalidate();
+			fRebuildFreeBits = -1;
+			return;
+		}
+
+		for (uint32 i = 0; i < cached.NumBlockBits(); i++, bit++) {
+			if (!cached.IsUsed(i)) {
+				if (range++ == 0)
+					start = bit;
+				continue;
+			}
+			if (range == 0)
+				continue;
+
+			// end of a free range
+			fFreeExtents.AddRange(start, range);
+			if (firstFree < 0)
+				firstFree = start;
+			if (range > largestLength) {
+				largestStart = start;
+				largestLength = range;
+			}
+			freeBits += range;
+			range = 0;
+		}
+	}
+	if (range > 0) {
+		fFreeExtents.AddRange(start, range);
+		if (firstFree < 0)
+			firstFree = start;
+		if (range > largestLength) {
+			largestStart = start;
+			largestLength = range;
+		}
+		freeBits += range;
+	}
+
+	fFreeBits = freeBits;
+	fFirstFree = firstFree >= 0 ? firstFree : fNumBits;
+	fLargestStart = largestStart;
+	fLargestLength = largestLength;
+	fLargestValid = largestLength > 0;
+	fRebuildFreeBits = fFreeBits;
+}
+
+
+/*!	Forgets everything we know about the free ranges of this group beyond
+	what's in the block bitmap.
+	Assumes that the group lock is held.
+*/
+void
+AllocationGroup::Invalidate()
+{
+	fFreeExtents.Invalidate();
+	fRebuildFreeBits = -1;
+	fFirstFree = 0;
+	fLargestValid = false;
+}
+
+
+//	#pragma mark -
+
+
+BlockAllocator::BlockAllocator(Volume* volume)
+	:
+	fVolume(volume),
+	fGroups(NULL),
+	fTransactionUsedBlocks(0),
+	fTransactionListener(NULL),
+	fCheckBitmap(NULL),
+	fCheckCookie(NULL)
+{
+	recursive_lock_init(&fLock, "bfs allocator");
+	mutex_init(&fUsedBlocksLock, "bfs allocator used blocks");
+}
+
+
+BlockAllocator::~BlockAllocator()
+{
+	recursive_lock_destroy(&fLock);
+	mutex_destroy(&fUsedBlocksLock);
+	delete[] fGroups;
+	delete fTransactionListener;
+}
 
 
 status_t
@@ -559,6 +1203,16 @@ BlockAllocator::Initialize(bool full)
 	fNumBlocks = (fVolume->NumBlocks() + fVolume->BlockSize() * 8 - 1)
 		/ (fVolume->BlockSize() * 8);
 
+	fMaxGroupExtents = kMaxFreeExtents / max_c(fNumGroups, 1);
+	if (fMaxGroupExtents < kMinGroupFreeExtents)
+		fMaxGroupExtents = kMinGroupFreeExtents;
+	else if (fMaxGroupExtents > kMaxGroupFreeExtents)
+		fMaxGroupExtents = kMaxGroupFreeExtents;
+
+	fTransactionListener = new(std::nothrow) BitmapTransactionListener(this);
+	if (fTransactionListener == NULL)
+		return B_NO_MEMORY;
+
 	fGroups = new(std::nothrow) AllocationGroup[fNumGroups];
 	if (fGroups == NULL)
 		return B_NO_MEMORY;
@@ -567,7 +1221,9 @@ BlockAllocator::Initialize(bool full)
 		return B_OK;
 
 	recursive_lock_lock(&fLock);
-		// the lock will be released by the _Initialize() method
+	for (int32 i = 0; i < fNumGroups; i++)
+		mutex_lock(&fGroups[i].Lock());
+		// the locks will be released by the _Initialize() method
 
 	thread_id id = spawn_kernel_thread((thread_func)BlockAllocator::_Initialize,
 		"bfs block allocator", B_LOW_PRIORITY, this);
@@ -575,6 +1231,8 @@ BlockAllocator::Initialize(bool full)
 		return _Initialize(this);
 
 	recursive_lock_transfer_lock(&fLock, id);
+	for (int32 i = 0; i < fNumGroups; i++)
+		mutex_transfer_lock(&fGroups[i].Lock(), id);
 
 	return resume_thread(id);
 }
@@ -621,6 +1279,8 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		fGroups[i].fFirstFree = fGroups[i].fLargestStart = 0;
 		fGroups[i].fFreeBits = fGroups[i].fLargestLength = fGroups[i].fNumBits;
 		fGroups[i].fLargestValid = true;
+		fGroups[i].fFreeExtents.Init(fMaxGroupExtents);
+		fGroups[i].fFreeExtents.AddRange(0, fGroups[i].fNumBits);
 
 		offset += fBlocksPerGroup;
 	}
@@ -643,8 +1303,10 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 status_t
 BlockAllocator::_Initialize(BlockAllocator* allocator)
 {
-	// The lock must already be held at this point
+	// The locks must already be held at this point
 	RecursiveLocker locker(allocator->fLock, true);
+	AllocationGroupsLocker groupsLocker(allocator->fGroups,
+		allocator->fNumGroups, true);
 
 	Volume* volume = allocator->fVolume;
 	uint32 blocks = allocator->fBlocksPerGroup;
@@ -659,6 +1321,7 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 	off_t offset = 1;
 	uint32 bitsPerGroup = 8 * (blocks << blockShift);
 	int32 numGroups = allocator->fNumGroups;
+	int32 maxExtents = allocator->fMaxGroupExtents;
 
 	for (int32 i = 0; i < numGroups; i++) {
 		if (read_pos(volume->Device(), offset << blockShift, buffer,
@@ -675,6 +1338,7 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 			groups[i].fNumBlocks = blocks;
 		}
 		groups[i].fStart = offset;
+		groups[i].fFreeExtents.Init(maxExtents);
 
 		// finds all free ranges in this allocation group
 		int32 start = -1, range = 0;
@@ -704,6 +1368,19 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 	}
 	free(buffer);
 
+	off_t usedBlocks = volume->NumBlocks() - freeBlocks;
+	if (volume->UsedBlocks() != usedBlocks) {
+		// If the disk in a dirty state at mount time, it's
+		// normal that the values don't match
+		INFORM(("volume reports %" B_PRIdOFF " used blocks, correct is %"
+			B_PRIdOFF "\n", volume->UsedBlocks(), usedBlocks));
+		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
+	}
+
+	// Let the allocations begin; a transaction must not be started with a
+	// group locked, as allocations lock their group within the transaction
+	groupsLocker.Unlock();
+
 	// check if block bitmap and log area are reserved
 	uint32 reservedBlocks = volume->Log().Start() + volume->Log().Length();
 
@@ -713,11 +1390,16 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 				"(volume is mounted read-only)!\n"));
 		} else {
 			Transaction transaction(volume, 0);
+			MutexLocker groupLocker(groups[0].Lock());
+			groups[0].Invalidate();
+				// the reserved range may have been partially allocated
+
 			if (groups[0].Allocate(transaction, 0, reservedBlocks) != B_OK) {
 				FATAL(("Could not allocate reserved space for block "
 					"bitmap/log!\n"));
 				volume->Panic();
 			} else {
+				groupLocker.Unlock();
 				transaction.Done();
 				FATAL(("Space for block bitmap or log area was not "
 					"reserved!\n"));
@@ -725,15 +1407,6 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 		}
 	}
 
-	off_t usedBlocks = volume->NumBlocks() - freeBlocks;
-	if (volume->UsedBlocks() != usedBlocks) {
-		// If the disk in a dirty state at mount time, it's
-		// normal that the values don't match
-		INFORM(("volume reports %" B_PRIdOFF " used blocks, correct is %"
-			B_PRIdOFF "\n", volume->UsedBlocks(), usedBlocks));
-		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
-	}
-
 	return B_OK;
 }
 
@@ -764,173 +1437,411 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
 		groupIndex, start, maximum, minimum));
 
-	AllocationBlock cached(fVolume);
-	RecursiveLocker lock(fLock);
+	fTransactionListener->Listen(transaction);
 
-	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
+	for (int32 attempt = 0; attempt < kMaxAllocationAttempts; attempt++) {
+		// Find the block_run that can fulfill the request best
+		int32 bestGroup = -1;
+		int32 bestStart = -1;
+		int32 bestLength = -1;
 
-	// Find the block_run that can fulfill the request best
-	int32 bestGroup = -1;
-	int32 bestStart = -1;
-	int32 bestLength = -1;
+		int32 index = groupIndex;
+		uint16 groupStart = start;
 
-	for (int32 i = 0; i < fNumGroups + 1; i++, groupIndex++, start = 0) {
-		groupIndex = groupIndex % fNumGroups;
-		AllocationGroup& group = fGroups[groupIndex];
+		for (int32 i = 0; i < fNumGroups + 1; i++, index++, groupStart = 0) {
+			index = index % fNumGroups;
+			AllocationGroup& group = fGroups[index];
+			MutexLocker groupLocker(group.Lock());
 
-		CHECK_ALLOCATION_GROUP(groupIndex);
+			status_t status = _FindInGroup(group, index, groupStart, maximum,
+				bestGroup, bestStart, bestLength);
+			if (status != B_OK)
+				return status;
 
-		if (start >= group.NumBits() || group.IsFull())
-			continue;
+			if (bestGroup == index && bestLength >= maximum) {
+				// we still hold the lock of the group, so the range can
+				// be allocated right away
+				return _AllocateInGroup(transaction, index, bestStart,
+					bestLength, maximum, minimum, run);
+			}
+		}
 
-		// The wanted maximum is smaller than the largest free block in the
-		// group or already smaller than the minimum
+		if (bestLength < minimum)
+			return B_DEVICE_FULL;
 
-		if (start < group.fFirstFree)
-			start = group.fFirstFree;
+		// No group could fulfill the request completely; the best range we
+		// found may have been allocated since we unlocked its group, though.
+		AllocationGroup& group = fGroups[bestGroup];
+		MutexLocker groupLocker(group.Lock());
 
-		if (group.fLargestValid) {
-			if (group.fLargestLength < bestLength)
-				continue;
+		if (group.IsFree(fVolume, bestStart, bestLength)) {
+			return _AllocateInGroup(transaction, bestGroup, bestStart,
+				bestLength, maximum, minimum, run);
+		}
+	}
 
-			if (group.fLargestStart >= start) {
-				if (group.fLargestLength >= bestLength) {
-					bestGroup = groupIndex;
-					bestStart = group.fLargestStart;
-					bestLength = group.fLargestLength;
+	return B_DEVICE_FULL;
+}
 
-					if (bestLength >= maximum)
-						break;
-				}
 
-				// We know everything about this group we have to, let's skip
-				// to the next
-				continue;
+status_t
+BlockAllocator::AllocateForInode(Transaction& transaction,
+	const block_run* parent, mode_t type, block_run& run)
+{
+	// Apply some allocation policies here (AllocateBlocks() will break them
+	// if necessary) - we will start with those described in Dominic Giampaolo's
+	// "Practical File System Design", and see how good they work
+
+	// Files are going in the same allocation group as its parent,
+	// sub-directories will be inserted 8 allocation groups after
+	// the one of the parent
+	uint16 group = parent->AllocationGroup();
+	if ((type & (S_DIRECTORY | S_INDEX_DIR | S_ATTR_DIR)) == S_DIRECTORY)
+		group += 8;
+
+	return AllocateBlocks(transaction, group, 0, 1, 1, run);
+}
+
+
+status_t
+BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
+	off_t numBlocks, block_run& run, uint16 minimum)
+{
+	if (numBlocks <= 0)
+		return B_ERROR;
+
+	// one block_run can't hold more data than there is in one allocation group
+	if (numBlocks > fGroups[0].NumBits())
+		numBlocks = fGroups[0].NumBits();
+
+	// since block_run.length is uint16, the largest number of blocks that
+	// can be covered by a block_run is 65535
+	// TODO: if we drop compatibility, couldn't we do this any better?
+	// There are basically two possibilities:
+	// a) since a length of zero doesn't have any sense, take that for 65536 -
+	//    but that could cause many problems (bugs) in other areas
+	// b) reduce the maximum amount of blocks per block_run, so that the
+	//    remaining number of free blocks can be used in a useful manner
+	//    (like 4 blocks) - but that would also reduce the maximum file size
+	// c) have BlockRun::Length() return (length + 1).
+	if (numBlocks > MAX_BLOCK_RUN_LENGTH)
+		numBlocks = MAX_BLOCK_RUN_LENGTH;
+
+	// Apply some allocation policies here (AllocateBlocks() will break them
+	// if necessary)
+	uint16 group = inode->BlockRun().AllocationGroup();
+	uint16 start = 0;
+	const block_run& hint = inode->AllocationHint();
+
+	// Are there already allocated blocks? (then just try to allocate near the
+	// last one)
+	if (inode->Size() > 0) {
+		const data_stream& data = inode->Node().data;
+		if (data.max_double_indirect_range == 0
+			&& data.max_indirect_range == 0) {
+			// Since size > 0, there must be a valid block run in this stream
+			int32 last = 0;
+			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
+				if (data.direct[last + 1].IsZero())
+					break;
+
+			group = data.direct[last].AllocationGroup();
+			start = data.direct[last].Start() + data.direct[last].Length();
+		} else if (!hint.IsZero()) {
+			// the stream has grown into the indirect ranges, continue after
+			// the last run we allocated for it
+			group = hint.AllocationGroup();
+			start = hint.Start() + hint.Length();
+		}
+	} else if (inode->IsContainer() || inode->IsSymLink()) {
+		// directory and symbolic link data will go in the same allocation
+		// group as the inode is in but after the inode data
+		start = inode->BlockRun().Start();
+	} else if (!hint.IsZero()) {
+		// the file has had data before, reuse its place
+		group = hint.AllocationGroup();
+		start = hint.Start();
+	} else {
+		// File data will start in the next allocation group; the group is
+		// only decided now that the file actually gets data, so that files
+		// that are written concurrently don't share their group
+		group = _StreamGroup(inode->ID(),
+			inode->BlockRun().AllocationGroup() + 1);
+	}
+
+	status_t status = AllocateBlocks(transaction, group, start, numBlocks,
+		minimum, run);
+	if (status != B_OK || !inode->IsFile())
+		return status;
+
+	inode->SetAllocationHint(run);
+	_SetStream(run.AllocationGroup(), inode->ID());
+	return B_OK;
+}
+
+
+status_t
+BlockAllocator::Free(Transaction& transaction, block_run run)
+{
+	int32 group = run.AllocationGroup();
+	uint16 start = run.Start();
+	uint16 length = run.Length();
+
+	FUNCTION_START(("group = %ld, start = %u, length = %u\n", group, start,
+		length));
+	T(Free(run));
+
+	// doesn't use Volume::IsValidBlockRun() here because it can check better
+	// against the group size (the last group may have a different length)
+	if (group < 0 || group >= fNumGroups
+		|| start > fGroups[group].NumBits()
+		|| uint32(start + length) > fGroups[group].NumBits()
+		|| length == 0) {
+		FATAL(("tried to free an invalid block_run (%d, %u, %u)\n", (int)group,
+			start, length));
+		DEBUGGER(("tried to free invalid block_run"));
+		return B_BAD_VALUE;
+	}
+	// check if someone tries to free reserved areas at the beginning of the
+	// drive
+	if (group == 0
+		&& start < uint32(fVolume->Log().Start() + fVolume->Log().Length())) {
+		FATAL(("tried to free a reserved block_run (%d, %u, %u)\n", (int)group,
+			start, length));
+		DEBUGGER(("tried to free reserved block"));
+		return B_BAD_VALUE;
+	}
+
+	fTransactionListener->Listen(transaction);
+
+	MutexLocker groupLocker(fGroups[group].Lock());
+
+#ifdef DEBUG
+	if (CheckBlockRun(run) != B_OK)
+		return B_BAD_DATA;
+#endif
+
+	CHECK_ALLOCATION_GROUP(group);
+
+	if (fGroups[group].Free(transaction, start, length) != B_OK)
+		RETURN_ERROR(B_IO_ERROR);
+
+	CHECK_ALLOCATION_GROUP(group);
+
+#ifdef DEBUG
+	if (CheckBlockRun(run, NULL, false) != B_OK) {
+		DEBUGGER(("CheckBlockRun() reports allocated blocks (which were just "
+			"freed)\n"));
+	}
+#endif
+
+	groupLocker.Unlock();
+
+	_AddUsedBlocks(-(int64)run.Length());
+	return B_OK;
+}
+
+
+/*!	Looks for the best range to allocate up to \a maximum blocks from
+	in the given group, and updates \a bestGroup, \a bestStart, and
+	\a bestLength if it found a larger one than the one passed in.
+	Assumes that the group lock is held.
+*/
+status_t
+BlockAllocator::_FindInGroup(AllocationGroup& group, int32 groupIndex,
+	uint16 start, uint16 maximum, int32& bestGroup, int32& bestStart,
+	int32& bestLength)
+{
+	group.UpdateFreeExtents(fVolume, fMaxGroupExtents);
+
+	CHECK_ALLOCATION_GROUP(groupIndex);
+
+	if (start >= group.NumBits() || group.IsFull())
+		return B_OK;
+
+	FreeExtentTree& extents = group.fFreeExtents;
+	if (extents.IsValid()) {
+		// Prefer the range at, or after the start (so that growing streams
+		// stay contiguous), otherwise, take the range that fits best
+		FreeExtent* extent = NULL;
+		int32 extentStart = 0;
+		int32 extentLength = 0;
+
+		if (start > 0) {
+			extent = extents.FindAt(start);
+			if (extent != NULL) {
+				extentStart = max_c(extent->Start(), (int32)start);
+				extentLength = extent->End() - extentStart;
+				if (extentLength < maximum)
+					extent = NULL;
 			}
 		}
+		if (extent == NULL) {
+			extent = extents.FindBestFit(maximum);
+			if (extent == NULL)
+				extent = extents.FindLargest();
+			if (extent == NULL)
+				return B_OK;
 
-		// There may be more than one block per allocation group - and
-		// we iterate through it to find a place for the allocation.
-		// (one allocation can't exceed one allocation group)
+			extentStart = extent->Start();
+			extentLength = extent->Length();
+		}
 
-		uint32 block = start / (fVolume->BlockSize() << 3);
-		int32 currentStart = 0, currentLength = 0;
-		int32 groupLargestStart = -1;
-		int32 groupLargestLength = -1;
-		int32 currentBit = start;
-		bool canFindGroupLargest = start == 0;
+		if (extentLength > bestLength) {
+			bestGroup = groupIndex;
+			bestStart = extentStart;
+			bestLength = extentLength;
+		}
+		return B_OK;
+	}
 
-		for (; block < group.NumBlocks(); block++) {
-			if (cached.SetTo(group, block) < B_OK)
-				RETURN_ERROR(B_ERROR);
+	// The group is too fragmented to keep its free ranges in memory, we need
+	// to search the bitmap
 
-			T(Block("alloc-in", group.Start() + block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
+	// The wanted maximum is smaller than the largest free block in the
+	// group or already smaller than the minimum
 
-			// find a block large enough to hold the allocation
-			for (uint32 bit = start % bitsPerFullBlock;
-					bit < cached.NumBlockBits(); bit++) {
-				if (!cached.IsUsed(bit)) {
-					if (currentLength == 0) {
-						// start new range
-						currentStart = currentBit;
-					}
+	if (start < group.fFirstFree)
+		start = group.fFirstFree;
+
+	if (group.fLargestValid) {
+		if (group.fLargestLength < bestLength)
+			return B_OK;
 
-					// have we found a range large enough to hold numBlocks?
-					if (++currentLength >= maximum) {
+		if (group.fLargestStart >= start) {
+			if (group.fLargestLength >= bestLength) {
+				bestGroup = groupIndex;
+				bestStart = group.fLargestStart;
+				bestLength = group.fLargestLength;
+			}
+
+			// We know everything about this group we have to, let's skip
+			// to the next
+			return B_OK;
+		}
+	}
+
+	// There may be more than one block per allocation group - and
+	// we iterate through it to find a place for the allocation.
+	// (one allocation can't exceed one allocation group)
+
+	AllocationBlock cached(fVolume);
+	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
+	uint32 block = start / bitsPerFullBlock;
+	int32 currentStart = 0, currentLength = 0;
+	int32 groupLargestStart = -1;
+	int32 groupLargestLength = -1;
+	int32 currentBit = start;
+	bool canFindGroupLargest = start == 0;
+
+	for (; block < group.NumBlocks(); block++) {
+		if (cached.SetTo(group, block) < B_OK)
+			RETURN_ERROR(B_ERROR);
+
+		T(Block("alloc-in", group.Start() + block, cached.Block(),
+			fVolume->BlockSize(), groupIndex, currentStart));
+
+		// find a block large enough to hold the allocation
+		for (uint32 bit = start % bitsPerFullBlock;
+				bit < cached.NumBlockBits(); bit++) {
+			if (!cached.IsUsed(bit)) {
+				if (currentLength == 0) {
+					// start new range
+					currentStart = currentBit;
+				}
+
+				// have we found a range large enough to hold numBlocks?
+				if (++currentLength >= maximum) {
+					bestGroup = groupIndex;
+					bestStart = currentStart;
+					bestLength = currentLength;
+					break;
+				}
+			} else {
+				if (currentLength) {
+					// end of a range
+					if (currentLength > bestLength) {
 						bestGroup = groupIndex;
 						bestStart = currentStart;
 						bestLength = currentLength;
-						break;
 					}
-				} else {
-					if (currentLength) {
-						// end of a range
-						if (currentLength > bestLength) {
-							bestGroup = groupIndex;
-							bestStart = currentStart;
-							bestLength = currentLength;
-						}
-						if (currentLength > groupLargestLength) {
-							groupLargestStart = currentStart;
-							groupLargestLength = currentLength;
-						}
-						currentLength = 0;
-					}
-					if ((int32)group.NumBits() - currentBit
-							<= groupLargestLength) {
-						// We can't find a bigger block in this group anymore,
-						// let's skip the rest.
-						block = group.NumBlocks();
-						break;
+					if (currentLength > groupLargestLength) {
+						groupLargestStart = currentStart;
+						groupLargestLength = currentLength;
 					}
+					currentLength = 0;
+				}
+				if ((int32)group.NumBits() - currentBit
+						<= groupLargestLength) {
+					// We can't find a bigger block in this group anymore,
+					// let's skip the rest.
+					block = group.NumBlocks();
+					break;
 				}
-				currentBit++;
 			}
+			currentBit++;
+		}
 
-			T(Block("alloc-out", block, cached.Block(),
-				fVolume->BlockSize(), groupIndex, currentStart));
+		T(Block("alloc-out", block, cached.Block(),
+			fVolume->BlockSize(), groupIndex, currentStart));
 
-			if (bestLength >= maximum) {
-				canFindGroupLargest = false;
-				break;
-			}
-
-			// start from the beginning of the next block
-			start = 0;
+		if (bestLength >= maximum) {
+			canFindGroupLargest = false;
+			break;
 		}
 
-		if (currentBit == (int32)group.NumBits()) {
-			if (currentLength > bestLength) {
-				bestGroup = groupIndex;
-				bestStart = currentStart;
-				bestLength = currentLength;
-			}
-			if (canFindGroupLargest && currentLength > groupLargestLength) {
-				groupLargestStart = currentStart;
-				groupLargestLength = currentLength;
-			}
-		}
+		// start from the beginning of the next block
+		start = 0;
+	}
 
-		if (canFindGroupLargest && !group.fLargestValid
-			&& groupLargestLength >= 0) {
-			group.fLargestStart = groupLargestStart;
-			group.fLargestLength = groupLargestLength;
-			group.fLargestValid = true;
+	if (currentBit == (int32)group.NumBits()) {
+		if (currentLength > bestLength) {
+			bestGroup = groupIndex;
+			bestStart = currentStart;
+			bestLength = currentLength;
+		}
+		if (canFindGroupLargest && currentLength > groupLargestLength) {
+			groupLargestStart = currentStart;
+			groupLargestLength = currentLength;
 		}
+	}
 
-		if (bestLength >= maximum)
-			break;
+	if (canFindGroupLargest && !group.fLargestValid
+		&& groupLargestLength >= 0) {
+		group.fLargestStart = groupLargestStart;
+		group.fLargestLength = groupLargestLength;
+		group.fLargestValid = true;
 	}
 
-	// If we found a suitable range, mark the blocks as in use, and
-	// write the updated block bitmap back to disk
-	if (bestLength < minimum)
-		return B_DEVICE_FULL;
+	return B_OK;
+}
+
 
-	if (bestLength > maximum)
-		bestLength = maximum;
+/*!	Marks up to \a maximum blocks of the free range \a start, \a length as
+	in use, and puts the allocation into \a run.
+	Assumes that the group lock is held.
+*/
+status_t
+BlockAllocator::_AllocateInGroup(Transaction& transaction, int32 groupIndex,
+	int32 start, int32 length, uint16 maximum, uint16 minimum, block_run& run)
+{
+	if (length > maximum)
+		length = maximum;
 	else if (minimum > 1) {
-		// make sure bestLength is a multiple of minimum
-		bestLength = round_down(bestLength, minimum);
+		// make sure length is a multiple of minimum
+		length = round_down(length, minimum);
 	}
 
-	if (fGroups[bestGroup].Allocate(transaction, bestStart, bestLength) != B_OK)
+	if (fGroups[groupIndex].Allocate(transaction, start, length) != B_OK)
 		RETURN_ERROR(B_IO_ERROR);
 
-	CHECK_ALLOCATION_GROUP(bestGroup);
+	CHECK_ALLOCATION_GROUP(groupIndex);
 
-	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
-	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
-	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
+	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(groupIndex);
+	run.start = HOST_ENDIAN_TO_BFS_INT16(start);
+	run.length = HOST_ENDIAN_TO_BFS_INT16(length);
 
-	fVolume->SuperBlock().used_blocks
-		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + bestLength);
-		// We are not writing back the disk's superblock - it's
-		// either done by the journaling code, or when the disk
-		// is unmounted.
-		// If the value is not correct at mount time, it will be
-		// fixed anyway.
+	_AddUsedBlocks(length);
 
 	// We need to flush any remaining blocks in the new allocation to make sure
 	// they won't interfere with the file cache.
@@ -938,143 +1849,102 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		run.Length());
 
 	T(Allocate(run));
-	return B_OK;
-}
-
-
-status_t
-BlockAllocator::AllocateForInode(Transaction& transaction,
-	const block_run* parent, mode_t type, block_run& run)
-{
-	// Apply some allocation policies here (AllocateBlocks() will break them
-	// if necessary) - we will start with those described in Dominic Giampaolo's
-	// "Practical File System Design", and see how good they work
-
-	// Files are going in the same allocation group as its parent,
-	// sub-directories will be inserted 8 allocation groups after
-	// the one of the parent
-	uint16 group = parent->AllocationGroup();
-	if ((type & (S_DIRECTORY | S_INDEX_DIR | S_ATTR_DIR)) == S_DIRECTORY)
-		group += 8;
-
-	return AllocateBlocks(transaction, group, 0, 1, 1, run);
+	return B_OK;
 }
 
 
-status_t
-BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
-	off_t numBlocks, block_run& run, uint16 minimum)
+/*!	Returns the allocation group the first data of a file \a inode should go
+	to, searching from \a groupIndex on: groups that another file has been
+	growing in recently are skipped, so that files that are written at the
+	same time don't end up interleaved.
+*/
+int32
+BlockAllocator::_StreamGroup(ino_t inode, int32 groupIndex)
 {
-	if (numBlocks <= 0)
-		return B_ERROR;
-
-	// one block_run can't hold more data than there is in one allocation group
-	if (numBlocks > fGroups[0].NumBits())
-		numBlocks = fGroups[0].NumBits();
+	bigtime_t now = system_time();
+	int32 oldestGroup = groupIndex % fNumGroups;
+	bigtime_t oldestTime = now;
 
-	// since block_run.length is uint16, the largest number of blocks that
-	// can be covered by a block_run is 65535
-	// TODO: if we drop compatibility, couldn't we do this any better?
-	// There are basically two possibilities:
-	// a) since a length of zero doesn't have any sense, take that for 65536 -
-	//    but that could cause many problems (bugs) in other areas
-	// b) reduce the maximum amount of blocks per block_run, so that the
-	//    remaining number of free blocks can be used in a useful manner
-	//    (like 4 blocks) - but that would also reduce the maximum file size
-	// c) have BlockRun::Length() return (length + 1).
-	if (numBlocks > MAX_BLOCK_RUN_LENGTH)
-		numBlocks = MAX_BLOCK_RUN_LENGTH;
+	for (int32 i = 0; i < kStreamGroupSpread && i < fNumGroups; i++) {
+		int32 index = (groupIndex + i) % fNumGroups;
+		AllocationGroup& group = fGroups[index];
+		MutexLocker groupLocker(group.Lock());
 
-	// Apply some allocation policies here (AllocateBlocks() will break them
-	// if necessary)
-	uint16 group = inode->BlockRun().AllocationGroup();
-	uint16 start = 0;
+		if (group.IsFull())
+			continue;
 
-	// Are there already allocated blocks? (then just try to allocate near the
-	// last one)
-	if (inode->Size() > 0) {
-		const data_stream& data = inode->Node().data;
-		// TODO: we currently don't care for when the data stream
-		// is already grown into the indirect ranges
-		if (data.max_double_indirect_range == 0
-			&& data.max_indirect_range == 0) {
-			// Since size > 0, there must be a valid block run in this stream
-			int32 last = 0;
-			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
-				if (data.direct[last + 1].IsZero())
-					break;
+		if (group.fStreamInode == inode
+			|| now - group.fStreamTime > kStreamIdleTime)
+			return index;
 
-			group = data.direct[last].AllocationGroup();
-			start = data.direct[last].Start() + data.direct[last].Length();
+		if (group.fStreamTime < oldestTime) {
+			oldestGroup = index;
+			oldestTime = group.fStreamTime;
 		}
-	} else if (inode->IsContainer() || inode->IsSymLink()) {
-		// directory and symbolic link data will go in the same allocation
-		// group as the inode is in but after the inode data
-		start = inode->BlockRun().Start();
-	} else {
-		// file data will start in the next allocation group
-		group = inode->BlockRun().AllocationGroup() + 1;
 	}
 
-	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run);
+	return oldestGroup;
 }
 
 
-status_t
-BlockAllocator::Free(Transaction& transaction, block_run run)
+void
+BlockAllocator::_SetStream(int32 groupIndex, ino_t inode)
 {
-	RecursiveLocker lock(fLock);
+	AllocationGroup& group = fGroups[groupIndex];
+	MutexLocker groupLocker(group.Lock());
 
-	int32 group = run.AllocationGroup();
-	uint16 start = run.Start();
-	uint16 length = run.Length();
+	group.fStreamInode = inode;
+	group.fStreamTime = system_time();
+}
 
-	FUNCTION_START(("group = %ld, start = %u, length = %u\n", group, start,
-		length));
-	T(Free(run));
 
-	// doesn't use Volume::IsValidBlockRun() here because it can check better
-	// against the group size (the last group may have a different length)
-	if (group < 0 || group >= fNumGroups
-		|| start > fGroups[group].NumBits()
-		|| uint32(start + length) > fGroups[group].NumBits()
-		|| length == 0) {
-		FATAL(("tried to free an invalid block_run (%d, %u, %u)\n", (int)group,
-			start, length));
-		DEBUGGER(("tried to free invalid block_run"));
-		return B_BAD_VALUE;
-	}
-	// check if someone tries to free reserved areas at the beginning of the
-	// drive
-	if (group == 0
-		&& start < uint32(fVolume->Log().Start() + fVolume->Log().Length())) {
-		FATAL(("tried to free a reserved block_run (%d, %u, %u)\n", (int)group,
-			start, length));
-		DEBUGGER(("tried to free reserved block"));
-		return B_BAD_VALUE;
-	}
-#ifdef DEBUG
-	if (CheckBlockRun(run) != B_OK)
-		return B_BAD_DATA;
-#endif
+void
+BlockAllocator::_AddUsedBlocks(int64 blocks)
+{
+	MutexLocker locker(fUsedBlocksLock);
 
-	CHECK_ALLOCATION_GROUP(group);
+	fVolume->SuperBlock().used_blocks
+		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + blocks);
+		// We are not writing back the disk's superblock - it's
+		// either done by the journaling code, or when the disk
+		// is unmounted.
+		// If the value is not correct at mount time, it will be
+		// fixed anyway.
 
-	if (fGroups[group].Free(transaction, start, length) != B_OK)
-		RETURN_ERROR(B_IO_ERROR);
+	fTransactionUsedBlocks += blocks;
+}
 
-	CHECK_ALLOCATION_GROUP(group);
 
-#ifdef DEBUG
-	if (CheckBlockRun(run, NULL, false) != B_OK) {
-		DEBUGGER(("CheckBlockRun() reports allocated blocks (which were just "
-			"freed)\n"));
+/*!	Called when the transaction that changed the bitmap is done. If it
+	failed, the block cache has reverted the bitmap blocks, and the blocks
+	the transaction allocated and freed must be accounted for again.
+*/
+void
+BlockAllocator::_TransactionDone(bool success)
+{
+	if (!success)
+		_InvalidateGroups();
+
+	MutexLocker locker(fUsedBlocksLock);
+
+	if (!success) {
+		fVolume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(
+			fVolume->UsedBlocks() - fTransactionUsedBlocks);
 	}
-#endif
+	fTransactionUsedBlocks = 0;
+}
 
-	fVolume->SuperBlock().used_blocks =
-		HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() - run.Length());
-	return B_OK;
+
+/*!	Makes sure that the allocation groups don't trust anything but the block
+	bitmap anymore.
+*/
+void
+BlockAllocator::_InvalidateGroups()
+{
+	for (int32 i = 0; i < fNumGroups; i++) {
+		MutexLocker groupLocker(fGroups[i].Lock());
+		fGroups[i].Invalidate();
+	}
 }
 
 
@@ -1112,6 +1982,8 @@ BlockAllocator::Fragment()
 			transaction.Done();
 		}
 	}
+
+	_InvalidateGroups();
 }
 #endif	// DEBUG_FRAGMENTER
 
@@ -1121,9 +1993,8 @@ void
 BlockAllocator::_CheckGroup(int32 groupIndex) const
 {
 	AllocationBlock cached(fVolume);
-	ASSERT_LOCKED_RECURSIVE(&fLock);
-
 	AllocationGroup& group = fGroups[groupIndex];
+	ASSERT_LOCKED_MUTEX(&group.Lock());
 
 	int32 currentStart = 0, currentLength = 0;
 	int32 firstFree = -1;
@@ -1201,6 +2072,7 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 
 	MemoryDeleter deleter(trimData);
 	RecursiveLocker locker(fLock);
+	AllocationGroupsLocker groupsLocker(fGroups, fNumGroups);
 
 	// TODO: take given offset and size into account!
 	int32 lastGroup = fNumGroups - 1;
@@ -1313,6 +2185,7 @@ BlockAllocator::StartChecking(const check_control* control)
 	}
 
 	fCheckCookie->pass = BFS_CHECK_PASS_BITMAP;
+	fCheckCookie->index_memory = 0;
 	fCheckCookie->stack.Push(fVolume->Root());
 	fCheckCookie->stack.Push(fVolume->Indices());
 	fCheckCookie->iterator = NULL;
@@ -1433,6 +2306,15 @@ BlockAllocator::CheckNextNode(check_control* control)
 					continue;
 				}
 
+				if (fCheckCookie->pass == BFS_CHECK_PASS_INDEX) {
+					// All entries have been collected, build the indices
+					status_t status = _BuildIndices();
+					if (status != B_OK) {
+						fCheckCookie->control.status = status;
+						return status;
+					}
+				}
+
 				fCheckCookie->control.status = B_ENTRY_NOT_FOUND;
 				return B_ENTRY_NOT_FOUND;
 			}
@@ -1475,6 +2357,8 @@ BlockAllocator::CheckNextNode(check_control* control)
 			if (fCheckCookie->iterator == NULL)
 				RETURN_ERROR(B_NO_MEMORY);
 
+			fCheckCookie->iterator->SetPrefetch(true);
+
 			// the inode must stay locked in memory until the iterator is freed
 			vnode.Keep();
 
@@ -1747,10 +2631,14 @@ BlockAllocator::_WriteBackCheckBitmap()
 				(uint8*)fCheckBitmap + i * blockSize, blocksToWrite);
 			if (status < B_OK) {
 				FATAL(("error writing bitmap: %s\n", strerror(status)));
+				_InvalidateGroups();
 				return status;
 			}
 			transaction.Done();
 		}
+
+		// the groups have to learn about the new bitmap
+		_InvalidateGroups();
 	}
 
 	return B_OK;
@@ -1924,20 +2812,23 @@ BlockAllocator::CheckInode(Inode* inode, const char* name)
 			if (inode->IsContainer()) {
 				bool repairErrors
 					= (fCheckCookie->control.flags & BFS_FIX_BPLUSTREES) != 0;
+				bool rebuildIndices
+					= (fCheckCookie->control.flags & BFS_REBUILD_INDICES) != 0;
 				bool errorsFound = false;
 				status = inode->Tree()->Validate(repairErrors, errorsFound);
-				if (errorsFound) {
+				if (errorsFound)
 					fCheckCookie->control.errors |= BFS_INVALID_BPLUSTREE;
-					if (inode->IsIndex() && name != NULL && repairErrors) {
-						// We completely rebuild corrupt indices
-						check_index* index = new(std::nothrow) check_index;
-						if (index == NULL)
-							return B_NO_MEMORY;
-
-						strlcpy(index->name, name, sizeof(index->name));
-						index->run = inode->BlockRun();
-						fCheckCookie->indices.Push(index);
-					}
+
+				if (inode->IsIndex() && name != NULL
+					&& ((errorsFound && repairErrors) || rebuildIndices)) {
+					// We completely rebuild corrupt indices
+					check_index* index = new(std::nothrow) check_index;
+					if (index == NULL)
+						return B_NO_MEMORY;
+
+					strlcpy(index->name, name, sizeof(index->name));
+					index->run = inode->BlockRun();
+					fCheckCookie->indices.Push(index);
 				}
 			}
 
@@ -2135,6 +3026,7 @@ BlockAllocator::_FreeIndices()
 			put_vnode(fVolume->FSVolume(),
 				fVolume->ToVnode(index->inode->BlockRun()));
 		}
+		delete index;
 	}
 	fCheckCookie->indices.MakeEmpty();
 }
@@ -2143,54 +3035,284 @@ BlockAllocator::_FreeIndices()
 status_t
 BlockAllocator::_AddInodeToIndex(Inode* inode)
 {
-	Transaction transaction(fVolume, inode->BlockNumber());
+	Transaction transaction;
 
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
 		if (index->inode == NULL)
 			continue;
 
-		index->inode->WriteLockInTransaction(transaction);
-
-		BPlusTree* tree = index->inode->Tree();
-		if (tree == NULL)
-			return B_ERROR;
-
-		status_t status = B_OK;
+		uint8 key[MAX_INDEX_KEY_LENGTH + 1];
+		size_t keyLength;
 
 		if (!strcmp(index->name, "name")) {
-			if (inode->InNameIndex()) {
-				char name[B_FILE_NAME_LENGTH];
-				if (inode->GetName(name, B_FILE_NAME_LENGTH) != B_OK)
-					return B_ERROR;
+			if (!inode->InNameIndex())
+				continue;
+			if (inode->GetName((char*)key, sizeof(key)) != B_OK)
+				return B_ERROR;
 
-				status = tree->Insert(transaction, name, inode->ID());
-			}
+			keyLength = strlen((char*)key);
 		} else if (!strcmp(index->name, "last_modified")) {
-			if (inode->InLastModifiedIndex()) {
-				status = tree->Insert(transaction, inode->OldLastModified(),
-					inode->ID());
-			}
+			if (!inode->InLastModifiedIndex())
+				continue;
+
+			int64 lastModified = inode->OldLastModified();
+			memcpy(key, &lastModified, sizeof(lastModified));
+			keyLength = sizeof(lastModified);
 		} else if (!strcmp(index->name, "size")) {
-			if (inode->InSizeIndex())
-				status = tree->Insert(transaction, inode->Size(), inode->ID());
+			if (!inode->InSizeIndex())
+				continue;
+
+			int64 size = inode->Size();
+			memcpy(key, &size, sizeof(size));
+			keyLength = sizeof(size);
 		} else {
-			uint8 key[MAX_INDEX_KEY_LENGTH];
-			size_t keyLength = MAX_INDEX_KEY_LENGTH;
+			keyLength = MAX_INDEX_KEY_LENGTH;
 			if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
-					&keyLength) == B_OK) {
-				status = tree->Insert(transaction, key, keyLength, inode->ID());
+					&keyLength) != B_OK) {
+				continue;
+			}
+		}
+
+		if (keyLength == 0)
+			continue;
+
+		if (index->collecting) {
+			status_t status = _CollectIndexEntry(index, key, keyLength,
+				inode->ID());
+			if (status == B_OK)
+				continue;
+
+			// There is not enough memory to collect all entries; build the
+			// index from what we have, and insert the others as they come.
+			// The index must not be built inside our transaction, or a
+			// failure could not be rolled back on its own.
+			if (transaction.IsStarted()) {
+				status = transaction.Done();
+				if (status != B_OK)
+					return status;
 			}
+
+			status = _BuildIndex(index);
+			if (status != B_OK)
+				return status;
+		}
+
+		if (!transaction.IsStarted()) {
+			status_t status = transaction.Start(fVolume, inode->BlockNumber());
+			if (status != B_OK)
+				return status;
+		}
+
+		index->inode->WriteLockInTransaction(transaction);
+
+		BPlusTree* tree = index->inode->Tree();
+		if (tree == NULL)
+			return B_ERROR;
+
+		status_t status = tree->Insert(transaction, key, keyLength,
+			inode->ID());
+		if (status != B_OK)
+			return status;
+	}
+
+	return transaction.Done();
+}
+
+
+/*!	Remembers the \a key, and \a value to be added to the \a index later.
+	Returns \c B_NO_MEMORY if there is no room for it.
+*/
+status_t
+BlockAllocator::_CollectIndexEntry(check_index* index, const uint8* key,
+	uint16 keyLength, off_t value)
+{
+	size_t size = index_entry::Size(keyLength);
+
+	if (index->entries_size + size > index->entries_capacity) {
+		size_t capacity = max_c(index->entries_capacity * 2, 64 * 1024);
+		size_t previousUsage = index->MemoryUsage();
+		size_t usage = capacity
+			+ index_entry::MaxCount(capacity) * sizeof(uint32);
+		if (fCheckCookie->index_memory - previousUsage + usage
+				> kMaxIndexEntryMemory) {
+			return B_NO_MEMORY;
+		}
+
+		uint8* entries = (uint8*)realloc(index->entries, capacity);
+		if (entries == NULL)
+			return B_NO_MEMORY;
+		index->entries = entries;
+
+		uint32* offsets = (uint32*)realloc(index->offsets,
+			index_entry::MaxCount(capacity) * sizeof(uint32));
+		if (offsets == NULL)
+			return B_NO_MEMORY;
+		index->offsets = offsets;
+
+		index->entries_capacity = capacity;
+		fCheckCookie->index_memory += usage - previousUsage;
+	}
+
+	index_entry* entry = (index_entry*)(index->entries + index->entries_size);
+	entry->value = value;
+	entry->key_length = keyLength;
+	memcpy(entry->key, key, keyLength);
+
+	index->offsets[index->count++] = index->entries_size;
+	index->entries_size += size;
+	return B_OK;
+}
+
+
+/*!	Sorts the entries collected for the \a index, and bulk loads its tree with
+	them. Any further entries need to be inserted normally.
+	Since the bulk load commits its work in several transactions, a failure
+	leaves a partial tree behind; it is then emptied again, and the entries
+	are inserted one by one instead.
+*/
+status_t
+BlockAllocator::_BuildIndex(check_index* index)
+{
+	index->collecting = false;
+
+	BPlusTree* tree = index->inode->Tree();
+	if (tree == NULL)
+		return B_ERROR;
+
+	std::sort(index->offsets, index->offsets + index->count,
+		IndexEntryLess(tree, index->entries));
+
+	status_t status = _BulkLoadIndex(index, tree);
+	if (status != B_OK) {
+		FATAL(("check: Could not bulk load index \"%s\": %s, inserting its "
+			"entries instead\n", index->name, strerror(status)));
+
+		status = tree->MakeEmpty();
+		if (status == B_OK)
+			status = _InsertIndexEntries(index, tree);
+	}
+
+	fCheckCookie->index_memory -= index->MemoryUsage();
+	free(index->entries);
+	free(index->offsets);
+	index->entries = NULL;
+	index->offsets = NULL;
+	index->entries_size = 0;
+	index->entries_capacity = 0;
+	index->count = 0;
+
+	return status;
+}
+
+
+/*!	Bulk loads the empty \a tree with the sorted entries of the \a index.
+	If this fails, the transaction in progress is aborted, but the ones
+	before it have already been committed.
+*/
+status_t
+BlockAllocator::_BulkLoadIndex(check_index* index, BPlusTree* tree)
+{
+	Transaction transaction(fVolume, index->inode->BlockNumber());
+	if (!transaction.IsStarted())
+		return B_ERROR;
+
+	index->inode->WriteLockInTransaction(transaction);
+
+	TreeBuilder builder(tree);
+
+	for (uint32 i = 0; i < index->count; i++) {
+		const index_entry* entry
+			= (const index_entry*)(index->entries + index->offsets[i]);
+
+		status_t status = builder.Add(transaction, entry->key,
+			entry->key_length, entry->value);
+		if (status == B_OK
+			&& (fCheckCookie->control.flags & BFS_FAIL_BULK_LOAD) != 0
+			&& i == index->count / 2) {
+			// Allows testing the recovery from a failed bulk load
+			status = B_IO_ERROR;
+		}
+		if (status != B_OK)
+			return status;
+
+		// Keep the transactions small
+		if ((i + 1) % kIndexEntriesPerTransaction == 0) {
+			status = transaction.Done();
+			if (status == B_OK)
+				status = transaction.Start(fVolume, index->inode->BlockNumber());
+			if (status != B_OK)
+				return status;
+
+			index->inode->WriteLockInTransaction(transaction);
+		}
+	}
+
+	status_t status = builder.Finish(transaction);
+	if (status != B_OK)
+		return status;
+
+	return transaction.Done();
+}
+
+
+/*!	Inserts the entries of the \a index into its \a tree one by one, as a
+	fallback for when bulk loading failed.
+*/
+status_t
+BlockAllocator::_InsertIndexEntries(check_index* index, BPlusTree* tree)
+{
+	Transaction transaction;
+
+	for (uint32 i = 0; i < index->count; i++) {
+		if (!transaction.IsStarted()) {
+			status_t status = transaction.Start(fVolume,
+				index->inode->BlockNumber());
+			if (status != B_OK)
+				return status;
+
+			index->inode->WriteLockInTransaction(transaction);
 		}
 
+		const index_entry* entry
+			= (const index_entry*)(index->entries + index->offsets[i]);
+
+		status_t status = tree->Insert(transaction, entry->key,
+			entry->key_length, entry->value);
 		if (status != B_OK)
 			return status;
+
+		if ((i + 1) % kIndexEntriesPerTransaction == 0) {
+			status = transaction.Done();
+			if (status != B_OK)
+				return status;
+		}
 	}
 
 	return transaction.Done();
 }
 
 
+status_t
+BlockAllocator::_BuildIndices()
+{
+	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
+		check_index* index = fCheckCookie->indices.Array()[i];
+		if (index->inode == NULL || !index->collecting)
+			continue;
+
+		status_t status = _BuildIndex(index);
+		if (status != B_OK) {
+			FATAL(("check: Could not build index \"%s\": %s\n", index->name,
+				strerror(status)));
+			return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
 status_t
 BlockAllocator::_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 	uint64 offset, uint64 size)
@@ -2265,6 +3387,14 @@ BlockAllocator::Dump(int32 index)
 			group.fLargestValid ? "" : "  (invalid)");
 		kprintf("      largest length: %" B_PRId32 "\n", group.fLargestLength);
 		kprintf("      free bits:      %" B_PRId32 "\n", group.fFreeBits);
+		if (group.fFreeExtents.IsValid()) {
+			kprintf("      free extents:   %" B_PRId32 "\n",
+				group.fFreeExtents.Count());
+		} else {
+			kprintf("      free extents:   (invalid, rebuild at %" B_PRId32
+				")\n", group.fRebuildFreeBits);
+		}
+		kprintf("      stream inode:   %" B_PRIdINO "\n", group.fStreamInode);
 	}
 }
 
@@ -10,6 +10,7 @@
 
 
 class AllocationGroup;
+class BitmapTransactionListener;
 class BPlusTree;
 class Inode;
 class Transaction;
@@ -18,6 +19,7 @@ struct disk_super_block;
 struct block_run;
 struct check_control;
 struct check_cookie;
+struct check_index;
 
 
 //#define DEBUG_ALLOCATION_GROUPS
@@ -70,6 +72,22 @@ public:
 #endif
 
 private:
+	friend class BitmapTransactionListener;
+
+			status_t		_FindInGroup(AllocationGroup& group,
+								int32 groupIndex, uint16 start,
+								uint16 maximum, int32& bestGroup,
+								int32& bestStart, int32& bestLength);
+			status_t		_AllocateInGroup(Transaction& transaction,
+								int32 groupIndex, int32 start, int32 length,
+								uint16 maximum, uint16 minimum,
+								block_run& run);
+			int32			_StreamGroup(ino_t inode, int32 groupIndex);
+			void			_SetStream(int32 groupIndex, ino_t inode);
+			void			_AddUsedBlocks(int64 blocks);
+			void			_TransactionDone(bool success);
+			void			_InvalidateGroups();
+
 			status_t		_RemoveInvalidNode(Inode* parent, BPlusTree* tree,
 								Inode* inode, const char* name);
 #ifdef DEBUG_ALLOCATION_GROUPS
@@ -83,6 +101,15 @@ private:
 			status_t		_PrepareIndices();
 			void			_FreeIndices();
 			status_t		_AddInodeToIndex(Inode* inode);
+			status_t		_CollectIndexEntry(check_index* index,
+								const uint8* key, uint16 keyLength,
+								off_t value);
+			status_t		_BuildIndex(check_index* index);
+			status_t		_BulkLoadIndex(check_index* index,
+								BPlusTree* tree);
+			status_t		_InsertIndexEntries(check_index* index,
+								BPlusTree* tree);
+			status_t		_BuildIndices();
 			status_t		_WriteBackCheckBitmap();
 			status_t		_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 								uint64 offset, uint64 size);
@@ -95,10 +122,18 @@ private:
 private:
 			Volume*			fVolume;
 			recursive_lock	fLock;
+				// only protects the bitmap as a whole, allocations only
+				// lock their allocation group
+			mutex			fUsedBlocksLock;
+			int64			fTransactionUsedBlocks;
+				// the blocks the current transaction allocated (or freed,
+				// if negative), protected by fUsedBlocksLock
 			AllocationGroup* fGroups;
 			int32			fNumGroups;
 			uint32			fBlocksPerGroup;
 			uint32			fNumBlocks;
+			int32			fMaxGroupExtents;
+			BitmapTransactionListener* fTransactionListener;
 
 			uint32*			fCheckBitmap;
 			check_cookie*	fCheckCookie;
@@ -344,14 +344,17 @@ Inode::Inode(Volume* volume, ino_t id)
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fOpenCount(0)
 {
 	PRINT(("Inode::Inode(volume = %p, id = %Ld) @ %p\n", volume, id, this));
 
 	rw_lock_init(&fLock, "bfs inode");
 	recursive_lock_init(&fSmallDataLock, "bfs inode small data");
+	fAllocationHint.SetTo(0, 0, 0);
 
-	if (UpdateNodeFromDisk() != B_OK) {
+	if (!volume->NodeCache().GetNode(id, fNode)
+		&& UpdateNodeFromDisk() != B_OK) {
 		// TODO: the error code gets eaten
 		return;
 	}
@@ -377,13 +380,18 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fOpenCount(0)
 {
 	PRINT(("Inode::Inode(volume = %p, transaction = %p, id = %Ld) @ %p\n",
 		volume, &transaction, id, this));
 
 	rw_lock_init(&fLock, "bfs inode");
 	recursive_lock_init(&fSmallDataLock, "bfs inode small data");
+	fAllocationHint.SetTo(0, 0, 0);
+
+	// the block might have belonged to an inode that has been deleted
+	volume->NodeCache().Remove(id);
 
 	NodeGetter node(volume, transaction, this, true);
 	if (node.Node() == NULL) {
@@ -678,6 +686,7 @@ Inode::_RemoveSmallData(Transaction& transaction, NodeGetter& nodeGetter,
 		return B_ENTRY_NOT_FOUND;
 
 	nodeGetter.MakeWritable(transaction);
+	fVolume->NodeCache().Remove(ID());
 
 	status_t status = _RemoveSmallData(node, item, index);
 	if (status == B_OK) {
@@ -720,6 +729,7 @@ Inode::_AddSmallData(Transaction& transaction, NodeGetter& nodeGetter,
 
 	nodeGetter.MakeWritable(transaction);
 	RecursiveLocker locker(fSmallDataLock);
+	fVolume->NodeCache().Remove(ID());
 
 	// Find the last item or one with the same name we have to add
 	small_data* item = node->SmallDataStart();
@@ -932,11 +942,27 @@ Inode::Name(const bfs_inode* node) const
 status_t
 Inode::GetName(char* buffer, size_t size) const
 {
+	if (size == 0)
+		return B_BAD_VALUE;
+
+	RecursiveLocker locker(fSmallDataLock);
+
+	const char nameTag[2] = {FILE_NAME_NAME, 0};
+	size_t length = size - 1;
+	status_t status = fVolume->NodeCache().ReadSmallData(ID(), nameTag, 0,
+		(uint8*)buffer, &length);
+	if (status == B_OK) {
+		buffer[length] = '\0';
+		return B_OK;
+	}
+	if (status == B_ENTRY_NOT_FOUND)
+		return status;
+
 	NodeGetter node(fVolume, this);
 	if (node.Node() == NULL)
 		return B_IO_ERROR;
 
-	RecursiveLocker locker(fSmallDataLock);
+	fVolume->NodeCache().Add(this, node.Node());
 
 	const char* name = Name(node.Node());
 	if (name == NULL)
@@ -1035,25 +1061,35 @@ Inode::ReadAttribute(const char* name, int32 type, off_t pos, uint8* buffer,
 
 	// search in the small_data section (which has to be locked first)
 	{
-		NodeGetter node(fVolume, this);
-		if (node.Node() == NULL)
-			return B_IO_ERROR;
-
 		RecursiveLocker locker(fSmallDataLock);
 
-		small_data* smallData = FindSmallData(node.Node(), name);
-		if (smallData != NULL) {
-			size_t length = *_length;
-			if (pos >= smallData->data_size) {
-				*_length = 0;
+		status_t status = fVolume->NodeCache().ReadSmallData(ID(), name, pos,
+			buffer, _length);
+		if (status == B_OK)
+			return B_OK;
+
+		if (status == B_NO_INIT) {
+			// the inode is not cached yet
+			NodeGetter node(fVolume, this);
+			if (node.Node() == NULL)
+				return B_IO_ERROR;
+
+			fVolume->NodeCache().Add(this, node.Node());
+
+			small_data* smallData = FindSmallData(node.Node(), name);
+			if (smallData != NULL) {
+				size_t length = *_length;
+				if (pos >= smallData->data_size) {
+					*_length = 0;
+					return B_OK;
+				}
+				if (length + pos > smallData->DataSize())
+					length = smallData->DataSize() - pos;
+
+				memcpy(buffer, smallData->Data() + pos, length);
+				*_length = length;
 				return B_OK;
 			}
-			if (length + pos > smallData->DataSize())
-				length = smallData->DataSize() - pos;
-
-			memcpy(buffer, smallData->Data() + pos, length);
-			*_length = length;
-			return B_OK;
 		}
 	}
 
@@ -2467,6 +2503,10 @@ Inode::TransactionDone(bool success)
 		// Revert any changes made to the cached bfs_inode
 		// TODO: return code gets eaten
 		UpdateNodeFromDisk();
+
+		// the small_data section might have been reverted as well
+		RecursiveLocker locker(fSmallDataLock);
+		fVolume->NodeCache().Remove(ID());
 	}
 }
 
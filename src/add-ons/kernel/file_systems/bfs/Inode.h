@@ -87,6 +87,12 @@ public:
 			bool				IsDeleted() const
 									{ return (Flags() & INODE_DELETED) != 0; }
 
+			void				Opened() { atomic_add(&fOpenCount, 1); }
+			void				Closed() { atomic_add(&fOpenCount, -1); }
+			bool				IsOpen() const
+									{ return atomic_get((int32*)&fOpenCount)
+										> 0; }
+
 			mode_t				Mode() const { return fNode.Mode(); }
 			uint32				Type() const { return fNode.Type(); }
 			int32				Flags() const { return fNode.Flags(); }
@@ -192,6 +198,12 @@ public:
 			void*				Map() const { return fMap; }
 			void				SetMap(void* map) { fMap = map; }
 
+			// block allocation
+			const block_run&	AllocationHint() const
+									{ return fAllocationHint; }
+			void				SetAllocationHint(const block_run& run)
+									{ fAllocationHint = run; }
+
 #if _KERNEL_MODE && KDEBUG
 			void				AssertReadLocked()
 									{ ASSERT_READ_LOCKED_RW_LOCK(&fLock); }
@@ -268,6 +280,11 @@ private:
 			off_t				fOldLastModified;
 				// we need those values to ensure we will remove
 				// the correct keys from the indices
+			block_run			fAllocationHint;
+				// the last run allocated for this stream, so that the next
+				// one can follow it
+			int32				fOpenCount;
+				// the number of file and directory cookies of this node
 
 			mutable recursive_lock fSmallDataLock;
 			SinglyLinkedList<AttributeIterator> fIterators;
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Keeps compact copies of the bfs_inode and its small_data section for
+	recently used inodes, so that neither recreating an Inode object, nor
+	reading the name or a small attribute of an inode needs the block cache.
+
+	The small_data section of an entry is only valid while nobody changes
+	it: all changes to it are done with the inode's small data lock held, and
+	remove the entry first. The bfs_inode itself is only needed to recreate
+	the Inode, and is therefore updated when the Inode object is deleted.
+*/
+
+
+#include "InodeCache.h"
+
+#include "Debug.h"
+#include "Inode.h"
+
+
+static const size_t kMaxCacheSize = 2 * 1024 * 1024;
+
+
+/*static*/ inline const ino_t&
+CachedInodeTreeDefinition::GetKey(const cached_inode* node)
+{
+	return node->id;
+}
+
+
+/*static*/ inline SplayTreeLink<cached_inode>*
+CachedInodeTreeDefinition::GetLink(cached_inode* node)
+{
+	return &node->treeLink;
+}
+
+
+/*static*/ inline int
+CachedInodeTreeDefinition::Compare(const ino_t& key, const cached_inode* node)
+{
+	if (key < node->id)
+		return -1;
+	return key == node->id ? 0 : 1;
+}
+
+
+//	#pragma mark -
+
+
+InodeCache::InodeCache()
+	:
+	fSize(0)
+{
+	mutex_init(&fLock, "bfs inode cache");
+}
+
+
+InodeCache::~InodeCache()
+{
+	Clear();
+	mutex_destroy(&fLock);
+}
+
+
+/*!	Fills \a node with the cached bfs_inode of the inode \a id, and returns
+	whether or not it could be found.
+*/
+bool
+InodeCache::GetNode(ino_t id, bfs_inode& node)
+{
+	MutexLocker locker(fLock);
+
+	cached_inode* entry = _Lookup(id);
+	if (entry == NULL)
+		return false;
+
+	memcpy(&node, &entry->node, sizeof(bfs_inode));
+	node.flags &= HOST_ENDIAN_TO_BFS_INT32(INODE_PERMANENT_FLAGS);
+	return true;
+}
+
+
+/*!	Reads the small_data attribute \a name of the inode \a id.
+	Returns \c B_ENTRY_NOT_FOUND if the inode is cached but does not have
+	such an attribute in its small_data section, and \c B_NO_INIT if the
+	inode is not cached at all.
+	You need to hold the inode's small data lock when you call this method.
+*/
+status_t
+InodeCache::ReadSmallData(ino_t id, const char* name, off_t pos,
+	uint8* buffer, size_t* _length)
+{
+	MutexLocker locker(fLock);
+
+	cached_inode* entry = _Lookup(id);
+	if (entry == NULL)
+		return B_NO_INIT;
+
+	small_data* item = entry->node.SmallDataStart();
+	while (!item->IsLast(&entry->node)) {
+		if (!strcmp(item->Name(), name))
+			break;
+		item = item->Next();
+	}
+	if (item->IsLast(&entry->node))
+		return B_ENTRY_NOT_FOUND;
+
+	size_t length = *_length;
+	if (pos >= item->DataSize()) {
+		*_length = 0;
+		return B_OK;
+	}
+	if (length + pos > item->DataSize())
+		length = item->DataSize() - pos;
+
+	memcpy(buffer, item->Data() + pos, length);
+	*_length = length;
+	return B_OK;
+}
+
+
+/*!	Adds or replaces the entry of \a inode, using the small_data section of
+	its inode block \a node.
+	You need to hold the inode's small data lock when you call this method.
+*/
+void
+InodeCache::Add(const Inode* inode, const bfs_inode* node)
+{
+	// only copy the used part of the small_data section
+	small_data* item = const_cast<bfs_inode*>(node)->SmallDataStart();
+	while (!item->IsLast(node))
+		item = item->Next();
+
+	size_t smallDataSize = (addr_t)item
+		- (addr_t)const_cast<bfs_inode*>(node)->SmallDataStart();
+	size_t size = sizeof(cached_inode) + smallDataSize + sizeof(small_data);
+
+	cached_inode* entry = (cached_inode*)malloc(size);
+	if (entry == NULL)
+		return;
+
+	entry->id = inode->ID();
+	entry->size = size;
+	memcpy(&entry->node, &inode->Node(), sizeof(bfs_inode));
+	memcpy(entry->node.SmallDataStart(),
+		const_cast<bfs_inode*>(node)->SmallDataStart(), smallDataSize);
+	memset((uint8*)entry->node.SmallDataStart() + smallDataSize, 0,
+		sizeof(small_data));
+
+	MutexLocker locker(fLock);
+
+	cached_inode* previous = fTree.Lookup(entry->id);
+	if (previous != NULL)
+		_Remove(previous);
+
+	fTree.Insert(entry);
+	fList.Add(entry, false);
+	fSize += size;
+
+	while (fSize > kMaxCacheSize) {
+		cached_inode* last = fList.Last();
+		if (last == entry)
+			break;
+		_Remove(last);
+	}
+}
+
+
+/*!	Called when the Inode object of \a inode is about to be deleted, so that
+	it can be recreated from the cache later on.
+*/
+void
+InodeCache::Keep(Inode* inode)
+{
+	if ((inode->Flags() & (INODE_DELETED | INODE_IN_TRANSACTION)) != 0) {
+		// the inode might still change without its Inode object
+		Remove(inode->ID());
+		return;
+	}
+
+	MutexLocker locker(fLock);
+
+	cached_inode* entry = _Lookup(inode->ID());
+	if (entry != NULL) {
+		// the small_data section is still valid, just update the rest
+		memcpy(&entry->node, &inode->Node(), sizeof(bfs_inode));
+		return;
+	}
+
+	locker.Unlock();
+
+	NodeGetter node(inode->GetVolume(), inode);
+	if (node.Node() != NULL)
+		Add(inode, node.Node());
+}
+
+
+void
+InodeCache::Remove(ino_t id)
+{
+	MutexLocker locker(fLock);
+
+	cached_inode* entry = fTree.Lookup(id);
+	if (entry != NULL)
+		_Remove(entry);
+}
+
+
+void
+InodeCache::Clear()
+{
+	MutexLocker locker(fLock);
+
+	while (cached_inode* entry = fList.Head())
+		_Remove(entry);
+}
+
+
+void
+InodeCache::_Remove(cached_inode* entry)
+{
+	fTree.Remove(entry);
+	fList.Remove(entry);
+	fSize -= entry->size;
+	free(entry);
+}
+
+
+/*!	Looks up the entry of \a id, and marks it as the most recently used one.
+*/
+cached_inode*
+InodeCache::_Lookup(ino_t id)
+{
+	cached_inode* entry = fTree.Lookup(id);
+	if (entry != NULL && fList.Head() != entry) {
+		fList.Remove(entry);
+		fList.Add(entry, false);
+	}
+
+	return entry;
+}
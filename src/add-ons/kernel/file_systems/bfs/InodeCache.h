@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef INODE_CACHE_H
+#define INODE_CACHE_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs.h"
+
+
+class Inode;
+struct cached_inode;
+
+
+struct CachedInodeTreeDefinition {
+	typedef ino_t			KeyType;
+	typedef cached_inode	NodeType;
+
+	static const KeyType& GetKey(const NodeType* node);
+	static SplayTreeLink<NodeType>* GetLink(NodeType* node);
+	static int Compare(const KeyType& key, const NodeType* node);
+};
+
+typedef SplayTree<CachedInodeTreeDefinition> CachedInodeTree;
+
+
+struct cached_inode {
+	ino_t				id;
+	size_t				size;
+	SplayTreeLink<cached_inode> treeLink;
+	DoublyLinkedListLink<cached_inode> listLink;
+	bfs_inode			node;
+		// followed by the used part of the small_data section, and an
+		// empty small_data item that terminates it
+
+	typedef DoublyLinkedListMemberGetLink<cached_inode,
+		&cached_inode::listLink> GetListLink;
+};
+
+typedef DoublyLinkedList<cached_inode, cached_inode::GetListLink>
+	CachedInodeList;
+
+
+class InodeCache {
+public:
+								InodeCache();
+								~InodeCache();
+
+			bool				GetNode(ino_t id, bfs_inode& node);
+			status_t			ReadSmallData(ino_t id, const char* name,
+									off_t pos, uint8* buffer,
+									size_t* _length);
+
+			void				Add(const Inode* inode, const bfs_inode* node);
+			void				Keep(Inode* inode);
+			void				Remove(ino_t id);
+			void				Clear();
+
+private:
+			void				_Remove(cached_inode* entry);
+			cached_inode*		_Lookup(ino_t id);
+
+private:
+			mutex				fLock;
+			CachedInodeTree		fTree;
+			CachedInodeList		fList;
+			size_t				fSize;
+};
+
+
+#endif	// INODE_CACHE_H
@@ -13,6 +13,10 @@
 #include "Inode.h"
 
 
+static const bigtime_t kGroupCommitWindow = 500;
+	// how long a commit waits for other transactions to join it
+
+
 struct run_array {
 	int32		count;
 	int32		max_runs;
@@ -69,10 +73,8 @@ public:
 			uint32			Start() const { return fStart; }
 			uint32			Length() const { return fLength; }
 
-#ifdef BFS_DEBUGGER_COMMANDS
 			void			SetTransactionID(int32 id) { fTransactionID = id; }
 			int32			TransactionID() const { return fTransactionID; }
-#endif
 
 			Journal*		GetJournal() { return fJournal; }
 
@@ -80,9 +82,7 @@ private:
 			Journal*		fJournal;
 			uint32			fStart;
 			uint32			fLength;
-#ifdef BFS_DEBUGGER_COMMANDS
 			int32			fTransactionID;
-#endif
 };
 
 
@@ -169,7 +169,8 @@ LogEntry::LogEntry(Journal* journal, uint32 start, uint32 length)
 	:
 	fJournal(journal),
 	fStart(start),
-	fLength(length)
+	fLength(length),
+	fTransactionID(-1)
 {
 }
 
@@ -405,10 +406,27 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fCommitSequence(0),
+	fLogSequence(0),
+	fCommitWaiters(0),
+	fSharedCommit(false),
+	fCheckpointing(0),
+	fCheckpointThread(-1),
+	fTransactions(0),
+	fLogWrites(0),
+	fLogBlocks(0),
+	fSyncRequests(0),
+	fSharedSyncs(0),
+	fCheckpoints(0),
+	fLogFullWaits(0),
+	fTotalCommitLatency(0),
+	fMaxCommitLatency(0)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+	mutex_init(&fCommitLock, "bfs journal commit");
+	memset(fCommitLatency, 0, sizeof(fCommitLatency));
 }
 
 
@@ -416,8 +434,13 @@ Journal::~Journal()
 {
 	FlushLogAndBlocks();
 
+	// no more log entries are written now, wait for the last checkpoint
+	if (fCheckpointThread >= 0)
+		wait_for_thread(fCheckpointThread, NULL);
+
 	recursive_lock_destroy(&fLock);
 	mutex_destroy(&fEntriesLock);
+	mutex_destroy(&fCommitLock);
 }
 
 
@@ -702,6 +725,61 @@ Journal::_FlushLog(void* _journal)
 }
 
 
+/*!	Writes back the blocks of the oldest log entries, until no more than a
+	quarter of the log is in use. This runs in parallel to new transactions
+	and log writes, so that they don't have to wait for log space later on.
+*/
+/*static*/ status_t
+Journal::_Checkpoint(void* _journal)
+{
+	Journal* journal = (Journal*)_journal;
+
+	int32 transactionID = -1;
+
+	mutex_lock(&journal->fEntriesLock);
+
+	uint32 used = journal->fUsed;
+	LogEntryList::Iterator iterator = journal->fEntries.GetIterator();
+	while (used > journal->fLogSize / 4 && iterator.HasNext()) {
+		LogEntry* entry = iterator.Next();
+		used -= entry->Length();
+		transactionID = entry->TransactionID();
+	}
+
+	mutex_unlock(&journal->fEntriesLock);
+
+	if (transactionID >= 0)
+		cache_sync_transaction(journal->fVolume->BlockCache(), transactionID);
+
+	atomic_set(&journal->fCheckpointing, 0);
+	return B_OK;
+}
+
+
+/*!	Starts writing back the oldest log entries in the background, once half
+	of the log is in use.
+*/
+void
+Journal::_StartCheckpoint()
+{
+	if (fUsed < fLogSize / 2
+		|| atomic_test_and_set(&fCheckpointing, 1, 0) != 0)
+		return;
+
+	thread_id thread = spawn_kernel_thread(&Journal::_Checkpoint,
+		"bfs checkpoint", B_NORMAL_PRIORITY, this);
+	if (thread < 0) {
+		// we'll have to wait for the log space when we need it
+		atomic_set(&fCheckpointing, 0);
+		return;
+	}
+
+	fCheckpointThread = thread;
+	atomic_add64(&fCheckpoints, 1);
+	resume_thread(thread);
+}
+
+
 /*!	Writes the blocks that are part of current transaction into the log,
 	and ends the current transaction.
 	If the current transaction is too large to fit into the log, it will
@@ -766,12 +844,14 @@ Journal::_WriteTransactionToLog()
 				NULL);
 			fUnwrittenTransactions = 0;
 		}
+		atomic_set64(&fLogSequence, fCommitSequence - (detached ? 1 : 0));
 		return B_OK;
 	}
 
 	// If necessary, flush the log, so that we have enough space for this
 	// transaction
 	if (runArrays.LogEntryLength() > FreeLogBlocks()) {
+		atomic_add64(&fLogFullWaits, 1);
 		cache_sync_transaction(fVolume->BlockCache(), fTransactionID);
 		if (runArrays.LogEntryLength() > FreeLogBlocks()) {
 			panic("no space in log after sync (%ld for %ld blocks)!",
@@ -861,9 +941,7 @@ Journal::_WriteTransactionToLog()
 		return B_NO_MEMORY;
 	}
 
-#ifdef BFS_DEBUGGER_COMMANDS
 	logEntry->SetTransactionID(fTransactionID);
-#endif
 
 	// Update the log end pointer in the superblock
 
@@ -888,6 +966,9 @@ Journal::_WriteTransactionToLog()
 	fUsed += logEntry->Length();
 	mutex_unlock(&fEntriesLock);
 
+	atomic_add64(&fLogWrites, 1);
+	atomic_add64(&fLogBlocks, logEntry->Length());
+
 	if (detached) {
 		fTransactionID = cache_detach_sub_transaction(fVolume->BlockCache(),
 			fTransactionID, _TransactionWritten, logEntry);
@@ -906,6 +987,11 @@ Journal::_WriteTransactionToLog()
 		fUnwrittenTransactions = 0;
 	}
 
+	// A detached sub-transaction is the last completed one, and still
+	// has to be written
+	atomic_set64(&fLogSequence, fCommitSequence - (detached ? 1 : 0));
+
+	_StartCheckpoint();
 	return status;
 }
 
@@ -943,6 +1029,47 @@ Journal::_FlushLog(bool canWait, bool flushBlocks)
 }
 
 
+/*!	Makes sure that all transactions that have been completed so far are
+	written to the log, as fsync() requires it.
+	Concurrent callers share their log writes: while one of them writes the
+	log, the others wait for it to finish, and only write the log themselves
+	if their transaction didn't make it into that write. If the previous
+	write had been shared, the writer waits a moment for the transactions
+	still in progress to join it.
+*/
+status_t
+Journal::FlushLog()
+{
+	int64 sequence = atomic_get64(&fCommitSequence);
+	if (atomic_get64(&fLogSequence) >= sequence)
+		return B_OK;
+
+	bigtime_t start = system_time();
+	atomic_add64(&fSyncRequests, 1);
+	atomic_add(&fCommitWaiters, 1);
+
+	mutex_lock(&fCommitLock);
+	atomic_add(&fCommitWaiters, -1);
+
+	status_t status = B_OK;
+	if (atomic_get64(&fLogSequence) >= sequence) {
+		// the previous log write already contained our transaction
+		atomic_add64(&fSharedSyncs, 1);
+	} else {
+		if (fSharedCommit)
+			snooze(kGroupCommitWindow);
+
+		status = _FlushLog(true, false);
+		fSharedCommit = atomic_get(&fCommitWaiters) > 0;
+	}
+
+	mutex_unlock(&fCommitLock);
+
+	_AddCommitLatency(system_time() - start);
+	return status;
+}
+
+
 /*!	Flushes the current log entry to disk, and also writes back all dirty
 	blocks for this volume (completing all open transactions).
 */
@@ -1067,14 +1194,19 @@ Journal::_TransactionDone(bool success)
 		return B_OK;
 	}
 
+	atomic_add64(&fCommitSequence, 1);
+	atomic_add64(&fTransactions, 1);
+
 	// Up to a maximum size, we will just batch several
 	// transactions together to improve speed
 	uint32 size = _TransactionSize();
 	if (size < fMaxTransactionSize) {
 		// Flush the log from time to time, so that we have enough space
 		// for this transaction
-		if (size > FreeLogBlocks())
+		if (size > FreeLogBlocks()) {
+			atomic_add64(&fLogFullWaits, 1);
 			cache_sync_transaction(fVolume->BlockCache(), fTransactionID);
+		}
 
 		fUnwrittenTransactions++;
 		return B_OK;
@@ -1084,6 +1216,47 @@ Journal::_TransactionDone(bool success)
 }
 
 
+void
+Journal::_AddCommitLatency(bigtime_t latency)
+{
+	int32 slot = 0;
+	for (bigtime_t limit = 32; latency >= limit
+			&& slot < BFS_JOURNAL_LATENCY_SLOTS - 1; limit <<= 1) {
+		slot++;
+	}
+
+	atomic_add64(&fCommitLatency[slot], 1);
+	atomic_add64(&fTotalCommitLatency, latency);
+
+	int64 max = atomic_get64(&fMaxCommitLatency);
+	while (latency > max) {
+		int64 previous = atomic_test_and_set64(&fMaxCommitLatency, latency,
+			max);
+		if (previous == max)
+			break;
+		max = previous;
+	}
+}
+
+
+void
+Journal::GetStatistics(journal_stats& stats)
+{
+	stats.transactions = atomic_get64(&fTransactions);
+	stats.log_writes = atomic_get64(&fLogWrites);
+	stats.log_blocks = atomic_get64(&fLogBlocks);
+	stats.sync_requests = atomic_get64(&fSyncRequests);
+	stats.shared_syncs = atomic_get64(&fSharedSyncs);
+	stats.checkpoints = atomic_get64(&fCheckpoints);
+	stats.log_full_waits = atomic_get64(&fLogFullWaits);
+	stats.total_commit_latency = atomic_get64(&fTotalCommitLatency);
+	stats.max_commit_latency = atomic_get64(&fMaxCommitLatency);
+
+	for (int32 i = 0; i < BFS_JOURNAL_LATENCY_SLOTS; i++)
+		stats.commit_latency[i] = atomic_get64(&fCommitLatency[i]);
+}
+
+
 //	#pragma mark - debugger commands
 
 
@@ -1105,6 +1278,9 @@ Journal::Dump()
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
 	kprintf("  separate sub-trans.:  %d\n", fSeparateSubTransactions);
+	kprintf("  commit sequence:      %" B_PRId64 "\n", fCommitSequence);
+	kprintf("  log sequence:         %" B_PRId64 "\n", fLogSequence);
+	kprintf("  checkpointing:        %" B_PRId32 "\n", fCheckpointing);
 	kprintf("entries:\n");
 	kprintf("  address        id  start length\n");
 
@@ -10,6 +10,7 @@
 
 #include "Volume.h"
 #include "Utility.h"
+#include "bfs_control.h"
 
 
 struct run_array;
@@ -35,12 +36,15 @@ public:
 			size_t			CurrentTransactionSize() const;
 			bool			CurrentTransactionTooLarge() const;
 
+			status_t		FlushLog();
 			status_t		FlushLogAndBlocks();
 			Volume*			GetVolume() const { return fVolume; }
 			int32			TransactionID() const { return fTransactionID; }
 
 	inline	uint32			FreeLogBlocks() const;
 
+			void			GetStatistics(journal_stats& stats);
+
 #ifdef BFS_DEBUGGER_COMMANDS
 			void			Dump();
 #endif
@@ -55,12 +59,15 @@ private:
 			status_t		_CheckRunArray(const run_array* array);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
+			void			_StartCheckpoint();
+			void			_AddCommitLatency(bigtime_t latency);
 
 	static	void			_TransactionWritten(int32 transactionID,
 								int32 event, void* _logEntry);
 	static	void			_TransactionIdle(int32 transactionID, int32 event,
 								void* _journal);
 	static	status_t		_FlushLog(void* _journal);
+	static	status_t		_Checkpoint(void* _journal);
 
 private:
 			Volume*			fVolume;
@@ -76,6 +83,25 @@ private:
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
 			bool			fSeparateSubTransactions;
+
+			mutex			fCommitLock;
+			int64			fCommitSequence;
+			int64			fLogSequence;
+			int32			fCommitWaiters;
+			bool			fSharedCommit;
+			int32			fCheckpointing;
+			thread_id		fCheckpointThread;
+
+			int64			fTransactions;
+			int64			fLogWrites;
+			int64			fLogBlocks;
+			int64			fSyncRequests;
+			int64			fSharedSyncs;
+			int64			fCheckpoints;
+			int64			fLogFullWaits;
+			int64			fTotalCommitLatency;
+			int64			fMaxCommitLatency;
+			int64			fCommitLatency[BFS_JOURNAL_LATENCY_SLOTS];
 };
 
 
@@ -15,6 +15,8 @@
 
 #include "Query.h"
 
+#include <stdarg.h>
+
 #include <file_systems/QueryParserUtils.h>
 #include <query_private.h>
 
@@ -70,11 +72,109 @@ union value {
 };
 
 
+// Loading and matching an inode is considered to be as expensive as reading
+// this many index entries.
+static const off_t kInodeCost = 24;
+// The maximum number of inode IDs that are collected into a single set.
+static const uint32 kMaxCandidates = 65536;
+
+
+/*!	A sorted set of inode IDs, as collected from an index.
+*/
+class IDSet {
+public:
+								IDSet();
+								~IDSet();
+
+			uint32				Count() const { return fCount; }
+			off_t				At(uint32 index) const { return fIDs[index]; }
+
+			status_t			Add(off_t id);
+			void				Sort();
+			void				Intersect(const IDSet& other);
+			status_t			Unite(const IDSet& other);
+
+private:
+			off_t*				fIDs;
+			uint32				fCount;
+			uint32				fCapacity;
+};
+
+
+/*!	Estimates how many entries of an index fall into a range of keys, based
+	on the statistics that are stored in the index B+tree.
+	Without a histogram, it can only make an educated guess.
+*/
+class IndexEstimator {
+public:
+								IndexEstimator(Index& index, type_code type);
+
+			off_t				Entries() const { return fEntries; }
+			bool				HasHistogram() const { return fHasHistogram; }
+
+			off_t				CountEqual(const uint8* key, uint16 length);
+			off_t				CountLess(const uint8* key, uint16 length,
+									bool orEqual);
+
+private:
+			int					_Compare(int32 bucket, const uint8* key,
+									uint16 length) const;
+			double				_Rank(const uint8* key, uint16 length,
+									bool orEqual) const;
+			double				_Fraction(int32 bucket, const uint8* key,
+									uint16 length) const;
+			double				_ToDouble(const uint8* key) const;
+			double				_Duplicates() const;
+			double				_Scale() const;
+
+private:
+			bplustree_statistics fStatistics;
+			type_code			fType;
+			off_t				fEntries;
+			bool				fHasHistogram;
+};
+
+
+/*!	Writes a textual description of a query plan into a buffer.
+*/
+class PlanPrinter {
+public:
+								PlanPrinter(char* buffer, size_t size);
+
+			void				Print(const char* format, ...);
+			void				Indent(int32 depth)
+									{ Print("%*s", (int)depth * 4, ""); }
+
+private:
+			char*				fBuffer;
+			size_t				fSize;
+			size_t				fLength;
+};
+
+
 /*!	Abstract base class for the operator/equation classes.
+
+	Before a query is run, every term estimates how many entries will match
+	it, and how expensive it would be to find them. Costs are measured in
+	index entries that have to be read; loading and matching an inode is
+	regarded as kInodeCost entries.
+	A term may also be evaluated by collecting the IDs of all matching inodes
+	from its indices into a set first - the set cost is the number of index
+	entries that have to be read for this, or -1 if that's not possible.
 */
 class Term {
 public:
-								Term(int8 op) : fOp(op), fParent(NULL) {}
+								Term(int8 op)
+									:
+									fOp(op),
+									fParent(NULL),
+									fMatches(0),
+									fSetCost(-1),
+									fCandidates(0),
+									fInSet(false),
+									fExactSet(false)
+								{
+								}
 	virtual						~Term() {}
 
 			int8				Op() const { return fOp; }
@@ -88,11 +188,22 @@ public:
 									size_t size = 0) = 0;
 	virtual	void				Complement() = 0;
 
-	virtual	void				CalculateScore(Index& index) = 0;
-	virtual	int32				Score() const = 0;
+	virtual	void				Estimate(Index& index, off_t entries) = 0;
+	virtual	off_t				ScanCost() const = 0;
+			off_t				StepCost() const;
+			bool				PrefersSet() const;
+
+			off_t				Matches() const { return fMatches; }
+			off_t				SetCost() const { return fSetCost; }
+			off_t				Candidates() const { return fCandidates; }
+			bool				InSet() const { return fInSet; }
+			void				SetInSet(bool inSet) { fInSet = inSet; }
+			bool				IsExactSet() const { return fExactSet; }
 
 	virtual	status_t			InitCheck() = 0;
 
+	virtual	void				PrintTo(PlanPrinter& printer) const = 0;
+
 #ifdef DEBUG
 	virtual	void				PrintToStream() = 0;
 #endif
@@ -100,6 +211,14 @@ public:
 protected:
 			int8				fOp;
 			Term*				fParent;
+
+			off_t				fMatches;
+			off_t				fSetCost;
+			off_t				fCandidates;
+			bool				fInSet;
+				// whether or not the parent intersects/unites our set
+			bool				fExactSet;
+				// whether or not all inodes in the set match this term
 };
 
 
@@ -108,7 +227,7 @@ protected:
 	Although an Equation object is quite independent from the volume on which
 	the query is run, there are some dependencies that are produced while
 	querying:
-	The type/size of the value, the score, and if it has an index or not.
+	The type/size of the value, the estimates, and if it has an index or not.
 	So you could run more than one query on the same volume, but it might return
 	wrong values when it runs concurrently on another volume.
 	That's not an issue right now, because we run single-threaded and don't use
@@ -133,9 +252,15 @@ public:
 			status_t			GetNextMatching(Volume* volume,
 									TreeIterator* iterator,
 									struct dirent* dirent, size_t bufferSize);
+			status_t			CollectMatching(Volume* volume, Index& index,
+									IDSet& set);
 
-	virtual	void				CalculateScore(Index &index);
-	virtual	int32				Score() const { return fScore; }
+	virtual	void				Estimate(Index& index, off_t entries);
+	virtual	off_t				ScanCost() const;
+
+	virtual	void				PrintTo(PlanPrinter& printer) const;
+			void				PrintIndexTo(PlanPrinter& printer,
+									bool queryNonIndexed) const;
 
 #ifdef DEBUG
 	virtual	void				PrintToStream();
@@ -153,6 +278,10 @@ private:
 			status_t			_ConvertValue(type_code type);
 			bool				_CompareTo(const uint8* value, uint16 size);
 			uint8*				_Value() const { return (uint8*)&fValue; }
+			status_t			_GetNextIndexEntry(TreeIterator* iterator,
+									off_t* _value);
+			off_t				_EstimateMatches(
+									IndexEstimator& estimator);
 
 private:
 			char*				fAttribute;
@@ -161,10 +290,15 @@ private:
 			type_code			fType;
 			size_t				fSize;
 			bool				fIsPattern;
+			int32				fPrefixLength;
+				// the number of characters before the first pattern symbol
 			bool				fIsSpecialTime;
 
-			int32				fScore;
 			bool				fHasIndex;
+			bool				fIndexMissing;
+			off_t				fIndexEntries;
+			off_t				fScanned;
+				// the number of index entries a scan has to read
 };
 
 
@@ -185,11 +319,13 @@ public:
 									size_t size = 0);
 	virtual	void				Complement();
 
-	virtual	void				CalculateScore(Index& index);
-	virtual	int32				Score() const;
+	virtual	void				Estimate(Index& index, off_t entries);
+	virtual	off_t				ScanCost() const;
 
 	virtual	status_t			InitCheck();
 
+	virtual	void				PrintTo(PlanPrinter& printer) const;
+
 #ifdef DEBUG
 	virtual	void				PrintToStream();
 #endif
@@ -208,13 +344,482 @@ private:
 //	#pragma mark -
 
 
+PlanPrinter::PlanPrinter(char* buffer, size_t size)
+	:
+	fBuffer(buffer),
+	fSize(size),
+	fLength(0)
+{
+	if (fSize > 0)
+		fBuffer[0] = '\0';
+}
+
+
+void
+PlanPrinter::Print(const char* format, ...)
+{
+	if (fLength + 1 >= fSize)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(fBuffer + fLength, fSize - fLength, format, args);
+	va_end(args);
+
+	if (length > 0)
+		fLength = min_c(fLength + length, fSize - 1);
+}
+
+
+//	#pragma mark -
+
+
+IDSet::IDSet()
+	:
+	fIDs(NULL),
+	fCount(0),
+	fCapacity(0)
+{
+}
+
+
+IDSet::~IDSet()
+{
+	free(fIDs);
+}
+
+
+status_t
+IDSet::Add(off_t id)
+{
+	if (fCount == fCapacity) {
+		if (fCapacity >= kMaxCandidates)
+			return B_BUFFER_OVERFLOW;
+
+		uint32 capacity = fCapacity == 0 ? 256 : fCapacity * 2;
+		off_t* ids = (off_t*)realloc(fIDs, capacity * sizeof(off_t));
+		if (ids == NULL)
+			return B_NO_MEMORY;
+
+		fIDs = ids;
+		fCapacity = capacity;
+	}
+
+	fIDs[fCount++] = id;
+	return B_OK;
+}
+
+
+/*!	Sorts the IDs, and removes the duplicates; this has to be done before
+	the set can be combined with another one.
+*/
+void
+IDSet::Sort()
+{
+	std::sort(fIDs, fIDs + fCount);
+	fCount = std::unique(fIDs, fIDs + fCount) - fIDs;
+}
+
+
+void
+IDSet::Intersect(const IDSet& other)
+{
+	uint32 count = 0;
+	uint32 otherIndex = 0;
+
+	for (uint32 i = 0; i < fCount; i++) {
+		while (otherIndex < other.fCount && other.fIDs[otherIndex] < fIDs[i])
+			otherIndex++;
+		if (otherIndex == other.fCount)
+			break;
+
+		if (other.fIDs[otherIndex] == fIDs[i])
+			fIDs[count++] = fIDs[i];
+	}
+
+	fCount = count;
+}
+
+
+status_t
+IDSet::Unite(const IDSet& other)
+{
+	if (other.fCount == 0)
+		return B_OK;
+
+	uint32 capacity = fCount + other.fCount;
+	off_t* ids = (off_t*)malloc(capacity * sizeof(off_t));
+	if (ids == NULL)
+		return B_NO_MEMORY;
+
+	fCount = std::set_union(fIDs, fIDs + fCount, other.fIDs,
+		other.fIDs + other.fCount, ids) - ids;
+
+	free(fIDs);
+	fIDs = ids;
+	fCapacity = capacity;
+	return B_OK;
+}
+
+
+//	#pragma mark -
+
+
+IndexEstimator::IndexEstimator(Index& index, type_code type)
+	:
+	fType(type),
+	fEntries(0),
+	fHasHistogram(false)
+{
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree != NULL && tree->GetStatistics(fStatistics) == B_OK) {
+		fEntries = fStatistics.EntryCount();
+		fHasHistogram = fStatistics.BucketCount() > 0
+			&& fStatistics.KeyCount() > 0
+			&& fStatistics.HistogramEntries() > 0;
+	} else {
+		// The index was created before we kept statistics - a node usually
+		// contains an entry for every 32 bytes or so.
+		fEntries = index.Node()->Size() / 32;
+	}
+}
+
+
+/*!	Returns the estimated number of entries with the given key.
+	You must only call this method if there is a histogram.
+*/
+off_t
+IndexEstimator::CountEqual(const uint8* key, uint16 length)
+{
+	// Frequent keys show up as several bucket keys in a row; all entries
+	// in between have that key as well
+	int32 first = -1;
+	int32 last = -1;
+	for (int32 i = 0; i < fStatistics.BucketCount(); i++) {
+		int compare = _Compare(i, key, length);
+		if (compare < 0)
+			continue;
+		if (compare > 0)
+			break;
+
+		if (first < 0)
+			first = i;
+		last = i;
+	}
+
+	double count = _Duplicates();
+	if (first >= 0 && last > first) {
+		count += fStatistics.buckets[last].Entries()
+			- fStatistics.buckets[first].Entries();
+	}
+
+	return min_c((off_t)(count * _Scale() + 0.5), fEntries);
+}
+
+
+/*!	Returns the estimated number of entries with a key lower than (or equal
+	to, if \a orEqual is \c true) the given key.
+	You must only call this method if there is a histogram.
+*/
+off_t
+IndexEstimator::CountLess(const uint8* key, uint16 length, bool orEqual)
+{
+	return min_c((off_t)(_Rank(key, length, orEqual) * _Scale() + 0.5),
+		fEntries);
+}
+
+
+int
+IndexEstimator::_Compare(int32 index, const uint8* key, uint16 length) const
+{
+	const bplustree_histogram_bucket& bucket = fStatistics.buckets[index];
+	uint16 bucketLength = bucket.StoredKeyLength();
+
+	// only the start of long keys is stored in the histogram
+	if (fType == B_STRING_TYPE && bucket.KeyLength() > bucketLength
+		&& length > bucketLength)
+		length = bucketLength;
+
+	return compareKeys(fType, bucket.key, bucketLength, key, length);
+}
+
+
+/*!	Returns the number of entries in the histogram that are lower than
+	the key, interpolating within the bucket the key falls into.
+*/
+double
+IndexEstimator::_Rank(const uint8* key, uint16 length, bool orEqual) const
+{
+	double previous = 0;
+
+	for (int32 i = 0; i < fStatistics.BucketCount(); i++) {
+		double entries = fStatistics.buckets[i].Entries();
+		int compare = _Compare(i, key, length);
+		if (compare < 0 || (compare == 0 && orEqual)) {
+			previous = entries;
+			continue;
+		}
+
+		if (compare == 0) {
+			// the bucket ends with the duplicates of our key
+			return max_c(previous, entries - _Duplicates());
+		}
+
+		return previous + (entries - previous) * _Fraction(i, key, length);
+	}
+
+	return previous;
+}
+
+
+/*!	Returns the relative position of the key between the keys of the
+	previous and the given bucket.
+*/
+double
+IndexEstimator::_Fraction(int32 index, const uint8* key, uint16 length) const
+{
+	if (index == 0)
+		return 0.5;
+
+	const bplustree_histogram_bucket& low = fStatistics.buckets[index - 1];
+	const bplustree_histogram_bucket& high = fStatistics.buckets[index];
+	double lowValue;
+	double highValue;
+	double value;
+
+	if (fType == B_STRING_TYPE) {
+		// skip the prefix both keys have in common, and compare the
+		// following characters
+		uint16 lowLength = low.StoredKeyLength();
+		uint16 highLength = high.StoredKeyLength();
+		uint16 prefix = 0;
+		while (prefix < lowLength && prefix < highLength
+			&& low.key[prefix] == high.key[prefix])
+			prefix++;
+
+		lowValue = highValue = value = 0;
+		double factor = 1;
+		for (uint16 i = prefix; i < prefix + 3; i++) {
+			factor /= 256;
+			lowValue += factor * (i < lowLength ? low.key[i] : 0);
+			highValue += factor * (i < highLength ? high.key[i] : 0);
+			value += factor * (i < length ? key[i] : 0);
+		}
+	} else {
+		lowValue = _ToDouble(low.key);
+		highValue = _ToDouble(high.key);
+		value = _ToDouble(key);
+	}
+
+	if (highValue <= lowValue)
+		return 0.5;
+
+	double fraction = (value - lowValue) / (highValue - lowValue);
+	if (fraction < 0)
+		return 0;
+	if (fraction > 1)
+		return 1;
+
+	return fraction;
+}
+
+
+double
+IndexEstimator::_ToDouble(const uint8* key) const
+{
+	switch (fType) {
+		case B_INT32_TYPE:
+			return *(int32*)key;
+		case B_UINT32_TYPE:
+			return *(uint32*)key;
+		case B_INT64_TYPE:
+			return *(int64*)key;
+		case B_UINT64_TYPE:
+			return *(uint64*)key;
+		case B_FLOAT_TYPE:
+			return *(float*)key;
+		case B_DOUBLE_TYPE:
+			return *(double*)key;
+	}
+	return 0;
+}
+
+
+//!	Returns the average number of entries per key.
+double
+IndexEstimator::_Duplicates() const
+{
+	return (double)fStatistics.HistogramEntries() / fStatistics.KeyCount();
+}
+
+
+//!	Returns how much the index has grown since the histogram was computed.
+double
+IndexEstimator::_Scale() const
+{
+	return (double)fEntries / fStatistics.HistogramEntries();
+}
+
+
+//	#pragma mark -
+
+
+/*!	Returns the cost to evaluate the term on its own, either by scanning its
+	indices, or by collecting a set of candidates first.
+*/
+off_t
+Term::StepCost() const
+{
+	if (PrefersSet())
+		return fSetCost + fCandidates * kInodeCost;
+
+	return ScanCost();
+}
+
+
+/*!	Returns whether or not the term should be evaluated by collecting the
+	candidates from its indices first. This is only done for operators, as
+	it doesn't pay off for a single equation.
+*/
+bool
+Term::PrefersSet() const
+{
+	return fOp < OP_EQUATION && fSetCost >= 0
+		&& fSetCost + fCandidates * kInodeCost < ScanCost();
+}
+
+
+/*!	Goes up in the tree until the root, and checks if the inode matches the
+	other side of every &&-operator on the way - ||-operators don't need to
+	be checked, as one side is enough.
+*/
+static status_t
+match_parents(Term* term, Inode* inode)
+{
+	status_t status = MATCH_OK;
+
+	while (term != NULL && status == MATCH_OK) {
+		Operator* parent = (Operator*)term->Parent();
+		if (parent == NULL)
+			break;
+
+		if (parent->Op() == OP_AND) {
+			// choose the other child of the parent
+			Term* other = parent->Right();
+			if (other == term)
+				other = parent->Left();
+
+			if (other == NULL) {
+				FATAL(("&&-operator has only one child... (parent = %p)\n",
+					parent));
+				break;
+			}
+			status = other->Match(inode);
+			if (status < 0) {
+				REPORT_ERROR(status);
+				status = NO_MATCH;
+			}
+		}
+		term = (Term*)parent;
+	}
+
+	return status;
+}
+
+
+static void
+fill_dirent(Volume* volume, Inode* inode, struct dirent* dirent)
+{
+	dirent->d_dev = volume->ID();
+	dirent->d_ino = inode->ID();
+	dirent->d_pdev = volume->ID();
+	dirent->d_pino = volume->ToVnode(inode->Parent());
+
+	if (inode->GetName(dirent->d_name) < B_OK) {
+		FATAL(("inode %" B_PRIdOFF " in query has no name!\n",
+			inode->BlockNumber()));
+	}
+
+	dirent->d_reclen = sizeof(struct dirent) + strlen(dirent->d_name);
+}
+
+
+static const char*
+operator_symbol(int8 op)
+{
+	switch (op) {
+		case OP_EQUAL:
+			return "==";
+		case OP_UNEQUAL:
+			return "!=";
+		case OP_GREATER_THAN:
+			return ">";
+		case OP_GREATER_THAN_OR_EQUAL:
+			return ">=";
+		case OP_LESS_THAN:
+			return "<";
+		case OP_LESS_THAN_OR_EQUAL:
+			return "<=";
+	}
+	return "???";
+}
+
+
+/*!	Describes how the candidate set of the term is collected.
+*/
+static void
+explain_set(PlanPrinter& printer, Term* term, int32 depth)
+{
+	if (term->Op() > OP_EQUATION) {
+		printer.Indent(depth);
+		((Equation*)term)->PrintIndexTo(printer, false);
+		printer.Print("\n");
+		return;
+	}
+
+	Operator* op = (Operator*)term;
+	Term* terms[2] = {op->Left(), op->Right()};
+
+	if (terms[0]->InSet() && terms[1]->InSet()) {
+		printer.Indent(depth);
+		printer.Print("%s\n", op->Op() == OP_AND ? "intersect" : "unite");
+		explain_set(printer, terms[0], depth + 1);
+		explain_set(printer, terms[1], depth + 1);
+		return;
+	}
+
+	// only one side of an "and" contributes candidates
+	for (int32 i = 0; i < 2; i++) {
+		if (terms[i]->InSet())
+			explain_set(printer, terms[i], depth);
+	}
+	for (int32 i = 0; i < 2; i++) {
+		if (terms[i]->InSet())
+			continue;
+
+		printer.Indent(depth);
+		printer.Print("match ");
+		terms[i]->PrintTo(printer);
+		printer.Print("\n");
+	}
+}
+
+
+//	#pragma mark -
+
+
 Equation::Equation(char** _expression)
 	:
 	Term(OP_EQUATION),
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fPrefixLength(0),
+	fHasIndex(false),
+	fIndexMissing(false),
+	fIndexEntries(0),
+	fScanned(0)
 {
 	char* string = *_expression;
 	char* start = string;
@@ -330,7 +935,8 @@ Equation::Equation(char** _expression)
 			// to NULL will cause InitCheck() to fail
 			free(fString);
 			fString = NULL;
-		}
+		} else if (fIsPattern)
+			fPrefixLength = max_c(getFirstPatternSymbol(fString), 0);
 	}
 
 	// The special time flag is set if the time values are shifted
@@ -519,6 +1125,8 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 	if (*iterator == NULL)
 		return B_NO_MEMORY;
 
+	(*iterator)->SetPrefetch(true);
+
 	if ((fOp == OP_EQUAL || fOp == OP_GREATER_THAN
 			|| fOp == OP_GREATER_THAN_OR_EQUAL || fIsPattern)
 		&& fHasIndex) {
@@ -543,51 +1151,221 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 			if (fType == B_STRING_TYPE) {
 				keySize = strlen(fValue.String);
 
-				// The empty string is a special case - we normally don't check
-				// for the trailing null byte, in the case for the empty string
-				// we do it explicitly, because there can't be keys in the
-				// B+tree with a length of zero
-				if (keySize == 0)
-					keySize = 1;
-			} else
-				RETURN_ERROR(B_ENTRY_NOT_FOUND);
-		}
+				// The empty string is a special case - we normally don't check
+				// for the trailing null byte, in the case for the empty string
+				// we do it explicitly, because there can't be keys in the
+				// B+tree with a length of zero
+				if (keySize == 0)
+					keySize = 1;
+			} else
+				RETURN_ERROR(B_ENTRY_NOT_FOUND);
+		}
+
+		if (fIsSpecialTime) {
+			// we have to find the first matching shifted value
+			off_t value = fValue.Int64 << INODE_TIME_SHIFT;
+			status = (*iterator)->Find((uint8*)&value, keySize);
+			if (status == B_ENTRY_NOT_FOUND)
+				return B_OK;
+		} else {
+			status = (*iterator)->Find(_Value(), keySize);
+			if (fOp == OP_EQUAL && !fIsPattern)
+				return status;
+			else if (status == B_ENTRY_NOT_FOUND
+				&& (fIsPattern || fOp == OP_GREATER_THAN
+					|| fOp == OP_GREATER_THAN_OR_EQUAL))
+				return B_OK;
+		}
+
+		RETURN_ERROR(status);
+	}
+
+	return B_OK;
+}
+
+
+status_t
+Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
+	struct dirent* dirent, size_t bufferSize)
+{
+	while (true) {
+		off_t offset;
+		status_t status = _GetNextIndexEntry(iterator, &offset);
+		if (status != B_OK)
+			return status;
+
+		Vnode vnode(volume, offset);
+		Inode* inode;
+		if ((status = vnode.Get(&inode)) != B_OK) {
+			REPORT_ERROR(status);
+			FATAL(("could not get inode %" B_PRIdOFF " in index \"%s\"!\n",
+				offset, fAttribute));
+			// try with next
+			continue;
+		}
+
+		// TODO: check user permissions here - but which one?!
+		// we could filter out all those where we don't have
+		// read access... (we should check for every parent
+		// directory if the X_OK is allowed)
+		// Although it's quite expensive to open all parents,
+		// it's likely that the application that runs the
+		// query will do something similar (and we don't have
+		// to do it for root, either).
+
+		status = MATCH_OK;
+		if (!fHasIndex)
+			status = Match(inode);
+
+		if (status == MATCH_OK)
+			status = match_parents(this, inode);
+
+		if (status == MATCH_OK) {
+			fill_dirent(volume, inode, dirent);
+			return B_OK;
+		}
+	}
+	RETURN_ERROR(B_ERROR);
+}
+
+
+/*!	Collects the IDs of all inodes that match the equation according to its
+	index. Fails with B_BUFFER_OVERFLOW if there are too many of them.
+	The IDs are added in index order; you have to sort the set afterwards.
+*/
+status_t
+Equation::CollectMatching(Volume* volume, Index& index, IDSet& set)
+{
+	TreeIterator* iterator = NULL;
+	status_t status = PrepareQuery(volume, index, &iterator, false);
+	ObjectDeleter<TreeIterator> iteratorDeleter(iterator);
+	if (iterator == NULL)
+		return status == B_OK ? B_ERROR : status;
+
+	if (!fHasIndex)
+		return B_BAD_VALUE;
+	if (status == B_ENTRY_NOT_FOUND) {
+		// there is no such key
+		return B_OK;
+	}
+	if (status != B_OK)
+		return status;
+
+	off_t id;
+	while ((status = _GetNextIndexEntry(iterator, &id)) == B_OK) {
+		status = set.Add(id);
+		if (status != B_OK)
+			return status;
+	}
+
+	return status == B_ENTRY_NOT_FOUND ? B_OK : status;
+}
+
+
+/*!	Estimates the number of inodes that match this equation on the volume
+	which has \a entries entries in its "name" index, and how many index
+	entries have to be read to find them.
+*/
+void
+Equation::Estimate(Index& index, off_t entries)
+{
+	// Unless we can use the index of the attribute, the whole "name" index
+	// has to be scanned, and every inode has to be matched
+	fHasIndex = false;
+	fIndexMissing = false;
+	fIndexEntries = entries;
+	fScanned = entries;
+	fMatches = entries / 2;
+	fSetCost = -1;
+	fCandidates = 0;
+	fExactSet = false;
+
+	if (index.SetTo(fAttribute) != B_OK) {
+		fIndexMissing = true;
+		return;
+	}
+	if (fOp == OP_UNEQUAL || _ConvertValue(index.Type()) != B_OK)
+		return;
+
+	IndexEstimator estimator(index, fType);
+
+	fHasIndex = true;
+	fIndexEntries = estimator.Entries();
+	fMatches = max_c(min_c(_EstimateMatches(estimator), fIndexEntries), 0);
+
+	// The iterator starts at the first matching key, and stops after the last
+	// one, unless we have no start for a pattern
+	fScanned = fMatches;
+	if (fIsPattern && fPrefixLength == 0)
+		fScanned = fIndexEntries;
+
+	if (fMatches <= kMaxCandidates) {
+		fSetCost = fScanned;
+		fCandidates = fMatches;
+		fExactSet = true;
+	}
+}
+
+
+off_t
+Equation::ScanCost() const
+{
+	if (!fHasIndex) {
+		// every inode has to be checked
+		return fScanned * (1 + kInodeCost);
+	}
+
+	return fScanned + fMatches * kInodeCost;
+}
+
+
+void
+Equation::PrintTo(PlanPrinter& printer) const
+{
+	printer.Print("\"%s\" %s \"%s\"", fAttribute, operator_symbol(fOp),
+		fString);
+}
+
 
-		if (fIsSpecialTime) {
-			// we have to find the first matching shifted value
-			off_t value = fValue.Int64 << INODE_TIME_SHIFT;
-			status = (*iterator)->Find((uint8*)&value, keySize);
-			if (status == B_ENTRY_NOT_FOUND)
-				return B_OK;
-		} else {
-			status = (*iterator)->Find(_Value(), keySize);
-			if (fOp == OP_EQUAL && !fIsPattern)
-				return status;
-			else if (status == B_ENTRY_NOT_FOUND
-				&& (fIsPattern || fOp == OP_GREATER_THAN
-					|| fOp == OP_GREATER_THAN_OR_EQUAL))
-				return B_OK;
-		}
+//!	Describes how the index is used to find the matching inodes.
+void
+Equation::PrintIndexTo(PlanPrinter& printer, bool queryNonIndexed) const
+{
+	if (fHasIndex) {
+		printer.Print("index \"%s\" for ", fAttribute);
+		PrintTo(printer);
+		printer.Print(": ~%" B_PRIdOFF " of %" B_PRIdOFF " entries", fMatches,
+			fIndexEntries);
+		if (fScanned > fMatches)
+			printer.Print(", reads all");
+		return;
+	}
 
-		RETURN_ERROR(status);
+	if (fIndexMissing && !queryNonIndexed) {
+		printer.Print("nothing, no index for ");
+		PrintTo(printer);
+		return;
 	}
 
-	return B_OK;
+	printer.Print("index \"name\" for ");
+	PrintTo(printer);
+	printer.Print(": %" B_PRIdOFF " entries, matches all", fIndexEntries);
 }
 
 
+/*!	Returns the next entry of the index that matches the equation, or
+	B_ENTRY_NOT_FOUND if there are no more.
+*/
 status_t
-Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
-	struct dirent* dirent, size_t bufferSize)
+Equation::_GetNextIndexEntry(TreeIterator* iterator, off_t* _value)
 {
 	while (true) {
 		union value indexValue;
 		uint16 keyLength;
 		uint16 duplicate;
-		off_t offset;
 
 		status_t status = iterator->GetNextEntry(&indexValue, &keyLength,
-			(uint16)sizeof(indexValue), &offset, &duplicate);
+			(uint16)sizeof(indexValue), _value, &duplicate);
 		if (status != B_OK)
 			return status;
 
@@ -601,7 +1379,11 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			// fit.
 			if (fOp == OP_LESS_THAN
 				|| fOp == OP_LESS_THAN_OR_EQUAL
-				|| (fOp == OP_EQUAL && !fIsPattern))
+				|| (fOp == OP_EQUAL && !fIsPattern)
+				|| (fIsPattern && fPrefixLength > 0
+					&& compareKeys(B_STRING_TYPE, &indexValue,
+						min_c(keyLength, fPrefixLength), fValue.String,
+						fPrefixLength) > 0))
 				return B_ENTRY_NOT_FOUND;
 
 			if (duplicate > 0)
@@ -609,111 +1391,92 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			continue;
 		}
 
-		Vnode vnode(volume, offset);
-		Inode* inode;
-		if ((status = vnode.Get(&inode)) != B_OK) {
-			REPORT_ERROR(status);
-			FATAL(("could not get inode %" B_PRIdOFF " in index \"%s\"!\n",
-				offset, fAttribute));
-			// try with next
-			continue;
-		}
-
-		// TODO: check user permissions here - but which one?!
-		// we could filter out all those where we don't have
-		// read access... (we should check for every parent
-		// directory if the X_OK is allowed)
-		// Although it's quite expensive to open all parents,
-		// it's likely that the application that runs the
-		// query will do something similar (and we don't have
-		// to do it for root, either).
-
-		// go up in the tree until a &&-operator is found, and check if the
-		// inode matches with the rest of the expression - we don't have to
-		// check ||-operators for that
-		Term* term = this;
-		status = MATCH_OK;
-
-		if (!fHasIndex)
-			status = Match(inode);
-
-		while (term != NULL && status == MATCH_OK) {
-			Operator* parent = (Operator*)term->Parent();
-			if (parent == NULL)
-				break;
-
-			if (parent->Op() == OP_AND) {
-				// choose the other child of the parent
-				Term* other = parent->Right();
-				if (other == term)
-					other = parent->Left();
+		return B_OK;
+	}
+}
 
-				if (other == NULL) {
-					FATAL(("&&-operator has only one child... (parent = %p)\n",
-						parent));
-					break;
-				}
-				status = other->Match(inode);
-				if (status < 0) {
-					REPORT_ERROR(status);
-					status = NO_MATCH;
-				}
-			}
-			term = (Term*)parent;
-		}
 
-		if (status == MATCH_OK) {
-			dirent->d_dev = volume->ID();
-			dirent->d_ino = offset;
-			dirent->d_pdev = volume->ID();
-			dirent->d_pino = volume->ToVnode(inode->Parent());
-
-			if (inode->GetName(dirent->d_name) < B_OK) {
-				FATAL(("inode %" B_PRIdOFF " in query has no name!\n",
-					inode->BlockNumber()));
-			}
+/*!	Estimates the number of index entries that match the equation. You have
+	to call _ConvertValue() before this one.
+*/
+off_t
+Equation::_EstimateMatches(IndexEstimator& estimator)
+{
+	off_t entries = estimator.Entries();
 
-			dirent->d_reclen = sizeof(struct dirent) + strlen(dirent->d_name);
+	if (!estimator.HasHistogram()) {
+		// We can only guess
+		if (fIsPattern) {
+			if (fPrefixLength == 0)
+				return entries / 8;
+
+			// every character of the prefix should help a bit
+			off_t matches = entries;
+			for (int32 i = 0; i < fPrefixLength && matches > 1; i++)
+				matches /= 8;
+			return matches;
 		}
+		if (fOp == OP_EQUAL)
+			return 1 + entries / 1000;
 
-		if (status == MATCH_OK)
-			return B_OK;
+		return entries / 3;
 	}
-	RETURN_ERROR(B_ERROR);
-}
 
-
-void
-Equation::CalculateScore(Index &index)
-{
-	// As always, these values could be tuned and refined.
-	// And the code could also need some real world testing :-)
-
-	// do we have to operate on a "foreign" index?
-	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) < B_OK) {
-		fScore = 0;
-		return;
+	if (fIsPattern) {
+		if (fPrefixLength == 0)
+			return entries / 8;
+
+		// count the keys that start with the prefix
+		char end[MAX_INDEX_KEY_LENGTH + 1];
+		memcpy(end, fValue.String, fPrefixLength);
+		int32 last = fPrefixLength - 1;
+		while (last >= 0 && (uint8)end[last] == 0xff)
+			last--;
+		if (last < 0)
+			return entries - estimator.CountLess(_Value(), fPrefixLength, false);
+
+		end[last]++;
+		return estimator.CountLess((uint8*)end, last + 1, false)
+			- estimator.CountLess(_Value(), fPrefixLength, false);
 	}
 
-	// if we have a pattern, how much does it help our search?
-	if (fIsPattern)
-		fScore = getFirstPatternSymbol(fString) << 3;
-	else {
-		// Score by operator
-		if (fOp == OP_EQUAL)
-			// higher than pattern="255 chars+*"
-			fScore = 2048;
-		else
-			// the pattern search is regarded cheaper when you have at
-			// least one character to set your index to
-			fScore = 5;
+	if (fIsSpecialTime) {
+		// the index contains shifted values
+		int64 start = fValue.Int64 << INODE_TIME_SHIFT;
+		int64 end = (fValue.Int64 + 1) << INODE_TIME_SHIFT;
+		off_t lessThanStart = estimator.CountLess((uint8*)&start,
+			sizeof(int64), false);
+		off_t lessThanEnd = estimator.CountLess((uint8*)&end, sizeof(int64),
+			false);
+
+		switch (fOp) {
+			case OP_EQUAL:
+				return lessThanEnd - lessThanStart;
+			case OP_LESS_THAN:
+				return lessThanStart;
+			case OP_LESS_THAN_OR_EQUAL:
+				return lessThanEnd;
+			case OP_GREATER_THAN:
+				return entries - lessThanEnd;
+			case OP_GREATER_THAN_OR_EQUAL:
+				return entries - lessThanStart;
+		}
+		return entries;
 	}
 
-	// take index size into account (1024 is the current node size
-	// in our B+trees)
-	// 2048 * 2048 == 4194304 is the maximum score (for an empty
-	// tree, since the header + 1 node are already 2048 bytes)
-	fScore = fScore * ((2048 * 1024LL) / index.Node()->Size());
+	switch (fOp) {
+		case OP_EQUAL:
+			return estimator.CountEqual(_Value(), fSize);
+		case OP_LESS_THAN:
+			return estimator.CountLess(_Value(), fSize, false);
+		case OP_LESS_THAN_OR_EQUAL:
+			return estimator.CountLess(_Value(), fSize, true);
+		case OP_GREATER_THAN:
+			return entries - estimator.CountLess(_Value(), fSize, true);
+		case OP_GREATER_THAN_OR_EQUAL:
+			return entries - estimator.CountLess(_Value(), fSize, false);
+	}
+	return entries;
 }
 
 
@@ -915,19 +1678,24 @@ Operator::Match(Inode* inode, const char* attribute, int32 type,
 	const uint8* key, size_t size)
 {
 	if (fOp == OP_AND) {
-		status_t status = fLeft->Match(inode, attribute, type, key, size);
+		// start with the term that is less likely to match
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Matches() < fLeft->Matches()) {
+			first = fRight;
+			second = fLeft;
+		}
+
+		status_t status = first->Match(inode, attribute, type, key, size);
 		if (status != MATCH_OK)
 			return status;
 
-		return fRight->Match(inode, attribute, type, key, size);
+		return second->Match(inode, attribute, type, key, size);
 	} else {
-		// choose the term with the better score for OP_OR
-		Term* first;
-		Term* second;
-		if (fRight->Score() > fLeft->Score()) {
-			first = fLeft;
-			second = fRight;
-		} else {
+		// start with the term that is more likely to match for OP_OR
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Matches() > fLeft->Matches()) {
 			first = fRight;
 			second = fLeft;
 		}
@@ -954,30 +1722,102 @@ Operator::Complement()
 }
 
 
+/*!	Estimates the number of matches like Equation::Estimate() does, assuming
+	that both terms are independent from each other. Also decides which
+	candidate sets of its terms to use.
+*/
 void
-Operator::CalculateScore(Index &index)
+Operator::Estimate(Index& index, off_t entries)
 {
-	fLeft->CalculateScore(index);
-	fRight->CalculateScore(index);
+	fLeft->Estimate(index, entries);
+	fRight->Estimate(index, entries);
+
+	fLeft->SetInSet(false);
+	fRight->SetInSet(false);
+	fSetCost = -1;
+	fCandidates = 0;
+	fExactSet = false;
+
+	if (entries < 1)
+		entries = 1;
+
+	if (fOp == OP_OR) {
+		fMatches = min_c(fLeft->Matches() + fRight->Matches(), entries);
+
+		// we can only unite the sets if both sides have one
+		if (fLeft->SetCost() >= 0 && fRight->SetCost() >= 0) {
+			fSetCost = fLeft->SetCost() + fRight->SetCost();
+			fCandidates = min_c(fLeft->Candidates() + fRight->Candidates(),
+				entries);
+			fExactSet = fLeft->IsExactSet() && fRight->IsExactSet();
+			fLeft->SetInSet(true);
+			fRight->SetInSet(true);
+		}
+		return;
+	}
+
+	fMatches = (off_t)((double)fLeft->Matches() * fRight->Matches()
+		/ entries + 0.5);
+
+	// Choose the cheapest candidate set: the one of either side, or the
+	// intersection of both
+	bool useLeft = false;
+	bool useRight = false;
+	off_t bestCost = -1;
+	if (fLeft->SetCost() >= 0) {
+		fSetCost = fLeft->SetCost();
+		fCandidates = fLeft->Candidates();
+		bestCost = fSetCost + fCandidates * kInodeCost;
+		useLeft = true;
+	}
+	if (fRight->SetCost() >= 0) {
+		off_t cost = fRight->SetCost() + fRight->Candidates() * kInodeCost;
+		if (bestCost < 0 || cost < bestCost) {
+			fSetCost = fRight->SetCost();
+			fCandidates = fRight->Candidates();
+			bestCost = cost;
+			useLeft = false;
+			useRight = true;
+		}
+	}
+	if (fLeft->SetCost() >= 0 && fRight->SetCost() >= 0) {
+		off_t candidates = (off_t)((double)fLeft->Candidates()
+			* fRight->Candidates() / entries + 0.5);
+		off_t setCost = fLeft->SetCost() + fRight->SetCost();
+		if (setCost + candidates * kInodeCost < bestCost) {
+			fSetCost = setCost;
+			fCandidates = candidates;
+			useLeft = useRight = true;
+		}
+	}
+
+	fLeft->SetInSet(useLeft);
+	fRight->SetInSet(useRight);
+	fExactSet = useLeft && useRight && fLeft->IsExactSet()
+		&& fRight->IsExactSet();
 }
 
 
-int32
-Operator::Score() const
+off_t
+Operator::ScanCost() const
 {
 	if (fOp == OP_AND) {
-		// return the one with the better score
-		if (fRight->Score() > fLeft->Score())
-			return fRight->Score();
-
-		return fLeft->Score();
+		// only the cheaper side has to be scanned
+		return min_c(fLeft->StepCost(), fRight->StepCost());
 	}
 
-	// for OP_OR, be honest, and return the one with the worse score
-	if (fRight->Score() < fLeft->Score())
-		return fRight->Score();
+	return fLeft->StepCost() + fRight->StepCost();
+}
+
 
-	return fLeft->Score();
+void
+Operator::PrintTo(PlanPrinter& printer) const
+{
+	printer.Print("(");
+	fLeft->PrintTo(printer);
+	printer.Print(fOp == OP_AND ? " && " : " || ");
+	fRight->PrintTo(printer);
+	printer.Print(")");
 }
 
 
@@ -1059,16 +1899,7 @@ Operator::PrintToStream()
 void
 Equation::PrintToStream()
 {
-	const char* symbol = "???";
-	switch (fOp) {
-		case OP_EQUAL: symbol = "=="; break;
-		case OP_UNEQUAL: symbol = "!="; break;
-		case OP_GREATER_THAN: symbol = ">"; break;
-		case OP_GREATER_THAN_OR_EQUAL: symbol = ">="; break;
-		case OP_LESS_THAN: symbol = "<"; break;
-		case OP_LESS_THAN_OR_EQUAL: symbol = "<="; break;
-	}
-	__out("[\"%s\" %s \"%s\"]", fAttribute, symbol, fString);
+	__out("[\"%s\" %s \"%s\"]", fAttribute, operator_symbol(fOp), fString);
 }
 
 #endif	// DEBUG
@@ -1234,6 +2065,10 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	fCurrent(NULL),
 	fIterator(NULL),
 	fIndex(volume),
+	fEntries(0),
+	fCandidates(NULL),
+	fCandidateIndex(0),
+	fCandidateTerm(NULL),
 	fFlags(flags),
 	fPort(-1)
 {
@@ -1243,8 +2078,15 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	if (volume == NULL || expression == NULL || expression->Root() == NULL)
 		return;
 
+	// the "name" index tells us how many entries there are on the volume
+	if (fIndex.SetTo("name") == B_OK) {
+		IndexEstimator estimator(fIndex, B_STRING_TYPE);
+		fEntries = estimator.Entries();
+	} else
+		fEntries = volume->UsedBlocks();
+
 	// create index on the stack and delete it afterwards
-	fExpression->Root()->CalculateScore(fIndex);
+	fExpression->Root()->Estimate(fIndex, fEntries);
 	fIndex.Unset();
 
 	Rewind();
@@ -1258,6 +2100,9 @@ Query::~Query()
 {
 	if ((fFlags & B_LIVE_QUERY) != 0)
 		fVolume->RemoveQuery(this);
+
+	delete fIterator;
+	delete fCandidates;
 }
 
 
@@ -1272,31 +2117,12 @@ Query::Rewind()
 	fIterator = NULL;
 	fCurrent = NULL;
 
-	// put the whole expression on the stack
-
-	Stack<Term*> stack;
-	stack.Push(fExpression->Root());
-
-	Term* term;
-	while (stack.Pop(&term)) {
-		if (term->Op() < OP_EQUATION) {
-			Operator* op = (Operator*)term;
+	delete fCandidates;
+	fCandidates = NULL;
+	fCandidateTerm = NULL;
 
-			if (op->Op() == OP_OR) {
-				stack.Push(op->Left());
-				stack.Push(op->Right());
-			} else {
-				// For OP_AND, we can use the scoring system to decide which
-				// path to add
-				if (op->Right()->Score() > op->Left()->Score())
-					stack.Push(op->Right());
-				else
-					stack.Push(op->Left());
-			}
-		} else if (term->Op() == OP_EQUATION
-			|| fStack.Push((Equation*)term) != B_OK)
-			FATAL(("Unknown term on stack or stack error"));
-	}
+	// put the whole expression on the stack
+	_AddSteps(fExpression->Root(), true);
 
 	return B_OK;
 }
@@ -1308,11 +2134,35 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 	// If we don't have an equation to use yet/anymore, get a new one
 	// from the stack
 	while (true) {
+		if (fCandidates != NULL) {
+			status_t status = _GetNextCandidate(dirent);
+			if (status == B_OK)
+				return B_OK;
+
+			delete fCandidates;
+			fCandidates = NULL;
+			fCandidateTerm = NULL;
+
+			if (status != B_ENTRY_NOT_FOUND)
+				return status;
+			continue;
+		}
+
 		if (fIterator == NULL) {
-			if (!fStack.Pop(&fCurrent)
-				|| fCurrent == NULL)
+			Term* step;
+			if (!fStack.Pop(&step) || step == NULL)
 				return B_ENTRY_NOT_FOUND;
 
+			if (step->Op() < OP_EQUATION) {
+				// If we cannot collect the candidates (because there are
+				// too many of them), we evaluate the term step by step
+				if (_PrepareCandidates(step) != B_OK)
+					_AddSteps(step, false);
+				continue;
+			}
+
+			fCurrent = (Equation*)step;
+
 			status_t status = fCurrent->PrepareQuery(fVolume, fIndex,
 				&fIterator, fFlags & B_QUERY_NON_INDEXED);
 			if (status == B_ENTRY_NOT_FOUND) {
@@ -1340,6 +2190,58 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 }
 
 
+/*!	Writes a description of the steps the query will take into the
+	buffer, together with the estimates they are based on.
+*/
+status_t
+Query::Explain(char* buffer, size_t size)
+{
+	if (fExpression == NULL || fExpression->Root() == NULL)
+		return B_BAD_VALUE;
+
+	PlanPrinter printer(buffer, size);
+	Term* root = fExpression->Root();
+	printer.Print("~%" B_PRIdOFF " matches of %" B_PRIdOFF " entries, cost %"
+		B_PRIdOFF "\n", root->Matches(), fEntries, root->StepCost());
+
+	Term** steps = fStack.Array();
+	int32 count = fStack.CountItems();
+
+	// the last step on the stack is run first
+	for (int32 i = count; i-- > 0;) {
+		Term* step = steps[i];
+		printer.Print("%" B_PRId32 ". ", count - i);
+
+		if (step->Op() < OP_EQUATION) {
+			printer.Print("collect ~%" B_PRIdOFF " candidates, cost %"
+				B_PRIdOFF "\n", step->Candidates(), step->StepCost());
+			explain_set(printer, step, 1);
+		} else {
+			printer.Print("scan ");
+			((Equation*)step)->PrintIndexTo(printer,
+				(fFlags & B_QUERY_NON_INDEXED) != 0);
+			printer.Print(", cost %" B_PRIdOFF "\n", step->ScanCost());
+		}
+
+		// the inode also has to match all other sides of the "and"s above
+		for (Term* term = step; term->Parent() != NULL;
+				term = term->Parent()) {
+			Operator* parent = (Operator*)term->Parent();
+			if (parent->Op() != OP_AND)
+				continue;
+
+			printer.Indent(1);
+			printer.Print("match ");
+			(parent->Left() == term ? parent->Right() : parent->Left())
+				->PrintTo(printer);
+			printer.Print("\n");
+		}
+	}
+
+	return B_OK;
+}
+
+
 void
 Query::SetLiveMode(port_id port, int32 token)
 {
@@ -1444,3 +2346,158 @@ Query::LiveUpdateRenameMove(Inode* inode, ino_t oldDirectoryID,
 	notify_query_entry_created(fPort, fToken, fVolume->ID(),
 		newDirectoryID, newName, inode->ID());
 }
+
+
+void
+Query::_AddSteps(Term* root, bool useSets)
+{
+	Stack<Term*> stack;
+	stack.Push(root);
+
+	Term* term;
+	while (stack.Pop(&term)) {
+		if (term->Op() < OP_EQUATION) {
+			Operator* op = (Operator*)term;
+
+			if (useSets && op->PrefersSet()) {
+				// collect the candidates for the whole term at once
+				if (fStack.Push(term) != B_OK)
+					FATAL(("stack error"));
+			} else if (op->Op() == OP_OR) {
+				stack.Push(op->Left());
+				stack.Push(op->Right());
+			} else {
+				// For OP_AND, we only need to go through the cheaper path
+				if (op->Right()->StepCost() < op->Left()->StepCost())
+					stack.Push(op->Right());
+				else
+					stack.Push(op->Left());
+			}
+		} else if (term->Op() == OP_EQUATION || fStack.Push(term) != B_OK)
+			FATAL(("Unknown term on stack or stack error"));
+	}
+}
+
+
+/*!	Collects the IDs of the inodes that might match the term into a sorted
+	set, by intersecting or uniting the sets of its subterms.
+*/
+status_t
+Query::_CollectCandidates(Term* term, IDSet& set)
+{
+	if (term->Op() > OP_EQUATION) {
+		status_t status = ((Equation*)term)->CollectMatching(fVolume, fIndex,
+			set);
+		if (status == B_OK)
+			set.Sort();
+		return status;
+	}
+
+	Operator* op = (Operator*)term;
+	Term* first = op->Left();
+	Term* second = op->Right();
+
+	if (op->Op() == OP_AND) {
+		// start with the smaller set, we might not need the other one
+		if (!first->InSet() || (second->InSet()
+				&& second->Candidates() < first->Candidates())) {
+			std::swap(first, second);
+		}
+
+		status_t status = _CollectCandidates(first, set);
+		if (status != B_OK || !second->InSet() || set.Count() == 0)
+			return status;
+	} else {
+		status_t status = _CollectCandidates(first, set);
+		if (status != B_OK)
+			return status;
+	}
+
+	IDSet other;
+	status_t status = _CollectCandidates(second, other);
+	if (status != B_OK)
+		return status;
+
+	if (op->Op() == OP_AND) {
+		set.Intersect(other);
+		return B_OK;
+	}
+
+	return set.Unite(other);
+}
+
+
+status_t
+Query::_PrepareCandidates(Term* term)
+{
+	IDSet* set = new(std::nothrow) IDSet;
+	if (set == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = _CollectCandidates(term, *set);
+	if (status != B_OK) {
+		delete set;
+		return status;
+	}
+
+	fCandidates = set;
+	fCandidateIndex = 0;
+	fCandidateTerm = term;
+	return B_OK;
+}
+
+
+/*!	Returns the next candidate that matches the whole expression. Since the
+	candidates are sorted by their ID, the inodes are read in disk order.
+*/
+status_t
+Query::_GetNextCandidate(struct dirent* dirent)
+{
+	while (fCandidateIndex < fCandidates->Count()) {
+		Vnode vnode(fVolume, fCandidates->At(fCandidateIndex++));
+		Inode* inode;
+		if (vnode.Get(&inode) != B_OK) {
+			// the inode might have been removed in the mean time
+			continue;
+		}
+
+		status_t status = _MatchCandidate(fCandidateTerm, inode);
+		if (status == MATCH_OK)
+			status = match_parents(fCandidateTerm, inode);
+		if (status < 0)
+			REPORT_ERROR(status);
+
+		if (status == MATCH_OK) {
+			fill_dirent(fVolume, inode, dirent);
+			return B_OK;
+		}
+	}
+
+	return B_ENTRY_NOT_FOUND;
+}
+
+
+/*!	Checks if the candidate matches the term, only evaluating those parts
+	that are not known to match already.
+*/
+status_t
+Query::_MatchCandidate(Term* term, Inode* inode)
+{
+	if (term->IsExactSet())
+		return MATCH_OK;
+
+	if (term->Op() == OP_AND) {
+		Operator* op = (Operator*)term;
+		Term* terms[2] = {op->Left(), op->Right()};
+
+		for (int32 i = 0; i < 2; i++) {
+			status_t status = terms[i]->InSet()
+				? _MatchCandidate(terms[i], inode) : terms[i]->Match(inode);
+			if (status != MATCH_OK)
+				return status;
+		}
+		return MATCH_OK;
+	}
+
+	return term->Match(inode);
+}
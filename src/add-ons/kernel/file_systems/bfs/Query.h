@@ -15,6 +15,7 @@ class Term;
 class Equation;
 class TreeIterator;
 class Query;
+class IDSet;
 
 
 class Expression {
@@ -63,13 +64,29 @@ public:
 
 			Expression*		GetExpression() const { return fExpression; }
 
+			status_t		Explain(char* buffer, size_t size);
+
+private:
+			void			_AddSteps(Term* term, bool useSets);
+			status_t		_CollectCandidates(Term* term, IDSet& set);
+			status_t		_PrepareCandidates(Term* term);
+			status_t		_GetNextCandidate(struct dirent* dirent);
+			status_t		_MatchCandidate(Term* term, Inode* inode);
+
 private:
 			Volume*			fVolume;
 			Expression*		fExpression;
 			Equation*		fCurrent;
 			TreeIterator*	fIterator;
 			Index			fIndex;
-			Stack<Equation*> fStack;
+			Stack<Term*>	fStack;
+				// contains equations to scan, and operators to collect
+				// the candidates for
+			off_t			fEntries;
+
+			IDSet*			fCandidates;
+			uint32			fCandidateIndex;
+			Term*			fCandidateTerm;
 
 			uint32			fFlags;
 			port_id			fPort;
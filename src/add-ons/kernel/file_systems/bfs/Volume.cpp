@@ -8,6 +8,7 @@
 
 
 #include "Attribute.h"
+#include "BPlusTree.h"
 #include "Debug.h"
 #include "Inode.h"
 #include "Journal.h"
@@ -619,6 +620,61 @@ Volume::RemoveQuery(Query* query)
 }
 
 
+/*!	Recomputes the key statistics of all indices. The query planner uses
+	them to estimate how many entries match an equation.
+*/
+status_t
+Volume::UpdateIndexStatistics()
+{
+	if (IsReadOnly())
+		return B_READ_ONLY_DEVICE;
+	if (fIndicesNode == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	BPlusTree* indices = fIndicesNode->Tree();
+	if (indices == NULL)
+		return B_BAD_VALUE;
+
+	TreeIterator iterator(indices);
+	char name[B_FILE_NAME_LENGTH];
+	uint16 length;
+	off_t id;
+
+	status_t status;
+	while ((status = iterator.GetNextEntry(name, &length, sizeof(name), &id))
+			== B_OK) {
+		Vnode vnode(this, id);
+		Inode* index;
+		if (vnode.Get(&index) != B_OK || !index->IsIndex())
+			continue;
+
+		BPlusTree* tree = index->Tree();
+		if (tree == NULL)
+			continue;
+
+		bplustree_statistics statistics;
+		status = tree->CollectStatistics(statistics);
+		if (status != B_OK)
+			return status;
+
+		Transaction transaction(this, index->BlockNumber());
+		index->WriteLockInTransaction(transaction);
+
+		status = tree->SetStatistics(transaction, statistics);
+		if (status == B_NOT_SUPPORTED) {
+			// the nodes of this tree are too small
+			continue;
+		}
+		if (status == B_OK)
+			status = transaction.Done();
+		if (status != B_OK)
+			return status;
+	}
+
+	return status == B_ENTRY_NOT_FOUND ? B_OK : status;
+}
+
+
 //	#pragma mark - Disk scanning and initialization
 
 
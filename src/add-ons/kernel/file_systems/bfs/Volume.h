@@ -10,6 +10,7 @@
 
 #include "bfs.h"
 #include "BlockAllocator.h"
+#include "InodeCache.h"
 
 
 class Journal;
@@ -116,6 +117,7 @@ public:
 								{ return find_thread(NULL) == fCheckingThread; }
 
 			// cache access
+			InodeCache&		NodeCache() { return fNodeCache; }
 			status_t		WriteSuperBlock();
 			status_t		FlushDevice();
 
@@ -131,6 +133,7 @@ public:
 			bool			CheckForLiveQuery(const char* attribute);
 			void			AddQuery(Query* query);
 			void			RemoveQuery(Query* query);
+			status_t		UpdateIndexStatistics();
 
 			status_t		Sync();
 			Journal*		GetJournal(off_t refBlock) const;
@@ -155,6 +158,7 @@ protected:
 			uint32			fAllocationGroupShift;
 
 			BlockAllocator	fBlockAllocator;
+			InodeCache		fNodeCache;
 			mutex			fLock;
 			Journal*		fJournal;
 			vint32			fLogStart;
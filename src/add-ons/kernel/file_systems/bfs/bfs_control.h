@@ -29,6 +29,45 @@ struct update_boot_block {
 	uint32			length;
 };
 
+/* ioctl to retrieve the statistics of the journal - parameter is a
+ * struct journal_stats *
+ */
+#define BFS_IOCTL_GET_JOURNAL_STATS	14205
+
+#define BFS_JOURNAL_LATENCY_SLOTS	16
+
+struct journal_stats {
+	uint64		transactions;		/* completed transactions */
+	uint64		log_writes;			/* log entries written */
+	uint64		log_blocks;			/* blocks written to the log */
+	uint64		sync_requests;		/* fsync() calls that had to commit */
+	uint64		shared_syncs;		/* ...whose commit was done by another one */
+	uint64		checkpoints;		/* log write backs started in advance */
+	uint64		log_full_waits;		/* commits that had to wait for log space */
+	bigtime_t	total_commit_latency;
+	bigtime_t	max_commit_latency;
+	uint64		commit_latency[BFS_JOURNAL_LATENCY_SLOTS];
+		/* histogram of the commit latencies of sync requests: slot 0 counts
+		 * those below 32 usecs, and each following slot doubles the limit;
+		 * the last slot counts everything above.
+		 */
+};
+
+/* ioctl to see how a query would be evaluated - parameter is a
+ * struct bfs_query_plan * with the query filled in
+ */
+#define BFS_IOCTL_EXPLAIN_QUERY		14206
+
+struct bfs_query_plan {
+	char		query[1024];
+	char		plan[4096];
+};
+
+/* ioctl to recompute the key statistics of all indices that the query
+ * planner uses - no parameter
+ */
+#define BFS_IOCTL_UPDATE_INDEX_STATISTICS	14207
+
 /* ioctls to use the "chkbfs" feature from the outside
  * all calls use a struct check_result as single parameter
  */
@@ -84,6 +123,12 @@ struct check_control {
 	 */
 #define BFS_FIX_NAME_MISMATCHES	8
 #define BFS_FIX_BPLUSTREES		16
+#define BFS_REBUILD_INDICES		32
+	/* recreates all indices, not only those with a broken b+tree */
+#define BFS_FAIL_BULK_LOAD		64
+	/* for testing: makes bulk loading the recreated indices fail halfway
+	 * through, so that they have to be filled by inserting their entries
+	 */
 
 /* values for the errors field */
 #define BFS_MISSING_BLOCKS		1
@@ -178,6 +178,9 @@ bfs_mount(fs_volume* _volume, const char* device, uint32 flags,
 	_volume->ops = &gBFSVolumeOps;
 	*_rootID = volume->ToVnode(volume->Root());
 
+	// we announce every change of an entry, so the VFS can cache lookups
+	entry_cache_set_lookup_caching(_volume->id, true);
+
 	INFORM(("mounted \"%s\" (root node at %" B_PRIdINO ", device = %s)\n",
 		volume->Name(), *_rootID, device));
 	return B_OK;
@@ -341,6 +344,10 @@ bfs_put_vnode(fs_volume* _volume, fs_vnode* _node, bool reenter)
 		}
 	}
 
+	// keep the inode around in a compact form, to be able to recreate it
+	// cheaply
+	volume->NodeCache().Keep(inode);
+
 	delete inode;
 	return B_OK;
 }
@@ -359,6 +366,8 @@ bfs_remove_vnode(fs_volume* _volume, fs_vnode* _node, bool reenter)
 	// transaction which has already deleted the inode.
 	Transaction transaction(volume, volume->ToBlock(inode->Parent()));
 
+	volume->NodeCache().Remove(inode->ID());
+
 	// The file system check functionality uses this flag to prevent the space
 	// used up by the inode from being freed - this flag is set only in
 	// situations where this does not cause any harm as the block bitmap will
@@ -687,6 +696,10 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 			if (status == B_OK) {
 				file_cookie* cookie = (file_cookie*)_cookie;
 				cookie->open_mode &= ~BFS_OPEN_MODE_CHECKING;
+
+				// the check might have repaired inodes without going
+				// through their Inode objects
+				volume->NodeCache().Clear();
 			}
 			if (status == B_OK)
 				status = user_memcpy(buffer, &control, sizeof(check_control));
@@ -705,6 +718,46 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			return status;
 		}
+		case BFS_IOCTL_GET_JOURNAL_STATS:
+		{
+			if (bufferLength < sizeof(journal_stats))
+				return B_BAD_VALUE;
+
+			journal_stats stats;
+			volume->GetJournal(0)->GetStatistics(stats);
+			return user_memcpy(buffer, &stats, sizeof(journal_stats));
+		}
+		case BFS_IOCTL_EXPLAIN_QUERY:
+		{
+			if (bufferLength < sizeof(bfs_query_plan))
+				return B_BAD_VALUE;
+
+			bfs_query_plan* plan
+				= (bfs_query_plan*)malloc(sizeof(bfs_query_plan));
+			if (plan == NULL)
+				return B_NO_MEMORY;
+			MemoryDeleter planDeleter(plan);
+
+			if (user_memcpy(plan->query, ((bfs_query_plan*)buffer)->query,
+					sizeof(plan->query)) != B_OK) {
+				return B_BAD_ADDRESS;
+			}
+			plan->query[sizeof(plan->query) - 1] = '\0';
+
+			Expression expression(plan->query);
+			if (expression.InitCheck() != B_OK)
+				return B_BAD_VALUE;
+
+			Query query(volume, &expression, 0);
+			status_t status = query.Explain(plan->plan, sizeof(plan->plan));
+			if (status != B_OK)
+				return status;
+
+			return user_memcpy(((bfs_query_plan*)buffer)->plan, plan->plan,
+				sizeof(plan->plan));
+		}
+		case BFS_IOCTL_UPDATE_INDEX_STATISTICS:
+			return volume->UpdateIndexStatistics();
 		case BFS_IOCTL_UPDATE_BOOT_BLOCK:
 		{
 			// let's makebootable (or anyone else) update the boot block
@@ -786,8 +839,20 @@ bfs_fsync(fs_volume* _volume, fs_vnode* _node)
 {
 	FUNCTION();
 
+	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
-	return inode->Sync();
+
+	status_t status = inode->Sync();
+	if (status != B_OK)
+		return status;
+
+	// The changes to the inode itself must reach the log, too. The VFS also
+	// syncs every node it frees, though, and that must not cost a log write
+	// each time; only nodes that are still open are synced on request.
+	if (!inode->IsOpen())
+		return B_OK;
+
+	return volume->GetJournal(0)->FlushLog();
 }
 
 
@@ -983,6 +1048,7 @@ bfs_create(fs_volume* _volume, fs_vnode* _directory, const char* name,
 	if (status == B_OK) {
 		// register the cookie
 		*_cookie = cookie;
+		inode->Opened();
 
 		if (created) {
 			notify_entry_created(volume->ID(), directory->ID(), name,
@@ -1345,6 +1411,7 @@ bfs_open(fs_volume* _volume, fs_vnode* _node, int openMode, void** _cookie)
 	fileCacheEnabler.Detach();
 	cookieDeleter.Detach();
 	*_cookie = cookie;
+	inode->Opened();
 	return B_OK;
 }
 
@@ -1506,6 +1573,7 @@ bfs_free_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 	if ((cookie->open_mode & O_NOCACHE) != 0 && inode->FileCache() != NULL)
 		file_cache_enable(inode->FileCache());
 
+	inode->Closed();
 	delete cookie;
 	return B_OK;
 }
@@ -1660,7 +1728,11 @@ bfs_open_dir(fs_volume* _volume, fs_vnode* _node, void** _cookie)
 	if (iterator == NULL)
 		RETURN_ERROR(B_NO_MEMORY);
 
+	// directories are usually read from start to end
+	iterator->SetPrefetch(true);
+
 	*_cookie = iterator;
+	inode->Opened();
 	return B_OK;
 }
 
@@ -1734,8 +1806,11 @@ bfs_close_dir(fs_volume* /*_volume*/, fs_vnode* /*node*/, void* /*_cookie*/)
 
 
 static status_t
-bfs_free_dir_cookie(fs_volume* _volume, fs_vnode* node, void* _cookie)
+bfs_free_dir_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 {
+	Inode* inode = (Inode*)_node->private_node;
+	inode->Closed();
+
 	delete (TreeIterator*)_cookie;
 	return B_OK;
 }
@@ -2263,14 +2338,32 @@ bfs_read_query(fs_volume* /*_volume*/, void* cookie, struct dirent* dirent,
 {
 	FUNCTION();
 	Query* query = (Query*)cookie;
-	status_t status = query->GetNextEntry(dirent, bufferSize);
-	if (status == B_OK)
-		*_num = 1;
-	else if (status == B_ENTRY_NOT_FOUND)
-		*_num = 0;
-	else
-		return status;
 
+	uint32 maxCount = *_num;
+	uint32 count = 0;
+
+	// Fill the buffer with as many entries as fit, so that reading a query
+	// does not need a syscall per entry
+	while (count < maxCount) {
+		if (count > 0
+			&& bufferSize < sizeof(struct dirent) + B_FILE_NAME_LENGTH)
+			break;
+
+		status_t status = query->GetNextEntry(dirent, bufferSize);
+		if (status == B_ENTRY_NOT_FOUND)
+			break;
+		if (status != B_OK) {
+			if (count == 0)
+				return status;
+			break;
+		}
+
+		bufferSize -= dirent->d_reclen;
+		dirent = (struct dirent*)((uint8*)dirent + dirent->d_reclen);
+		count++;
+	}
+
+	*_num = count;
 	return B_OK;
 }
 
@@ -10,6 +10,7 @@
 
 #include <new>
 
+#include <fs_cache.h>
 #include <fs_info.h>
 #include <fs_interface.h>
 #include <KernelExport.h>
@@ -73,6 +74,9 @@ packagefs_mount(fs_volume* fsVolume, const char* device, uint32 flags,
 	if (error != B_OK)
 		return error;
 
+	// we announce every change of an entry, so the VFS can cache lookups
+	entry_cache_set_lookup_caching(fsVolume->id, true);
+
 	// set return values
 	*_rootID = volume->RootDirectory()->ID();
 
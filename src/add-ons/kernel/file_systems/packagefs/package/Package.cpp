@@ -45,6 +45,7 @@ using BPackageKit::BHPKG::BFDDataReader;
 using BPackageKit::BHPKG::BPackageInfoAttributeValue;
 using BPackageKit::BHPKG::BPackageVersionData;
 using BPackageKit::BHPKG::BPrivate::PackageFileHeapReader;
+using BPackageKit::BHPKG::BPrivate::PackageFileSection;
 
 // current format version types
 typedef BPackageKit::BHPKG::BPackageContentHandler BPackageContentHandler;
@@ -95,17 +96,27 @@ private:
 
 
 struct Package::LoaderContentHandler : BPackageContentHandler {
-	LoaderContentHandler(Package* package, const PackageSettings& settings)
+	LoaderContentHandler(Package* package, const PackageSettings& settings,
+		const PackageReaderImpl& reader)
 		:
 		fPackage(package),
 		fSettings(settings),
 		fSettingsItem(NULL),
 		fLastSettingsEntry(NULL),
 		fLastSettingsEntryEntry(NULL),
+		fReader(reader),
+		fTOCStrings(NULL),
+		fTOCStringCount(0),
+		fTOCStringsInterned(false),
 		fErrorOccurred(false)
 	{
 	}
 
+	~LoaderContentHandler()
+	{
+		delete[] fTOCStrings;
+	}
+
 	status_t Init()
 	{
 		return B_OK;
@@ -119,6 +130,9 @@ struct Package::LoaderContentHandler : BPackageContentHandler {
 			return B_OK;
 		}
 
+		if (!fTOCStringsInterned)
+			_InternTOCStrings();
+
 		PackageDirectory* parentDir = NULL;
 		if (entry->Parent() != NULL) {
 			parentDir = dynamic_cast<PackageDirectory*>(
@@ -152,7 +166,7 @@ struct Package::LoaderContentHandler : BPackageContentHandler {
 		} else if (S_ISLNK(mode)) {
 			// symlink
 			String path;
-			if (!path.SetTo(entry->SymlinkPath()))
+			if (!_SetTo(path, entry->SymlinkPath()))
 				RETURN_ERROR(B_NO_MEMORY);
 
 			PackageSymlink* symlink = new(std::nothrow) PackageSymlink(
@@ -173,7 +187,7 @@ struct Package::LoaderContentHandler : BPackageContentHandler {
 		BReference<PackageNode> nodeReference(node, true);
 
 		String entryName;
-		if (!entryName.SetTo(entry->Name()))
+		if (!_SetTo(entryName, entry->Name()))
 			RETURN_ERROR(B_NO_MEMORY);
 
 		status_t error = node->Init(parentDir, entryName);
@@ -205,7 +219,7 @@ struct Package::LoaderContentHandler : BPackageContentHandler {
 		PackageNode* node = (PackageNode*)entry->UserToken();
 
 		String name;
-		if (!name.SetTo(attribute->Name()))
+		if (!_SetTo(name, attribute->Name()))
 			RETURN_ERROR(B_NO_MEMORY);
 
 		PackageNodeAttribute* nodeAttribute = new(std::nothrow)
@@ -367,12 +381,69 @@ struct Package::LoaderContentHandler : BPackageContentHandler {
 		fErrorOccurred = true;
 	}
 
+private:
+	/*!	Interns all strings of the TOC's string table at once. Most entry and
+		attribute names refer to it, and we can find them by address later.
+		If that fails, the strings are simply interned one by one.
+	*/
+	void _InternTOCStrings()
+	{
+		fTOCStringsInterned = true;
+
+		const PackageFileSection& section = fReader.TOCSection();
+		if (section.stringsCount == 0 || section.strings == NULL)
+			return;
+
+		fTOCStrings = new(std::nothrow) String[section.stringsCount];
+		if (fTOCStrings == NULL)
+			return;
+
+		if (String::SetToMultiple(fTOCStrings, section.strings,
+				section.stringsCount) != B_OK) {
+			delete[] fTOCStrings;
+			fTOCStrings = NULL;
+			return;
+		}
+
+		fTOCStringCount = section.stringsCount;
+	}
+
+	bool _SetTo(String& string, const char* value)
+	{
+		if (fTOCStringCount > 0) {
+			// the string table is sorted by address
+			char* const* strings = fReader.TOCSection().strings;
+			if (value >= strings[0] && value <= strings[fTOCStringCount - 1]) {
+				uint32 lower = 0;
+				uint32 upper = fTOCStringCount - 1;
+				while (lower < upper) {
+					uint32 mid = (lower + upper) / 2;
+					if (strings[mid] < value)
+						lower = mid + 1;
+					else
+						upper = mid;
+				}
+
+				if (strings[lower] == value) {
+					string = fTOCStrings[lower];
+					return true;
+				}
+			}
+		}
+
+		return string.SetTo(value);
+	}
+
 private:
 	Package*					fPackage;
 	const PackageSettings&		fSettings;
 	const PackageSettingsItem*	fSettingsItem;
 	PackageSettingsItem::Entry*	fLastSettingsEntry;
 	const BPackageEntry*		fLastSettingsEntryEntry;
+	const PackageReaderImpl&	fReader;
+	String*						fTOCStrings;
+	uint32						fTOCStringCount;
+	bool						fTOCStringsInterned;
 	bool						fErrorOccurred;
 };
 
@@ -413,8 +484,11 @@ struct Package::LoaderContentHandlerV1 : BPackageContentHandlerV1 {
 		PackageNode* node;
 		if (S_ISREG(mode)) {
 			// file
-			node = new(std::nothrow) PackageFile(fPackage, mode,
-				PackageData(entry->Data()));
+			PackageData data(entry->Data());
+			if (data.InitCheck() != B_OK)
+				RETURN_ERROR(data.InitCheck());
+
+			node = new(std::nothrow) PackageFile(fPackage, mode, data);
 		} else if (S_ISLNK(mode)) {
 			// symlink
 			String path;
@@ -471,9 +545,12 @@ struct Package::LoaderContentHandlerV1 : BPackageContentHandlerV1 {
 		if (!name.SetTo(attribute->Name()))
 			RETURN_ERROR(B_NO_MEMORY);
 
+		PackageData data(attribute->Data());
+		if (data.InitCheck() != B_OK)
+			RETURN_ERROR(data.InitCheck());
+
 		PackageNodeAttribute* nodeAttribute = new(std::nothrow)
-			PackageNodeAttribute(attribute->Type(),
-			PackageData(attribute->Data()));
+			PackageNodeAttribute(attribute->Type(), data);
 		if (nodeAttribute == NULL)
 			RETURN_ERROR(B_NO_MEMORY)
 
@@ -822,7 +899,8 @@ Package::Package(::Volume* volume, PackagesDirectory* directory, dev_t deviceID,
 	fOpenCount(0),
 	fHeapReader(NULL),
 	fNodeID(nodeID),
-	fDeviceID(deviceID)
+	fDeviceID(deviceID),
+	fLoadTime(0)
 {
 	mutex_init(&fLock, "packagefs package");
 
@@ -864,6 +942,8 @@ Package::Init(const char* fileName)
 status_t
 Package::Load(const PackageSettings& settings)
 {
+	bigtime_t startTime = system_time();
+
 	status_t error = _Load(settings);
 	if (error != B_OK)
 		return error;
@@ -871,6 +951,7 @@ Package::Load(const PackageSettings& settings)
 	if (!_InitVersionedName())
 		RETURN_ERROR(B_NO_MEMORY);
 
+	fLoadTime = system_time() - startTime;
 	return B_OK;
 }
 
@@ -1024,7 +1105,7 @@ Package::_Load(const PackageSettings& settings)
 			BHPKG::B_HPKG_READER_DONT_PRINT_VERSION_MISMATCH_MESSAGE);
 		if (error == B_OK) {
 			// parse content
-			LoaderContentHandler handler(this, settings);
+			LoaderContentHandler handler(this, settings, packageReader);
 			error = handler.Init();
 			if (error != B_OK)
 				RETURN_ERROR(error);
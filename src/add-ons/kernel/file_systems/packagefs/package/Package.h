@@ -44,6 +44,8 @@ public:
 
 			status_t			Init(const char* fileName);
 			status_t			Load(const PackageSettings& settings);
+			bigtime_t			LoadTime() const	{ return fLoadTime; }
+									// how long Load() took
 
 			::Volume*			Volume() const		{ return fVolume; }
 			const String&		FileName() const	{ return fFileName; }
@@ -131,6 +133,7 @@ private:
 			Package*			fFileNameHashTableNext;
 			ino_t				fNodeID;
 			dev_t				fDeviceID;
+			bigtime_t			fLoadTime;
 			PackageNodeList		fNodes;
 			ResolvableList		fResolvables;
 			DependencyList		fDependencies;
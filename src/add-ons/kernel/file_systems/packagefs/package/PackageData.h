@@ -11,15 +11,29 @@
 
 #include <string.h>
 
+#include <new>
+
 
 typedef BPackageKit::BHPKG::BPackageData PackageDataV2;
 typedef BPackageKit::BHPKG::V1::BPackageData PackageDataV1;
 
 
+/*!	The data of a package file or attribute.
+	Since there's one for every file and attribute of every package, the
+	current version's data is stored in place, while the rarely used and
+	much larger version 1 data lives in a reference counted block shared by
+	all copies.
+*/
 class PackageData {
 public:
 	explicit					PackageData(const PackageDataV1& data);
 	explicit					PackageData(const PackageDataV2& data);
+								PackageData(const PackageData& other);
+								~PackageData();
+
+			status_t			InitCheck() const;
+
+			PackageData&		operator=(const PackageData& other);
 
 			uint8				Version() const	{ return fVersion; }
 			const PackageDataV1& DataV1() const;
@@ -27,19 +41,23 @@ public:
 
 			uint64				CompressedSize() const;
 			uint64				UncompressedSize() const;
-
 			bool				IsEncodedInline() const;
 			const uint8*		InlineData() const;
 
 private:
-	static	const size_t		kDataSize = sizeof(PackageDataV1)
-										> sizeof(PackageDataV2)
-									? sizeof(PackageDataV1)
-									: sizeof(PackageDataV2);
+			struct SharedDataV1 {
+				int32			referenceCount;
+				PackageDataV1	data;
+			};
+
+private:
+	inline	void				_AcquireDataV1() const;
+	inline	void				_ReleaseDataV1();
 
 private:
 			union {
-				char			fData[kDataSize];
+				char			fData[sizeof(PackageDataV2)];
+				SharedDataV1*	fDataV1;
 				uint64			fAlignmentDummy;
 			};
 			uint8				fVersion;
@@ -51,7 +69,11 @@ PackageData::PackageData(const PackageDataV1& data)
 	:
 	fVersion(1)
 {
-	memcpy(&fData, &data, sizeof(data));
+	fDataV1 = new(std::nothrow) SharedDataV1;
+	if (fDataV1 != NULL) {
+		fDataV1->referenceCount = 1;
+		memcpy(&fDataV1->data, &data, sizeof(data));
+	}
 }
 
 
@@ -64,10 +86,51 @@ PackageData::PackageData(const PackageDataV2& data)
 }
 
 
+inline
+PackageData::PackageData(const PackageData& other)
+	:
+	fVersion(other.fVersion)
+{
+	memcpy(&fData, &other.fData, sizeof(fData));
+	_AcquireDataV1();
+}
+
+
+inline
+PackageData::~PackageData()
+{
+	_ReleaseDataV1();
+}
+
+
+/*!	Returns whether the version 1 data could be allocated.
+*/
+inline status_t
+PackageData::InitCheck() const
+{
+	return fVersion == 1 && fDataV1 == NULL ? B_NO_MEMORY : B_OK;
+}
+
+
+inline PackageData&
+PackageData::operator=(const PackageData& other)
+{
+	if (this == &other)
+		return *this;
+
+	other._AcquireDataV1();
+	_ReleaseDataV1();
+
+	memcpy(&fData, &other.fData, sizeof(fData));
+	fVersion = other.fVersion;
+	return *this;
+}
+
+
 inline const PackageDataV1&
 PackageData::DataV1() const
 {
-	return *(PackageDataV1*)&fData;
+	return fDataV1->data;
 }
 
 
@@ -114,4 +177,22 @@ PackageData::InlineData() const
 }
 
 
+inline void
+PackageData::_AcquireDataV1() const
+{
+	if (fVersion == 1 && fDataV1 != NULL)
+		atomic_add(&fDataV1->referenceCount, 1);
+}
+
+
+inline void
+PackageData::_ReleaseDataV1()
+{
+	if (fVersion == 1 && fDataV1 != NULL
+		&& atomic_add(&fDataV1->referenceCount, -1) == 1) {
+		delete fDataV1;
+	}
+}
+
+
 #endif	// PACKAGE_DATA_H
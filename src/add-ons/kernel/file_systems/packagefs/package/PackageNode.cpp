@@ -72,7 +72,19 @@ PackageNode::FileSize() const
 void
 PackageNode::AddAttribute(PackageNodeAttribute* attribute)
 {
-	fAttributes.Add(attribute);
+	// Append the attribute, so that the attributes keep the order they have
+	// in the package. Nodes don't have many of them.
+	PackageNodeAttribute* last = fAttributes.Head();
+	if (last == NULL) {
+		fAttributes.Add(attribute);
+		return;
+	}
+
+	while (PackageNodeAttribute* next = fAttributes.GetNext(last))
+		last = next;
+
+	attribute->GetSinglyLinkedListLink()->next = NULL;
+	last->GetSinglyLinkedListLink()->next = attribute;
 }
 
 
@@ -86,7 +98,7 @@ PackageNode::RemoveAttribute(PackageNodeAttribute* attribute)
 PackageNodeAttribute*
 PackageNode::FindAttribute(const StringKey& name) const
 {
-	for (PackageNodeAttributeList::ConstIterator it = fAttributes.GetIterator();
+	for (PackageNodeAttributeList::Iterator it = fAttributes.GetIterator();
 			PackageNodeAttribute* attribute = it.Next();) {
 		if (name == attribute->Name())
 			return attribute;
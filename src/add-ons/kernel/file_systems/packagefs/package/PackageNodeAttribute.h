@@ -6,7 +6,7 @@
 #define PACKAGE_NODE_ATTRIBUTE_H
 
 
-#include <util/DoublyLinkedList.h>
+#include <util/SinglyLinkedList.h>
 
 #include "PackageData.h"
 
@@ -17,7 +17,7 @@ class PackageNode;
 
 
 class PackageNodeAttribute
-	: public DoublyLinkedListLinkImpl<PackageNodeAttribute> {
+	: public SinglyLinkedListLinkImpl<PackageNodeAttribute> {
 public:
 								PackageNodeAttribute(uint32 type,
 									const PackageData& data);
@@ -42,7 +42,7 @@ protected:
 };
 
 
-typedef DoublyLinkedList<PackageNodeAttribute> PackageNodeAttributeList;
+typedef SinglyLinkedList<PackageNodeAttribute> PackageNodeAttributeList;
 
 
 #endif	// PACKAGE_NODE_ATTRIBUTE_H
@@ -20,6 +20,34 @@ String::SetToExactLength(const char* string, size_t length)
 }
 
 
+/*!	Sets the \a count \a strings to the respective null-terminated \a values.
+	All of them are interned at once, which is a lot cheaper than setting
+	them one by one.
+*/
+/*static*/ status_t
+String::SetToMultiple(String* strings, const char* const* values,
+	uint32 count)
+{
+	StringData** data = (StringData**)malloc(sizeof(StringData*) * count);
+	if (data == NULL)
+		return B_NO_MEMORY;
+
+	status_t error = StringPool::GetMultiple(values, NULL, count, data);
+	if (error != B_OK) {
+		free(data);
+		return error;
+	}
+
+	for (uint32 i = 0; i < count; i++) {
+		strings[i].fData->ReleaseReference();
+		strings[i].fData = data[i];
+	}
+
+	free(data);
+	return B_OK;
+}
+
+
 String&
 String::operator=(const String& other)
 {
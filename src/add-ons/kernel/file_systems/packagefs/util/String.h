@@ -19,6 +19,8 @@ public:
 			bool				SetTo(const char* string, size_t maxLength);
 			bool				SetToExactLength(const char* string,
 									size_t length);
+	static	status_t			SetToMultiple(String* strings,
+									const char* const* values, uint32 count);
 
 			const char*			Data() const;
 			uint32				Hash() const;
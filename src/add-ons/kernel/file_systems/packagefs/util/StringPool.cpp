@@ -6,17 +6,30 @@
 
 #include "StringPool.h"
 
+#include <AutoDeleter.h>
+
 #include "DebugSupport.h"
 
 
 static const size_t kInitialStringTableSize = 128;
 
-static char sStringsBuffer[sizeof(StringDataHash)];
+// The pool is split into shards, each with its own lock and hash table, so
+// that packages can be loaded concurrently without serializing on a single
+// lock.
+static const uint32 kShardBits = 5;
+static const uint32 kShardCount = 1 << kShardBits;
+static const size_t kShardAlignment = 64;
+
+
+struct StringPool::Shard {
+	mutex			lock;
+	StringDataHash	strings;
+} __attribute__((aligned(kShardAlignment)));
+
 
 StringData StringData::fEmptyString(StringDataKey("", 0));
 
-mutex StringPool::sLock;
-StringDataHash* StringPool::sStrings;
+StringPool::Shard* StringPool::sShards;
 
 
 // #pragma mark - StringData
@@ -35,18 +48,27 @@ StringData::Init()
 /*static*/ status_t
 StringPool::Init()
 {
-	sStrings = new(sStringsBuffer) StringDataHash;
-	status_t error = sStrings->Init(kInitialStringTableSize);
-	if (error != B_OK) {
-		sStrings->~StringDataHash();
-		sStrings = NULL;
-		return error;
+	static char sShardsBuffer[sizeof(Shard) * kShardCount]
+		__attribute__((aligned(kShardAlignment)));
+	sShards = (Shard*)sShardsBuffer;
+
+	for (uint32 i = 0; i < kShardCount; i++) {
+		Shard* shard = new(&sShards[i]) Shard;
+		mutex_init(&shard->lock, "string pool");
+
+		status_t error = shard->strings.Init(kInitialStringTableSize);
+		if (error != B_OK) {
+			for (uint32 k = 0; k <= i; k++) {
+				mutex_destroy(&sShards[k].lock);
+				sShards[k].~Shard();
+			}
+			sShards = NULL;
+			return error;
+		}
 	}
 
-	mutex_init(&sLock, "string pool");
-
 	StringData::Init();
-	sStrings->Insert(StringData::Empty());
+	_ShardFor(StringData::Empty()->Hash()).strings.Insert(StringData::Empty());
 
 	return B_OK;
 }
@@ -55,25 +77,36 @@ StringPool::Init()
 /*static*/ void
 StringPool::Cleanup()
 {
-	sStrings->Remove(StringData::Empty());
+	_ShardFor(StringData::Empty()->Hash()).strings.Remove(StringData::Empty());
+
+	for (uint32 i = 0; i < kShardCount; i++) {
+		mutex_destroy(&sShards[i].lock);
+		sShards[i].~Shard();
+	}
+
+	sShards = NULL;
+}
 
-	sStrings->~StringDataHash();
-	sStrings = NULL;
 
-	mutex_destroy(&sLock);
+/*static*/ inline StringPool::Shard&
+StringPool::_ShardFor(uint32 hash)
+{
+	// The hash tables use the low bits of the hash, so spread all of them
+	// over the bits we use to pick the shard.
+	return sShards[(hash * 0x9e3779b1) >> (32 - kShardBits)];
 }
 
 
 /*static*/ inline StringData*
-StringPool::_GetLocked(const StringDataKey& key)
+StringPool::_GetLocked(Shard& shard, const StringDataKey& key)
 {
-	if (StringData* string = sStrings->Lookup(key)) {
+	if (StringData* string = shard.strings.Lookup(key)) {
 		if (!string->AcquireReference())
 			return string;
 
 		// The object was fully dereferenced and will be deleted. Remove it
 		// from the hash table, so it isn't in the way.
-		sStrings->Remove(string);
+		shard.strings.Remove(string);
 	}
 
 	return NULL;
@@ -83,9 +116,11 @@ StringPool::_GetLocked(const StringDataKey& key)
 /*static*/ StringData*
 StringPool::Get(const char* string, size_t length)
 {
-	MutexLocker locker(sLock);
 	StringDataKey key(string, length);
-	StringData* data = _GetLocked(key);
+	Shard& shard = _ShardFor(key.Hash());
+
+	MutexLocker locker(shard.lock);
+	StringData* data = _GetLocked(shard, key);
 	if (data != NULL)
 		return data;
 
@@ -97,50 +132,188 @@ StringPool::Get(const char* string, size_t length)
 
 	locker.Lock();
 
-	data = _GetLocked(key);
+	data = _GetLocked(shard, key);
 	if (data != NULL) {
 		locker.Unlock();
 		newString->Delete();
 		return data;
 	}
 
-	sStrings->Insert(newString);
+	shard.strings.Insert(newString);
 	return newString;
 }
 
 
+/*!	Gets the pooled strings for \a count strings at once, and stores them in
+	\a _data. If \a lengths is \c NULL, the strings must be null-terminated.
+	The strings are grouped by shard first, so that every shard is locked
+	only once for looking them up, and once more for adding the ones that
+	weren't in the pool yet.
+	On error no references are held.
+*/
+/*static*/ status_t
+StringPool::GetMultiple(const char* const* strings, const size_t* lengths,
+	uint32 count, StringData** _data)
+{
+	if (count == 0)
+		return B_OK;
+
+	StringDataKey* keys = (StringDataKey*)malloc(
+		count * (sizeof(StringDataKey) + 2 * sizeof(uint32)));
+	if (keys == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter keysDeleter(keys);
+	uint32* order = (uint32*)(keys + count);
+	uint32* missing = order + count;
+
+	// compute the keys, and sort the strings by shard
+	uint32 shardStart[kShardCount + 1];
+	memset(shardStart, 0, sizeof(shardStart));
+
+	for (uint32 i = 0; i < count; i++) {
+		new(&keys[i]) StringDataKey(strings[i],
+			lengths != NULL ? lengths[i] : strlen(strings[i]));
+		shardStart[&_ShardFor(keys[i].Hash()) - sShards + 1]++;
+	}
+
+	for (uint32 i = 1; i <= kShardCount; i++)
+		shardStart[i] += shardStart[i - 1];
+
+	uint32 shardFill[kShardCount];
+	memcpy(shardFill, shardStart, sizeof(shardFill));
+	for (uint32 i = 0; i < count; i++)
+		order[shardFill[&_ShardFor(keys[i].Hash()) - sShards]++] = i;
+
+	// look up the strings that are already in the pool
+	uint32 missingCount = 0;
+	for (uint32 i = 0; i < kShardCount; i++) {
+		if (shardStart[i] == shardStart[i + 1])
+			continue;
+
+		MutexLocker locker(sShards[i].lock);
+		for (uint32 k = shardStart[i]; k < shardStart[i + 1]; k++) {
+			uint32 index = order[k];
+			_data[index] = _GetLocked(sShards[i], keys[index]);
+			if (_data[index] == NULL)
+				missing[missingCount++] = index;
+		}
+	}
+
+	if (missingCount == 0)
+		return B_OK;
+
+	// create the missing ones without holding any lock
+	for (uint32 i = 0; i < missingCount; i++) {
+		StringData* data = StringData::Create(keys[missing[i]]);
+		if (data == NULL) {
+			for (uint32 k = 0; k < i; k++) {
+				_data[missing[k]]->Delete();
+				_data[missing[k]] = NULL;
+			}
+			for (uint32 k = 0; k < count; k++) {
+				if (_data[k] != NULL)
+					_data[k]->ReleaseReference();
+			}
+			return B_NO_MEMORY;
+		}
+
+		_data[missing[i]] = data;
+	}
+
+	// add them -- the missing ones are still sorted by shard
+	Shard* lockedShard = NULL;
+	for (uint32 i = 0; i < missingCount; i++) {
+		uint32 index = missing[i];
+		Shard& shard = _ShardFor(keys[index].Hash());
+		if (&shard != lockedShard) {
+			if (lockedShard != NULL)
+				mutex_unlock(&lockedShard->lock);
+			lockedShard = &shard;
+			mutex_lock(&lockedShard->lock);
+		}
+
+		// someone else might have added it in the meantime
+		StringData* data = _GetLocked(shard, keys[index]);
+		if (data != NULL) {
+			_data[index]->Delete();
+			_data[index] = data;
+		} else
+			shard.strings.Insert(_data[index]);
+	}
+
+	if (lockedShard != NULL)
+		mutex_unlock(&lockedShard->lock);
+
+	return B_OK;
+}
+
+
 /*static*/ void
 StringPool::LastReferenceReleased(StringData* data)
 {
-	MutexLocker locker(sLock);
-	sStrings->Remove(data);
+	Shard& shard = _ShardFor(data->Hash());
+
+	MutexLocker locker(shard.lock);
+	shard.strings.Remove(data);
 	locker.Unlock();
 	data->Delete();
 }
 
 
+/*!	Returns the number of strings in the pool, and the memory they use.
+*/
+/*static*/ void
+StringPool::GetUsage(size_t& _stringCount, size_t& _stringBytes)
+{
+	size_t stringCount = 0;
+	size_t stringBytes = 0;
+
+	for (uint32 i = 0; i < kShardCount; i++) {
+		MutexLocker locker(sShards[i].lock);
+		StringDataHash& strings = sShards[i].strings;
+		for (StringDataHash::Iterator it = strings.GetIterator();
+				it.HasNext();) {
+			stringBytes += StringData::SizeFor(strlen(it.Next()->String()));
+		}
+		stringCount += strings.CountElements();
+	}
+
+	_stringCount = stringCount;
+	_stringBytes = stringBytes;
+}
+
+
 /*static*/ void
 StringPool::DumpUsageStatistics()
 {
+	size_t stringCount = 0;
 	size_t unsharedStringCount = 0;
 	size_t totalReferenceCount = 0;
 	size_t totalStringSize = 0;
 	size_t totalStringSizeWithDuplicates = 0;
-
-	MutexLocker locker(sLock);
-	for (StringDataHash::Iterator it = sStrings->GetIterator(); it.HasNext();) {
-		StringData* data = it.Next();
-		int32 referenceCount = data->CountReferences();
-		totalReferenceCount += referenceCount;
-		if (referenceCount == 1)
-			unsharedStringCount++;
-
-		size_t stringSize = strlen(data->String() + 1);
-		totalStringSize += stringSize;
-		totalStringSizeWithDuplicates += stringSize * referenceCount;
+	size_t largestShard = 0;
+
+	for (uint32 i = 0; i < kShardCount; i++) {
+		MutexLocker locker(sShards[i].lock);
+		StringDataHash& strings = sShards[i].strings;
+		for (StringDataHash::Iterator it = strings.GetIterator();
+				it.HasNext();) {
+			StringData* data = it.Next();
+			int32 referenceCount = data->CountReferences();
+			totalReferenceCount += referenceCount;
+			if (referenceCount == 1)
+				unsharedStringCount++;
+
+			size_t stringSize = strlen(data->String() + 1);
+			totalStringSize += stringSize;
+			totalStringSizeWithDuplicates += stringSize * referenceCount;
+		}
+
+		stringCount += strings.CountElements();
+		if (strings.CountElements() > largestShard)
+			largestShard = strings.CountElements();
 	}
 
-	size_t stringCount = sStrings->CountElements();
 	size_t overhead = stringCount * (sizeof(StringData) - 1);
 
 	INFORM("StringPool usage:\n");
@@ -151,4 +324,6 @@ StringPool::DumpUsageStatistics()
 	INFORM("  unshared strings:        %8zu\n", unsharedStringCount);
 	INFORM("  bytes saved:             %8zd\n",
 		(ssize_t)(totalStringSizeWithDuplicates - totalStringSize - overhead));
+	INFORM("  shards:                  %8" B_PRIu32 ", largest: %zu strings\n",
+		kShardCount, largestShard);
 }
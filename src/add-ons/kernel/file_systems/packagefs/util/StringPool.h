@@ -63,16 +63,24 @@ public:
 	static	void				Cleanup();
 
 	static	StringData*			Get(const char* string, size_t length);
+	static	status_t			GetMultiple(const char* const* strings,
+									const size_t* lengths, uint32 count,
+									StringData** _data);
 	static	void				LastReferenceReleased(StringData* data);
 
+	static	void				GetUsage(size_t& _stringCount,
+									size_t& _stringBytes);
 	static	void				DumpUsageStatistics();
 
 private:
-	static	StringData*			_GetLocked(const StringDataKey& key);
+			struct Shard;
+
+	static	inline Shard&		_ShardFor(uint32 hash);
+	static	StringData*			_GetLocked(Shard& shard,
+									const StringDataKey& key);
 
 private:
-	static	mutex				sLock;
-	static	StringDataHash*		sStrings;
+	static	Shard*				sShards;
 };
 
 
@@ -82,13 +90,18 @@ public:
 
 	static StringData* Create(const StringDataKey& key)
 	{
-		void* data = malloc(sizeof(StringData) + key.Length());
+		void* data = malloc(SizeFor(key.Length()));
 		if (data == NULL)
 			return NULL;
 
 		return new(data) StringData(key);
 	}
 
+	static size_t SizeFor(size_t length)
+	{
+		return sizeof(StringData) + length;
+	}
+
 	static StringData* Empty()
 	{
 		return &fEmptyString;
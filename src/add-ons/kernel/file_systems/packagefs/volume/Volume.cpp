@@ -9,6 +9,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -23,6 +24,7 @@
 
 #include <AutoDeleter.h>
 #include <PackagesDirectoryDefs.h>
+#include <smp.h>
 
 #include <vfs.h>
 
@@ -32,9 +34,12 @@
 #include "LastModifiedIndex.h"
 #include "NameIndex.h"
 #include "OldUnpackingNodeAttributes.h"
+#include "PackageDirectory.h"
+#include "PackageFile.h"
 #include "PackageFSRoot.h"
 #include "PackageLinkDirectory.h"
 #include "PackageLinksDirectory.h"
+#include "PackageSymlink.h"
 #include "Resolvable.h"
 #include "SizeIndex.h"
 #include "UnpackingLeafNode.h"
@@ -69,6 +74,14 @@ static const char* const kActivationFilePath
 	= PACKAGES_DIRECTORY_ADMIN_DIRECTORY "/"
 		PACKAGES_DIRECTORY_ACTIVATION_FILE;
 
+// maximum number of threads loading the initial packages
+static const int32 kMaxPackageLoaderThreads = 8;
+
+// kernel driver settings file, and the setting that enables printing how
+// long loading and adding each of the initial packages took
+static const char* const kDriverSettingsName = "packagefs";
+static const char* const kTimingTraceSetting = "timing_trace";
+
 
 // #pragma mark - ShineThroughDirectory
 
@@ -159,6 +172,280 @@ private:
 };
 
 
+// #pragma mark - InitialPackageLoader
+
+
+/*!	Loads the initial packages of a volume on a few threads at once, since
+	reading and parsing the package files is what takes the most time when
+	mounting a volume. Adding the packages to the volume is left to the
+	caller, which does that in the original order.
+*/
+struct Volume::InitialPackageLoader {
+	InitialPackageLoader(Volume* volume, PackagesDirectory* packagesDirectory,
+		bool stopOnError)
+		:
+		fVolume(volume),
+		fPackagesDirectory(packagesDirectory),
+		fItems(NULL),
+		fCount(0),
+		fCapacity(0),
+		fNextItem(0),
+		fStopped(0),
+		fStopOnError(stopOnError)
+	{
+	}
+
+	~InitialPackageLoader()
+	{
+		for (uint32 i = 0; i < fCount; i++) {
+			free(fItems[i].name);
+			if (fItems[i].package != NULL)
+				fItems[i].package->ReleaseReference();
+		}
+
+		free(fItems);
+	}
+
+	status_t AddPackage(const char* name)
+	{
+		if (fCount == fCapacity) {
+			uint32 capacity = fCapacity > 0 ? fCapacity * 2 : 64;
+			Item* items = (Item*)realloc(fItems, capacity * sizeof(Item));
+			if (items == NULL)
+				RETURN_ERROR(B_NO_MEMORY);
+
+			fItems = items;
+			fCapacity = capacity;
+		}
+
+		Item& item = fItems[fCount];
+		item.name = strdup(name);
+		if (item.name == NULL)
+			RETURN_ERROR(B_NO_MEMORY);
+
+		item.package = NULL;
+		item.error = B_CANCELED;
+		fCount++;
+
+		return B_OK;
+	}
+
+	void Load()
+	{
+		int32 threadCount = min_c(min_c(smp_get_num_cpus(),
+			kMaxPackageLoaderThreads), (int32)fCount);
+
+		// we do our share of the work in this thread, too
+		thread_id threads[kMaxPackageLoaderThreads];
+		int32 spawnedCount = 0;
+		for (int32 i = 1; i < threadCount; i++) {
+			thread_id thread = spawn_kernel_thread(&_LoaderThread,
+				"packagefs package loader", B_NORMAL_PRIORITY, this);
+			if (thread < 0)
+				break;
+
+			resume_thread(thread);
+			threads[spawnedCount++] = thread;
+		}
+
+		_LoadPackages();
+
+		for (int32 i = 0; i < spawnedCount; i++) {
+			status_t result;
+			wait_for_thread(threads[i], &result);
+		}
+	}
+
+	uint32 CountPackages() const
+	{
+		return fCount;
+	}
+
+	Package* PackageAt(uint32 index) const
+	{
+		return fItems[index].package;
+	}
+
+	status_t ErrorAt(uint32 index) const
+	{
+		return fItems[index].error;
+	}
+
+	bool StopOnError() const
+	{
+		return fStopOnError;
+	}
+
+private:
+	struct Item {
+		char*		name;
+		Package*	package;
+		status_t	error;
+	};
+
+	static status_t _LoaderThread(void* data)
+	{
+		((InitialPackageLoader*)data)->_LoadPackages();
+		return B_OK;
+	}
+
+	void _LoadPackages()
+	{
+		while (atomic_get(&fStopped) == 0) {
+			int32 index = atomic_add(&fNextItem, 1);
+			if (index >= (int32)fCount)
+				break;
+
+			Item& item = fItems[index];
+			item.error = fVolume->_LoadPackage(fPackagesDirectory, item.name,
+				item.package);
+			if (item.error != B_OK) {
+				item.package = NULL;
+				ERROR("Failed to load package \"%s\": %s\n", item.name,
+					strerror(item.error));
+				if (fStopOnError)
+					atomic_set(&fStopped, 1);
+			}
+		}
+	}
+
+private:
+	Volume*				fVolume;
+	PackagesDirectory*	fPackagesDirectory;
+	Item*				fItems;
+	uint32				fCount;
+	uint32				fCapacity;
+	int32				fNextItem;
+	int32				fStopped;
+	bool				fStopOnError;
+};
+
+
+// #pragma mark - MemoryUsageCollector
+
+
+/*!	Collects the memory usage of packages. Since the strings are shared, the
+	packages are walked twice: once to count the string references, and
+	once more to collect them, so that the distinct ones can be found.
+*/
+struct Volume::MemoryUsageCollector {
+	MemoryUsageCollector()
+		:
+		fStrings(NULL),
+		fStringCount(0)
+	{
+		memset(&fUsage, 0, sizeof(fUsage));
+	}
+
+	~MemoryUsageCollector()
+	{
+		free(fStrings);
+	}
+
+	status_t PrepareSecondPass()
+	{
+		fStrings = (const char**)malloc(
+			sizeof(const char*) * (fStringCount + 1));
+		if (fStrings == NULL)
+			return B_NO_MEMORY;
+
+		memset(&fUsage, 0, sizeof(fUsage));
+		fStringCount = 0;
+		return B_OK;
+	}
+
+	void AddPackage(Package* package)
+	{
+		fUsage.packageCount++;
+
+		_AddString(package->FileName());
+		_AddString(package->Name());
+		_AddString(package->InstallPath());
+		_AddString(package->VersionedName());
+
+		for (PackageNodeList::Iterator it = package->Nodes().GetIterator();
+			PackageNode* node = it.Next();) {
+			_AddNode(node);
+		}
+	}
+
+	void Finish(PackageFSMemoryUsage& _usage)
+	{
+		fUsage.stringReferenceCount = fStringCount;
+
+		// sort the strings by address to find the distinct ones
+		qsort(fStrings, fStringCount, sizeof(const char*), &_CompareStrings);
+
+		for (uint32 i = 0; i < fStringCount; i++) {
+			if (i > 0 && fStrings[i] == fStrings[i - 1])
+				continue;
+
+			fUsage.stringCount++;
+			fUsage.stringBytes += StringData::SizeFor(strlen(fStrings[i]));
+		}
+
+		size_t poolStringCount;
+		size_t poolStringBytes;
+		StringPool::GetUsage(poolStringCount, poolStringBytes);
+		fUsage.poolStringCount = poolStringCount;
+		fUsage.poolStringBytes = poolStringBytes;
+
+		_usage = fUsage;
+	}
+
+private:
+	void _AddNode(PackageNode* node)
+	{
+		fUsage.nodeCount++;
+		_AddString(node->Name());
+
+		if (S_ISDIR(node->Mode())) {
+			fUsage.nodeBytes += sizeof(PackageDirectory);
+
+			PackageDirectory* directory = static_cast<PackageDirectory*>(node);
+			for (PackageNodeList::Iterator it
+					= directory->Children().GetIterator();
+				PackageNode* child = it.Next();) {
+				_AddNode(child);
+			}
+		} else if (S_ISLNK(node->Mode())) {
+			fUsage.nodeBytes += sizeof(PackageSymlink);
+			_AddString(static_cast<PackageSymlink*>(node)->SymlinkPath());
+		} else
+			fUsage.nodeBytes += sizeof(PackageFile);
+
+		for (PackageNodeAttributeList::Iterator it
+				= node->Attributes().GetIterator();
+			PackageNodeAttribute* attribute = it.Next();) {
+			fUsage.attributeCount++;
+			fUsage.nodeBytes += sizeof(PackageNodeAttribute);
+			_AddString(attribute->Name());
+		}
+	}
+
+	void _AddString(const String& string)
+	{
+		if (fStrings != NULL)
+			fStrings[fStringCount] = string.Data();
+		fStringCount++;
+	}
+
+	static int _CompareStrings(const void* a, const void* b)
+	{
+		const char* stringA = *(const char**)a;
+		const char* stringB = *(const char**)b;
+		if (stringA == stringB)
+			return 0;
+		return stringA < stringB ? -1 : 1;
+	}
+
+private:
+	PackageFSMemoryUsage	fUsage;
+	const char**			fStrings;
+	uint32					fStringCount;
+};
+
+
 // #pragma mark - Volume
 
 
@@ -441,6 +728,7 @@ Volume::Mount(const char* parameterString)
 		RETURN_ERROR(error);
 
 	StringPool::DumpUsageStatistics();
+	_DumpMemoryUsage();
 
 	return B_OK;
 }
@@ -558,6 +846,22 @@ Volume::IOCtl(Node* node, uint32 operation, void* buffer, size_t size)
 			return _ChangeActivation(request);
 		}
 
+		case PACKAGE_FS_OPERATION_GET_MEMORY_USAGE:
+		{
+			if (size < sizeof(PackageFSMemoryUsage))
+				RETURN_ERROR(B_BAD_VALUE);
+
+			PackageFSMemoryUsage usage;
+			{
+				VolumeReadLocker volumeReadLocker(this);
+				status_t error = _GetMemoryUsage(usage);
+				if (error != B_OK)
+					RETURN_ERROR(error);
+			}
+
+			RETURN_ERROR(user_memcpy(buffer, &usage, sizeof(usage)));
+		}
+
 		default:
 			return B_BAD_VALUE;
 	}
@@ -745,6 +1049,8 @@ Volume::_LoadOldPackagesStates(const char* packagesState)
 status_t
 Volume::_AddInitialPackages()
 {
+	bigtime_t startTime = system_time();
+
 	PackagesDirectory* packagesDirectory = fPackagesDirectories.Last();
 	INFORM("Adding packages from \"%s\"\n", packagesDirectory->Path());
 
@@ -787,11 +1093,27 @@ Volume::_AddInitialPackages()
 			RETURN_ERROR(error);
 	}
 
+	bigtime_t loadTime = system_time() - startTime;
+
+	bool traceTiming = false;
+	void* settingsHandle = load_driver_settings(kDriverSettingsName);
+	if (settingsHandle != NULL) {
+		traceTiming = get_driver_boolean_parameter(settingsHandle,
+			kTimingTraceSetting, false, true);
+		unload_driver_settings(settingsHandle);
+	}
+
 	// add the packages to the node tree
 	VolumeWriteLocker systemVolumeLocker(_SystemVolumeIfNotSelf());
 	VolumeWriteLocker volumeLocker(this);
+
+	startTime = system_time();
+	bigtime_t totalPackageLoadTime = 0;
+
 	for (PackageFileNameHashTable::Iterator it = fPackages.GetIterator();
 		Package* package = it.Next();) {
+		bigtime_t packageStartTime = system_time();
+
 		error = _AddPackageContent(package, false);
 		if (error != B_OK) {
 			for (it.Rewind(); Package* activePackage = it.Next();) {
@@ -801,8 +1123,24 @@ Volume::_AddInitialPackages()
 			}
 			RETURN_ERROR(error);
 		}
+
+		totalPackageLoadTime += package->LoadTime();
+
+		if (traceTiming) {
+			bigtime_t addTime = system_time() - packageStartTime;
+			INFORM("  %6" B_PRIdBIGTIME ".%03" B_PRIdBIGTIME " ms load, %6"
+				B_PRIdBIGTIME ".%03" B_PRIdBIGTIME " ms add: %s\n",
+				package->LoadTime() / 1000, package->LoadTime() % 1000,
+				addTime / 1000, addTime % 1000, package->FileName().Data());
+		}
 	}
 
+	bigtime_t addTime = system_time() - startTime;
+	INFORM("Added %" B_PRIu32 " packages: loading took %" B_PRIdBIGTIME
+		" ms (%" B_PRIdBIGTIME " ms for all packages together), adding %"
+		B_PRIdBIGTIME " ms\n", fPackages.CountElements(), loadTime / 1000,
+		totalPackageLoadTime / 1000, addTime / 1000);
+
 	return B_OK;
 }
 
@@ -856,6 +1194,7 @@ Volume::_AddInitialPackagesFromActivationFile(
 	fileContent[st.st_size] = '\0';
 
 	// parse the file and add the respective packages
+	InitialPackageLoader loader(this, packagesDirectory, true);
 	const char* packageName = fileContent;
 	char* const fileContentEnd = fileContent + st.st_size;
 	while (packageName < fileContentEnd) {
@@ -875,15 +1214,14 @@ Volume::_AddInitialPackagesFromActivationFile(
 			RETURN_ERROR(B_BAD_DATA);
 		}
 
-		status_t error = _LoadAndAddInitialPackage(packagesDirectory,
-			packageName);
+		status_t error = loader.AddPackage(packageName);
 		if (error != B_OK)
 			RETURN_ERROR(error);
 
 		packageName = packageNameEnd + 1;
 	}
 
-	return B_OK;
+	return _LoadAndAddInitialPackages(loader);
 }
 
 
@@ -905,6 +1243,7 @@ Volume::_AddInitialPackagesFromDirectory()
 	}
 	CObjectDeleter<DIR, int> dirCloser(dir, closedir);
 
+	InitialPackageLoader loader(this, fPackagesDirectory, false);
 	while (dirent* entry = readdir(dir)) {
 		// skip "." and ".."
 		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
@@ -917,28 +1256,38 @@ Volume::_AddInitialPackagesFromDirectory()
 			continue;
 		}
 
-		_LoadAndAddInitialPackage(fPackagesDirectory, entry->d_name);
+		status_t error = loader.AddPackage(entry->d_name);
+		if (error != B_OK)
+			RETURN_ERROR(error);
 	}
 
-	return B_OK;
+	return _LoadAndAddInitialPackages(loader);
 }
 
 
+/*!	Loads the packages of \a loader concurrently, and adds them to the
+	volume in their original order, but not yet to the node tree.
+	If the loader stops on errors, the first error is returned, and only
+	the packages before the failed one are added.
+*/
 status_t
-Volume::_LoadAndAddInitialPackage(PackagesDirectory* packagesDirectory,
-	const char* name)
+Volume::_LoadAndAddInitialPackages(InitialPackageLoader& loader)
 {
-	Package* package;
-	status_t error = _LoadPackage(packagesDirectory, name, package);
-	if (error != B_OK) {
-		ERROR("Failed to load package \"%s\": %s\n", name, strerror(error));
-		RETURN_ERROR(error);
-	}
-	BReference<Package> packageReference(package, true);
+	loader.Load();
 
 	VolumeWriteLocker systemVolumeLocker(_SystemVolumeIfNotSelf());
 	VolumeWriteLocker volumeLocker(this);
-	_AddPackage(package);
+
+	for (uint32 i = 0; i < loader.CountPackages(); i++) {
+		Package* package = loader.PackageAt(i);
+		if (package == NULL) {
+			if (loader.StopOnError())
+				RETURN_ERROR(loader.ErrorAt(i));
+			continue;
+		}
+
+		_AddPackage(package);
+	}
 
 	return B_OK;
 }
@@ -1656,6 +2005,52 @@ INFORM("package \"%s\" activated\n", package->FileName().Data());
 }
 
 
+status_t
+Volume::_GetMemoryUsage(PackageFSMemoryUsage& _usage)
+{
+	MemoryUsageCollector collector;
+
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			status_t error = collector.PrepareSecondPass();
+			if (error != B_OK)
+				RETURN_ERROR(error);
+		}
+
+		for (PackageFileNameHashTable::Iterator it = fPackages.GetIterator();
+			Package* package = it.Next();) {
+			collector.AddPackage(package);
+		}
+	}
+
+	collector.Finish(_usage);
+	return B_OK;
+}
+
+
+void
+Volume::_DumpMemoryUsage()
+{
+	PackageFSMemoryUsage usage;
+	{
+		VolumeReadLocker volumeReadLocker(this);
+		if (_GetMemoryUsage(usage) != B_OK)
+			return;
+	}
+
+	INFORM("Volume %" B_PRIdDEV " memory usage:\n", ID());
+	INFORM("  packages:                %8" B_PRIu32 "\n", usage.packageCount);
+	INFORM("  nodes:                   %8" B_PRIu32 ", attributes: %" B_PRIu32
+		", %" B_PRIu64 " bytes\n", usage.nodeCount, usage.attributeCount,
+		usage.nodeBytes);
+	INFORM("  strings:                 %8" B_PRIu32 ", references: %" B_PRIu32
+		", %" B_PRIu64 " bytes\n", usage.stringCount,
+		usage.stringReferenceCount, usage.stringBytes);
+	INFORM("  all volumes' strings:    %8" B_PRIu32 ", %" B_PRIu64 " bytes\n",
+		usage.poolStringCount, usage.poolStringBytes);
+}
+
+
 status_t
 Volume::_InitMountType(const char* mountType)
 {
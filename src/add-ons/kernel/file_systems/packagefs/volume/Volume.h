@@ -108,6 +108,8 @@ private:
 private:
 			struct ShineThroughDirectory;
 			struct ActivationChangeRequest;
+			struct InitialPackageLoader;
+			struct MemoryUsageCollector;
 
 private:
 			status_t			_LoadOldPackagesStates(
@@ -117,9 +119,8 @@ private:
 			status_t			_AddInitialPackagesFromActivationFile(
 									PackagesDirectory* packagesDirectory);
 			status_t			_AddInitialPackagesFromDirectory();
-			status_t			_LoadAndAddInitialPackage(
-									PackagesDirectory* packagesDirectory,
-									const char* name);
+			status_t			_LoadAndAddInitialPackages(
+									InitialPackageLoader& loader);
 
 	inline	void				_AddPackage(Package* package);
 	inline	void				_RemovePackage(Package* package);
@@ -159,6 +160,10 @@ private:
 			status_t			_ChangeActivation(
 									ActivationChangeRequest& request);
 
+			status_t			_GetMemoryUsage(PackageFSMemoryUsage& _usage);
+									// caller must hold the volume lock
+			void				_DumpMemoryUsage();
+
 			status_t			_InitMountType(const char* mountType);
 			status_t			_CreateShineThroughDirectory(Directory* parent,
 									const char* name, Directory*& _directory);
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 
+#include <fs_cache.h>
 #include <fs_index.h>
 #include <fs_info.h>
 #include <fs_interface.h>
@@ -106,6 +107,9 @@ ramfs_mount(fs_volume* _volume, const char* /*device*/, uint32 flags,
 	*_rootID = volume->GetRootDirectory()->GetID();
 	_volume->private_volume = volume;
 
+	// we announce every change of an entry, so the VFS can cache lookups
+	entry_cache_set_lookup_caching(_volume->id, true);
+
 	RETURN_ERROR(B_OK);
 }
 
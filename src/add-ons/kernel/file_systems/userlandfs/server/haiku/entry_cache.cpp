@@ -29,3 +29,10 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 {
 	return B_OK;
 }
+
+
+status_t
+entry_cache_set_lookup_caching(dev_t mountID, bool enabled)
+{
+	return B_OK;
+}
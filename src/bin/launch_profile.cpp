@@ -0,0 +1,287 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "launch_speedup.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+
+typedef std::pair<int64, int64> Range;
+	// offset, end
+typedef std::pair<int32, int64> NodeKey;
+	// device, node
+typedef std::map<NodeKey, std::vector<Range> > RangeMap;
+
+
+struct Profile {
+	launch_speedup_profile_header	header;
+	std::vector<launch_speedup_extent> extents;
+};
+
+
+static const char* sProgramName = "launch_profile";
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s dump <profile>\n"
+		"       %s compare <profile> <profile>\n"
+		"Profiles are stored in " LAUNCH_SPEEDUP_PROFILE_DIRECTORY ", and can "
+		"be given by their\nname only.\n", sProgramName, sProgramName);
+	exit(1);
+}
+
+
+static bool
+load_profile(const char* name, Profile& profile)
+{
+	char path[PATH_MAX];
+	if (strchr(name, '/') == NULL) {
+		snprintf(path, sizeof(path), "%s/%s", LAUNCH_SPEEDUP_PROFILE_DIRECTORY,
+			name);
+		if (access(path, R_OK) != 0)
+			strlcpy(path, name, sizeof(path));
+	} else
+		strlcpy(path, name, sizeof(path));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not open \"%s\": %s\n", sProgramName, path,
+			strerror(errno));
+		return false;
+	}
+
+	launch_speedup_profile_header& header = profile.header;
+	if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+		|| header.magic != LAUNCH_SPEEDUP_PROFILE_MAGIC) {
+		fprintf(stderr, "%s: \"%s\" is not a launch profile.\n", sProgramName,
+			path);
+		close(fd);
+		return false;
+	}
+	if (header.version != LAUNCH_SPEEDUP_PROFILE_VERSION) {
+		fprintf(stderr, "%s: \"%s\" has unsupported version %" B_PRIu32 ".\n",
+			sProgramName, path, header.version);
+		close(fd);
+		return false;
+	}
+
+	profile.extents.resize(header.extent_count);
+	size_t size = header.extent_count * sizeof(launch_speedup_extent);
+	if (size > 0 && read(fd, &profile.extents[0], size) != (ssize_t)size) {
+		fprintf(stderr, "%s: \"%s\" is truncated.\n", sProgramName, path);
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+	return true;
+}
+
+
+static int64
+total_size(const Profile& profile)
+{
+	int64 size = 0;
+	for (size_t i = 0; i < profile.extents.size(); i++)
+		size += profile.extents[i].size;
+	return size;
+}
+
+
+/*!	Collects the extents of the profile per node, sorted by offset, and with
+	overlapping extents joined.
+*/
+static void
+collect_ranges(const Profile& profile, RangeMap& map)
+{
+	for (size_t i = 0; i < profile.extents.size(); i++) {
+		const launch_speedup_extent& extent = profile.extents[i];
+		map[NodeKey(extent.device, extent.node)].push_back(
+			Range(extent.offset, extent.offset + extent.size));
+	}
+
+	for (RangeMap::iterator iterator = map.begin(); iterator != map.end();
+			iterator++) {
+		std::vector<Range>& ranges = iterator->second;
+		std::sort(ranges.begin(), ranges.end());
+
+		std::vector<Range> joined;
+		for (size_t i = 0; i < ranges.size(); i++) {
+			if (!joined.empty() && ranges[i].first <= joined.back().second) {
+				joined.back().second = std::max(joined.back().second,
+					ranges[i].second);
+			} else
+				joined.push_back(ranges[i]);
+		}
+		ranges.swap(joined);
+	}
+}
+
+
+static int64
+ranges_size(const std::vector<Range>& ranges)
+{
+	int64 size = 0;
+	for (size_t i = 0; i < ranges.size(); i++)
+		size += ranges[i].second - ranges[i].first;
+	return size;
+}
+
+
+static int64
+common_size(const std::vector<Range>& a, const std::vector<Range>& b)
+{
+	int64 size = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < a.size() && j < b.size()) {
+		int64 start = std::max(a[i].first, b[j].first);
+		int64 end = std::min(a[i].second, b[j].second);
+		if (start < end)
+			size += end - start;
+
+		if (a[i].second < b[j].second)
+			i++;
+		else
+			j++;
+	}
+
+	return size;
+}
+
+
+static void
+print_header(const char* name, const Profile& profile)
+{
+	printf("%s: %" B_PRIu32 " extents, %" B_PRIu32 " files, %" B_PRId64
+		" KB, recorded for %g s\n", name, profile.header.extent_count,
+		profile.header.node_count, total_size(profile) / 1024,
+		profile.header.duration / 1000000.0);
+}
+
+
+static int
+dump_profile(const char* name)
+{
+	Profile profile;
+	if (!load_profile(name, profile))
+		return 1;
+
+	print_header(name, profile);
+	printf("\n  time (ms)  device          node        offset          size\n");
+
+	for (size_t i = 0; i < profile.extents.size(); i++) {
+		const launch_speedup_extent& extent = profile.extents[i];
+		printf("%11" B_PRIu32 " %7" B_PRId32 " %13" B_PRId64 " %13" B_PRId64
+			" %13" B_PRId64 "\n", extent.first_access, extent.device,
+			extent.node, extent.offset, extent.size);
+	}
+
+	return 0;
+}
+
+
+static int
+compare_profiles(const char* nameA, const char* nameB)
+{
+	Profile profileA;
+	Profile profileB;
+	if (!load_profile(nameA, profileA) || !load_profile(nameB, profileB))
+		return 1;
+
+	print_header(nameA, profileA);
+	print_header(nameB, profileB);
+
+	RangeMap rangesA;
+	RangeMap rangesB;
+	collect_ranges(profileA, rangesA);
+	collect_ranges(profileB, rangesB);
+
+	int64 sizeA = 0;
+	int64 sizeB = 0;
+	int64 common = 0;
+	int32 onlyInA = 0;
+	int32 onlyInB = 0;
+
+	printf("\n  device          node    size (KB) A   size (KB) B   common (KB)\n");
+
+	for (RangeMap::iterator iterator = rangesA.begin();
+			iterator != rangesA.end(); iterator++) {
+		int64 nodeSizeA = ranges_size(iterator->second);
+		int64 nodeSizeB = 0;
+		int64 nodeCommon = 0;
+
+		RangeMap::iterator other = rangesB.find(iterator->first);
+		if (other != rangesB.end()) {
+			nodeSizeB = ranges_size(other->second);
+			nodeCommon = common_size(iterator->second, other->second);
+		} else
+			onlyInA++;
+
+		sizeA += nodeSizeA;
+		sizeB += nodeSizeB;
+		common += nodeCommon;
+
+		if (nodeCommon != nodeSizeA || nodeCommon != nodeSizeB) {
+			printf("%8" B_PRId32 " %13" B_PRId64 " %13" B_PRId64 " %13"
+				B_PRId64 " %13" B_PRId64 "\n", iterator->first.first,
+				iterator->first.second, nodeSizeA / 1024, nodeSizeB / 1024,
+				nodeCommon / 1024);
+		}
+	}
+
+	for (RangeMap::iterator iterator = rangesB.begin();
+			iterator != rangesB.end(); iterator++) {
+		if (rangesA.find(iterator->first) != rangesA.end())
+			continue;
+
+		int64 nodeSizeB = ranges_size(iterator->second);
+		sizeB += nodeSizeB;
+		onlyInB++;
+
+		printf("%8" B_PRId32 " %13" B_PRId64 " %13d %13" B_PRId64 " %13d\n",
+			iterator->first.first, iterator->first.second, 0,
+			nodeSizeB / 1024, 0);
+	}
+
+	printf("\n%" B_PRId32 " files only in %s, %" B_PRId32 " files only in "
+		"%s.\n", onlyInA, nameA, onlyInB, nameB);
+	printf("%" B_PRId64 " KB in common, %g%% of %s, %g%% of %s.\n",
+		common / 1024, sizeA > 0 ? 100.0 * common / sizeA : 0.0, nameA,
+		sizeB > 0 ? 100.0 * common / sizeB : 0.0, nameB);
+
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc > 0)
+		sProgramName = argv[0];
+
+	if (argc == 3 && !strcmp(argv[1], "dump"))
+		return dump_profile(argv[2]);
+	if (argc == 4 && !strcmp(argv[1], "compare"))
+		return compare_profiles(argv[2], argv[3]);
+
+	usage();
+	return 1;
+}
@@ -48,3 +48,20 @@ add_current_directory_entries(BPackageWriter& packageWriter,
 
 	return B_OK;
 }
+
+
+/*!	Translates the name of a heap compression type, as given on the command
+	line, into its \c B_HPKG_COMPRESSION_* value.
+*/
+bool
+parse_compression_type(const char* name, uint32& _compression)
+{
+	if (strcmp(name, "zlib") == 0)
+		_compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
+	else if (strcmp(name, "lz4") == 0)
+		_compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LZ4;
+	else
+		return false;
+
+	return true;
+}
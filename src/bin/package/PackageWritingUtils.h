@@ -18,5 +18,7 @@ using BPackageKit::BHPKG::BPackageWriterListener;
 status_t	add_current_directory_entries(BPackageWriter& packageWriter,
 				BPackageWriterListener& listener, bool skipPackageInfo);
 
+bool		parse_compression_type(const char* name, uint32& _compression);
+
 
 #endif	// PACKAGE_WRITING_UTILS_H
@@ -36,6 +36,7 @@ command_add(int argc, const char* const* argv)
 	bool verbose = false;
 	bool force = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -46,7 +47,7 @@ command_add(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+0123456789C:fhi:qv",
+		int c = getopt_long(argc, (char**)argv, "+0123456789C:fhi:qvz:",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -89,6 +90,14 @@ command_add(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				if (!parse_compression_type(optarg, compression)) {
+					fprintf(stderr, "Error: Unsupported compression type "
+						"\"%s\".\n", optarg);
+					return 1;
+				}
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -114,6 +123,7 @@ command_add(int argc, const char* const* argv)
 	writerParameters.SetFlags(
 		B_HPKG_WRITER_UPDATE_PACKAGE | (force ? B_HPKG_WRITER_FORCE_ADD : 0));
 	writerParameters.SetCompressionLevel(compressionLevel);
+	writerParameters.SetCompression(compression);
 	if (compressionLevel == 0) {
 		writerParameters.SetCompression(
 			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
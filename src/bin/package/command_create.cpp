@@ -39,6 +39,7 @@ command_create(int argc, const char* const* argv)
 	bool quiet = false;
 	bool verbose = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -49,7 +50,7 @@ command_create(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+b0123456789C:hi:I:qv",
+		int c = getopt_long(argc, (char**)argv, "+b0123456789C:hi:I:qvz:",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -96,6 +97,14 @@ command_create(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				if (!parse_compression_type(optarg, compression)) {
+					fprintf(stderr, "Error: Unsupported compression type "
+						"\"%s\".\n", optarg);
+					return 1;
+				}
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -118,6 +127,7 @@ command_create(int argc, const char* const* argv)
 	// create package
 	BPackageWriterParameters writerParameters;
 	writerParameters.SetCompressionLevel(compressionLevel);
+	writerParameters.SetCompression(compression);
 	if (compressionLevel == 0) {
 		writerParameters.SetCompression(
 			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
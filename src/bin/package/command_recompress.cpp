@@ -23,6 +23,7 @@
 
 #include "package.h"
 #include "PackageWriterListener.h"
+#include "PackageWritingUtils.h"
 
 
 using BPackageKit::BHPKG::BPackageReader;
@@ -45,6 +46,7 @@ command_recompress(int argc, const char* const* argv)
 	bool quiet = false;
 	bool verbose = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -55,7 +57,7 @@ command_recompress(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+0123456789:hqv",
+		int c = getopt_long(argc, (char**)argv, "+0123456789:hqvz:",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -86,6 +88,14 @@ command_recompress(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				if (!parse_compression_type(optarg, compression)) {
+					fprintf(stderr, "Error: Unsupported compression type "
+						"\"%s\".\n", optarg);
+					return 1;
+				}
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -119,6 +129,7 @@ command_recompress(int argc, const char* const* argv)
 	// write the output package
 	BPackageWriterParameters writerParameters;
 	writerParameters.SetCompressionLevel(compressionLevel);
+	writerParameters.SetCompression(compression);
 	if (compressionLevel == 0) {
 		writerParameters.SetCompression(
 			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
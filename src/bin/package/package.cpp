@@ -40,6 +40,10 @@ static const char* kUsage =
 	"                 existing.\n"
 	"    -q         - Be quiet (don't show any output except for errors).\n"
 	"    -v         - Be verbose (show more info about created package).\n"
+	"    -z <type>  - Use compression type <type>: \"zlib\" (default), or "
+		"\"lz4\",\n"
+	"                 which compresses less, but decompresses a lot faster.\n"
+	"                 LZ4 ignores the compression level, except for 0.\n"
 	"\n"
 	"  checksum [ <options> ] [ <package> ]\n"
 	"    Computes the checksum of package file <package>. If <package> is "
@@ -72,6 +76,10 @@ static const char* kUsage =
 	"                 to redirect a \"make install\". Only allowed with -b.\n"
 	"    -q         - Be quiet (don't show any output except for errors).\n"
 	"    -v         - Be verbose (show more info about created package).\n"
+	"    -z <type>  - Use compression type <type>: \"zlib\" (default), or "
+		"\"lz4\",\n"
+	"                 which compresses less, but decompresses a lot faster.\n"
+	"                 LZ4 ignores the compression level, except for 0.\n"
 	"\n"
 	"  dump [ <options> ] <package>\n"
 	"    Dumps the TOC section of package file <package>. For debugging only.\n"
@@ -120,6 +128,10 @@ static const char* kUsage =
 	"                 Defaults to 9.\n"
 	"    -q         - Be quiet (don't show any output except for errors).\n"
 	"    -v         - Be verbose (show more info about created package).\n"
+	"    -z <type>  - Use compression type <type>: \"zlib\" (default), or "
+		"\"lz4\",\n"
+	"                 which compresses less, but decompresses a lot faster.\n"
+	"                 LZ4 ignores the compression level, except for 0.\n"
 	"\n"
 	"Common Options:\n"
 	"  -h, --help   - Print this usage info.\n"
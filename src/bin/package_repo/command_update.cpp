@@ -29,9 +29,11 @@
 #include <package/RepositoryInfo.h>
 
 #include "package_repo.h"
+#include "PackageWritingUtils.h"
 
 
 using BPackageKit::BHPKG::BRepositoryWriterListener;
+using BPackageKit::BHPKG::BPackageWriterParameters;
 using BPackageKit::BHPKG::BRepositoryWriter;
 using namespace BPackageKit::BHPKG;
 using namespace BPackageKit;
@@ -212,6 +214,7 @@ command_update(int argc, const char* const* argv)
 	const char* changeToDirectory = NULL;
 	bool quiet = false;
 	bool verbose = false;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -222,7 +225,7 @@ command_update(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+C:hqv", sLongOptions, NULL);
+		int c = getopt_long(argc, (char**)argv, "+C:hqvz:", sLongOptions, NULL);
 		if (c == -1)
 			break;
 
@@ -243,6 +246,14 @@ command_update(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				if (!parse_compression_type(optarg, compression)) {
+					fprintf(stderr, "Error: Unsupported compression type "
+						"\"%s\".\n", optarg);
+					return 1;
+				}
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -303,11 +314,14 @@ command_update(int argc, const char* const* argv)
 	}
 
 	// create new repository
+	BPackageWriterParameters writerParameters;
+	writerParameters.SetCompression(compression);
+
 	BRepositoryWriter repositoryWriter(&listener, &repositoryInfo);
 	BString tempRepositoryFileName(targetRepositoryFileName);
 	tempRepositoryFileName += ".___new___";
-	if ((result = repositoryWriter.Init(tempRepositoryFileName.String()))
-			!= B_OK) {
+	if ((result = repositoryWriter.Init(tempRepositoryFileName.String(),
+			writerParameters)) != B_OK) {
 		listener.PrintError("Error: can't initialize repository-writer : %s\n",
 			strerror(result));
 		return 1;
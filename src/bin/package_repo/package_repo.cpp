@@ -28,6 +28,8 @@ static const char* kUsage =
 	"    -C <dir>   - Change to directory <dir> before starting.\n"
 	"    -q         - be quiet (don't show any output except for errors).\n"
 	"    -v         - be verbose (list package attributes as encountered).\n"
+	"    -z <type>  - Use compression type <type>: \"zlib\" (default), or "
+		"\"lz4\".\n"
 	"\n"
 	"  list [ <options> ] <package-repo>\n"
 	"    Lists the contents of package repository file <package-repo>.\n"
@@ -44,6 +46,8 @@ static const char* kUsage =
 	"    -C <dir>   - Change to directory <dir> before starting.\n"
 	"    -q         - be quiet (don't show any output except for errors).\n"
 	"    -v         - be verbose (list package attributes as encountered).\n"
+	"    -z <type>  - Use compression type <type>: \"zlib\" (default), or "
+		"\"lz4\".\n"
 	"\n"
 	"Common Options:\n"
 	"  -h, --help   - Print this usage info.\n"
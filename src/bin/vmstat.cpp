@@ -11,6 +11,9 @@
 
 #include <system_info.h>
 
+#include <syscalls.h>
+#include <vm_defs.h>
+
 
 static struct option const kLongOptions[] = {
 	{"periodic", no_argument, 0, 'p'},
@@ -82,14 +85,52 @@ main(int argc, char** argv)
 	printf("free swap space:\t%Lu\n", info.free_swap_pages * B_PAGE_SIZE);
 	printf("page faults:\t\t%lu\n", info.page_faults);
 
+	vm_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	if (_kern_get_vm_stats(&stats, sizeof(stats)) == B_OK) {
+		printf("large pages mapped:\t%" B_PRIu64 "\n",
+			stats.large_pages_mapped);
+		printf("large page faults:\t%" B_PRIu64 "\n", stats.large_page_faults);
+		printf("large page failures:\t%" B_PRIu64 "\n",
+			stats.large_page_allocation_failures);
+		printf("large page demotions:\t%" B_PRIu64 "\n",
+			stats.large_page_demotions);
+		printf("fault-around pages:\t%" B_PRIu64 "\n",
+			stats.fault_around_pages);
+		printf("swap pages read:\t%" B_PRIu64 "\n", stats.swap_pages_read);
+		printf("swap pages written:\t%" B_PRIu64 "\n",
+			stats.swap_pages_written);
+		printf("swap read-ahead pages:\t%" B_PRIu64 "\n",
+			stats.swap_read_ahead_pages);
+		printf("compressed swap pages:\t%" B_PRIu64 "\n",
+			stats.compressed_swap_pages);
+		printf("compressed swap size:\t%" B_PRIu64 "\n",
+			stats.compressed_swap_size);
+		printf("page daemon threads:\t%" B_PRIu64 "\n",
+			stats.page_daemon_threads);
+		printf("pages scanned:\t\t%" B_PRIu64 "\n", stats.pages_scanned);
+		printf("page scan rate:\t\t%" B_PRIu64 " pages/s\n",
+			stats.page_scan_time > 0
+				? stats.pages_scanned * 1000000 / stats.page_scan_time : 0);
+		printf("pages reclaimed:\t%" B_PRIu64 "\n", stats.pages_reclaimed);
+		printf("reclaim waits:\t\t%" B_PRIu64 "\n", stats.reclaim_waits);
+		printf("reclaim latency:\t%" B_PRIu64 " us\n",
+			stats.reclaim_waits > 0
+				? stats.reclaim_wait_time / stats.reclaim_waits : 0);
+	}
+
 	if (periodically) {
-		puts("\npage faults  used memory    used swap  block cache");
+		puts("\npage faults  used memory    used swap  block cache"
+			"  pages scanned  reclaim latency");
 		system_info lastInfo = info;
+		vm_stats lastStats = stats;
 
 		while (true) {
 			snooze(rate);
 
 			get_system_info(&info);
+			if (_kern_get_vm_stats(&stats, sizeof(stats)) != B_OK)
+				stats = lastStats;
 
 			int32 pageFaults = info.page_faults - lastInfo.page_faults;
 			int64 usedMemory
@@ -102,10 +143,18 @@ main(int argc, char** argv)
 			int64 blockCache
 				= (info.block_cache_pages - lastInfo.block_cache_pages)
 					* B_PAGE_SIZE;
+			uint64 pagesScanned = stats.pages_scanned - lastStats.pages_scanned;
+			uint64 reclaimWaits = stats.reclaim_waits - lastStats.reclaim_waits;
+			uint64 reclaimLatency = reclaimWaits > 0
+				? (stats.reclaim_wait_time - lastStats.reclaim_wait_time)
+					/ reclaimWaits
+				: 0;
 			printf("%11" B_PRId32 "  %11" B_PRId64 "  %11" B_PRId64 "  %11"
-				B_PRId64 "\n", pageFaults, usedMemory, usedSwap, blockCache);
+				B_PRId64 "  %13" B_PRIu64 "  %12" B_PRIu64 " us\n", pageFaults,
+				usedMemory, usedSwap, blockCache, pagesScanned, reclaimLatency);
 
 			lastInfo = info;
+			lastStats = stats;
 		}
 	}
 
@@ -151,22 +151,61 @@ PackageFileHeapReader::Clone() const
 }
 
 
+/*!	Returns whether the heap data range \a offset, \a size is stored
+	uncompressed in the file, i.e. whether all chunks it touches are stored
+	as is. If so, the range is contiguous in the file and \a _fileOffset is
+	set to the file offset it starts at.
+*/
+bool
+PackageFileHeapReader::GetStoredUncompressedRange(uint64 offset, size_t size,
+	off_t& _fileOffset) const
+{
+	if (size == 0 || offset > fUncompressedHeapSize
+		|| size > fUncompressedHeapSize - offset) {
+		return false;
+	}
+
+	size_t firstChunk = offset / kChunkSize;
+	size_t lastChunk = (offset + size - 1) / kChunkSize;
+	for (size_t i = firstChunk; i <= lastChunk; i++) {
+		size_t compressedSize;
+		size_t uncompressedSize;
+		_GetChunkSizes(i, compressedSize, uncompressedSize);
+		if (compressedSize != uncompressedSize)
+			return false;
+	}
+
+	_fileOffset = fHeapOffset + fOffsets[firstChunk] + offset % kChunkSize;
+	return true;
+}
+
+
 status_t
 PackageFileHeapReader::ReadAndDecompressChunk(size_t chunkIndex,
 	void* compressedDataBuffer, void* uncompressedDataBuffer)
+{
+	size_t compressedSize;
+	size_t uncompressedSize;
+	_GetChunkSizes(chunkIndex, compressedSize, uncompressedSize);
+
+	return ReadAndDecompressChunkData(fOffsets[chunkIndex], compressedSize,
+		uncompressedSize, compressedDataBuffer, uncompressedDataBuffer);
+}
+
+
+void
+PackageFileHeapReader::_GetChunkSizes(size_t chunkIndex,
+	size_t& _compressedSize, size_t& _uncompressedSize) const
 {
 	uint64 offset = fOffsets[chunkIndex];
 	bool isLastChunk
 		= uint64(chunkIndex + 1) * kChunkSize >= fUncompressedHeapSize;
-	size_t compressedSize = isLastChunk
+	_compressedSize = isLastChunk
 		? fCompressedHeapSize - offset
 		: fOffsets[chunkIndex + 1] - offset;
-	size_t uncompressedSize = isLastChunk
+	_uncompressedSize = isLastChunk
 		? fUncompressedHeapSize - (uint64)chunkIndex * kChunkSize
 		: kChunkSize;
-
-	return ReadAndDecompressChunkData(offset, compressedSize, uncompressedSize,
-		compressedDataBuffer, uncompressedDataBuffer);
 }
 
 
@@ -6,6 +6,9 @@
 
 #include <package/hpkg/PackageFileHeapWriter.h>
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <new>
 
@@ -24,6 +27,11 @@
 // minimum length of data we require before trying to compress them
 static const size_t kCompressionSizeThreshold = 64;
 
+// limits for compressing chunks in parallel
+static const int32 kMaxCompressionThreads = 32;
+static const int32 kCompressionJobsPerThread = 4;
+static const size_t kCompressionMemoryBudget = 16 * 1024 * 1024;
+
 
 namespace BPackageKit {
 
@@ -194,6 +202,196 @@ private:
 };
 
 
+struct PackageFileHeapWriter::CompressionJob {
+	void*		data;
+	void*		compressedData;
+	size_t		size;
+	size_t		compressedSize;
+	status_t	status;
+	bool		done;
+};
+
+
+/*!	Compresses chunks on a number of worker threads. The writer queues the
+	chunks in heap order, and writes them in the same order once they are
+	done, so the result is exactly the same as when compressing serially.
+	The number of queued chunks is limited, and the job buffers are reused,
+	so that the memory use stays bounded.
+	Only the writer's thread queues and dequeues jobs, therefore the queue and
+	write positions need no locking; the lock protects the compression
+	position and the jobs' done flags.
+*/
+struct PackageFileHeapWriter::CompressionQueue {
+	CompressionQueue(PackageFileHeapWriter* writer)
+		:
+		fWriter(writer),
+		fThreads(NULL),
+		fThreadCount(0),
+		fJobs(NULL),
+		fJobCount(0),
+		fQueuedCount(0),
+		fStartedCount(0),
+		fWrittenCount(0),
+		fQuit(false)
+	{
+		pthread_mutex_init(&fLock, NULL);
+		pthread_cond_init(&fJobQueuedCondition, NULL);
+		pthread_cond_init(&fJobDoneCondition, NULL);
+	}
+
+	~CompressionQueue()
+	{
+		pthread_mutex_lock(&fLock);
+		fQuit = true;
+		pthread_cond_broadcast(&fJobQueuedCondition);
+		pthread_mutex_unlock(&fLock);
+
+		for (int32 i = 0; i < fThreadCount; i++)
+			pthread_join(fThreads[i], NULL);
+		delete[] fThreads;
+
+		if (fJobs != NULL) {
+			for (int32 i = 0; i < fJobCount; i++) {
+				free(fJobs[i].data);
+				free(fJobs[i].compressedData);
+			}
+			delete[] fJobs;
+		}
+
+		pthread_cond_destroy(&fJobDoneCondition);
+		pthread_cond_destroy(&fJobQueuedCondition);
+		pthread_mutex_destroy(&fLock);
+	}
+
+	status_t Init(int32 threadCount, int32 jobCount)
+	{
+		fJobs = new(std::nothrow) CompressionJob[jobCount];
+		if (fJobs == NULL)
+			return B_NO_MEMORY;
+
+		for (int32 i = 0; i < jobCount; i++) {
+			CompressionJob& job = fJobs[i];
+			job.data = malloc(kChunkSize);
+			job.compressedData = malloc(kChunkSize);
+			job.done = false;
+			fJobCount++;
+			if (job.data == NULL || job.compressedData == NULL)
+				return B_NO_MEMORY;
+		}
+
+		fThreads = new(std::nothrow) pthread_t[threadCount];
+		if (fThreads == NULL)
+			return B_NO_MEMORY;
+
+		for (; fThreadCount < threadCount; fThreadCount++) {
+			if (pthread_create(&fThreads[fThreadCount], NULL, &_WorkerThread,
+					this) != 0) {
+				break;
+			}
+		}
+
+		return fThreadCount > 0 ? B_OK : B_ERROR;
+	}
+
+	bool IsEmpty() const
+	{
+		return fWrittenCount == fQueuedCount;
+	}
+
+	bool IsFull() const
+	{
+		return fQueuedCount - fWrittenCount == (uint64)fJobCount;
+	}
+
+	CompressionJob& FreeJob()
+	{
+		return fJobs[fQueuedCount % fJobCount];
+	}
+
+	void QueueFreeJob()
+	{
+		pthread_mutex_lock(&fLock);
+		FreeJob().done = false;
+		fQueuedCount++;
+		pthread_cond_signal(&fJobQueuedCondition);
+		pthread_mutex_unlock(&fLock);
+	}
+
+	bool IsOldestJobDone()
+	{
+		pthread_mutex_lock(&fLock);
+		bool done = !IsEmpty() && _OldestJob().done;
+		pthread_mutex_unlock(&fLock);
+		return done;
+	}
+
+	CompressionJob& WaitForOldestJob()
+	{
+		pthread_mutex_lock(&fLock);
+		CompressionJob& job = _OldestJob();
+		while (!job.done)
+			pthread_cond_wait(&fJobDoneCondition, &fLock);
+		pthread_mutex_unlock(&fLock);
+		return job;
+	}
+
+	void OldestJobWritten()
+	{
+		fWrittenCount++;
+	}
+
+private:
+	CompressionJob& _OldestJob()
+	{
+		return fJobs[fWrittenCount % fJobCount];
+	}
+
+	static void* _WorkerThread(void* data)
+	{
+		((CompressionQueue*)data)->_Work();
+		return NULL;
+	}
+
+	void _Work()
+	{
+		pthread_mutex_lock(&fLock);
+
+		while (true) {
+			while (!fQuit && fStartedCount == fQueuedCount)
+				pthread_cond_wait(&fJobQueuedCondition, &fLock);
+			if (fQuit)
+				break;
+
+			CompressionJob& job = fJobs[fStartedCount++ % fJobCount];
+			pthread_mutex_unlock(&fLock);
+
+			job.status = fWriter->_CompressChunk(job.data, job.size,
+				job.compressedData, job.compressedSize);
+
+			pthread_mutex_lock(&fLock);
+			job.done = true;
+			pthread_cond_broadcast(&fJobDoneCondition);
+		}
+
+		pthread_mutex_unlock(&fLock);
+	}
+
+private:
+	PackageFileHeapWriter*	fWriter;
+	pthread_mutex_t			fLock;
+	pthread_cond_t			fJobQueuedCondition;
+	pthread_cond_t			fJobDoneCondition;
+	pthread_t*				fThreads;
+	int32					fThreadCount;
+	CompressionJob*			fJobs;
+	int32					fJobCount;
+	uint64					fQueuedCount;
+	uint64					fStartedCount;
+	uint64					fWrittenCount;
+	bool					fQuit;
+};
+
+
 PackageFileHeapWriter::PackageFileHeapWriter(BErrorOutput* errorOutput,
 	BPositionIO* file, off_t heapOffset,
 	CompressionAlgorithmOwner* compressionAlgorithm,
@@ -205,7 +403,9 @@ PackageFileHeapWriter::PackageFileHeapWriter(BErrorOutput* errorOutput,
 	fCompressedDataBuffer(NULL),
 	fPendingDataSize(0),
 	fOffsets(),
-	fCompressionAlgorithm(compressionAlgorithm)
+	fCompressionAlgorithm(compressionAlgorithm),
+	fCompressionQueue(NULL),
+	fParallelCompression(compressionAlgorithm != NULL)
 {
 	if (fCompressionAlgorithm != NULL)
 		fCompressionAlgorithm->AcquireReference();
@@ -319,6 +519,15 @@ PackageFileHeapWriter::RemoveDataRanges(
 	// handling and also can use the pending data buffer.
 	_FlushPendingData();
 
+	// We rely on the heap sizes being exact all the time, so we also write
+	// all queued chunks, and don't queue any new ones until we're done.
+	status_t error = _WriteQueuedChunks();
+	if (error != B_OK)
+		throw error;
+
+	bool parallelCompression = fParallelCompression;
+	fParallelCompression = false;
+
 	// We potentially have to recompress all data from the first affected chunk
 	// to the end (minus the removed ranges, of course). As a basic algorithm we
 	// can use our usual data writing strategy, i.e. read a chunk, decompress it
@@ -430,6 +639,8 @@ PackageFileHeapWriter::RemoveDataRanges(
 	// buffer.
 	if (chunkBuffer.IsEmpty())
 		_UnwriteLastPartialChunk();
+
+	fParallelCompression = parallelCompression;
 }
 
 
@@ -438,6 +649,8 @@ PackageFileHeapWriter::Finish()
 {
 	// flush pending data, if any
 	status_t error = _FlushPendingData();
+	if (error == B_OK)
+		error = _WriteQueuedChunks();
 	if (error != B_OK)
 		return error;
 
@@ -479,6 +692,11 @@ status_t
 PackageFileHeapWriter::ReadAndDecompressChunk(size_t chunkIndex,
 	void* compressedDataBuffer, void* uncompressedDataBuffer)
 {
+	// make sure the chunk has been written, if it isn't pending anymore
+	status_t error = _WriteQueuedChunks();
+	if (error != B_OK)
+		return error;
+
 	if (uint64(chunkIndex + 1) * kChunkSize > fUncompressedHeapSize) {
 		// The chunk has not been written to disk yet. Its data are still in the
 		// pending data buffer.
@@ -501,6 +719,9 @@ PackageFileHeapWriter::ReadAndDecompressChunk(size_t chunkIndex,
 void
 PackageFileHeapWriter::_Uninit()
 {
+	delete fCompressionQueue;
+	fCompressionQueue = NULL;
+
 	free(fPendingDataBuffer);
 	free(fCompressedDataBuffer);
 	fPendingDataBuffer = NULL;
@@ -514,7 +735,9 @@ PackageFileHeapWriter::_FlushPendingData()
 	if (fPendingDataSize == 0)
 		return B_OK;
 
-	status_t error = _WriteChunk(fPendingDataBuffer, fPendingDataSize, true);
+	status_t error = fParallelCompression && _StartCompressionQueue()
+		? _QueuePendingData()
+		: _WriteChunk(fPendingDataBuffer, fPendingDataSize, true);
 	if (error == B_OK)
 		fPendingDataSize = 0;
 
@@ -532,51 +755,50 @@ PackageFileHeapWriter::_WriteChunk(const void* data, size_t size,
 		return B_NO_MEMORY;
 	}
 
-	// Try to use compression only for data large enough.
-	bool compress = mayCompress && size >= (off_t)kCompressionSizeThreshold;
-	if (compress) {
-		status_t error = _WriteDataCompressed(data, size);
-		if (error != B_OK) {
-			if (error != B_BUFFER_OVERFLOW)
-				return error;
-			compress = false;
-		}
-	}
+	if (mayCompress) {
+		size_t compressedSize;
+		status_t error = _CompressChunk(data, size, fCompressedDataBuffer,
+			compressedSize);
+		if (error == B_OK)
+			return _WriteDataUncompressed(fCompressedDataBuffer, compressedSize);
 
-	// Write uncompressed, if necessary.
-	if (!compress) {
-		status_t error = _WriteDataUncompressed(data, size);
-		if (error != B_OK)
+		if (error != B_BUFFER_OVERFLOW) {
+			fErrorOutput->PrintError("Failed to compress chunk data: %s\n",
+				strerror(error));
 			return error;
+		}
 	}
 
-	return B_OK;
+	// Write uncompressed, if necessary.
+	return _WriteDataUncompressed(data, size);
 }
 
 
+/*!	Compresses the chunk \a data to \a compressedData, which must be as
+	large as the chunk.
+	Returns \c B_BUFFER_OVERFLOW, if the chunk shall be stored uncompressed.
+	May be called by the compression queue's worker threads, and therefore
+	must not touch anything but the arguments.
+*/
 status_t
-PackageFileHeapWriter::_WriteDataCompressed(const void* data, size_t size)
+PackageFileHeapWriter::_CompressChunk(const void* data, size_t size,
+	void* compressedData, size_t& _compressedSize) const
 {
-	if (fCompressionAlgorithm == NULL)
+	// Try to use compression only for data large enough.
+	if (fCompressionAlgorithm == NULL || size < kCompressionSizeThreshold)
 		return B_BUFFER_OVERFLOW;
 
-	size_t compressedSize;
 	status_t error = fCompressionAlgorithm->algorithm->CompressBuffer(data,
-		size, fCompressedDataBuffer, size, compressedSize,
+		size, compressedData, size, _compressedSize,
 		fCompressionAlgorithm->parameters);
-	if (error != B_OK) {
-		if (error != B_BUFFER_OVERFLOW) {
-			fErrorOutput->PrintError("Failed to compress chunk data: %s\n",
-				strerror(error));
-		}
+	if (error != B_OK)
 		return error;
-	}
 
 	// only use compressed data when we've actually saved space
-	if (compressedSize == size)
+	if (_compressedSize == size)
 		return B_BUFFER_OVERFLOW;
 
-	return _WriteDataUncompressed(fCompressedDataBuffer, compressedSize);
+	return B_OK;
 }
 
 
@@ -596,6 +818,114 @@ PackageFileHeapWriter::_WriteDataUncompressed(const void* data, size_t size)
 }
 
 
+/*!	Creates the compression queue, if that hasn't been done yet, and it makes
+	sense on this machine. If it fails, all chunks will be compressed
+	serially.
+*/
+bool
+PackageFileHeapWriter::_StartCompressionQueue()
+{
+	if (fCompressionQueue != NULL)
+		return true;
+
+	long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+	int32 threadCount = (int32)std::min(cpuCount, (long)kMaxCompressionThreads);
+	if (threadCount < 2) {
+		fParallelCompression = false;
+		return false;
+	}
+
+	// a job needs two chunk buffers
+	int32 jobCount = std::min(threadCount * kCompressionJobsPerThread,
+		int32(kCompressionMemoryBudget / (2 * kChunkSize)));
+
+	fCompressionQueue = new(std::nothrow) CompressionQueue(this);
+	if (fCompressionQueue == NULL
+		|| fCompressionQueue->Init(threadCount, jobCount) != B_OK) {
+		delete fCompressionQueue;
+		fCompressionQueue = NULL;
+		fParallelCompression = false;
+		return false;
+	}
+
+	return true;
+}
+
+
+/*!	Hands the pending data over to the compression queue. Writes queued chunks
+	that are already done, and, if the queue is full, waits for the oldest
+	one to be done.
+*/
+status_t
+PackageFileHeapWriter::_QueuePendingData()
+{
+	if (fCompressionQueue->IsFull()) {
+		status_t error = _WriteQueuedChunk();
+		if (error != B_OK)
+			return error;
+	}
+
+	// swap buffers instead of copying the data
+	CompressionJob& job = fCompressionQueue->FreeJob();
+	std::swap(job.data, fPendingDataBuffer);
+	job.size = fPendingDataSize;
+	fCompressionQueue->QueueFreeJob();
+
+	while (fCompressionQueue->IsOldestJobDone()) {
+		status_t error = _WriteQueuedChunk();
+		if (error != B_OK)
+			return error;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Waits for the oldest queued chunk to be compressed, and writes it.
+*/
+status_t
+PackageFileHeapWriter::_WriteQueuedChunk()
+{
+	CompressionJob& job = fCompressionQueue->WaitForOldestJob();
+	fCompressionQueue->OldestJobWritten();
+		// the job is not reused before we queue another one
+
+	if (job.status != B_OK && job.status != B_BUFFER_OVERFLOW) {
+		fErrorOutput->PrintError("Failed to compress chunk data: %s\n",
+			strerror(job.status));
+		return job.status;
+	}
+
+	if (!fOffsets.Add(fCompressedHeapSize)) {
+		fErrorOutput->PrintError("Out of memory!\n");
+		return B_NO_MEMORY;
+	}
+
+	return job.status == B_OK
+		? _WriteDataUncompressed(job.compressedData, job.compressedSize)
+		: _WriteDataUncompressed(job.data, job.size);
+}
+
+
+/*!	Writes all queued chunks, so that the heap sizes and chunk offsets are
+	exact afterwards.
+*/
+status_t
+PackageFileHeapWriter::_WriteQueuedChunks()
+{
+	if (fCompressionQueue == NULL)
+		return B_OK;
+
+	while (!fCompressionQueue->IsEmpty()) {
+		status_t error = _WriteQueuedChunk();
+		if (error != B_OK)
+			return error;
+	}
+
+	return B_OK;
+}
+
+
 void
 PackageFileHeapWriter::_PushChunks(ChunkBuffer& chunkBuffer, uint64 startOffset,
 	uint64 endOffset)
@@ -341,6 +341,7 @@ PackageReaderImpl::Init(int fd, bool keepFD, uint32 flags)
 		return B_NO_MEMORY;
 	}
 
+	SetFileDescriptor(fd);
 	return Init(file, true, flags);
 }
 
@@ -429,15 +430,11 @@ PackageReaderImpl::ParseContent(BLowLevelPackageContentHandler* contentHandler)
 status_t
 PackageReaderImpl::_PrepareSections()
 {
-	status_t error = PrepareSection(fTOCSection);
-	if (error != B_OK)
-		return error;
-
-	error = PrepareSection(fPackageAttributesSection);
-	if (error != B_OK)
-		return error;
-
-	return B_OK;
+	PackageFileSection* sections[] = {
+		&fTOCSection,
+		&fPackageAttributesSection
+	};
+	return PrepareSections(sections, 2);
 }
 
 
@@ -13,12 +13,18 @@
 #include <string.h>
 #include <unistd.h>
 
+#if !defined(_KERNEL_MODE) && !defined(_BOOT_MODE)
+#	include <sys/mman.h>
+#	define MAP_SECTION_DATA 1
+#endif
+
 #include <algorithm>
 #include <new>
 
 #include <ByteOrder.h>
 #include <DataIO.h>
 
+#include <Lz4CompressionAlgorithm.h>
 #include <ZlibCompressionAlgorithm.h>
 
 #include <package/hpkg/HPKGDefsPrivate.h>
@@ -768,6 +774,11 @@ ReaderImplBase::ReaderImplBase(const char* fileType, BErrorOutput* errorOutput)
 	fOwnsFile(false),
 	fRawHeapReader(NULL),
 	fHeapReader(NULL),
+	fFD(-1),
+	fSectionData(NULL),
+	fMappedSectionData(NULL),
+	fMappedSectionDataSize(0),
+	fSectionsPrepared(false),
 	fCurrentSection(NULL)
 {
 }
@@ -775,6 +786,8 @@ ReaderImplBase::ReaderImplBase(const char* fileType, BErrorOutput* errorOutput)
 
 ReaderImplBase::~ReaderImplBase()
 {
+	_UnsetSectionData();
+
 	delete fHeapReader;
 	if (fRawHeapReader != fHeapReader)
 		delete fRawHeapReader;
@@ -824,6 +837,17 @@ ReaderImplBase::InitHeapReader(uint32 compression, uint32 chunkSize,
 				return B_NO_MEMORY;
 			}
 			break;
+		case B_HPKG_COMPRESSION_LZ4:
+			decompressionAlgorithm = DecompressionAlgorithmOwner::Create(
+				new(std::nothrow) BLz4CompressionAlgorithm,
+				new(std::nothrow) BLz4DecompressionParameters);
+			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
+			if (decompressionAlgorithm == NULL
+				|| decompressionAlgorithm->algorithm == NULL
+				|| decompressionAlgorithm->parameters == NULL) {
+				return B_NO_MEMORY;
+			}
+			break;
 		default:
 			fErrorOutput->PrintError("Error: Invalid heap compression\n");
 			return B_BAD_DATA;
@@ -899,28 +923,78 @@ ReaderImplBase::InitSection(PackageFileSection& section, uint64 endOffset,
 }
 
 
+/*!	Loads the data of the given sections and parses their strings.
+	The sections are read in one go, since they are usually adjacent at the end
+	of the heap. If that part of the heap is stored uncompressed and the file
+	can be mapped, the section data, and thus all strings and attribute values
+	handed out, point directly into the mapping. Otherwise the sections are
+	decompressed once into a single buffer.
+	The sections are only loaded once: since the strings and attribute values
+	handed out by an earlier parse must stay valid until the reader is
+	deleted, a later call just rewinds the sections to after their strings.
+*/
 status_t
-ReaderImplBase::PrepareSection(PackageFileSection& section)
+ReaderImplBase::PrepareSections(PackageFileSection* const* sections,
+	int32 count)
 {
-	// allocate memory for the section data and read it in
-	section.data = new(std::nothrow) uint8[section.uncompressedLength];
-	if (section.data == NULL) {
-		ErrorOutput()->PrintError("Error: Out of memory!\n");
-		return B_NO_MEMORY;
+	if (fSectionsPrepared) {
+		for (int32 i = 0; i < count; i++)
+			sections[i]->currentOffset = sections[i]->stringsLength;
+		return B_OK;
 	}
 
-	status_t error = ReadSection(section);
-	if (error != B_OK)
-		return error;
+	_UnsetSectionData();
+
+	// determine the heap range covering all sections
+	uint64 startOffset = UncompressedHeapSize();
+	uint64 endOffset = 0;
+	for (int32 i = 0; i < count; i++) {
+		PackageFileSection* section = sections[i];
+		startOffset = std::min(startOffset, section->offset);
+		endOffset = std::max(endOffset,
+			section->offset + section->uncompressedLength);
+	}
+
+	if (startOffset > endOffset)
+		startOffset = endOffset;
+	size_t size = endOffset - startOffset;
+
+	// map or read the section data
+	uint8* data = _MapSectionData(startOffset, size);
+	if (data == NULL) {
+		fSectionData = new(std::nothrow) uint8[std::max(size, (size_t)1)];
+		if (fSectionData == NULL) {
+			ErrorOutput()->PrintError("Error: Out of memory!\n");
+			return B_NO_MEMORY;
+		}
+
+		if (size > 0) {
+			status_t error = fHeapReader->ReadData(startOffset, fSectionData,
+				size);
+			if (error != B_OK)
+				return error;
+		}
+
+		data = fSectionData;
+	}
 
 	// parse the section strings
-	section.currentOffset = 0;
-	SetCurrentSection(&section);
+	for (int32 i = 0; i < count; i++) {
+		PackageFileSection* section = sections[i];
+		section->data = data + (section->offset - startOffset);
+		section->currentOffset = 0;
 
-	error = ParseStrings();
-	if (error != B_OK)
-		return error;
+		delete[] section->strings;
+		section->strings = NULL;
+
+		SetCurrentSection(section);
 
+		status_t error = ParseStrings();
+		if (error != B_OK)
+			return error;
+	}
+
+	fSectionsPrepared = true;
 	return B_OK;
 }
 
@@ -1340,6 +1414,59 @@ ReaderImplBase::_ReadSectionBuffer(void* buffer, size_t size)
 }
 
 
+/*!	Maps the heap range \a offset, \a size, if it is stored uncompressed.
+	Returns \c NULL, if that isn't possible.
+*/
+uint8*
+ReaderImplBase::_MapSectionData(uint64 offset, size_t size)
+{
+#ifdef MAP_SECTION_DATA
+	off_t fileOffset;
+	if (fFD < 0 || fRawHeapReader == NULL
+		|| !fRawHeapReader->GetStoredUncompressedRange(offset, size,
+			fileOffset)) {
+		return NULL;
+	}
+
+	// don't map beyond the end of the file -- we'd fault instead of failing
+	off_t fileSize;
+	if (fFile->GetSize(&fileSize) != B_OK || fileOffset > fileSize
+		|| (off_t)size > fileSize - fileOffset) {
+		return NULL;
+	}
+
+	off_t pageSize = sysconf(_SC_PAGE_SIZE);
+	off_t mapOffset = fileOffset / pageSize * pageSize;
+	size_t mapSize = size + (fileOffset - mapOffset);
+	void* address = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fFD,
+		mapOffset);
+	if (address == MAP_FAILED)
+		return NULL;
+
+	fMappedSectionData = address;
+	fMappedSectionDataSize = mapSize;
+	return (uint8*)address + (fileOffset - mapOffset);
+#else
+	return NULL;
+#endif
+}
+
+
+void
+ReaderImplBase::_UnsetSectionData()
+{
+#ifdef MAP_SECTION_DATA
+	if (fMappedSectionData != NULL)
+		munmap(fMappedSectionData, fMappedSectionDataSize);
+#endif
+	fMappedSectionData = NULL;
+	fMappedSectionDataSize = 0;
+
+	delete[] fSectionData;
+	fSectionData = NULL;
+}
+
+
 status_t
 ReaderImplBase::ReadBuffer(off_t offset, void* buffer, size_t size)
 {
@@ -1354,14 +1481,6 @@ ReaderImplBase::ReadBuffer(off_t offset, void* buffer, size_t size)
 }
 
 
-status_t
-ReaderImplBase::ReadSection(const PackageFileSection& section)
-{
-	return fHeapReader->ReadData(section.offset,
-		section.data, section.uncompressedLength);
-}
-
-
 }	// namespace BPrivate
 
 }	// namespace BHPKG
@@ -206,6 +206,7 @@ RepositoryReaderImpl::Init(int fd, bool keepFD)
 		return B_NO_MEMORY;
 	}
 
+	SetFileDescriptor(fd);
 	return Init(file, true);
 }
 
@@ -240,11 +241,11 @@ RepositoryReaderImpl::Init(BPositionIO* file, bool keepFile)
 		return error;
 
 	// prepare the sections for use
-	error = PrepareSection(repositoryInfoSection);
-	if (error != B_OK)
-		return error;
-
-	error = PrepareSection(fPackageAttributesSection);
+	PackageFileSection* sections[] = {
+		&repositoryInfoSection,
+		&fPackageAttributesSection
+	};
+	error = PrepareSections(sections, 2);
 	if (error != B_OK)
 		return error;
 
@@ -8,6 +8,7 @@
 
 #include <new>
 
+#include <package/hpkg/PackageWriter.h>
 #include <package/hpkg/RepositoryWriterImpl.h>
 #include <package/RepositoryInfo.h>
 
@@ -37,7 +38,21 @@ BRepositoryWriter::Init(const char* fileName)
 	if (fImpl == NULL)
 		return B_NO_MEMORY;
 
-	return fImpl->Init(fileName);
+	return fImpl->Init(fileName, BPackageWriterParameters());
+}
+
+
+/*!	Like Init(const char*), but uses the heap compression given by
+	\a parameters instead of the default one.
+*/
+status_t
+BRepositoryWriter::Init(const char* fileName,
+	const BPackageWriterParameters& parameters)
+{
+	if (fImpl == NULL)
+		return B_NO_MEMORY;
+
+	return fImpl->Init(fileName, parameters);
 }
 
 
@@ -202,14 +202,15 @@ RepositoryWriterImpl::~RepositoryWriterImpl()
 
 
 status_t
-RepositoryWriterImpl::Init(const char* fileName)
+RepositoryWriterImpl::Init(const char* fileName,
+	const BPackageWriterParameters& parameters)
 {
 	try {
 		fPackageNames = new PackageNameSet();
 		status_t result = fPackageNames->InitCheck();
 		if (result != B_OK)
 			return result;
-		return _Init(fileName);
+		return _Init(fileName, parameters);
 	} catch (status_t error) {
 		return error;
 	} catch (std::bad_alloc) {
@@ -262,10 +263,10 @@ RepositoryWriterImpl::Finish()
 
 
 status_t
-RepositoryWriterImpl::_Init(const char* fileName)
+RepositoryWriterImpl::_Init(const char* fileName,
+	const BPackageWriterParameters& parameters)
 {
-	status_t error = inherited::Init(NULL, false, fileName,
-		BPackageWriterParameters());
+	status_t error = inherited::Init(NULL, false, fileName, parameters);
 	if (error != B_OK)
 		return error;
 
@@ -19,6 +19,7 @@
 #include <File.h>
 
 #include <AutoDeleter.h>
+#include <Lz4CompressionAlgorithm.h>
 #include <ZlibCompressionAlgorithm.h>
 
 #include <package/hpkg/DataReader.h>
@@ -317,6 +318,27 @@ WriterImplBase::InitHeapReader(size_t headerSize)
 				new(std::nothrow) BZlibDecompressionParameters);
 			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
 
+			if (compressionAlgorithm == NULL
+				|| compressionAlgorithm->algorithm == NULL
+				|| compressionAlgorithm->parameters == NULL
+				|| decompressionAlgorithm == NULL
+				|| decompressionAlgorithm->algorithm == NULL
+				|| decompressionAlgorithm->parameters == NULL) {
+				throw std::bad_alloc();
+			}
+			break;
+		case B_HPKG_COMPRESSION_LZ4:
+			// The compression level is ignored, LZ4 only has a fast mode.
+			compressionAlgorithm = CompressionAlgorithmOwner::Create(
+				new(std::nothrow) BLz4CompressionAlgorithm,
+				new(std::nothrow) BLz4CompressionParameters);
+			compressionAlgorithmReference.SetTo(compressionAlgorithm, true);
+
+			decompressionAlgorithm = DecompressionAlgorithmOwner::Create(
+				new(std::nothrow) BLz4CompressionAlgorithm,
+				new(std::nothrow) BLz4DecompressionParameters);
+			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
+
 			if (compressionAlgorithm == NULL
 				|| compressionAlgorithm->algorithm == NULL
 				|| compressionAlgorithm->parameters == NULL
@@ -10,6 +10,9 @@
 #include "LibsolvSolver.h"
 
 #include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/utsname.h>
 
 #include <new>
@@ -18,9 +21,16 @@
 #include <solv/poolarch.h>
 #include <solv/repo.h>
 #include <solv/repo_haiku.h>
+#include <solv/repo_solv.h>
+#include <solv/repo_write.h>
 #include <solv/selection.h>
 #include <solv/solverdebug.h>
 
+#include <Directory.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <package/PackageInfo.h>
 #include <package/PackageResolvableExpression.h>
 #include <package/RepositoryCache.h>
 #include <package/solver/SolverPackage.h>
@@ -170,6 +180,191 @@ private:
 };
 
 
+// #pragma mark - solver cache
+
+
+/*!	The solvables of remote repositories are cached in libsolv's own format.
+	It already contains the string pool and the dependency indices, and thus
+	loads a lot faster than converting all package infos again. A cache file
+	starts with a header identifying the package set it has been written for.
+*/
+
+
+static const uint32 kSolverCacheMagic = 'hpsc';
+static const uint32 kSolverCacheVersion = 1;
+
+
+struct solver_cache_header {
+	uint32	magic;
+	uint32	version;
+	uint64	fingerprint;
+	uint32	package_count;
+	uint32	reserved;
+};
+
+
+static inline uint64
+hash_data(uint64 hash, const void* data, size_t size)
+{
+	// FNV-1a
+	const uint8* bytes = (const uint8*)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+
+static inline uint64
+hash_string(uint64 hash, const BString& string)
+{
+	// include the terminating null, so that adjacent strings can't blend
+	return hash_data(hash, string.String(), string.Length() + 1);
+}
+
+
+/*!	Computes a fingerprint of the repository's package set. A repository
+	package is identified by its name, version, architecture, and checksum, so
+	the resolvables don't need to be included. Packages without a checksum,
+	like local package files, can't be identified that way, so \c false is
+	returned for repositories containing any.
+*/
+static bool
+get_repository_fingerprint(BSolverRepository* repository, uint64& _fingerprint)
+{
+	int32 packageCount = repository->CountPackages();
+	if (packageCount == 0)
+		return false;
+
+	uint64 hash = hash_string(14695981039346656037ULL, repository->Name());
+	for (int32 i = 0; i < packageCount; i++) {
+		const BPackageInfo& info = repository->PackageAt(i)->Info();
+		if (info.Checksum().IsEmpty())
+			return false;
+
+		const BPackageVersion& version = info.Version();
+		uint32 revision = version.Revision();
+		uint32 architecture = info.Architecture();
+
+		hash = hash_string(hash, info.Name());
+		hash = hash_string(hash, version.Major());
+		hash = hash_string(hash, version.Minor());
+		hash = hash_string(hash, version.Micro());
+		hash = hash_string(hash, version.PreRelease());
+		hash = hash_data(hash, &revision, sizeof(revision));
+		hash = hash_data(hash, &architecture, sizeof(architecture));
+		hash = hash_string(hash, info.Checksum());
+	}
+
+	_fingerprint = hash;
+	return true;
+}
+
+
+static bool
+get_solver_cache_path(BSolverRepository* repository, BPath& _path)
+{
+#ifdef HAIKU_TARGET_PLATFORM_HAIKU
+	if (find_directory(B_USER_CACHE_DIRECTORY, &_path, true) != B_OK
+		|| _path.Append("package-solver") != B_OK
+		|| create_directory(_path.Path(), 0755) != B_OK) {
+		return false;
+	}
+
+	BString fileName(repository->Name());
+	fileName.ReplaceAll('/', '_');
+	fileName << ".solv";
+	return _path.Append(fileName) == B_OK;
+#else
+	// don't leave cache files behind on the build host
+	return false;
+#endif
+}
+
+
+/*!	Loads the solvables of \a repository from its solver cache file, if it
+	has been written for the same package set. The solvables are in the same
+	order as the repository's packages.
+*/
+static bool
+load_cached_repository(Repo* repo, BSolverRepository* repository,
+	uint64 fingerprint)
+{
+	BPath path;
+	if (!get_solver_cache_path(repository, path))
+		return false;
+
+	FILE* file = fopen(path.Path(), "rb");
+	if (file == NULL)
+		return false;
+
+	int32 packageCount = repository->CountPackages();
+
+	solver_cache_header header;
+	bool loaded = fread(&header, sizeof(header), 1, file) == 1
+		&& header.magic == kSolverCacheMagic
+		&& header.version == kSolverCacheVersion
+		&& header.fingerprint == fingerprint
+		&& header.package_count == (uint32)packageCount
+		&& repo_add_solv(repo, file, 0) == 0
+		&& repo->nsolvables == packageCount;
+	fclose(file);
+
+	if (loaded) {
+		// double check that the solvables match the packages
+		int32 index = 0;
+		Id solvableId;
+		Solvable* solvable;
+		FOR_REPO_SOLVABLES(repo, solvableId, solvable) {
+			if (index >= packageCount
+				|| repository->PackageAt(index++)->Info().Name()
+					!= pool_id2str(repo->pool, solvable->name)) {
+				loaded = false;
+				break;
+			}
+		}
+	}
+
+	if (!loaded)
+		repo_empty(repo, 1);
+
+	return loaded;
+}
+
+
+static void
+write_cached_repository(Repo* repo, BSolverRepository* repository,
+	uint64 fingerprint)
+{
+	BPath path;
+	if (!get_solver_cache_path(repository, path))
+		return;
+
+	// write a temporary file first, so concurrent readers never see a partial
+	// one
+	BString tempPath;
+	tempPath.SetToFormat("%s.%" B_PRId32, path.Path(), (int32)getpid());
+
+	FILE* file = fopen(tempPath.String(), "wb");
+	if (file == NULL)
+		return;
+
+	solver_cache_header header;
+	header.magic = kSolverCacheMagic;
+	header.version = kSolverCacheVersion;
+	header.fingerprint = fingerprint;
+	header.package_count = repository->CountPackages();
+	header.reserved = 0;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& repo_write(repo, file) == 0;
+	if (fclose(file) != 0)
+		written = false;
+
+	if (!written || rename(tempPath.String(), path.Path()) != 0)
+		unlink(tempPath.String());
+}
+
+
 // #pragma mark - LibsolvSolver
 
 
@@ -731,49 +926,133 @@ LibsolvSolver::_AddRepositories()
 	if (fPool != NULL && !_HaveRepositoriesChanged())
 		return B_OK;
 
-	// something has changed -- re-create the pool
-	status_t error = _InitPool();
-	if (error != B_OK)
-		return error;
+	if (fPool == NULL) {
+		status_t error = _InitPool();
+		if (error != B_OK)
+			return error;
+	} else {
+		// The jobs and the solver refer to the pool data we're going to
+		// change. Only the changed repositories are re-added, though.
+		_CleanupJobQueue();
+		pool_freewhatprovides(fPool);
+	}
 
 	fInstalledRepository = NULL;
 
 	int32 repositoryCount = fRepositoryInfos.CountItems();
 	for (int32 i = 0; i < repositoryCount; i++) {
 		RepositoryInfo* repositoryInfo = fRepositoryInfos.ItemAt(i);
-		BSolverRepository* repository = repositoryInfo->Repository();
-		Repo* repo = repo_create(fPool, repository->Name());
-		repositoryInfo->SetSolvRepo(repo);
+		if (repositoryInfo->HasChanged()) {
+			status_t error = _AddRepository(repositoryInfo);
+			if (error != B_OK)
+				return error;
+		}
 
-		repo->priority = -1 - repository->Priority();
-		repo->appdata = (void*)repositoryInfo;
+		if (repositoryInfo->Repository()->IsInstalled()) {
+			fInstalledRepository = repositoryInfo;
+			pool_set_installed(fPool, repositoryInfo->SolvRepo());
+		}
+	}
 
-		int32 packageCount = repository->CountPackages();
-		for (int32 k = 0; k < packageCount; k++) {
-			BSolverPackage* package = repository->PackageAt(k);
+	// create "provides" lookup
+	pool_createwhatprovides(fPool);
+
+	return B_OK;
+}
+
+
+/*!	(Re-)adds the solvables of the given repository to the pool. If possible,
+	they are loaded from the solver cache, which is also updated otherwise.
+*/
+status_t
+LibsolvSolver::_AddRepository(RepositoryInfo* repositoryInfo)
+{
+	_RemoveRepository(repositoryInfo);
+
+	BSolverRepository* repository = repositoryInfo->Repository();
+	Repo* repo = repo_create(fPool, repository->Name());
+	repositoryInfo->SetSolvRepo(repo);
+
+	repo->priority = -1 - repository->Priority();
+	repo->appdata = (void*)repositoryInfo;
+
+	uint64 fingerprint;
+	bool useCache = !repository->IsInstalled()
+		&& get_repository_fingerprint(repository, fingerprint);
+
+	int32 packageCount = repository->CountPackages();
+	if (useCache && load_cached_repository(repo, repository, fingerprint)) {
+		int32 index = 0;
+		Id solvableId;
+		Solvable* solvable;
+		FOR_REPO_SOLVABLES(repo, solvableId, solvable) {
+			status_t error = _AddSolvable(solvableId,
+				repository->PackageAt(index++));
+			if (error != B_OK)
+				return error;
+		}
+	} else {
+		for (int32 i = 0; i < packageCount; i++) {
+			BSolverPackage* package = repository->PackageAt(i);
 			Id solvableId = repo_add_haiku_package_info(repo, package->Info(),
 				REPO_REUSE_REPODATA | REPO_NO_INTERNALIZE);
 
-			try {
-				fSolvablePackages[solvableId] = package;
-				fPackageSolvables[package] = solvableId;
-			} catch (std::bad_alloc&) {
-				return B_NO_MEMORY;
-			}
+			status_t error = _AddSolvable(solvableId, package);
+			if (error != B_OK)
+				return error;
 		}
 
 		repo_internalize(repo);
 
-		if (repository->IsInstalled()) {
-			fInstalledRepository = repositoryInfo;
-			pool_set_installed(fPool, repo);
+		if (useCache)
+			write_cached_repository(repo, repository, fingerprint);
+	}
+
+	repositoryInfo->SetUnchanged();
+	return B_OK;
+}
+
+
+void
+LibsolvSolver::_RemoveRepository(RepositoryInfo* repositoryInfo)
+{
+	Repo* repo = repositoryInfo->SolvRepo();
+	if (repo == NULL)
+		return;
+
+	// The repository's packages might already be gone, so only the solvables
+	// may be used to find them.
+	Id solvableId;
+	Solvable* solvable;
+	FOR_REPO_SOLVABLES(repo, solvableId, solvable) {
+		SolvableMap::iterator it = fSolvablePackages.find(solvableId);
+		if (it == fSolvablePackages.end())
+			continue;
+
+		// a new package might have reused the address of a deleted one
+		PackageMap::iterator packageIt = fPackageSolvables.find(it->second);
+		if (packageIt != fPackageSolvables.end()
+			&& packageIt->second == solvableId) {
+			fPackageSolvables.erase(packageIt);
 		}
 
-		repositoryInfo->SetUnchanged();
+		fSolvablePackages.erase(it);
 	}
 
-	// create "provides" lookup
-	pool_createwhatprovides(fPool);
+	repo_free(repo, 1);
+	repositoryInfo->SetSolvRepo(NULL);
+}
+
+
+status_t
+LibsolvSolver::_AddSolvable(Id solvableId, BSolverPackage* package)
+{
+	try {
+		fSolvablePackages[solvableId] = package;
+		fPackageSolvables[package] = solvableId;
+	} catch (std::bad_alloc&) {
+		return B_NO_MEMORY;
+	}
 
 	return B_OK;
 }
@@ -95,6 +95,12 @@ private:
 
 			bool				_HaveRepositoriesChanged() const;
 			status_t			_AddRepositories();
+			status_t			_AddRepository(
+									RepositoryInfo* repositoryInfo);
+			void				_RemoveRepository(
+									RepositoryInfo* repositoryInfo);
+			status_t			_AddSolvable(Id solvableId,
+									BSolverPackage* package);
 			RepositoryInfo*		_InstalledRepository() const;
 			RepositoryInfo*		_GetRepositoryInfo(
 									BSolverRepository* repository) const;
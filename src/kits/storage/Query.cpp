@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2009, Haiku, Inc. All Rights Reserved.
+ * Copyright 2002-2026, Haiku, Inc. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -23,6 +23,7 @@
 #include <MessengerPrivate.h>
 #include <syscalls.h>
 #include <query_private.h>
+#include <QueryReader.h>
 
 #include "QueryPredicate.h"
 #include "storage_support.h"
@@ -32,6 +33,10 @@ using namespace std;
 using namespace BPrivate::Storage;
 
 
+// fDevice value of a query that is run on all volumes
+static const dev_t kAllVolumes = -2;
+
+
 // Creates an uninitialized BQuery.
 BQuery::BQuery()
 	:
@@ -42,7 +47,8 @@ BQuery::BQuery()
 	fLive(false),
 	fPort(B_ERROR),
 	fToken(0),
-	fQueryFd(-1)
+	fQueryFd(-1),
+	fReader(NULL)
 {
 }
 
@@ -59,6 +65,8 @@ status_t
 BQuery::Clear()
 {
 	// close the currently open query
+	delete fReader;
+	fReader = NULL;
 	status_t error = B_OK;
 	if (fQueryFd >= 0) {
 		error = _kern_close(fQueryFd);
@@ -201,6 +209,18 @@ BQuery::SetVolume(const BVolume* volume)
 }
 
 
+// Lets the query run on all mounted volumes that support queries.
+status_t
+BQuery::SetAllVolumes()
+{
+	if (_HasFetched())
+		return B_NOT_ALLOWED;
+
+	fDevice = kAllVolumes;
+	return B_OK;
+}
+
+
 // Assigns the passed-in predicate expression.
 status_t
 BQuery::SetPredicate(const char* expression)
@@ -291,7 +311,7 @@ BQuery::PredicateLength()
 dev_t
 BQuery::TargetDevice() const
 {
-	return fDevice;
+	return fDevice != kAllVolumes ? fDevice : (dev_t)B_ERROR;
 }
 
 
@@ -304,20 +324,44 @@ BQuery::Fetch()
 
 	_EvaluateStack();
 
-	if (!fPredicate || fDevice < 0)
+	if (!fPredicate || (fDevice < 0 && fDevice != kAllVolumes))
 		return B_NO_INIT;
 
 	BString parsedPredicate;
 	_ParseDates(parsedPredicate);
 
+	QueryReader* reader = new(nothrow) QueryReader;
+	if (reader == NULL)
+		return B_NO_MEMORY;
+
+	uint32 flags = fLive ? B_LIVE_QUERY : 0;
+
+	if (fDevice == kAllVolumes) {
+		// the reader runs the query on all volumes concurrently
+		status_t error = reader->SetToAllVolumes(parsedPredicate.String(),
+			parsedPredicate.Length(), flags, fPort, fToken);
+		if (error != B_OK) {
+			delete reader;
+			return error;
+		}
+
+		fReader = reader;
+		return B_OK;
+	}
+
 	fQueryFd = _kern_open_query(fDevice, parsedPredicate.String(),
-		parsedPredicate.Length(), fLive ? B_LIVE_QUERY : 0, fPort, fToken);
-	if (fQueryFd < 0)
+		parsedPredicate.Length(), flags, fPort, fToken);
+	if (fQueryFd < 0) {
+		delete reader;
 		return fQueryFd;
+	}
 
 	// set close on exec flag
 	fcntl(fQueryFd, F_SETFD, FD_CLOEXEC);
 
+	reader->SetTo(fQueryFd);
+	fReader = reader;
+
 	return B_OK;
 }
 
@@ -348,20 +392,20 @@ BQuery::GetNextRef(entry_ref* ref)
 	if (error == B_OK && !_HasFetched())
 		error = B_FILE_ERROR;
 	if (error == B_OK) {
-		BPrivate::Storage::LongDirEntry entry;
+		// the entries are read in batches, not one by one
+		struct dirent* entry;
 		bool next = true;
 		while (error == B_OK && next) {
-			if (GetNextDirents(&entry, sizeof(entry), 1) != 1) {
-				error = B_ENTRY_NOT_FOUND;
-			} else {
-				next = (!strcmp(entry.d_name, ".")
-						|| !strcmp(entry.d_name, ".."));
+			error = fReader->GetNextDirent(&entry);
+			if (error == B_OK) {
+				next = (!strcmp(entry->d_name, ".")
+						|| !strcmp(entry->d_name, ".."));
 			}
 		}
 		if (error == B_OK) {
-			ref->device = entry.d_pdev;
-			ref->directory = entry.d_pino;
-			error = ref->set_name(entry.d_name);
+			ref->device = entry->d_pdev;
+			ref->directory = entry->d_pino;
+			error = ref->set_name(entry->d_name);
 		}
 	}
 	return error;
@@ -377,7 +421,7 @@ BQuery::GetNextDirents(struct dirent* buffer, size_t length, int32 count)
 		return B_BAD_VALUE;
 	if (!_HasFetched())
 		return B_FILE_ERROR;
-	return _kern_read_dir(fQueryFd, buffer, length, count);
+	return fReader->GetNextDirents(buffer, length, count);
 }
 
 
@@ -387,7 +431,7 @@ BQuery::Rewind()
 {
 	if (!_HasFetched())
 		return B_FILE_ERROR;
-	return _kern_rewind_dir(fQueryFd);
+	return fReader->Rewind();
 }
 
 
@@ -406,7 +450,7 @@ BQuery::CountEntries()
 bool
 BQuery::_HasFetched() const
 {
-	return fQueryFd >= 0;
+	return fReader != NULL;
 }
 
 
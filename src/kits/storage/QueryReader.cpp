@@ -0,0 +1,448 @@
+/*
+ * Copyright 2026, Haiku, Inc. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <QueryReader.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Autolock.h>
+#include <fs_info.h>
+
+#include <syscalls.h>
+
+
+namespace BPrivate {
+namespace Storage {
+
+
+static const size_t kChunkSize = 32 * 1024;
+static const int32 kMaxQueuedChunks = 8;
+
+
+struct QueryReader::Chunk {
+	Chunk*			next;
+	int32			count;
+	struct dirent*	entry;
+
+	uint8* Data()
+	{
+		return (uint8*)(this + 1);
+	}
+
+	struct dirent* Next()
+	{
+		struct dirent* current = entry;
+		entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+		count--;
+		return current;
+	}
+};
+
+
+struct QueryReader::Reader {
+	QueryReader*	owner;
+	int				fd;
+	thread_id		thread;
+};
+
+
+QueryReader::QueryReader()
+	:
+	fLock("query reader"),
+	fFD(-1),
+	fReaders(NULL),
+	fReaderCount(0),
+	fFinishedReaders(0),
+	fFirstChunk(NULL),
+	fLastChunk(NULL),
+	fCurrent(NULL),
+	fAvailableSem(-1),
+	fSpaceSem(-1),
+	fStopping(0),
+	fError(B_OK)
+{
+}
+
+
+QueryReader::~QueryReader()
+{
+	Unset();
+}
+
+
+/*!	Reads the entries of the already opened query \a fd. The file
+	descriptor is not owned by the reader.
+*/
+status_t
+QueryReader::SetTo(int fd)
+{
+	Unset();
+
+	if (fd < 0)
+		return B_BAD_VALUE;
+
+	fFD = fd;
+	return B_OK;
+}
+
+
+/*!	Opens the query on all mounted volumes that support queries, and starts
+	reading their entries right away.
+*/
+status_t
+QueryReader::SetToAllVolumes(const char* predicate, size_t length,
+	uint32 flags, port_id port, int32 token)
+{
+	Unset();
+
+	status_t error = B_NOT_SUPPORTED;
+	int32 cookie = 0;
+	dev_t device;
+	while ((device = next_dev(&cookie)) >= 0) {
+		fs_info info;
+		if (fs_stat_dev(device, &info) != 0
+			|| (info.flags & B_FS_HAS_QUERY) == 0)
+			continue;
+
+		int fd = _kern_open_query(device, predicate, length, flags, port,
+			token);
+		if (fd < 0) {
+			error = fd;
+			continue;
+		}
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		Reader* readers = (Reader*)realloc(fReaders,
+			(fReaderCount + 1) * sizeof(Reader));
+		if (readers == NULL) {
+			_kern_close(fd);
+			Unset();
+			return B_NO_MEMORY;
+		}
+
+		fReaders = readers;
+		fReaders[fReaderCount].owner = this;
+		fReaders[fReaderCount].fd = fd;
+		fReaders[fReaderCount].thread = -1;
+		fReaderCount++;
+	}
+
+	if (fReaderCount == 0)
+		return error;
+
+	error = _StartReaders();
+	if (error != B_OK)
+		Unset();
+
+	return error;
+}
+
+
+void
+QueryReader::Unset()
+{
+	_StopReaders();
+	_FreeChunks();
+
+	for (int32 i = 0; i < fReaderCount; i++)
+		_kern_close(fReaders[i].fd);
+
+	free(fReaders);
+	fReaders = NULL;
+	fReaderCount = 0;
+	fFD = -1;
+	fError = B_OK;
+}
+
+
+/*!	Copies up to \a count entries to \a buffer. Entries that have already
+	been read in advance are returned first.
+*/
+int32
+QueryReader::GetNextDirents(struct dirent* buffer, size_t length,
+	int32 count)
+{
+	if (fCurrent == NULL || fCurrent->count == 0) {
+		free(fCurrent);
+		fCurrent = NULL;
+
+		if (fReaders == NULL) {
+			if (fFD < 0)
+				return B_NO_INIT;
+
+			// the caller's buffer is as good as ours
+			return _kern_read_dir(fFD, buffer, length, count);
+		}
+
+		fCurrent = _NextChunk();
+		if (fCurrent == NULL) {
+			status_t error = fError;
+			fError = B_OK;
+			return error;
+		}
+	}
+
+	uint8* target = (uint8*)buffer;
+	int32 copied = 0;
+	while (copied < count && fCurrent->count > 0
+		&& fCurrent->entry->d_reclen <= length) {
+		struct dirent* entry = fCurrent->Next();
+		memcpy(target, entry, entry->d_reclen);
+
+		target += entry->d_reclen;
+		length -= entry->d_reclen;
+		copied++;
+	}
+
+	if (copied == 0 && count > 0)
+		return B_BUFFER_OVERFLOW;
+
+	return copied;
+}
+
+
+/*!	Returns the next entry in \a _entry. It stays valid until the next call
+	of any of the reader's methods.
+*/
+status_t
+QueryReader::GetNextDirent(struct dirent** _entry)
+{
+	if (fCurrent == NULL || fCurrent->count == 0) {
+		free(fCurrent);
+		fCurrent = NULL;
+
+		if (fReaders == NULL) {
+			if (fFD < 0)
+				return B_NO_INIT;
+
+			status_t error = _ReadChunk(fFD, &fCurrent);
+			if (error != B_OK)
+				return error;
+		} else {
+			fCurrent = _NextChunk();
+			if (fCurrent == NULL) {
+				status_t error = fError;
+				fError = B_OK;
+				return error != B_OK ? error : B_ENTRY_NOT_FOUND;
+			}
+		}
+	}
+
+	*_entry = fCurrent->Next();
+	return B_OK;
+}
+
+
+status_t
+QueryReader::Rewind()
+{
+	if (fReaders == NULL) {
+		_FreeChunks();
+		if (fFD < 0)
+			return B_NO_INIT;
+
+		return _kern_rewind_dir(fFD);
+	}
+
+	_StopReaders();
+	_FreeChunks();
+	fError = B_OK;
+
+	for (int32 i = 0; i < fReaderCount; i++) {
+		status_t error = _kern_rewind_dir(fReaders[i].fd);
+		if (error != B_OK)
+			return error;
+	}
+
+	return _StartReaders();
+}
+
+
+status_t
+QueryReader::_StartReaders()
+{
+	fAvailableSem = create_sem(0, "query entries available");
+	if (fAvailableSem < 0)
+		return fAvailableSem;
+
+	fSpaceSem = create_sem(kMaxQueuedChunks, "query reader space");
+	if (fSpaceSem < 0) {
+		status_t error = fSpaceSem;
+		delete_sem(fAvailableSem);
+		fAvailableSem = -1;
+		return error;
+	}
+
+	fStopping = 0;
+	fFinishedReaders = 0;
+
+	for (int32 i = 0; i < fReaderCount; i++) {
+		Reader& reader = fReaders[i];
+		reader.thread = spawn_thread(&_ReaderThread, "query reader",
+			B_NORMAL_PRIORITY, &reader);
+		if (reader.thread < 0) {
+			// this volume won't return anything, then
+			if (fError == B_OK)
+				fError = reader.thread;
+			fFinishedReaders++;
+			continue;
+		}
+
+		resume_thread(reader.thread);
+	}
+
+	return B_OK;
+}
+
+
+void
+QueryReader::_StopReaders()
+{
+	if (fAvailableSem < 0)
+		return;
+
+	// readers waiting for space fail to acquire the deleted semaphore
+	atomic_set(&fStopping, 1);
+	delete_sem(fSpaceSem);
+	fSpaceSem = -1;
+
+	for (int32 i = 0; i < fReaderCount; i++) {
+		if (fReaders[i].thread < 0)
+			continue;
+
+		status_t result;
+		wait_for_thread(fReaders[i].thread, &result);
+		fReaders[i].thread = -1;
+	}
+
+	delete_sem(fAvailableSem);
+	fAvailableSem = -1;
+}
+
+
+void
+QueryReader::_FreeChunks()
+{
+	while (fFirstChunk != NULL) {
+		Chunk* chunk = fFirstChunk;
+		fFirstChunk = chunk->next;
+		free(chunk);
+	}
+	fLastChunk = NULL;
+
+	free(fCurrent);
+	fCurrent = NULL;
+}
+
+
+/*!	Waits until one of the readers has queued a chunk of entries, and
+	returns it. Returns \c NULL when all readers are done.
+*/
+QueryReader::Chunk*
+QueryReader::_NextChunk()
+{
+	while (true) {
+		{
+			BAutolock locker(fLock);
+
+			Chunk* chunk = fFirstChunk;
+			if (chunk != NULL) {
+				fFirstChunk = chunk->next;
+				if (fFirstChunk == NULL)
+					fLastChunk = NULL;
+
+				locker.Unlock();
+				release_sem(fSpaceSem);
+				return chunk;
+			}
+
+			if (fFinishedReaders == fReaderCount)
+				return NULL;
+		}
+
+		status_t error;
+		do {
+			error = acquire_sem(fAvailableSem);
+		} while (error == B_INTERRUPTED);
+
+		if (error != B_OK)
+			return NULL;
+	}
+}
+
+
+status_t
+QueryReader::_ReadChunk(int fd, Chunk** _chunk)
+{
+	Chunk* chunk = (Chunk*)malloc(sizeof(Chunk) + kChunkSize);
+	if (chunk == NULL)
+		return B_NO_MEMORY;
+
+	ssize_t count = _kern_read_dir(fd, (struct dirent*)chunk->Data(),
+		kChunkSize, INT32_MAX);
+	if (count <= 0) {
+		free(chunk);
+		return count == 0 ? B_ENTRY_NOT_FOUND : count;
+	}
+
+	chunk->next = NULL;
+	chunk->count = count;
+	chunk->entry = (struct dirent*)chunk->Data();
+
+	*_chunk = chunk;
+	return B_OK;
+}
+
+
+/*static*/ status_t
+QueryReader::_ReaderThread(void* data)
+{
+	Reader* reader = (Reader*)data;
+	QueryReader* self = reader->owner;
+	status_t error = B_OK;
+
+	while (atomic_get(&self->fStopping) == 0) {
+		do {
+			error = acquire_sem(self->fSpaceSem);
+		} while (error == B_INTERRUPTED);
+
+		if (error != B_OK) {
+			// we are being stopped
+			error = B_OK;
+			break;
+		}
+
+		Chunk* chunk;
+		error = self->_ReadChunk(reader->fd, &chunk);
+		if (error != B_OK)
+			break;
+
+		BAutolock locker(self->fLock);
+		if (self->fLastChunk != NULL)
+			self->fLastChunk->next = chunk;
+		else
+			self->fFirstChunk = chunk;
+		self->fLastChunk = chunk;
+		locker.Unlock();
+
+		release_sem(self->fAvailableSem);
+	}
+
+	BAutolock locker(self->fLock);
+	if (error != B_OK && error != B_ENTRY_NOT_FOUND && self->fError == B_OK)
+		self->fError = error;
+	self->fFinishedReaders++;
+	locker.Unlock();
+
+	release_sem(self->fAvailableSem);
+	return B_OK;
+}
+
+
+}	// namespace Storage
+}	// namespace BPrivate
@@ -0,0 +1,382 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A self-contained implementation of the LZ4 block format.
+
+	A block is a sequence of sequences, each consisting of a token byte, whose
+	high nibble is the literal length and whose low nibble is the match length
+	minus 4, optionally followed by more literal length bytes, the literals,
+	a 16 bit little endian match offset, and optionally more match length
+	bytes. A nibble of 15 means that more length bytes follow, each adding
+	its value, until one is not 255. The last sequence only consists of
+	literals, and must contain at least the last 5 bytes of the input.
+
+	The compressor is a simple greedy one with a single entry hash table, and
+	is only built for userland. Decompression is available everywhere.
+*/
+
+
+#include <Lz4CompressionAlgorithm.h>
+
+#include <string.h>
+
+
+// build compression support only for userland
+#if !defined(_KERNEL_MODE) && !defined(_BOOT_MODE)
+#	define B_LZ4_COMPRESSION_SUPPORT 1
+#endif
+
+
+static const size_t kMinMatch			= 4;
+static const size_t kLastLiterals		= 5;
+static const size_t kMatchFindLimit		= 12;
+static const size_t kMaxOffset			= 65535;
+static const size_t kRunMask			= 15;
+static const size_t kFastCopySize		= 16;
+
+#ifdef B_LZ4_COMPRESSION_SUPPORT
+static const uint32 kHashBits			= 12;
+static const uint32 kSkipShift			= 6;
+#endif
+
+
+static inline uint32
+read32(const uint8* data)
+{
+	uint32 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+// #pragma mark - BLz4CompressionParameters
+
+
+BLz4CompressionParameters::BLz4CompressionParameters(int32 acceleration)
+	:
+	BCompressionParameters(),
+	fAcceleration(acceleration)
+{
+}
+
+
+BLz4CompressionParameters::~BLz4CompressionParameters()
+{
+}
+
+
+int32
+BLz4CompressionParameters::Acceleration() const
+{
+	return fAcceleration;
+}
+
+
+void
+BLz4CompressionParameters::SetAcceleration(int32 acceleration)
+{
+	fAcceleration = acceleration;
+}
+
+
+// #pragma mark - BLz4DecompressionParameters
+
+
+BLz4DecompressionParameters::BLz4DecompressionParameters()
+	:
+	BDecompressionParameters()
+{
+}
+
+
+BLz4DecompressionParameters::~BLz4DecompressionParameters()
+{
+}
+
+
+// #pragma mark - compression
+
+
+#ifdef B_LZ4_COMPRESSION_SUPPORT
+
+
+static inline uint32
+hash_sequence(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+
+static inline size_t
+length_bytes(size_t length)
+{
+	return length >= kRunMask ? (length - kRunMask) / 255 + 1 : 0;
+}
+
+
+static inline void
+write_length(uint8*& output, size_t length)
+{
+	length -= kRunMask;
+	while (length >= 255) {
+		*output++ = 255;
+		length -= 255;
+	}
+	*output++ = (uint8)length;
+}
+
+
+/*!	Writes a sequence to \a output. A \a matchLength of 0 writes the final
+	sequence, which consists of literals only.
+	Returns \c false, if the sequence doesn't fit into the output buffer.
+*/
+static bool
+write_sequence(uint8*& output, const uint8* outputEnd, const uint8* literals,
+	size_t literalLength, size_t offset, size_t matchLength)
+{
+	size_t matchLengthCode = matchLength > 0 ? matchLength - kMinMatch : 0;
+	size_t needed = 1 + length_bytes(literalLength) + literalLength;
+	if (matchLength > 0)
+		needed += 2 + length_bytes(matchLengthCode);
+	if ((size_t)(outputEnd - output) < needed)
+		return false;
+
+	uint8* token = output++;
+
+	uint8 tokenValue;
+	if (literalLength >= kRunMask) {
+		tokenValue = kRunMask << 4;
+		write_length(output, literalLength);
+	} else
+		tokenValue = literalLength << 4;
+
+	memcpy(output, literals, literalLength);
+	output += literalLength;
+
+	if (matchLength > 0) {
+		*output++ = (uint8)offset;
+		*output++ = (uint8)(offset >> 8);
+
+		if (matchLengthCode >= kRunMask) {
+			tokenValue |= kRunMask;
+			write_length(output, matchLengthCode);
+		} else
+			tokenValue |= matchLengthCode;
+	}
+
+	*token = tokenValue;
+	return true;
+}
+
+
+#endif	// B_LZ4_COMPRESSION_SUPPORT
+
+
+// #pragma mark - decompression
+
+
+static inline bool
+read_length(const uint8*& input, const uint8* inputEnd, size_t& _length)
+{
+	uint8 value;
+	do {
+		if (input == inputEnd)
+			return false;
+		value = *input++;
+		_length += value;
+	} while (value == 255);
+
+	return true;
+}
+
+
+// #pragma mark - BLz4CompressionAlgorithm
+
+
+BLz4CompressionAlgorithm::BLz4CompressionAlgorithm()
+	:
+	BCompressionAlgorithm()
+{
+}
+
+
+BLz4CompressionAlgorithm::~BLz4CompressionAlgorithm()
+{
+}
+
+
+status_t
+BLz4CompressionAlgorithm::CompressBuffer(const void* input,
+	size_t inputSize, void* output, size_t outputSize, size_t& _compressedSize,
+	const BCompressionParameters* parameters)
+{
+#ifdef B_LZ4_COMPRESSION_SUPPORT
+	const BLz4CompressionParameters* lz4Parameters
+		= dynamic_cast<const BLz4CompressionParameters*>(parameters);
+	size_t acceleration = lz4Parameters != NULL
+		? lz4Parameters->Acceleration() : B_LZ4_ACCELERATION_DEFAULT;
+	if (acceleration < 1)
+		acceleration = 1;
+	else if (acceleration > B_LZ4_ACCELERATION_MAX)
+		acceleration = B_LZ4_ACCELERATION_MAX;
+
+	// the hash table stores 32 bit offsets
+	if (inputSize > (size_t)UINT32_MAX)
+		return B_BAD_VALUE;
+
+	const uint8* source = (const uint8*)input;
+	const uint8* sourceEnd = source + inputSize;
+	const uint8* anchor = source;
+	uint8* target = (uint8*)output;
+	const uint8* targetEnd = target + outputSize;
+
+	if (inputSize > kMatchFindLimit) {
+		uint32 hashTable[1 << kHashBits];
+		memset(hashTable, 0, sizeof(hashTable));
+
+		const uint8* matchLimit = sourceEnd - kLastLiterals;
+		const uint8* searchLimit = sourceEnd - kMatchFindLimit;
+		const uint8* position = source;
+		size_t misses = 0;
+
+		while (position < searchLimit) {
+			uint32 sequence = read32(position);
+			uint32 hash = hash_sequence(sequence);
+			const uint8* match = source + hashTable[hash];
+			hashTable[hash] = position - source;
+
+			if (match >= position || (size_t)(position - match) > kMaxOffset
+				|| read32(match) != sequence) {
+				// skip faster over data that doesn't compress
+				position += (misses++ >> kSkipShift) + acceleration;
+				continue;
+			}
+
+			// extend the match backwards and forwards
+			while (position > anchor && match > source
+				&& position[-1] == match[-1]) {
+				position--;
+				match--;
+			}
+
+			const uint8* matchEnd = position + kMinMatch;
+			while (matchEnd < matchLimit
+				&& *matchEnd == match[matchEnd - position]) {
+				matchEnd++;
+			}
+
+			if (!write_sequence(target, targetEnd, anchor, position - anchor,
+					position - match, matchEnd - position)) {
+				return B_BUFFER_OVERFLOW;
+			}
+
+			position = anchor = matchEnd;
+			misses = 0;
+
+			// the data right before a match's end often starts another one
+			if (position < searchLimit) {
+				hashTable[hash_sequence(read32(position - 2))]
+					= position - 2 - source;
+			}
+		}
+	}
+
+	if (!write_sequence(target, targetEnd, anchor, sourceEnd - anchor, 0, 0))
+		return B_BUFFER_OVERFLOW;
+
+	_compressedSize = target - (uint8*)output;
+	return B_OK;
+#else
+	return B_NOT_SUPPORTED;
+#endif
+}
+
+
+status_t
+BLz4CompressionAlgorithm::DecompressBuffer(const void* input,
+	size_t inputSize, void* output, size_t outputSize,
+	size_t& _uncompressedSize, const BDecompressionParameters* parameters)
+{
+	const uint8* source = (const uint8*)input;
+	const uint8* sourceEnd = source + inputSize;
+	uint8* target = (uint8*)output;
+	uint8* targetEnd = target + outputSize;
+
+	while (true) {
+		if (source == sourceEnd)
+			return B_BAD_DATA;
+
+		uint8 token = *source++;
+
+		// copy the literals
+		size_t literalLength = token >> 4;
+		if (literalLength == kRunMask
+			&& !read_length(source, sourceEnd, literalLength)) {
+			return B_BAD_DATA;
+		}
+
+		size_t sourceLeft = sourceEnd - source;
+		size_t targetLeft = targetEnd - target;
+		if (literalLength > sourceLeft)
+			return B_BAD_DATA;
+		if (literalLength > targetLeft)
+			return B_BUFFER_OVERFLOW;
+
+		if (literalLength <= kFastCopySize && sourceLeft >= kFastCopySize
+			&& targetLeft >= kFastCopySize) {
+			// a constant size copy is a lot faster
+			memcpy(target, source, kFastCopySize);
+		} else
+			memcpy(target, source, literalLength);
+		source += literalLength;
+		target += literalLength;
+
+		// the last sequence has no match
+		if (source == sourceEnd)
+			break;
+
+		// copy the match
+		if (sourceEnd - source < 2)
+			return B_BAD_DATA;
+
+		size_t offset = source[0] | ((size_t)source[1] << 8);
+		source += 2;
+		if (offset == 0 || offset > (size_t)(target - (uint8*)output))
+			return B_BAD_DATA;
+
+		size_t matchLength = token & kRunMask;
+		if (matchLength == kRunMask
+			&& !read_length(source, sourceEnd, matchLength)) {
+			return B_BAD_DATA;
+		}
+		matchLength += kMinMatch;
+
+		targetLeft = targetEnd - target;
+		if (matchLength > targetLeft)
+			return B_BUFFER_OVERFLOW;
+
+		const uint8* match = target - offset;
+		if (offset >= kFastCopySize && matchLength <= kFastCopySize
+			&& targetLeft >= kFastCopySize) {
+			memcpy(target, match, kFastCopySize);
+		} else if (offset >= matchLength) {
+			memcpy(target, match, matchLength);
+		} else if (offset >= 8) {
+			// the regions overlap, but not within 8 bytes
+			for (size_t i = 0; i < matchLength; i += 8) {
+				memcpy(target + i, match + i,
+					matchLength - i < 8 ? matchLength - i : 8);
+			}
+		} else {
+			for (size_t i = 0; i < matchLength; i++)
+				target[i] = match[i];
+		}
+		target += matchLength;
+	}
+
+	_uncompressedSize = target - (uint8*)output;
+	return B_OK;
+}
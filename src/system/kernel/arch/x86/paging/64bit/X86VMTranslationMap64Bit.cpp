@@ -37,7 +37,9 @@
 
 X86VMTranslationMap64Bit::X86VMTranslationMap64Bit()
 	:
-	fPagingStructures(NULL)
+	fPagingStructures(NULL),
+	fSparePageTableCount(0),
+	fLargePageCount(0)
 {
 }
 
@@ -71,6 +73,12 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0)
 						continue;
 
+					if ((virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0) {
+						// the pages belong to the area's cache
+						atomic_add(&gMappedLargePagesCount, -1);
+						continue;
+					}
+
 					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
 					page = vm_lookup_page(address / B_PAGE_SIZE);
 					if (page == NULL) {
@@ -104,6 +112,11 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 			vm_page_set_state(page, PAGE_STATE_FREE);
 		}
 
+		while (vm_page* page = fSparePageTables.RemoveHead()) {
+			DEBUG_PAGE_ACCESS_START(page);
+			vm_page_set_state(page, PAGE_STATE_FREE);
+		}
+
 		fPageMapper->Delete();
 	}
 
@@ -199,9 +212,8 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 
 	// Look up the page table for the virtual address, allocating new tables
 	// if required. Shouldn't fail.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
-		true, reservation, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(virtualAddress, true,
+		reservation);
 	ASSERT(entry != NULL);
 
 	// The entry should not already exist.
@@ -235,9 +247,24 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pde = _LargePageEntryForAddress(start);
+		if (pde != NULL && start % k64BitPageTableRange == 0
+			&& end - start >= k64BitPageTableRange - 1) {
+			// The range covers the whole large page, so we don't need to
+			// split it up.
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+			fMapCount -= k64BitTableEntryCount;
+			fLargePageCount--;
+			atomic_add(&gMappedLargePagesCount, -1);
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -271,6 +298,84 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 }
 
 
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	// The kernel map uses large pages for the physical map area only.
+	return fIsKernelMap ? 0 : k64BitPageTableRange;
+}
+
+
+status_t
+X86VMTranslationMap64Bit::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	TRACE("X86VMTranslationMap64Bit::MapLargePage(%#" B_PRIxADDR ", %#"
+		B_PRIxPHYSADDR ")\n", virtualAddress, physicalAddress);
+
+	ASSERT(virtualAddress % k64BitPageTableRange == 0);
+	ASSERT(physicalAddress % k64BitPageTableRange == 0);
+
+	if (fIsKernelMap)
+		return B_NOT_SUPPORTED;
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		true, reservation, fPageMapper, fMapCount);
+	ASSERT(pde != NULL);
+
+	// Every large page needs a spare page table, so that it can be split up
+	// at any time without having to allocate memory.
+	vm_page* sparePage = NULL;
+	if ((*pde & X86_64_PDE_PRESENT) != 0) {
+		if ((*pde & X86_64_PDE_LARGE_PAGE) != 0)
+			return B_BUSY;
+
+		// An empty page table can be replaced by the large page.
+		phys_addr_t physicalPageTable = *pde & X86_64_PDE_ADDRESS_MASK;
+		uint64* pageTable
+			= (uint64*)fPageMapper->GetPageTableAt(physicalPageTable);
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+			if ((pageTable[i] & X86_64_PTE_PRESENT) != 0)
+				return B_BUSY;
+		}
+
+		sparePage = vm_lookup_page(physicalPageTable / B_PAGE_SIZE);
+		ASSERT(sparePage != NULL);
+
+		// No CPU must use the page table anymore, before we reuse it.
+		X86PagingMethod64Bit::ClearTableEntry(pde);
+		InvalidatePage(virtualAddress);
+		Flush();
+	} else if (fSparePageTableCount <= fLargePageCount) {
+		sparePage = vm_page_allocate_page(reservation, PAGE_STATE_WIRED);
+		DEBUG_PAGE_ACCESS_END(sparePage);
+		fMapCount++;
+	}
+
+	if (sparePage != NULL) {
+		fSparePageTables.Add(sparePage);
+		fSparePageTableCount++;
+	}
+
+	// The flags of a large page directory entry are the same as those of a
+	// page table entry, save for the large page flag.
+	uint64 entry;
+	X86PagingMethod64Bit::PutPageTableEntryInTable(&entry, physicalAddress,
+		attributes, memoryType, false);
+	X86PagingMethod64Bit::SetTableEntry(pde, entry | X86_64_PDE_LARGE_PAGE);
+
+	fMapCount += k64BitTableEntryCount;
+	fLargePageCount++;
+	atomic_add(&gMappedLargePagesCount, 1);
+
+	return B_OK;
+}
+
+
 status_t
 X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -285,9 +390,7 @@ X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -332,17 +435,14 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 
 	TRACE("X86VMTranslationMap64Bit::UnmapPage(%#" B_PRIxADDR ")\n", address);
 
+	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	// Look up the page table for the virtual address.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	RecursiveLocker locker(fLock);
-
 	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(entry);
 
 	pinner.Unlock();
@@ -402,9 +502,7 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -535,9 +633,7 @@ X86VMTranslationMap64Bit::UnmapArea(VMArea* area, bool deletingAddressSpace,
 			addr_t address = area->Base()
 				+ ((page->cache_offset * B_PAGE_SIZE) - area->cache_offset);
 
-			uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-				fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-				false, NULL, fPageMapper, fMapCount);
+			uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 			if (entry == NULL) {
 				panic("page %p has mapping for area %p (%#" B_PRIxADDR "), but "
 					"has no page table", page, area, address);
@@ -683,9 +779,35 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pde = _LargePageEntryForAddress(start);
+		if (pde != NULL && start % k64BitPageTableRange == 0
+			&& end - start >= k64BitPageTableRange - 1) {
+			// The range covers the whole large page. The protection and
+			// memory type flags of the page directory entry are the same as
+			// those of a page table entry.
+			uint64 entry = *pde;
+			uint64 oldEntry;
+			while (true) {
+				oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+					(entry & ~(X86_64_PTE_PROTECTION_MASK
+							| X86_64_PTE_MEMORY_TYPE_MASK))
+						| newProtectionFlags
+						| X86PagingMethod64Bit::MemoryTypeToPageTableEntryFlags(
+							memoryType),
+					entry);
+				if (oldEntry == entry)
+					break;
+				entry = oldEntry;
+			}
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -740,9 +862,21 @@ X86VMTranslationMap64Bit::ClearFlags(addr_t address, uint32 flags)
 
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* pde = _LargePageEntryForAddress(address);
+	if (pde != NULL && (flags & PAGE_MODIFIED) == 0) {
+		// The accessed flag can be cleared for the whole large page, the
+		// modified flag only for the single page, so we have to split it in
+		// that case.
+		if ((flags & PAGE_ACCESSED) != 0) {
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntryFlags(pde,
+				X86_64_PDE_ACCESSED);
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(address);
+		}
+		return B_OK;
+	}
+
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return B_OK;
 
@@ -771,9 +905,36 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* pde = _LargePageEntryForAddress(address);
+	if (pde != NULL) {
+		// All pages of a large page share its flags. Only the first page
+		// clears the accessed flag, so that the large page ages as a whole.
+		// The modified flag is never cleared, which errs on the safe side.
+		// An unaccessed large page that shall be unmapped is split up, so
+		// that its pages can be reclaimed individually.
+		uint64 entry = *pde;
+		if ((entry & X86_64_PDE_ACCESSED) != 0 || !unmapIfUnaccessed) {
+			if (address % k64BitPageTableRange == 0) {
+				entry = X86PagingMethod64Bit::ClearTableEntryFlags(pde,
+					X86_64_PDE_ACCESSED);
+			}
+
+			pinner.Unlock();
+
+			_modified = (entry & X86_64_PDE_DIRTY) != 0;
+
+			if ((entry & X86_64_PDE_ACCESSED) == 0)
+				return false;
+
+			if (address % k64BitPageTableRange == 0) {
+				InvalidatePage(address);
+				Flush();
+			}
+			return true;
+		}
+	}
+
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return false;
 
@@ -843,3 +1004,109 @@ X86VMTranslationMap64Bit::PagingStructures() const
 {
 	return fPagingStructures;
 }
+
+
+/*!	Returns the page directory entry for the given address, if it maps a large
+	page, \c NULL otherwise. The thread must be pinned.
+*/
+uint64*
+X86VMTranslationMap64Bit::_LargePageEntryForAddress(addr_t virtualAddress)
+{
+	if (fLargePageCount == 0)
+		return NULL;
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		false, NULL, fPageMapper, fMapCount);
+	if (pde == NULL || (*pde & (X86_64_PDE_PRESENT | X86_64_PDE_LARGE_PAGE))
+			!= (X86_64_PDE_PRESENT | X86_64_PDE_LARGE_PAGE)) {
+		return NULL;
+	}
+
+	return pde;
+}
+
+
+/*!	Like X86PagingMethod64Bit::PageTableForAddress(), but splits up a large
+	page covering the address first. The thread must be pinned.
+*/
+uint64*
+X86VMTranslationMap64Bit::_PageTableForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation)
+{
+	uint64* pde = _LargePageEntryForAddress(virtualAddress);
+	if (pde != NULL)
+		_DemoteLargePage(pde, virtualAddress);
+
+	return X86PagingMethod64Bit::PageTableForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		allocateTables, reservation, fPageMapper, fMapCount);
+}
+
+
+uint64*
+X86VMTranslationMap64Bit::_PageTableEntryForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation)
+{
+	uint64* pageTable = _PageTableForAddress(virtualAddress, allocateTables,
+		reservation);
+	if (pageTable == NULL)
+		return NULL;
+
+	return &pageTable[VADDR_TO_PTE(virtualAddress)];
+}
+
+
+/*!	Replaces the large page mapped by \a pde with a page table mapping the
+	same physical pages with the same flags, using one of the spare page
+	tables. The thread must be pinned.
+*/
+void
+X86VMTranslationMap64Bit::_DemoteLargePage(uint64* pde, addr_t virtualAddress)
+{
+	RecursiveLocker locker(fLock);
+
+	virtualAddress = ROUNDDOWN(virtualAddress, k64BitPageTableRange);
+
+	TRACE("X86VMTranslationMap64Bit::_DemoteLargePage(%#" B_PRIxADDR ")\n",
+		virtualAddress);
+
+	vm_page* page = fSparePageTables.RemoveHead();
+	if (page == NULL) {
+		panic("X86VMTranslationMap64Bit::_DemoteLargePage(): no spare page "
+			"table for large page at %#" B_PRIxADDR, virtualAddress);
+		return;
+	}
+	fSparePageTableCount--;
+
+	// Remove the large page first and make sure that no CPU uses it anymore,
+	// so that we catch its final accessed and dirty flags.
+	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+	InvalidatePage(virtualAddress);
+	Flush();
+
+	phys_addr_t physicalPageTable
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	uint64* pageTable
+		= (uint64*)fPageMapper->GetPageTableAt(physicalPageTable);
+
+	phys_addr_t physicalAddress
+		= oldEntry & X86_64_PDE_ADDRESS_MASK & ~(k64BitPageTableRange - 1);
+	uint64 flags = oldEntry & (X86_64_PTE_PROTECTION_MASK
+		| X86_64_PTE_MEMORY_TYPE_MASK | X86_64_PTE_ACCESSED | X86_64_PTE_DIRTY
+		| X86_64_PTE_GLOBAL);
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+		X86PagingMethod64Bit::SetTableEntry(&pageTable[i],
+			(physicalAddress + i * B_PAGE_SIZE) | flags | X86_64_PTE_PRESENT);
+	}
+
+	X86PagingMethod64Bit::SetTableEntry(pde,
+		(physicalPageTable & X86_64_PDE_ADDRESS_MASK)
+			| X86_64_PDE_PRESENT
+			| X86_64_PDE_WRITABLE
+			| X86_64_PDE_USER);
+
+	fLargePageCount--;
+	atomic_add(&gMappedLargePagesCount, -1);
+	atomic_add64(&gLargePageDemotions, 1);
+}
@@ -7,6 +7,9 @@
 #define KERNEL_ARCH_X86_PAGING_64BIT_X86_VM_TRANSLATION_MAP_64BIT_H
 
 
+#include <util/DoublyLinkedList.h>
+#include <vm/vm_types.h>
+
 #include "paging/X86VMTranslationMap.h"
 
 
@@ -28,6 +31,12 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 									vm_page_reservation* reservation);
 	virtual	status_t			Unmap(addr_t start, addr_t end);
 
+	virtual	size_t				LargePageSize() const;
+	virtual	status_t			MapLargePage(addr_t virtualAddress,
+									phys_addr_t physicalAddress,
+									uint32 attributes, uint32 memoryType,
+									vm_page_reservation* reservation);
+
 	virtual	status_t			DebugMarkRangePresent(addr_t start, addr_t end,
 									bool markPresent);
 
@@ -61,8 +70,29 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 	inline	X86PagingStructures64Bit* PagingStructures64Bit() const
 									{ return fPagingStructures; }
 
+private:
+			typedef DoublyLinkedList<vm_page,
+				DoublyLinkedListMemberGetLink<vm_page, &vm_page::queue_link> >
+					PageList;
+
+private:
+			uint64*				_LargePageEntryForAddress(
+									addr_t virtualAddress);
+			uint64*				_PageTableForAddress(addr_t virtualAddress,
+									bool allocateTables,
+									vm_page_reservation* reservation);
+			uint64*				_PageTableEntryForAddress(
+									addr_t virtualAddress, bool allocateTables,
+									vm_page_reservation* reservation);
+			void				_DemoteLargePage(uint64* pde,
+									addr_t virtualAddress);
+
 private:
 			X86PagingStructures64Bit* fPagingStructures;
+			PageList			fSparePageTables;
+				// one for each large page, so that it can always be split
+			int32				fSparePageTableCount;
+			int32				fLargePageCount;
 };
 
 
@@ -26,10 +26,17 @@
 
 #include "kernel_debug_config.h"
 
+#if defined(_KERNEL_MODE) && !defined(BUILDING_USERLAND_FS_SERVER)
+#	define BLOCK_CACHE_ASYNC_IO 1
+#	include "IORequest.h"
+#else
+#	define BLOCK_CACHE_ASYNC_IO 0
+#endif
+
 
 // TODO: this is a naive but growing implementation to test the API:
-//	block reading/writing is not at all optimized for speed, it will
-//	just read and write single blocks.
+//	block reading is not at all optimized for speed, it will just read single
+//	blocks.
 // TODO: the retrieval/copy of the original data could be delayed until the
 //		new data must be written, ie. in low memory situations.
 
@@ -48,6 +55,15 @@
 
 static const bigtime_t kTransactionIdleTime = 2000000LL;
 	// a transaction is considered idle after 2 seconds of inactivity
+static const uint32 kBlockShardShift = 4;
+static const uint32 kBlockShardCount = 1 << kBlockShardShift;
+	// number of independently locked partitions of the block hash and the
+	// unused list of each cache
+static const size_t kUnusedWriterBlocks = 64;
+	// Dirty unused blocks are collected with a shard lock held; the writer must
+	// never need to grow (and thus write back on its own) while doing so.
+static const size_t kMaxPrefetchBlocks = 64;
+	// maximum number of blocks read ahead with a single request
 
 
 namespace {
@@ -55,6 +71,7 @@ namespace {
 struct cache_transaction;
 struct cached_block;
 struct block_cache;
+class BlockWriter;
 typedef DoublyLinkedListLink<cached_block> block_link;
 
 struct cached_block {
@@ -81,13 +98,17 @@ struct cached_block {
 #endif
 	int32			ref_count;
 	int32			last_accessed;
-	bool			busy_reading : 1;
+	bool			busy_reading;
+	bool			unused;
+		// The above fields are protected by the lock of the block's shard (and
+		// may be read with the cache lock held if they are only changed with
+		// both locks held, as busy_reading is). They must not share a bit field
+		// with the flags below that are protected by the cache lock only.
 	bool			busy_writing : 1;
 	bool			is_writing : 1;
 		// Block has been checked out for writing without transactions, and
 		// cannot be written back if set
 	bool			is_dirty : 1;
-	bool			unused : 1;
 	bool			discard : 1;
 	bool			busy_reading_waiters : 1;
 	bool			busy_writing_waiters : 1;
@@ -130,12 +151,14 @@ struct BlockHash {
 
 	size_t HashKey(KeyType key) const
 	{
-		return key;
+		// the lower bits select the shard, and are the same for all blocks
+		// in one table
+		return key >> kBlockShardShift;
 	}
 
 	size_t Hash(ValueType* block) const
 	{
-		return block->block_number;
+		return HashKey(block->block_number);
 	}
 
 	bool Compare(KeyType key, ValueType* block) const
@@ -169,8 +192,23 @@ struct TransactionHash {
 typedef BOpenHashTable<TransactionHash> TransactionTable;
 
 
-struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
+/*!	A partition of the blocks of a cache. The hash table may only be changed
+	with both, the cache lock, and the shard lock held, so that either of them
+	is sufficient for lookups. The unused list, and the reference count of its
+	blocks are only protected by the shard lock; this allows blocks to be
+	acquired and released without touching the cache lock at all in the common
+	case (see get_cached_block_fast()).
+*/
+struct block_shard {
+	mutex			lock;
 	BlockTable*		hash;
+	block_list		unused_blocks;
+	uint32			unused_block_count;
+};
+
+
+struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
+	block_shard		shards[kBlockShardCount];
 	mutex			lock;
 	int				fd;
 	off_t			max_blocks;
@@ -180,8 +218,8 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	TransactionTable* transaction_hash;
 
 	object_cache*	buffer_cache;
-	block_list		unused_blocks;
-	uint32			unused_block_count;
+	int32			unused_block_count;
+	uint32			next_reclaim_shard;
 
 	ConditionVariable busy_reading_condition;
 	uint32			busy_reading_count;
@@ -209,6 +247,15 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	block_shard&	ShardFor(off_t blockNumber)
+						{ return shards[blockNumber
+							& (kBlockShardCount - 1)]; }
+	cached_block*	Lookup(off_t blockNumber)
+						{ return ShardFor(blockNumber).hash->Lookup(
+							blockNumber); }
+	void			AddUnused(block_shard& shard, cached_block* block);
+	void			RemoveUnused(block_shard& shard, cached_block* block);
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
 	void			RemoveBlock(cached_block* block);
 	void			DiscardBlock(cached_block* block);
@@ -216,7 +263,10 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 private:
 	static void		_LowMemoryHandler(void* data, uint32 resources,
 						int32 level);
+	int32			_FreeUnusedBlocks(int32 count, int32 minSecondsOld,
+						BlockWriter* writer);
 	cached_block*	_GetUnusedBlock();
+	cached_block*	_GetUnusedBlock(BlockWriter* writer);
 };
 
 struct cache_listener;
@@ -272,6 +322,10 @@ public:
 private:
 			void*				_Data(cached_block* block) const;
 			status_t			_WriteBlock(cached_block* block);
+			void				_WriteRun(size_t first, size_t count);
+			void				_WaitForRun(uint32 index);
+			void				_RunFailed(size_t first, size_t count,
+									status_t status);
 			void				_BlockDone(cached_block* block,
 									cache_transaction* transaction);
 			void				_UnmarkWriting(cached_block* block);
@@ -281,6 +335,16 @@ private:
 
 private:
 	static	const size_t		kBufferSize = 64;
+	static	const size_t		kMaxBlocksPerRun = 32;
+	static	const uint32		kMaxRunsInFlight = 8;
+
+#if BLOCK_CACHE_ASYNC_IO
+			struct write_run {
+				IORequest*		request;
+				size_t			first;
+				size_t			count;
+			};
+#endif
 
 			block_cache*		fCache;
 			cached_block*		fBuffer[kBufferSize];
@@ -291,6 +355,10 @@ private:
 			size_t				fMax;
 			status_t			fStatus;
 			bool				fDeletedTransaction;
+#if BLOCK_CACHE_ASYNC_IO
+			write_run			fRuns[kMaxRunsInFlight];
+			uint32				fRunCount;
+#endif
 };
 
 
@@ -324,6 +392,53 @@ public:
 
 typedef AutoLocker<block_cache, TransactionLocking> TransactionLocker;
 
+
+/*!	The blocks read ahead by a single block_cache_prefetch() call; they are
+	all consecutive, starting at the one in \c blocks[0].
+*/
+struct block_prefetch {
+	block_cache*	cache;
+	size_t			count;
+	cached_block*	blocks[kMaxPrefetchBlocks];
+};
+
+
+/*!	Iterates over all blocks of a cache, one shard after the other.
+	The cache lock must be held, as only that guarantees that none of the hash
+	tables change during the iteration.
+*/
+class BlockIterator {
+public:
+	BlockIterator(block_cache* cache)
+		:
+		fCache(cache),
+		fShard(0),
+		fIterator(cache->shards[0].hash)
+	{
+	}
+
+	bool HasNext()
+	{
+		while (!fIterator.HasNext()) {
+			if (++fShard >= kBlockShardCount)
+				return false;
+
+			fIterator = BlockTable::Iterator(fCache->shards[fShard].hash);
+		}
+		return true;
+	}
+
+	cached_block* Next()
+	{
+		return HasNext() ? fIterator.Next() : NULL;
+	}
+
+private:
+	block_cache*			fCache;
+	uint32					fShard;
+	BlockTable::Iterator	fIterator;
+};
+
 } // namespace
 
 
@@ -1071,6 +1186,10 @@ BlockWriter::BlockWriter(block_cache* cache, size_t max)
 	fMax(max),
 	fStatus(B_OK),
 	fDeletedTransaction(false)
+#if BLOCK_CACHE_ASYNC_IO
+	,
+	fRunCount(0)
+#endif
 {
 }
 
@@ -1174,25 +1293,29 @@ BlockWriter::Write(cache_transaction* transaction, bool canUnlock)
 	if (canUnlock)
 		mutex_unlock(&fCache->lock);
 
-	// Sort blocks in their on-disk order
-	// TODO: ideally, this should be handled by the I/O scheduler
+	// Sort blocks in their on-disk order, so that physically adjacent blocks
+	// can be written back with a single request
 
 	qsort(fBlocks, fCount, sizeof(void*), &_CompareBlocks);
 	fDeletedTransaction = false;
 
-	for (uint32 i = 0; i < fCount; i++) {
-		status_t status = _WriteBlock(fBlocks[i]);
-		if (status != B_OK) {
-			// propagate to global error handling
-			if (fStatus == B_OK)
-				fStatus = status;
-
-			_UnmarkWriting(fBlocks[i]);
-			fBlocks[i] = NULL;
-				// This block will not be marked clean
+	for (size_t i = 0; i < fCount;) {
+		off_t first = fBlocks[i]->block_number;
+		size_t count = 1;
+		while (i + count < fCount && count < kMaxBlocksPerRun
+			&& fBlocks[i + count]->block_number == first + (off_t)count) {
+			count++;
 		}
+
+		_WriteRun(i, count);
+		i += count;
 	}
 
+#if BLOCK_CACHE_ASYNC_IO
+	while (fRunCount > 0)
+		_WaitForRun(0);
+#endif
+
 	if (canUnlock)
 		mutex_lock(&fCache->lock);
 
@@ -1220,6 +1343,130 @@ BlockWriter::WriteBlock(block_cache* cache, cached_block* block)
 }
 
 
+/*!	Writes back the \a count physically adjacent blocks starting at index
+	\a first. If possible, this is done with a single asynchronous I/O request
+	through the device's I/O scheduler; up to kMaxRunsInFlight of them are
+	kept in flight before this method starts waiting for the oldest one.
+	Failed blocks are removed from the array, and won't be marked clean.
+*/
+void
+BlockWriter::_WriteRun(size_t first, size_t count)
+{
+#if BLOCK_CACHE_ASYNC_IO
+	if (fRunCount == kMaxRunsInFlight)
+		_WaitForRun(0);
+
+	size_t blockSize = fCache->block_size;
+	generic_io_vec vecs[kMaxBlocksPerRun];
+
+	for (size_t i = 0; i < count; i++) {
+		cached_block* block = fBlocks[first + i];
+		ASSERT(block->busy_writing);
+
+		TRACE(("BlockWriter::_WriteRun(block %" B_PRIdOFF ")\n",
+			block->block_number));
+		TB(Write(fCache, block));
+		TB2(BlockData(fCache, block, "before write"));
+
+		vecs[i].base = (generic_addr_t)_Data(block);
+		vecs[i].length = blockSize;
+	}
+
+	IORequest* request = IORequest::Create(false);
+	status_t status = request != NULL
+		? request->Init(fBlocks[first]->block_number * blockSize, vecs, count,
+			count * blockSize, true, 0)
+		: B_NO_MEMORY;
+	size_t written = 0;
+	if (status == B_OK) {
+		status = do_fd_io(fCache->fd, request);
+		if (status != B_OK && request->IsFinished()) {
+			// The request failed while it was processed, and has already
+			// been notified; the blocks it transferred until then are on
+			// disk, and must not be written again
+			written = request->TransferredBytes() / blockSize;
+			if (written > count)
+				written = count;
+		}
+	}
+
+	if (status != B_OK) {
+		delete request;
+
+		// The device might not support requests at all (or we are out of
+		// memory); write the remaining blocks back synchronously instead
+		for (size_t i = written; i < count; i++) {
+			status = _WriteBlock(fBlocks[first + i]);
+			if (status != B_OK)
+				_RunFailed(first + i, 1, status);
+		}
+		return;
+	}
+
+	write_run& run = fRuns[fRunCount++];
+	run.request = request;
+	run.first = first;
+	run.count = count;
+#else
+	for (size_t i = first; i < first + count; i++) {
+		status_t status = _WriteBlock(fBlocks[i]);
+		if (status != B_OK)
+			_RunFailed(i, 1, status);
+	}
+#endif
+}
+
+
+#if BLOCK_CACHE_ASYNC_IO
+/*!	Waits for the run at \a index in the in-flight list to be finished, and
+	removes it from that list.
+*/
+void
+BlockWriter::_WaitForRun(uint32 index)
+{
+	write_run run = fRuns[index];
+	memmove(&fRuns[index], &fRuns[index + 1],
+		(fRunCount - index - 1) * sizeof(write_run));
+	fRunCount--;
+
+	status_t status = run.request->Wait();
+	size_t blockSize = fCache->block_size;
+	size_t written = run.request->TransferredBytes() / blockSize;
+	delete run.request;
+
+	if (status == B_OK && written >= run.count)
+		return;
+
+	if (written > run.count)
+		written = run.count;
+
+	TB(Error(fCache, fBlocks[run.first + written]->block_number,
+		"write failed", status));
+	TRACE_ALWAYS(("could not write back block %" B_PRIdOFF " (%s)\n",
+		fBlocks[run.first + written]->block_number,
+		strerror(status != B_OK ? status : B_IO_ERROR)));
+
+	_RunFailed(run.first + written, run.count - written,
+		status != B_OK ? status : B_IO_ERROR);
+}
+#endif	// BLOCK_CACHE_ASYNC_IO
+
+
+void
+BlockWriter::_RunFailed(size_t first, size_t count, status_t status)
+{
+	// propagate to global error handling
+	if (fStatus == B_OK)
+		fStatus = status;
+
+	for (size_t i = first; i < first + count; i++) {
+		_UnmarkWriting(fBlocks[i]);
+		fBlocks[i] = NULL;
+			// This block will not be marked clean
+	}
+}
+
+
 void*
 BlockWriter::_Data(cached_block* block) const
 {
@@ -1307,12 +1554,15 @@ BlockWriter::_BlockDone(cached_block* block,
 			fDeletedTransaction = true;
 		}
 	}
-	if (block->transaction == NULL && block->ref_count == 0 && !block->unused) {
-		// the block is no longer used
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
+	if (block->transaction == NULL) {
+		block_shard& shard = fCache->ShardFor(block->block_number);
+		MutexLocker shardLocker(shard.lock);
+
+		if (block->ref_count == 0 && !block->unused) {
+			// the block is no longer used
+			ASSERT(block->original_data == NULL && block->parent_data == NULL);
+			fCache->AddUnused(shard, block);
+		}
 	}
 
 	TB2(BlockData(fCache, block, "after write"));
@@ -1356,7 +1606,6 @@ BlockWriter::_CompareBlocks(const void* _blockA, const void* _blockB)
 block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
-	hash(NULL),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1365,6 +1614,7 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	transaction_hash(NULL),
 	buffer_cache(NULL),
 	unused_block_count(0),
+	next_reclaim_shard(0),
 	busy_reading_count(0),
 	busy_reading_waiters(false),
 	busy_writing_count(0),
@@ -1381,7 +1631,11 @@ block_cache::~block_cache()
 	unregister_low_resource_handler(&_LowMemoryHandler, this);
 
 	delete transaction_hash;
-	delete hash;
+
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		delete shards[i].hash;
+		mutex_destroy(&shards[i].lock);
+	}
 
 	delete_object_cache(buffer_cache);
 
@@ -1397,14 +1651,24 @@ block_cache::Init()
 	condition_variable.Init(this, "cache transaction sync");
 	mutex_init(&lock, "block cache");
 
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		block_shard& shard = shards[i];
+		mutex_init(&shard.lock, "block cache shard");
+		shard.unused_block_count = 0;
+		shard.hash = NULL;
+	}
+
 	buffer_cache = create_object_cache_etc("block cache buffers", block_size,
 		8, 0, 0, 0, CACHE_LARGE_SLAB, NULL, NULL, NULL, NULL);
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	hash = new BlockTable();
-	if (hash == NULL || hash->Init(1024) != B_OK)
-		return B_NO_MEMORY;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		shards[i].hash = new(std::nothrow) BlockTable();
+		if (shards[i].hash == NULL
+			|| shards[i].hash->Init(1024 / kBlockShardCount) != B_OK)
+			return B_NO_MEMORY;
+	}
 
 	transaction_hash = new(std::nothrow) TransactionTable();
 	if (transaction_hash == NULL || transaction_hash->Init(16) != B_OK)
@@ -1478,7 +1742,7 @@ block_cache::NewBlock(off_t blockNumber)
 		} else {
 			TB(Error(this, blockNumber, "allocation failed"));
 			dprintf("block allocation failed, unused list is %sempty.\n",
-				unused_blocks.IsEmpty() ? "" : "not ");
+				unused_block_count == 0 ? "" : "not ");
 
 			// allocation failed, try to reuse an unused block
 			block = _GetUnusedBlock();
@@ -1498,10 +1762,10 @@ block_cache::NewBlock(off_t blockNumber)
 	block->original_data = NULL;
 	block->parent_data = NULL;
 	block->busy_reading = false;
+	block->unused = false;
 	block->busy_writing = false;
 	block->is_writing = false;
 	block->is_dirty = false;
-	block->unused = false;
 	block->discard = false;
 	block->busy_reading_waiters = false;
 	block->busy_writing_waiters = false;
@@ -1523,47 +1787,63 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+/*!	Adds the \a block to the unused list of its \a shard.
+	The shard must be locked.
+*/
 void
-block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
+block_cache::AddUnused(block_shard& shard, cached_block* block)
 {
-	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(!block->unused);
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
-		}
-		if (block->busy_reading || block->busy_writing)
-			continue;
+	block->unused = true;
+	shard.unused_blocks.Add(block);
+	shard.unused_block_count++;
+	atomic_add(&unused_block_count, 1);
+}
 
-		TB(Flush(this, block));
-		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
-			block->block_number, block->last_accessed));
 
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->discard) {
-			if (block->busy_writing)
-				continue;
+/*!	Removes the \a block from the unused list of its \a shard.
+	The shard must be locked.
+*/
+void
+block_cache::RemoveUnused(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(block->unused);
 
-			BlockWriter::WriteBlock(this, block);
-		}
+	block->unused = false;
+	shard.unused_blocks.Remove(block);
+	shard.unused_block_count--;
+	atomic_add(&unused_block_count, -1);
+}
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
 
-		if (--count <= 0)
-			break;
-	}
+void
+block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
+{
+	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
+
+	// Dirty blocks are written back before they are freed; since we cannot
+	// do any I/O with a shard locked, they are collected first, and freed in
+	// a second pass after they have been written.
+	BlockWriter writer(this, kUnusedWriterBlocks);
+	count = _FreeUnusedBlocks(count, minSecondsOld, &writer);
+
+	if (writer.Write() == B_OK && count > 0)
+		_FreeUnusedBlocks(count, minSecondsOld, NULL);
 }
 
 
 void
 block_cache::RemoveBlock(cached_block* block)
 {
-	hash->Remove(block);
+	block_shard& shard = ShardFor(block->block_number);
+
+	mutex_lock(&shard.lock);
+	shard.hash->Remove(block);
+	mutex_unlock(&shard.lock);
+
 	FreeBlock(block);
 }
 
@@ -1627,42 +1907,121 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 	}
 
 #ifdef TRACE_BLOCK_CACHE
-	uint32 oldUnused = cache->unused_block_count;
+	int32 oldUnused = cache->unused_block_count;
 #endif
 
 	cache->RemoveUnusedBlocks(free, secondsOld);
 
-	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRIu32 " -> %" B_PRIu32 "\n",
+	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRId32 " -> %" B_PRId32 "\n",
 		cache, oldUnused, cache->unused_block_count));
 }
 
 
+/*!	Frees up to \a count unused blocks that have not been accessed for at
+	least \a minSecondsOld seconds, going through the shards in a round robin
+	fashion. Dirty blocks are added to the \a writer instead, if one is given.
+	Returns the number of blocks that are left to be freed.
+*/
+int32
+block_cache::_FreeUnusedBlocks(int32 count, int32 minSecondsOld,
+	BlockWriter* writer)
+{
+	uint32 firstShard = next_reclaim_shard++;
+
+	for (uint32 i = 0; i < kBlockShardCount && count > 0; i++) {
+		block_shard& shard = shards[(firstShard + i) % kBlockShardCount];
+		MutexLocker shardLocker(shard.lock);
+
+		for (block_list::Iterator iterator = shard.unused_blocks.GetIterator();
+				cached_block* block = iterator.Next();) {
+			if (minSecondsOld >= block->LastAccess()) {
+				// The list is sorted by last access
+				break;
+			}
+			if (block->busy_reading || block->busy_writing)
+				continue;
+
+			// this can only happen if no transactions are used
+			if (block->is_dirty && !block->discard) {
+				if (writer != NULL && !writer->Add(block))
+					writer = NULL;
+				continue;
+			}
+
+			TB(Flush(this, block));
+			TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32
+				"\n", block->block_number, block->last_accessed));
+
+			// remove block from lists
+			RemoveUnused(shard, block);
+			shard.hash->Remove(block);
+			FreeBlock(block);
+
+			if (--count <= 0)
+				break;
+		}
+	}
+
+	return count;
+}
+
+
 cached_block*
 block_cache::_GetUnusedBlock()
 {
 	TRACE(("block_cache: get unused block\n"));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		TB(Flush(this, block, true));
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
-			BlockWriter::WriteBlock(this, block);
+	BlockWriter writer(this, kUnusedWriterBlocks);
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash->Remove(block);
+	cached_block* block = _GetUnusedBlock(&writer);
+	if (block == NULL && writer.Write() == B_OK) {
+		// there were only dirty blocks, try again now that they are written
+		block = _GetUnusedBlock(NULL);
+	}
+
+	return block;
+}
 
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
 
-		// TODO: see if compare data is handled correctly here!
+/*!	Removes the first clean unused block of any shard from the cache, and
+	returns it. Dirty unused blocks are added to the \a writer, if given.
+*/
+cached_block*
+block_cache::_GetUnusedBlock(BlockWriter* writer)
+{
+	uint32 firstShard = next_reclaim_shard++;
+
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		block_shard& shard = shards[(firstShard + i) % kBlockShardCount];
+		MutexLocker shardLocker(shard.lock);
+
+		for (block_list::Iterator iterator = shard.unused_blocks.GetIterator();
+				cached_block* block = iterator.Next();) {
+			if (block->busy_reading || block->busy_writing)
+				continue;
+
+			// this can only happen if no transactions are used
+			if (block->is_dirty && !block->discard) {
+				if (writer != NULL && !writer->Add(block))
+					writer = NULL;
+				continue;
+			}
+
+			TB(Flush(this, block, true));
+
+			// remove block from lists
+			RemoveUnused(shard, block);
+			shard.hash->Remove(block);
+
+			ASSERT(block->original_data == NULL && block->parent_data == NULL);
+
+			// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
-		if (block->compare != NULL)
-			Free(block->compare);
+			if (block->compare != NULL)
+				Free(block->compare);
 #endif
-		return block;
+			return block;
+		}
 	}
 
 	return NULL;
@@ -1672,22 +2031,32 @@ block_cache::_GetUnusedBlock()
 //	#pragma mark - private block functions
 
 
-/*!	Cache must be locked.
+/*!	Cache must be locked, the block's shard must not.
 */
 static void
 mark_block_busy_reading(block_cache* cache, cached_block* block)
 {
+	block_shard& shard = cache->ShardFor(block->block_number);
+
+	mutex_lock(&shard.lock);
 	block->busy_reading = true;
+	mutex_unlock(&shard.lock);
+
 	cache->busy_reading_count++;
 }
 
 
-/*!	Cache must be locked.
+/*!	Cache must be locked, the block's shard must not.
 */
 static void
 mark_block_unbusy_reading(block_cache* cache, cached_block* block)
 {
+	block_shard& shard = cache->ShardFor(block->block_number);
+
+	mutex_lock(&shard.lock);
 	block->busy_reading = false;
+	mutex_unlock(&shard.lock);
+
 	cache->busy_reading_count--;
 
 	if ((cache->busy_reading_waiters && cache->busy_reading_count == 0)
@@ -1700,11 +2069,13 @@ mark_block_unbusy_reading(block_cache* cache, cached_block* block)
 
 
 /*!	Cache must be locked.
+	Since the block might be removed from the cache if reading it failed, this
+	only waits once; the caller has to look the block up again afterwards.
 */
 static void
 wait_for_busy_reading_block(block_cache* cache, cached_block* block)
 {
-	while (block->busy_reading) {
+	if (block->busy_reading) {
 		// wait for at least the specified block to be read in
 		ConditionVariableEntry entry;
 		cache->busy_reading_condition.Add(&entry);
@@ -1803,6 +2174,9 @@ put_cached_block(block_cache* cache, cached_block* block)
 #endif
 	TB(Put(cache, block));
 
+	block_shard& shard = cache->ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->ref_count < 1) {
 		panic("Invalid ref_count for block %p, cache %p\n", block, cache);
 		return;
@@ -1814,15 +2188,14 @@ put_cached_block(block_cache* cache, cached_block* block)
 		block->is_writing = false;
 
 		if (block->discard) {
-			cache->RemoveBlock(block);
+			shard.hash->Remove(block);
+			shardLocker.Unlock();
+
+			cache->FreeBlock(block);
 		} else {
 			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
-			block->unused = true;
-
 			ASSERT(block->original_data == NULL && block->parent_data == NULL);
-			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
+			cache->AddUnused(shard, block);
 		}
 	}
 }
@@ -1836,7 +2209,7 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 			blockNumber, cache->max_blocks - 1);
 	}
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block != NULL)
 		put_cached_block(cache, block);
 	else {
@@ -1845,6 +2218,60 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 }
 
 
+/*!	Removes a reference from the block \a blockNumber without acquiring the
+	cache lock. This only works if it isn't the last reference, as only the
+	last one needs to look at the transaction state of the block.
+	Returns \c false if the caller must use put_cached_block() instead.
+*/
+static bool
+put_cached_block_fast(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	return false;
+#else
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash->Lookup(blockNumber);
+	if (block == NULL || block->ref_count < 2)
+		return false;
+
+	TB(Put(cache, block));
+	block->ref_count--;
+	return true;
+#endif
+}
+
+
+/*!	Retrieves the block \a blockNumber from the hash table if that can be done
+	without acquiring the cache lock, that is, if the block is either in the
+	unused list, or already referenced by someone else. Blocks that are being
+	read, or that are in any other state only the cache lock may change, are
+	left to get_cached_block().
+	Returns \c NULL if the caller must use get_cached_block() instead.
+*/
+static cached_block*
+get_cached_block_fast(block_cache* cache, off_t blockNumber)
+{
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash->Lookup(blockNumber);
+	if (block == NULL || block->busy_reading)
+		return NULL;
+
+	if (block->unused)
+		cache->RemoveUnused(shard, block);
+	else if (block->ref_count == 0)
+		return NULL;
+
+	block->ref_count++;
+	block->last_accessed = system_time() / 1000000L;
+
+	return block;
+}
+
+
 /*!	Retrieves the block \a blockNumber from the hash table, if it's already
 	there, or reads it from the disk.
 	You need to have the cache locked when calling this function.
@@ -1853,8 +2280,9 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
 		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
-		block is read in.
+		data; it is left marked busy if it was allocated, and you need to call
+		mark_block_unbusy_reading() once it has valid contents. If \c true,
+		the cache will be temporarily unlocked while the block is read in.
 */
 static cached_block*
 get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
@@ -1868,44 +2296,75 @@ get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
 		return NULL;
 	}
 
+	block_shard& shard = cache->ShardFor(blockNumber);
+
 retry:
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	mutex_lock(&shard.lock);
+
+	cached_block* block = shard.hash->Lookup(blockNumber);
 	*_allocated = false;
 
 	if (block == NULL) {
-		// put block into cache
+		// put block into cache; allocating it might need to temporarily
+		// unlock the cache, so we have to check again afterwards
+		mutex_unlock(&shard.lock);
+
 		block = cache->NewBlock(blockNumber);
 		if (block == NULL)
 			return NULL;
 
-		cache->hash->Insert(block);
+		mutex_lock(&shard.lock);
+
+		if (shard.hash->Lookup(blockNumber) != NULL) {
+			mutex_unlock(&shard.lock);
+			cache->FreeBlock(block);
+			goto retry;
+		}
+
+		// mark the block busy before anyone else can see it
+		block->busy_reading = true;
+		cache->busy_reading_count++;
+
+		shard.hash->Insert(block);
 		*_allocated = true;
 	} else if (block->busy_reading) {
 		// The block is currently busy_reading - wait and try again later
+		mutex_unlock(&shard.lock);
+
 		wait_for_busy_reading_block(cache, block);
 		goto retry;
 	}
 
 	if (block->unused) {
 		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
-		cache->unused_blocks.Remove(block);
-		cache->unused_block_count--;
+		cache->RemoveUnused(shard, block);
 	}
 
+	block->ref_count++;
+	block->last_accessed = system_time() / 1000000L;
+
+	mutex_unlock(&shard.lock);
+
 	if (*_allocated && readBlock) {
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
 			block->current_data, blockSize);
 
 		mutex_lock(&cache->lock);
+
 		if (bytesRead < blockSize) {
-			cache->RemoveBlock(block);
+			// remove the block before anyone else can get hold of it
+			mutex_lock(&shard.lock);
+			shard.hash->Remove(block);
+			mutex_unlock(&shard.lock);
+
+			mark_block_unbusy_reading(cache, block);
+			cache->FreeBlock(block);
+
 			TB(Error(cache, blockNumber, "read failed", bytesRead));
 
 			TRACE_ALWAYS(("could not read block %" B_PRIdOFF ": bytesRead: %zd, error: %s\n",
@@ -1917,13 +2376,66 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->ref_count++;
-	block->last_accessed = system_time() / 1000000L;
-
 	return block;
 }
 
 
+/*!	Finishes a prefetch: the first \a readCount blocks of it have been read
+	successfully, and are added to the unused list, the others are removed
+	from the cache again. Frees the \a prefetch.
+	The cache must not be locked.
+*/
+static void
+finish_prefetch(block_prefetch* prefetch, size_t readCount)
+{
+	block_cache* cache = prefetch->cache;
+	MutexLocker locker(&cache->lock);
+
+	for (size_t i = 0; i < prefetch->count; i++) {
+		cached_block* block = prefetch->blocks[i];
+		block_shard& shard = cache->ShardFor(block->block_number);
+
+		mutex_lock(&shard.lock);
+
+		if (i < readCount && !block->discard) {
+			// Nobody could have acquired the block while it was busy
+			TB(Read(cache, block));
+			block->last_accessed = system_time() / 1000000L;
+			cache->AddUnused(shard, block);
+			mutex_unlock(&shard.lock);
+
+			mark_block_unbusy_reading(cache, block);
+		} else {
+			shard.hash->Remove(block);
+			mutex_unlock(&shard.lock);
+
+			mark_block_unbusy_reading(cache, block);
+			cache->FreeBlock(block);
+		}
+	}
+
+	locker.Unlock();
+	delete prefetch;
+}
+
+
+#if BLOCK_CACHE_ASYNC_IO
+static status_t
+prefetch_io_finished(void* data, io_request* request, status_t status,
+	bool partialTransfer, generic_size_t transferEndOffset)
+{
+	block_prefetch* prefetch = (block_prefetch*)data;
+
+	size_t readCount = prefetch->count;
+	if (status != B_OK || partialTransfer)
+		readCount = transferEndOffset / prefetch->cache->block_size;
+
+	finish_prefetch(prefetch, readCount);
+	return B_OK;
+}
+#endif
+
+
 /*!	Returns the writable block data for the requested blockNumber.
 	If \a cleared is true, the block is not read from disk; an empty block
 	is returned.
@@ -1949,6 +2461,17 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 	if (block == NULL)
 		return NULL;
 
+	if (allocated && cleared) {
+		// get_cached_block() left the new block busy, so that no one else
+		// can see its random contents before they have been cleared
+		mutex_unlock(&cache->lock);
+
+		memset(block->current_data, 0, cache->block_size);
+
+		mutex_lock(&cache->lock);
+		mark_block_unbusy_reading(cache, block);
+	}
+
 	if (block->busy_writing)
 		wait_for_busy_writing_block(cache, block);
 
@@ -1956,7 +2479,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
-		if (cleared) {
+		if (cleared && !allocated) {
 			mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
@@ -2059,7 +2582,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		&& block->parent_data == NULL && wasUnchanged)
 		transaction->sub_num_blocks++;
 
-	if (cleared) {
+	if (cleared && !allocated) {
 		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
@@ -2192,7 +2715,7 @@ dump_cache(int argc, char** argv)
 	off_t blockNumber = -1;
 	if (i + 1 < argc) {
 		blockNumber = parse_expression(argv[i + 1]);
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL)
 			dump_block_long(block);
 		else
@@ -2252,7 +2775,7 @@ dump_cache(int argc, char** argv)
 	uint32 count = 0;
 	uint32 dirty = 0;
 	uint32 discarded = 0;
-	BlockTable::Iterator iterator(cache->hash);
+	BlockIterator iterator(cache);
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
 		if (showBlocks)
@@ -2268,7 +2791,7 @@ dump_cache(int argc, char** argv)
 	}
 
 	kprintf(" %" B_PRIu32 " blocks total, %" B_PRIu32 " dirty, %" B_PRIu32
-		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRIu32
+		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRId32
 		" in unused.\n",
 		count, dirty, discarded, referenced, cache->busy_reading_count,
 		cache->unused_block_count);
@@ -2543,7 +3066,7 @@ block_notifier_and_writer(void* /*data*/)
 			if (cache->num_dirty_blocks) {
 				// This cache is not using transactions, we'll scan the blocks
 				// directly
-				BlockTable::Iterator iterator(cache->hash);
+				BlockIterator iterator(cache);
 
 				while (iterator.HasNext()) {
 					cached_block* block = iterator.Next();
@@ -3066,11 +3589,12 @@ cache_abort_sub_transaction(void* _cache, int32 id)
 				block->original_data = NULL;
 				block->is_dirty = false;
 
+				block_shard& shard = cache->ShardFor(block->block_number);
+				MutexLocker shardLocker(shard.lock);
+
 				if (block->ref_count == 0) {
 					// Move the block into the unused list if possible
-					block->unused = true;
-					cache->unused_blocks.Add(block);
-					cache->unused_block_count++;
+					cache->AddUnused(shard, block);
 				}
 			}
 		} else {
@@ -3324,11 +3848,13 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
-	cached_block* block = cache->hash->Clear(true);
-	while (block != NULL) {
-		cached_block* next = block->next;
-		cache->FreeBlock(block);
-		block = next;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		cached_block* block = cache->shards[i].hash->Clear(true);
+		while (block != NULL) {
+			cached_block* next = block->next;
+			cache->FreeBlock(block);
+			block = next;
+		}
 	}
 
 	// free all transactions (they will all be aborted)
@@ -3375,7 +3901,7 @@ block_cache_sync(void* _cache)
 	MutexLocker locker(&cache->lock);
 
 	BlockWriter writer(cache);
-	BlockTable::Iterator iterator(cache->hash);
+	BlockIterator iterator(cache);
 
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
@@ -3413,7 +3939,7 @@ block_cache_sync_etc(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (; numBlocks > 0; numBlocks--, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
@@ -3447,7 +3973,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL && block->previous_transaction != NULL)
 			writer.Add(block);
 	}
@@ -3459,17 +3985,24 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 		// reset blockNumber to its original value
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
 		ASSERT(block->previous_transaction == NULL);
 
+		block_shard& shard = cache->ShardFor(blockNumber);
+		MutexLocker shardLocker(shard.lock);
+
 		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
-			cache->RemoveBlock(block);
+			cache->RemoveUnused(shard, block);
+			shard.hash->Remove(block);
+			shardLocker.Unlock();
+
+			cache->FreeBlock(block);
 		} else {
+			shardLocker.Unlock();
+
 			if (block->transaction != NULL && block->parent_data != NULL
 				&& block->parent_data != block->current_data) {
 				panic("Discarded block %" B_PRIdOFF " has already been changed in this "
@@ -3551,6 +4084,19 @@ const void*
 block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	// Most blocks asked for are already in the cache, and can be retrieved
+	// without contending for the cache lock
+	{
+		cached_block* block = get_cached_block_fast(cache, blockNumber);
+		if (block != NULL) {
+			TB(Get(cache, block));
+			return block->current_data;
+		}
+	}
+#endif
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
@@ -3577,6 +4123,138 @@ block_cache_get(void* _cache, off_t blockNumber)
 }
 
 
+/*!	Starts reading the \a _numBlocks blocks beginning with \a blockNumber
+	into the cache, and returns without waiting for them; a later
+	block_cache_get() of one of them will then only wait for the pending read,
+	if at all.
+	Blocks at the start of the range that are already cached are skipped, and
+	reading stops at the next cached block, so that only a single request is
+	issued. \a _numBlocks is set to the number of blocks that have been
+	handled this way; the caller may continue after them.
+	The blocks are not referenced, and end up in the unused list, where they
+	can be reclaimed like any other block that is no longer in use.
+*/
+status_t
+block_cache_prefetch(void* _cache, off_t blockNumber, size_t* _numBlocks)
+{
+	block_cache* cache = (block_cache*)_cache;
+	size_t numBlocks = *_numBlocks;
+	*_numBlocks = 0;
+
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return B_BAD_VALUE;
+
+	if (numBlocks > kMaxPrefetchBlocks)
+		numBlocks = kMaxPrefetchBlocks;
+	if (blockNumber + (off_t)numBlocks > cache->max_blocks)
+		numBlocks = cache->max_blocks - blockNumber;
+
+	// Reading ahead must not cause other blocks to be thrown out
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY
+			| B_KERNEL_RESOURCE_ADDRESS_SPACE) != B_NO_LOW_RESOURCE) {
+		return B_NO_MEMORY;
+	}
+
+	block_prefetch* prefetch = new(std::nothrow) block_prefetch;
+	if (prefetch == NULL)
+		return B_NO_MEMORY;
+
+	prefetch->cache = cache;
+	prefetch->count = 0;
+
+	MutexLocker locker(&cache->lock);
+
+	// skip the blocks that are already there
+	size_t skipped = 0;
+	for (; skipped < numBlocks; skipped++, blockNumber++) {
+		block_shard& shard = cache->ShardFor(blockNumber);
+		MutexLocker shardLocker(shard.lock);
+		if (shard.hash->Lookup(blockNumber) == NULL)
+			break;
+	}
+	numBlocks -= skipped;
+
+	while (prefetch->count < numBlocks) {
+		off_t number = blockNumber + prefetch->count;
+		block_shard& shard = cache->ShardFor(number);
+
+		mutex_lock(&shard.lock);
+		cached_block* block = shard.hash->Lookup(number);
+		mutex_unlock(&shard.lock);
+		if (block != NULL)
+			break;
+
+		block = cache->NewBlock(number);
+		if (block == NULL)
+			break;
+
+		mutex_lock(&shard.lock);
+		if (shard.hash->Lookup(number) != NULL) {
+			mutex_unlock(&shard.lock);
+			cache->FreeBlock(block);
+			break;
+		}
+
+		// mark the block busy before anyone else can see it
+		block->busy_reading = true;
+		cache->busy_reading_count++;
+
+		shard.hash->Insert(block);
+		mutex_unlock(&shard.lock);
+
+		prefetch->blocks[prefetch->count++] = block;
+	}
+
+	locker.Unlock();
+
+	size_t count = prefetch->count;
+	*_numBlocks = skipped + count;
+
+	if (count == 0) {
+		delete prefetch;
+		return B_OK;
+	}
+
+	size_t blockSize = cache->block_size;
+
+#if BLOCK_CACHE_ASYNC_IO
+	generic_io_vec vecs[kMaxPrefetchBlocks];
+	for (size_t i = 0; i < count; i++) {
+		vecs[i].base = (generic_addr_t)prefetch->blocks[i]->current_data;
+		vecs[i].length = blockSize;
+	}
+
+	IORequest* request = IORequest::Create(false);
+	status_t status = request != NULL
+		? request->Init(blockNumber * blockSize, vecs, count,
+			count * blockSize, false, B_DELETE_IO_REQUEST)
+		: B_NO_MEMORY;
+	if (status == B_OK) {
+		// from here on, the callback takes care of the blocks, even if the
+		// request fails right away
+		request->SetFinishedCallback(&prefetch_io_finished, prefetch);
+		do_fd_io(cache->fd, request);
+		return B_OK;
+	}
+
+	delete request;
+#endif
+
+	// read the blocks synchronously instead
+	size_t readCount = 0;
+	for (; readCount < count; readCount++) {
+		ssize_t bytesRead = read_pos(cache->fd,
+			(blockNumber + readCount) * blockSize,
+			prefetch->blocks[readCount]->current_data, blockSize);
+		if (bytesRead < (ssize_t)blockSize)
+			break;
+	}
+
+	finish_prefetch(prefetch, readCount);
+	return B_OK;
+}
+
+
 /*!	Changes the internal status of a writable block to \a dirty. This can be
 	helpful in case you realize you don't need to change that block anymore
 	for whatever reason.
@@ -3591,7 +4269,7 @@ block_cache_set_dirty(void* _cache, off_t blockNumber, bool dirty,
 	block_cache* cache = (block_cache*)_cache;
 	MutexLocker locker(&cache->lock);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block == NULL)
 		return B_BAD_VALUE;
 	if (block->is_dirty == dirty) {
@@ -3611,6 +4289,10 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+	if (put_cached_block_fast(cache, blockNumber))
+		return;
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
@@ -42,6 +42,23 @@
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
 
+// read-ahead parameters
+#define READ_AHEAD_STREAMS	4
+static const size_t kMinReadAhead = 4 * B_PAGE_SIZE;
+static const size_t kInitialReadAhead = 16 * B_PAGE_SIZE;
+static const size_t kMaxReadAhead = 1024 * 1024;
+
+struct read_ahead_stream {
+	off_t			next_offset;
+		// where the next read of this stream is expected
+	off_t			end;
+		// end of the data that has already been read ahead
+	uint32			window;
+		// current read-ahead size, 0 as long as the stream has not been
+		// accessed sequentially
+	uint32			last_used;
+};
+
 struct file_cache_ref {
 	VMCache			*cache;
 	struct vnode	*vnode;
@@ -51,6 +68,9 @@ struct file_cache_ref {
 		//	write vs. read)
 	int32			last_access_index;
 	uint16			disabled_count;
+	read_ahead_stream read_ahead[READ_AHEAD_STREAMS];
+	uint32			read_count;
+		// The read-ahead state is protected by the cache lock
 
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
@@ -181,7 +201,7 @@ PrecacheIO::ReadAsync()
 	// This object is going to be deleted after the I/O request has been
 	// fulfilled
 	vfs_asynchronous_read_pages(fRef->vnode, NULL, fOffset, fVecs, fVecCount,
-		fSize, B_PHYSICAL_IO_REQUEST, this);
+		fSize, B_PHYSICAL_IO_REQUEST | B_BACKGROUND_IO_REQUEST, this);
 }
 
 
@@ -282,6 +302,84 @@ push_access(file_cache_ref* ref, off_t offset, generic_size_t bytes,
 }
 
 
+/*!	Assigns a read of \a size bytes at \a offset to one of the read-ahead
+	streams of the file, and adapts the stream's read-ahead window: it grows
+	with every sequential read that finds its data already in the cache, and
+	shrinks if the data that has been read ahead was evicted before it could
+	be used.
+	If more data should be read ahead, the range is returned in \a _offset
+	and \a _size, otherwise \a _size is set to \c 0.
+	The cache must be locked, and must not have been changed by the read yet.
+*/
+static void
+update_read_ahead(file_cache_ref* ref, off_t offset, size_t size,
+	off_t& _offset, size_t& _size)
+{
+	_size = 0;
+
+	off_t end = offset + size;
+	uint32 readCount = ++ref->read_count;
+	read_ahead_stream* stream = NULL;
+	read_ahead_stream* oldest = NULL;
+
+	for (int32 i = 0; i < READ_AHEAD_STREAMS; i++) {
+		read_ahead_stream* current = &ref->read_ahead[i];
+		if (current->last_used != 0
+			&& offset >= current->next_offset - B_PAGE_SIZE
+			&& offset <= current->next_offset + B_PAGE_SIZE) {
+			stream = current;
+			break;
+		}
+		if (oldest == NULL || current->last_used < oldest->last_used)
+			oldest = current;
+	}
+
+	if (stream == NULL) {
+		// This is either a random access, or the start of a new stream; we
+		// replace the least recently used stream with it
+		oldest->next_offset = end;
+		oldest->end = end;
+		oldest->window = 0;
+		oldest->last_used = readCount;
+		return;
+	}
+
+	stream->next_offset = end;
+	stream->last_used = readCount;
+
+	if (stream->window == 0) {
+		// the second sequential read in a row
+		stream->window = kInitialReadAhead;
+	} else if (offset < stream->end) {
+		// we've read ahead this part before -- check if it has been used
+		if (ref->cache->LookupPage(ROUNDDOWN(offset, B_PAGE_SIZE)) == NULL) {
+			// The pages were evicted before they could be used, we're reading
+			// too far ahead for the current memory situation
+			stream->window = max_c(stream->window / 4, kMinReadAhead);
+			stream->end = end;
+			TRACE(("%p: read-ahead wasted at %Ld, window %lu\n", ref, offset,
+				stream->window));
+		} else if (stream->window < kMaxReadAhead)
+			stream->window = min_c(stream->window * 2, kMaxReadAhead);
+	}
+
+	// Only start reading ahead again when the reader has consumed half of
+	// the window, so that requests of a useful size are issued
+	if (stream->end - end >= (off_t)stream->window / 2)
+		return;
+
+	off_t start = ROUNDUP(max_c(stream->end, end), B_PAGE_SIZE);
+	off_t readAheadEnd = min_c(ROUNDUP(end + stream->window, B_PAGE_SIZE),
+		ROUNDUP(ref->cache->virtual_end, B_PAGE_SIZE));
+	if (start >= readAheadEnd)
+		return;
+
+	stream->end = readAheadEnd;
+	_offset = start;
+	_size = readAheadEnd - start;
+}
+
+
 static void
 reserve_pages(file_cache_ref* ref, vm_page_reservation* reservation,
 	size_t reservePages, bool isWrite)
@@ -407,6 +505,8 @@ read_into_cache(file_cache_ref* ref, void* cookie, off_t offset,
 	cache->Unlock();
 	vm_page_unreserve_pages(reservation);
 
+	cache_node_read(ref->vnode, offset, numBytes);
+
 	// read file into reserved pages
 	status_t status = read_pages_and_clear_partial(ref, cookie, offset, vecs,
 		vecCount, B_PHYSICAL_IO_REQUEST, &numBytes);
@@ -936,47 +1036,19 @@ file_cache_control(const char* subsystem, uint32 function, void* buffer,
 }
 
 
-//	#pragma mark - private kernel API
-
-
-extern "C" void
-cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
+/*!	Reads all pages in the given page aligned range that are not yet in the
+	cache asynchronously.
+	The cache must be locked; it will be unlocked temporarily while the I/O
+	requests are issued. The \a reservation must cover the whole range.
+*/
+static void
+precache_range(file_cache_ref* ref, off_t offset, size_t size,
+	vm_page_reservation* reservation)
 {
-	if (size == 0)
-		return;
-
-	VMCache* cache;
-	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
-		return;
-
-	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
-	off_t fileSize = cache->virtual_end;
-
-	if ((off_t)(offset + size) > fileSize)
-		size = fileSize - offset;
-
-	// "offset" and "size" are always aligned to B_PAGE_SIZE,
-	offset = ROUNDDOWN(offset, B_PAGE_SIZE);
-	size = ROUNDUP(size, B_PAGE_SIZE);
-
-	size_t reservePages = size / B_PAGE_SIZE;
-
-	// Don't do anything if we don't have the resources left, or the cache
-	// already contains more than 2/3 of its pages
-	if (offset >= fileSize || vm_page_num_unused_pages() < 2 * reservePages
-		|| 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE) {
-		cache->ReleaseRef();
-		return;
-	}
-
+	VMCache* cache = ref->cache;
 	size_t bytesToRead = 0;
 	off_t lastOffset = offset;
 
-	vm_page_reservation reservation;
-	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
-
-	cache->Lock();
-
 	while (true) {
 		// check if this page is already in memory
 		if (size > 0) {
@@ -994,7 +1066,7 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 			// read the part before the current page (or the end of the request)
 			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
 				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
+			if (io == NULL || io->Prepare(reservation) != B_OK) {
 				delete io;
 				break;
 			}
@@ -1014,6 +1086,80 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 
 		lastOffset = offset;
 	}
+}
+
+
+/*!	Asynchronously reads the given range as determined by
+	update_read_ahead(). Nothing is read if that would need to wait for free
+	pages.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t size)
+{
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES) != B_NO_LOW_RESOURCE)
+		return;
+
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, size / B_PAGE_SIZE,
+			VM_PRIORITY_USER)) {
+		return;
+	}
+
+	VMCache* cache = ref->cache;
+	cache->Lock();
+
+	if (offset < cache->virtual_end && ref->disabled_count == 0) {
+		size = min_c((off_t)size,
+			ROUNDUP(cache->virtual_end, B_PAGE_SIZE) - offset);
+
+		TRACE(("%p: read ahead %Ld, %lu bytes\n", ref, offset, size));
+		precache_range(ref, offset, size, &reservation);
+	}
+
+	cache->Unlock();
+	vm_page_unreserve_pages(&reservation);
+}
+
+
+//	#pragma mark - private kernel API
+
+
+extern "C" void
+cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
+{
+	if (size == 0)
+		return;
+
+	VMCache* cache;
+	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
+		return;
+
+	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	off_t fileSize = cache->virtual_end;
+
+	if ((off_t)(offset + size) > fileSize)
+		size = fileSize - offset;
+
+	// "offset" and "size" are always aligned to B_PAGE_SIZE,
+	offset = ROUNDDOWN(offset, B_PAGE_SIZE);
+	size = ROUNDUP(size, B_PAGE_SIZE);
+
+	size_t reservePages = size / B_PAGE_SIZE;
+
+	// Don't do anything if we don't have the resources left, or the cache
+	// already contains more than 2/3 of its pages
+	if (offset >= fileSize || vm_page_num_unused_pages() < 2 * reservePages
+		|| 3 * cache->page_count > 2 * fileSize / B_PAGE_SIZE) {
+		cache->ReleaseRef();
+		return;
+	}
+
+	vm_page_reservation reservation;
+	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
+
+	cache->Lock();
+
+	precache_range(ref, offset, size, &reservation);
 
 	cache->ReleaseRefAndUnlock();
 	vm_page_unreserve_pages(&reservation);
@@ -1072,6 +1218,24 @@ cache_node_closed(struct vnode* vnode, int32 fdType, VMCache* cache,
 }
 
 
+/*!	Informs the cache module that the given range of the file had to be read
+	from disk, either through the file cache, or because of a page fault in a
+	mapped file.
+*/
+extern "C" void
+cache_node_read(struct vnode* vnode, off_t offset, size_t size)
+{
+	if (sCacheModule == NULL || sCacheModule->node_read == NULL)
+		return;
+
+	dev_t mountID;
+	ino_t vnodeID;
+	vfs_vnode_to_node_ref(vnode, &mountID, &vnodeID);
+
+	sCacheModule->node_read(vnode, mountID, vnodeID, offset, size);
+}
+
+
 extern "C" void
 cache_node_launched(size_t argCount, char*  const* args)
 {
@@ -1133,6 +1297,8 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	memset(ref->read_ahead, 0, sizeof(ref->read_ahead));
+	ref->read_count = 0;
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1299,7 +1465,20 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	off_t readAheadOffset = 0;
+	size_t readAheadSize = 0;
+	if (offset >= 0 && *_size > 0) {
+		AutoLocker<VMCache> locker(ref->cache);
+		update_read_ahead(ref, offset, *_size, readAheadOffset, readAheadSize);
+	}
+
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+
+	if (status == B_OK && readAheadSize != 0)
+		read_ahead(ref, readAheadOffset, readAheadSize);
+
+	return status;
 }
 
 
@@ -48,6 +48,8 @@ VMVnodeCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 {
 	generic_size_t bytesUntouched = *_numBytes;
 
+	cache_node_read(fVnode, offset, bytesUntouched);
+
 	status_t status = vfs_read_pages(fVnode, NULL, offset, vecs, count,
 		flags, _numBytes);
 
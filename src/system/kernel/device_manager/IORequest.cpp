@@ -756,6 +756,7 @@ IORequest::Init(off_t offset, generic_size_t firstVecOffset,
 	fBuffer->SetVecs(firstVecOffset, vecs, count, length, flags);
 
 	fOwner = NULL;
+	fDeadline = 0;
 	fOffset = offset;
 	fLength = length;
 	fRelativeParentOffset = 0;
@@ -1002,6 +1003,24 @@ IORequest::SetStatusAndNotify(status_t status)
 }
 
 
+/*!	Sets the request's status to the given error like SetStatusAndNotify(),
+	but doesn't notify the request. The status is kept when the operations
+	that are still in progress finish.
+	Returns whether there are no pending operations anymore, in which case
+	the caller is responsible for calling NotifyFinished().
+*/
+bool
+IORequest::Abort(status_t status)
+{
+	MutexLocker locker(fLock);
+
+	if (fStatus == 1)
+		fStatus = status;
+
+	return fPendingChildren == 0;
+}
+
+
 void
 IORequest::OperationFinished(IOOperation* operation, status_t status,
 	bool partialTransfer, generic_size_t transferEndOffset)
@@ -24,6 +24,8 @@
 #define B_VIP_IO_REQUEST		0x02	/* used by the page writer -- make sure
 										   allocations won't fail */
 #define B_DELETE_IO_REQUEST		0x04	/* delete request when finished */
+#define B_BACKGROUND_IO_REQUEST	0x08	/* prefetching -- no one is waiting for
+										   the request to finish */
 
 struct DMABuffer;
 struct IOOperation;
@@ -231,6 +233,10 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 									{ fOwner = owner; }
 			IORequestOwner*		Owner() const	{ return fOwner; }
 
+			void				SetDeadline(bigtime_t deadline)
+									{ fDeadline = deadline; }
+			bigtime_t			Deadline() const	{ return fDeadline; }
+
 			status_t			CreateSubRequest(off_t parentOffset,
 									off_t offset, generic_size_t length,
 									IORequest*& subRequest);
@@ -253,6 +259,7 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 			void				NotifyFinished();
 			bool				HasCallbacks() const;
 			void				SetStatusAndNotify(status_t status);
+			bool				Abort(status_t status);
 
 			void				OperationFinished(IOOperation* operation,
 									status_t status, bool partialTransfer,
@@ -327,6 +334,7 @@ private:
 
 			mutex				fLock;
 			IORequestOwner*		fOwner;
+			bigtime_t			fDeadline;
 			IOBuffer*			fBuffer;
 			off_t				fOffset;
 			generic_size_t		fLength;
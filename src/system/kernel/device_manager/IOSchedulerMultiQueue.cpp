@@ -0,0 +1,741 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	An I/O scheduler for devices that can process many requests in parallel.
+
+	Requests are queued in a submission queue of the CPU they are scheduled
+	on, so that submitting threads on different CPUs don't contend for a
+	single lock. Each submission queue is served by one of several hardware
+	queues, each of which has its own dispatcher thread and its own set of
+	operations that can be in flight at the same time.
+
+	Every request is assigned an I/O class -- read, write, or background --
+	and a deadline depending on its class. A hardware queue always dispatches
+	the request whose deadline has expired first; if none has expired, reads
+	go before writes, and background requests are only dispatched when no
+	other requests are waiting, and the queue is less than half full.
+*/
+
+
+#include "IOSchedulerMultiQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lock.h>
+#include <smp.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER
+#ifdef TRACE_IO_SCHEDULER
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const int32 kMaxHardwareQueues = 4;
+static const bigtime_t kBusyRetryDelay = 1000;
+	// how long to wait for another queue to release DMA buffers
+
+static const bigtime_t kClassDeadlines[IO_CLASS_COUNT] = {
+	50000,		// read
+	500000,		// write
+	2000000		// background
+};
+
+static const char* const kClassNames[IO_CLASS_COUNT] = {
+	"read",
+	"write",
+	"background"
+};
+
+
+struct IOSchedulerMultiQueue::SubmitQueue {
+	spinlock			lock;
+	IORequestList		requests;
+} CACHE_LINE_ALIGN;
+
+
+struct IOSchedulerMultiQueue::HardwareQueue {
+	IOSchedulerMultiQueue* scheduler;
+	int32				index;
+	thread_id			thread;
+
+	// protected by the lock
+	spinlock			lock;
+	ConditionVariable	condition;
+	bool				work_pending;
+	IOOperationList		completed_operations;
+
+	// only accessed by the dispatcher thread
+	IORequestList		requests[IO_CLASS_COUNT];
+	IOOperationList		unused_operations;
+	int32				operations_in_flight;
+
+	// statistics, only written by the dispatcher thread
+	int64				finished_requests[IO_CLASS_COUNT];
+	int64				missed_deadlines[IO_CLASS_COUNT];
+	bigtime_t			total_latency[IO_CLASS_COUNT];
+	bigtime_t			max_latency[IO_CLASS_COUNT];
+	int32				max_operations_in_flight;
+};
+
+
+IOSchedulerMultiQueue::IOSchedulerMultiQueue(DMAResource* resource,
+	int32 queueCount)
+	:
+	IOScheduler(resource),
+	fSubmitQueues(NULL),
+	fSubmitQueueCount(0),
+	fHardwareQueues(NULL),
+	fHardwareQueueCount(queueCount),
+	fOperations(NULL),
+	fOperationsPerQueue(0),
+	fBlockSize(0),
+	fMaxOperationLength(0),
+	fRequestNotifierThread(-1),
+	fTerminating(false)
+{
+	mutex_init(&fNotifierLock, "I/O scheduler notifier");
+	fFinishedRequestCondition.Init(this, "I/O finished request");
+}
+
+
+IOSchedulerMultiQueue::~IOSchedulerMultiQueue()
+{
+	// shutdown threads
+	fTerminating = true;
+
+	for (int32 i = 0; fHardwareQueues != NULL && i < fHardwareQueueCount;
+			i++) {
+		HardwareQueue& queue = fHardwareQueues[i];
+		InterruptsSpinLocker locker(queue.lock);
+		queue.condition.NotifyAll();
+		locker.Unlock();
+
+		if (queue.thread >= 0)
+			wait_for_thread(queue.thread, NULL);
+	}
+
+	mutex_lock(&fNotifierLock);
+	fFinishedRequestCondition.NotifyAll();
+	mutex_unlock(&fNotifierLock);
+
+	if (fRequestNotifierThread >= 0)
+		wait_for_thread(fRequestNotifierThread, NULL);
+
+	// destroy our belongings
+	mutex_lock(&fNotifierLock);
+	mutex_destroy(&fNotifierLock);
+
+	delete[] fHardwareQueues;
+	delete[] fOperations;
+	free(fSubmitQueues);
+}
+
+
+status_t
+IOSchedulerMultiQueue::Init(const char* name)
+{
+	status_t error = IOScheduler::Init(name);
+	if (error != B_OK)
+		return error;
+
+	if (fDMAResource != NULL)
+		fBlockSize = fDMAResource->BlockSize();
+	if (fBlockSize == 0)
+		fBlockSize = 512;
+	fMaxOperationLength = fBlockSize * 1024;
+
+	// one submission queue per CPU, and up to kMaxHardwareQueues queues that
+	// serve them
+	fSubmitQueueCount = smp_get_num_cpus();
+	if (fHardwareQueueCount <= 0)
+		fHardwareQueueCount = min_c(fSubmitQueueCount, kMaxHardwareQueues);
+	fHardwareQueueCount = min_c(fHardwareQueueCount, fSubmitQueueCount);
+
+	fSubmitQueues = (SubmitQueue*)memalign(CACHE_LINE_SIZE,
+		fSubmitQueueCount * sizeof(SubmitQueue));
+	if (fSubmitQueues == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < fSubmitQueueCount; i++) {
+		SubmitQueue* queue = new(&fSubmitQueues[i]) SubmitQueue;
+		B_INITIALIZE_SPINLOCK(&queue->lock);
+	}
+
+	// divide the operations -- and thus the queue depth the DMA resource
+	// allows for -- between the hardware queues
+	int32 operationCount = fDMAResource != NULL
+		? fDMAResource->BufferCount() : 16 * fHardwareQueueCount;
+	fOperationsPerQueue = max_c(operationCount / fHardwareQueueCount, 1);
+
+	fOperations = new(std::nothrow) IOOperation[
+		fOperationsPerQueue * fHardwareQueueCount];
+	fHardwareQueues = new(std::nothrow) HardwareQueue[fHardwareQueueCount];
+	if (fOperations == NULL || fHardwareQueues == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < fHardwareQueueCount; i++) {
+		HardwareQueue& queue = fHardwareQueues[i];
+		queue.scheduler = this;
+		queue.index = i;
+		queue.thread = -1;
+		B_INITIALIZE_SPINLOCK(&queue.lock);
+		queue.condition.Init(&queue, "I/O queue work");
+		queue.work_pending = false;
+		queue.operations_in_flight = 0;
+		queue.max_operations_in_flight = 0;
+
+		for (int32 j = 0; j < IO_CLASS_COUNT; j++) {
+			queue.finished_requests[j] = 0;
+			queue.missed_deadlines[j] = 0;
+			queue.total_latency[j] = 0;
+			queue.max_latency[j] = 0;
+		}
+
+		for (int32 j = 0; j < fOperationsPerQueue; j++) {
+			queue.unused_operations.Add(
+				&fOperations[i * fOperationsPerQueue + j]);
+		}
+	}
+
+	// start threads
+	char buffer[B_OS_NAME_LENGTH];
+	for (int32 i = 0; i < fHardwareQueueCount; i++) {
+		snprintf(buffer, sizeof(buffer), "%s queue %" B_PRId32 " %" B_PRId32,
+			name, i, fID);
+		fHardwareQueues[i].thread = spawn_kernel_thread(&_DispatcherThread,
+			buffer, B_NORMAL_PRIORITY + 2, &fHardwareQueues[i]);
+		if (fHardwareQueues[i].thread < B_OK)
+			return fHardwareQueues[i].thread;
+	}
+
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " notifier ", sizeof(buffer));
+	size_t nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fRequestNotifierThread = spawn_kernel_thread(&_RequestNotifierThread,
+		buffer, B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fRequestNotifierThread < B_OK)
+		return fRequestNotifierThread;
+
+	for (int32 i = 0; i < fHardwareQueueCount; i++)
+		resume_thread(fHardwareQueues[i].thread);
+	resume_thread(fRequestNotifierThread);
+
+	return B_OK;
+}
+
+
+status_t
+IOSchedulerMultiQueue::ScheduleRequest(IORequest* request)
+{
+	TRACE("%p->IOSchedulerMultiQueue::ScheduleRequest(%p)\n", this, request);
+
+	IOBuffer* buffer = request->Buffer();
+
+	// TODO: it would be nice to be able to lock the memory later, but we can't
+	// easily do it in the I/O scheduler without being able to asynchronously
+	// lock memory (via another thread or a dedicated call).
+
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	request->SetDeadline(system_time() + kClassDeadlines[ClassFor(request)]);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_SCHEDULED, this,
+		request);
+
+	// We don't need to stay on this CPU, the queue index only serves to
+	// spread the submitting threads over the queues.
+	int32 cpu = smp_get_current_cpu();
+	SubmitQueue& submitQueue = fSubmitQueues[cpu];
+	HardwareQueue& queue = fHardwareQueues[cpu % fHardwareQueueCount];
+
+	InterruptsSpinLocker submitLocker(submitQueue.lock);
+	submitQueue.requests.Add(request);
+	submitLocker.Unlock();
+
+	InterruptsSpinLocker locker(queue.lock);
+	queue.work_pending = true;
+	queue.condition.NotifyAll();
+
+	return B_OK;
+}
+
+
+void
+IOSchedulerMultiQueue::AbortRequest(IORequest* request, status_t status)
+{
+	TRACE("%p->IOSchedulerMultiQueue::AbortRequest(%p, %#" B_PRIx32 ")\n",
+		this, request, status);
+
+	// If the request is still in a submission queue, no dispatcher knows
+	// about it yet, and we can finish it right away.
+	for (int32 i = 0; i < fSubmitQueueCount; i++) {
+		SubmitQueue& submitQueue = fSubmitQueues[i];
+
+		InterruptsSpinLocker locker(submitQueue.lock);
+		if (!submitQueue.requests.Contains(request))
+			continue;
+
+		submitQueue.requests.Remove(request);
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+		request->SetStatusAndNotify(status);
+		return;
+	}
+
+	// Otherwise it belongs to a dispatcher: set the status, so that it won't
+	// issue any further operations for the request, and let it finish the
+	// request as soon as no operations are in flight anymore.
+	request->Abort(status);
+
+	for (int32 i = 0; i < fHardwareQueueCount; i++) {
+		HardwareQueue& queue = fHardwareQueues[i];
+		InterruptsSpinLocker locker(queue.lock);
+		queue.work_pending = true;
+		queue.condition.NotifyAll();
+	}
+}
+
+
+void
+IOSchedulerMultiQueue::OperationCompleted(IOOperation* operation,
+	status_t status, generic_size_t transferredBytes)
+{
+	HardwareQueue* queue = _QueueFor(operation);
+
+	InterruptsSpinLocker _(queue->lock);
+
+	// finish operation only once
+	if (operation->Status() <= 0)
+		return;
+
+	operation->SetStatus(status);
+
+	// set the bytes transferred (of the net data)
+	generic_size_t partialBegin
+		= operation->OriginalOffset() - operation->Offset();
+	operation->SetTransferredBytes(
+		transferredBytes > partialBegin ? transferredBytes - partialBegin : 0);
+
+	queue->completed_operations.Add(operation);
+	queue->condition.NotifyAll();
+}
+
+
+void
+IOSchedulerMultiQueue::Dump() const
+{
+	kprintf("IOSchedulerMultiQueue at %p\n", this);
+	kprintf("  DMA resource:     %p\n", fDMAResource);
+	kprintf("  submit queues:    %" B_PRId32 "\n", fSubmitQueueCount);
+	kprintf("  hardware queues:  %" B_PRId32 ", %" B_PRId32 " operations "
+		"each\n", fHardwareQueueCount, fOperationsPerQueue);
+
+	for (int32 i = 0; i < fHardwareQueueCount; i++) {
+		const HardwareQueue& queue = fHardwareQueues[i];
+		kprintf("  queue %" B_PRId32 ": thread %" B_PRId32 ", %" B_PRId32
+			" operations in flight (max %" B_PRId32 ")\n", i, queue.thread,
+			queue.operations_in_flight, queue.max_operations_in_flight);
+
+		for (int32 j = 0; j < IO_CLASS_COUNT; j++) {
+			kprintf("    %-10s  requests:", kClassNames[j]);
+			for (IORequestList::ConstIterator it
+						= queue.requests[j].GetIterator();
+					IORequest* request = it.Next();) {
+				kprintf(" %p", request);
+			}
+			kprintf("\n");
+
+			int64 count = queue.finished_requests[j];
+			kprintf("                finished: %" B_PRId64 ", missed "
+				"deadlines: %" B_PRId64 ", latency: avg %" B_PRId64 " us, max %"
+				B_PRId64 " us\n", count, queue.missed_deadlines[j],
+				count > 0 ? queue.total_latency[j] / count : 0,
+				queue.max_latency[j]);
+		}
+	}
+}
+
+
+/*static*/ int32
+IOSchedulerMultiQueue::ClassFor(const IORequest* request)
+{
+	if ((request->Flags() & B_BACKGROUND_IO_REQUEST) != 0
+		|| (request->IsWrite() && (request->Flags() & B_VIP_IO_REQUEST) != 0))
+		return IO_CLASS_BACKGROUND;
+
+	return request->IsWrite() ? IO_CLASS_WRITE : IO_CLASS_READ;
+}
+
+
+IOSchedulerMultiQueue::HardwareQueue*
+IOSchedulerMultiQueue::_QueueFor(IOOperation* operation) const
+{
+	return &fHardwareQueues[(operation - fOperations) / fOperationsPerQueue];
+}
+
+
+/*!	Moves all requests from the submission queues served by the given queue
+	to the queue's per class lists.
+*/
+void
+IOSchedulerMultiQueue::_CollectRequests(HardwareQueue* queue)
+{
+	for (int32 i = queue->index; i < fSubmitQueueCount;
+			i += fHardwareQueueCount) {
+		SubmitQueue& submitQueue = fSubmitQueues[i];
+
+		InterruptsSpinLocker locker(submitQueue.lock);
+		IORequestList requests;
+		requests.MoveFrom(&submitQueue.requests);
+		locker.Unlock();
+
+		while (IORequest* request = requests.RemoveHead())
+			queue->requests[ClassFor(request)].Add(request);
+	}
+}
+
+
+IORequest*
+IOSchedulerMultiQueue::_NextRequest(HardwareQueue* queue, bigtime_t now)
+{
+	// Requests are queued in the order they have been scheduled, so the one
+	// with the earliest deadline in each class is at the head of its list
+	IORequest* expired = NULL;
+	for (int32 i = 0; i < IO_CLASS_COUNT; i++) {
+		IORequest* request = queue->requests[i].Head();
+		if (request != NULL && request->Deadline() <= now
+			&& (expired == NULL || request->Deadline() < expired->Deadline()))
+			expired = request;
+	}
+	if (expired != NULL)
+		return expired;
+
+	if (IORequest* request = queue->requests[IO_CLASS_READ].Head())
+		return request;
+	if (IORequest* request = queue->requests[IO_CLASS_WRITE].Head())
+		return request;
+
+	// leave room for foreground requests that might arrive
+	if (queue->operations_in_flight < (fOperationsPerQueue + 1) / 2)
+		return queue->requests[IO_CLASS_BACKGROUND].Head();
+
+	return NULL;
+}
+
+
+/*!	Removes the requests that have been aborted, and have no operations in
+	flight anymore, from the given queue's per class lists, and finishes them.
+	Aborted requests that still have operations in flight are finished when
+	the last one of them is.
+*/
+void
+IOSchedulerMultiQueue::_RemoveAbortedRequests(HardwareQueue* queue)
+{
+	for (int32 i = 0; i < IO_CLASS_COUNT; i++) {
+		IORequestList::Iterator it = queue->requests[i].GetIterator();
+		while (IORequest* request = it.Next()) {
+			if (request->Status() == 1 || !request->IsFinished())
+				continue;
+
+			it.Remove();
+			_FinishRequest(queue, request);
+		}
+	}
+}
+
+
+/*!	Prepares the next operation of the given request, and passes it to the
+	driver. Returns \c B_BUSY, if no DMA buffers are available right now.
+*/
+status_t
+IOSchedulerMultiQueue::_IssueOperation(HardwareQueue* queue,
+	IORequest* request, bigtime_t now)
+{
+	int32 ioClass = ClassFor(request);
+
+	IOOperation* operation = queue->unused_operations.RemoveHead();
+	ASSERT(operation != NULL);
+
+	status_t status;
+	if (fDMAResource != NULL) {
+		status = fDMAResource->TranslateNext(request, operation,
+			fMaxOperationLength);
+	} else {
+		// TODO: If the device has block size restrictions, we might need to use
+		// a bounce buffer.
+		status = operation->Prepare(request);
+		if (status == B_OK) {
+			operation->SetOriginalRange(request->Offset(), request->Length());
+			request->Advance(request->Length());
+		}
+	}
+
+	if (status != B_OK) {
+		operation->SetParent(NULL);
+		queue->unused_operations.Add(operation);
+
+		// B_BUSY means some resource (DMABuffers or DMABounceBuffers) was
+		// temporarily unavailable. That's OK, we'll retry later.
+		if (status == B_BUSY)
+			return B_BUSY;
+
+		queue->requests[ioClass].Remove(request);
+		if (request->Abort(status))
+			_FinishRequest(queue, request);
+		return status;
+	}
+
+	if (request->RemainingBytes() == 0) {
+		// all of the request is in flight now
+		queue->requests[ioClass].Remove(request);
+		if (now > request->Deadline())
+			queue->missed_deadlines[ioClass]++;
+	}
+
+	if (++queue->operations_in_flight > queue->max_operations_in_flight)
+		queue->max_operations_in_flight = queue->operations_in_flight;
+
+	_StartOperation(queue, operation);
+	return B_OK;
+}
+
+
+void
+IOSchedulerMultiQueue::_StartOperation(HardwareQueue* queue,
+	IOOperation* operation)
+{
+	TRACE("IOSchedulerMultiQueue::_StartOperation(): queue %" B_PRId32
+		", operation: %p\n", queue->index, operation);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_STARTED, this,
+		operation->Parent(), operation);
+
+	fIOCallback(fIOCallbackData, operation);
+}
+
+
+void
+IOSchedulerMultiQueue::_FinishOperation(HardwareQueue* queue,
+	IOOperation* operation)
+{
+	TRACE("IOSchedulerMultiQueue::_FinishOperation(): operation: %p\n",
+		operation);
+
+	bool operationFinished = operation->Finish();
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_FINISHED,
+		this, operation->Parent(), operation);
+		// Notify for every time the operation is passed to the I/O hook,
+		// not only when it is fully finished.
+
+	if (!operationFinished) {
+		// the operation has another phase (like the write after the read of
+		// a partial block) -- pass it to the driver again right away
+		TRACE("  operation: %p not finished yet\n", operation);
+		operation->SetTransferredBytes(0);
+		_StartOperation(queue, operation);
+		return;
+	}
+
+	// notify request and recycle the operation
+	IORequest* request = operation->Parent();
+
+	generic_size_t operationOffset
+		= operation->OriginalOffset() - request->Offset();
+	request->OperationFinished(operation, operation->Status(),
+		operation->TransferredBytes() < operation->OriginalLength(),
+		operation->Status() == B_OK
+			? operationOffset + operation->OriginalLength()
+			: operationOffset);
+
+	if (fDMAResource != NULL)
+		fDMAResource->RecycleBuffer(operation->Buffer());
+
+	queue->operations_in_flight--;
+	queue->unused_operations.Add(operation);
+
+	if (!request->IsFinished())
+		return;
+
+	if (request->Status() == B_OK && request->RemainingBytes() > 0) {
+		// The request has been processed OK so far, but it isn't really
+		// finished yet -- it is still in its queue, and will be continued.
+		request->SetUnfinished();
+		return;
+	}
+
+	if (request->RemainingBytes() > 0) {
+		// the request failed or has been aborted before all of it could be
+		// issued, so it is still in its queue
+		queue->requests[ClassFor(request)].Remove(request);
+	}
+
+	_FinishRequest(queue, request);
+}
+
+
+void
+IOSchedulerMultiQueue::_FinishRequest(HardwareQueue* queue,
+	IORequest* request)
+{
+	int32 ioClass = ClassFor(request);
+	bigtime_t latency = system_time()
+		- (request->Deadline() - kClassDeadlines[ioClass]);
+
+	queue->finished_requests[ioClass]++;
+	queue->total_latency[ioClass] += latency;
+	if (latency > queue->max_latency[ioClass])
+		queue->max_latency[ioClass] = latency;
+
+	if (request->HasCallbacks()) {
+		// The request has callbacks that may take some time to perform, so we
+		// hand it over to the request notifier.
+		MutexLocker locker(fNotifierLock);
+		fFinishedRequests.Add(request);
+		fFinishedRequestCondition.NotifyAll();
+		return;
+	}
+
+	// No callbacks -- finish the request right now.
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED, this,
+		request);
+	request->NotifyFinished();
+}
+
+
+status_t
+IOSchedulerMultiQueue::_Dispatcher(HardwareQueue* queue)
+{
+	while (!fTerminating) {
+		InterruptsSpinLocker locker(queue->lock);
+		IOOperationList completedOperations;
+		completedOperations.MoveFrom(&queue->completed_operations);
+		queue->work_pending = false;
+		locker.Unlock();
+
+		while (IOOperation* operation = completedOperations.RemoveHead())
+			_FinishOperation(queue, operation);
+
+		_CollectRequests(queue);
+		_RemoveAbortedRequests(queue);
+
+		// fill the queue
+		bool buffersBusy = false;
+		bigtime_t now = system_time();
+		while (queue->operations_in_flight < fOperationsPerQueue) {
+			IORequest* request = _NextRequest(queue, now);
+			if (request == NULL)
+				break;
+
+			if (_IssueOperation(queue, request, now) == B_BUSY) {
+				buffersBusy = true;
+				break;
+			}
+		}
+
+		// wait for more work
+		locker.Lock();
+		if (queue->work_pending || !queue->completed_operations.IsEmpty()
+			|| fTerminating) {
+			continue;
+		}
+
+		ConditionVariableEntry entry;
+		queue->condition.Add(&entry);
+		locker.Unlock();
+
+		IORequest* background = queue->requests[IO_CLASS_BACKGROUND].Head();
+		if (buffersBusy && queue->operations_in_flight == 0) {
+			// the DMA buffers are used up by the other queues, and we won't be
+			// notified when they become available again
+			entry.Wait(B_RELATIVE_TIMEOUT, kBusyRetryDelay);
+		} else if (background != NULL && !buffersBusy
+			&& queue->operations_in_flight < fOperationsPerQueue
+			&& background->Deadline() > system_time()) {
+			// background requests must be dispatched when their deadline is
+			// reached, even if nothing else happens
+			entry.Wait(B_ABSOLUTE_TIMEOUT, background->Deadline());
+		} else {
+			// Either there is nothing to do, or we can't issue anything before
+			// an operation has been completed -- which will notify us.
+			entry.Wait();
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerMultiQueue::_DispatcherThread(void* data)
+{
+	HardwareQueue* queue = (HardwareQueue*)data;
+	return queue->scheduler->_Dispatcher(queue);
+}
+
+
+status_t
+IOSchedulerMultiQueue::_RequestNotifier()
+{
+	while (true) {
+		MutexLocker locker(fNotifierLock);
+
+		// get a request
+		IORequest* request = fFinishedRequests.RemoveHead();
+
+		if (request == NULL) {
+			if (fTerminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			fFinishedRequestCondition.Add(&entry);
+
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+
+		// notify the request
+		request->NotifyFinished();
+	}
+
+	// never can get here
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerMultiQueue::_RequestNotifierThread(void *_self)
+{
+	IOSchedulerMultiQueue *self = (IOSchedulerMultiQueue*)_self;
+	return self->_RequestNotifier();
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_MULTI_QUEUE_H
+#define IO_SCHEDULER_MULTI_QUEUE_H
+
+
+#include <KernelExport.h>
+
+#include <condition_variable.h>
+#include <lock.h>
+
+#include "dma_resources.h"
+#include "IOScheduler.h"
+
+
+// I/O classes, each with its own deadline
+enum {
+	IO_CLASS_READ = 0,
+	IO_CLASS_WRITE,
+	IO_CLASS_BACKGROUND,
+		// the page writer, and prefetching
+
+	IO_CLASS_COUNT
+};
+
+
+class IOSchedulerMultiQueue : public IOScheduler {
+public:
+								IOSchedulerMultiQueue(DMAResource* resource,
+									int32 queueCount = 0);
+	virtual						~IOSchedulerMultiQueue();
+
+	virtual	status_t			Init(const char* name);
+
+	virtual	status_t			ScheduleRequest(IORequest* request);
+
+	virtual	void				AbortRequest(IORequest* request,
+									status_t status = B_CANCELED);
+	virtual	void				OperationCompleted(IOOperation* operation,
+									status_t status,
+									generic_size_t transferredBytes);
+									// called by the driver when the operation
+									// has been completed successfully or failed
+									// for some reason
+
+	virtual	void				Dump() const;
+
+	static	int32				ClassFor(const IORequest* request);
+
+private:
+			struct SubmitQueue;
+			struct HardwareQueue;
+
+			HardwareQueue*		_QueueFor(IOOperation* operation) const;
+			void				_CollectRequests(HardwareQueue* queue);
+			void				_RemoveAbortedRequests(
+									HardwareQueue* queue);
+			IORequest*			_NextRequest(HardwareQueue* queue,
+									bigtime_t now);
+			status_t			_IssueOperation(HardwareQueue* queue,
+									IORequest* request, bigtime_t now);
+			void				_StartOperation(HardwareQueue* queue,
+									IOOperation* operation);
+			void				_FinishOperation(HardwareQueue* queue,
+									IOOperation* operation);
+			void				_FinishRequest(HardwareQueue* queue,
+									IORequest* request);
+			status_t			_Dispatcher(HardwareQueue* queue);
+	static	status_t			_DispatcherThread(void* data);
+			status_t			_RequestNotifier();
+	static	status_t			_RequestNotifierThread(void* self);
+
+private:
+			SubmitQueue*		fSubmitQueues;
+			int32				fSubmitQueueCount;
+			HardwareQueue*		fHardwareQueues;
+			int32				fHardwareQueueCount;
+			IOOperation*		fOperations;
+			int32				fOperationsPerQueue;
+			generic_size_t		fBlockSize;
+			generic_size_t		fMaxOperationLength;
+			mutex				fNotifierLock;
+			thread_id			fRequestNotifierThread;
+			IORequestList		fFinishedRequests;
+			ConditionVariable	fFinishedRequestCondition;
+	volatile bool				fTerminating;
+};
+
+
+#endif	// IO_SCHEDULER_MULTI_QUEUE_H
@@ -6,8 +6,14 @@
 
 #include "IOSchedulerRoster.h"
 
+#include <string.h>
+
+#include <driver_settings.h>
 #include <util/AutoLock.h>
 
+#include "IOSchedulerMultiQueue.h"
+#include "IOSchedulerSimple.h"
+
 
 /*static*/ IOSchedulerRoster IOSchedulerRoster::sDefaultInstance;
 
@@ -72,6 +78,36 @@ IOSchedulerRoster::NextID()
 }
 
 
+/*!	Creates an I/O scheduler of the given \a type. If \a type is \c NULL,
+	the type set by the "io_scheduler" kernel setting is used, and the simple
+	scheduler, if there is none.
+*/
+IOScheduler*
+IOSchedulerRoster::CreateScheduler(DMAResource* resource, const char* type)
+{
+	bool multiQueue = false;
+
+	if (type != NULL)
+		multiQueue = strcmp(type, IO_SCHEDULER_TYPE_MULTI_QUEUE) == 0;
+	else {
+		void* handle = load_driver_settings("kernel");
+		if (handle != NULL) {
+			const char* setting = get_driver_parameter(handle, "io_scheduler",
+				NULL, NULL);
+			multiQueue = setting != NULL
+				&& strcmp(setting, IO_SCHEDULER_TYPE_MULTI_QUEUE) == 0;
+
+			unload_driver_settings(handle);
+		}
+	}
+
+	if (multiQueue)
+		return new(std::nothrow) IOSchedulerMultiQueue(resource);
+
+	return new(std::nothrow) IOSchedulerSimple(resource);
+}
+
+
 IOSchedulerRoster::IOSchedulerRoster()
 	:
 	fNextID(1),
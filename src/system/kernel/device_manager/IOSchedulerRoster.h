@@ -20,6 +20,9 @@
 #define IO_SCHEDULER_OPERATION_STARTED	0x10
 #define IO_SCHEDULER_OPERATION_FINISHED	0x20
 
+// I/O scheduler types, as set by the "io_scheduler" kernel setting
+#define IO_SCHEDULER_TYPE_SIMPLE		"simple"
+#define IO_SCHEDULER_TYPE_MULTI_QUEUE	"multiqueue"
 
 
 typedef DoublyLinkedList<IOScheduler> IOSchedulerList;
@@ -48,6 +51,10 @@ public:
 
 			int32				NextID();
 
+			IOScheduler*		CreateScheduler(DMAResource* resource,
+									const char* type = NULL);
+									// the caller still needs to Init() it
+
 private:
 								IOSchedulerRoster();
 								~IOSchedulerRoster();
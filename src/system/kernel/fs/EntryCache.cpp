@@ -8,12 +8,50 @@
 
 #include <new>
 
+#include <cpu.h>
+#include <smp.h>
+
 
 static const int32 kEntriesPerGeneration = 1024;
+static const size_t kTableSize = 4096;
 
 static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
 
+static const bigtime_t kExpiringEntryLifetime = 1000000;
+	// for entries the VFS added on its own behalf
+static const int32 kMaxRetiredEntries = 128;
+
+
+struct cpu_entry_cache_stats {
+	entry_cache_stats	stats;
+} CACHE_LINE_ALIGN;
+
+static cpu_entry_cache_stats sStatistics[SMP_MAX_CPUS];
+
+#define COUNT(counter)	\
+	atomic_add64(&sStatistics[smp_get_current_cpu()].stats.counter, 1)
+
+
+static inline void
+count_hit(bool missing, bool lockless)
+{
+	COUNT(hits);
+	if (lockless)
+		COUNT(lockless_hits);
+	if (missing)
+		COUNT(negative_hits);
+}
+
+
+static void
+retired_entries_barrier(void* cookie, int cpu)
+{
+	// Nothing to do: the lockless lookups run with interrupts disabled, so
+	// when every CPU has processed this call, none of them can still be
+	// looking at a retired entry.
+}
+
 
 // #pragma mark - EntryCacheGeneration
 
@@ -50,11 +88,16 @@ EntryCacheGeneration::Init()
 
 EntryCache::EntryCache()
 	:
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fMissingCount(0),
+	fRetiredEntries(NULL),
+	fRetiredCount(0)
 {
 	rw_lock_init(&fLock, "entry cache");
 
 	new(&fEntries) EntryTable;
+
+	memset(fChangeCounts, 0, sizeof(fChangeCounts));
 }
 
 
@@ -68,6 +111,12 @@ EntryCache::~EntryCache()
 		entry = next;
 	}
 
+	while (fRetiredEntries != NULL) {
+		entry = fRetiredEntries;
+		fRetiredEntries = entry->retired_link;
+		free(entry);
+	}
+
 	rw_lock_destroy(&fLock);
 }
 
@@ -75,7 +124,7 @@ EntryCache::~EntryCache()
 status_t
 EntryCache::Init()
 {
-	status_t error = fEntries.Init();
+	status_t error = fEntries.Init(kTableSize);
 	if (error != B_OK)
 		return error;
 
@@ -89,40 +138,107 @@ EntryCache::Init()
 }
 
 
+/*!	Adds an entry to the cache, or updates the existing one. This is used
+	by the file systems, their entries don't expire.
+*/
 status_t
 EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 {
-	EntryCacheKey key(dirID, name);
+	WriteLocker _(fLock);
+
+	return _Add(dirID, name, nodeID, missing, 0);
+}
+
+
+/*!	Adds an entry that is only valid for a limited time; the VFS uses this
+	for the lookups it caches on its own. \a changeCount must have been
+	retrieved via ChangeCount() before the file system was asked about the
+	entry: if the file system announced a change in the directory since
+	then, the result might already be outdated, and the entry is not added.
+	An expiring entry never replaces one of the file system.
+*/
+status_t
+EntryCache::AddExpiring(ino_t dirID, const char* name, ino_t nodeID,
+	bool missing, uint32 changeCount)
+{
+	bigtime_t expiration = system_time() + kExpiringEntryLifetime;
 
 	WriteLocker _(fLock);
 
+	if (ChangeCount(dirID) != changeCount)
+		return B_OK;
+
+	EntryCacheEntry* entry = fEntries.Lookup(EntryCacheKey(dirID, name));
+	if (entry != NULL && entry->expiration == 0)
+		return B_OK;
+
+	return _Add(dirID, name, nodeID, missing, expiration);
+}
+
+
+/*!	Returns a counter that changes whenever the file system announces a
+	change of an entry in the given directory (or, rarely, in another one).
+*/
+uint32
+EntryCache::ChangeCount(ino_t dirID) const
+{
+	return atomic_get((int32*)&fChangeCounts[dirID % kChangeCountSlots]);
+}
+
+
+/*!	The caller must hold the write lock. */
+status_t
+EntryCache::_Add(ino_t dirID, const char* name, ino_t nodeID, bool missing,
+	bigtime_t expiration)
+{
+	EntryCacheKey key(dirID, name);
+
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry != NULL) {
-		entry->node_id = nodeID;
-		entry->missing = missing;
-		if (entry->generation != fCurrentGeneration) {
-			if (entry->index >= 0) {
+		if (entry->node_id == nodeID && entry->missing == missing
+			&& entry->expiration == expiration) {
+			// The entry is up to date, just refresh it.
+			if (entry->generation != fCurrentGeneration && entry->index >= 0) {
 				fGenerations[entry->generation].entries[entry->index] = NULL;
 				_AddEntryToCurrentGeneration(entry);
 			}
+			return B_OK;
 		}
-		return B_OK;
+
+		// Entries must not be changed once they are in the table, so we
+		// replace it.
+		_RemoveEntry(entry);
 	}
 
 	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
-	if (entry == NULL)
+	if (entry == NULL) {
+		_FreeRetiredEntries();
 		return B_NO_MEMORY;
+	}
 
+	entry->hash_link = NULL;
+	entry->retired_link = NULL;
 	entry->node_id = nodeID;
 	entry->dir_id = dirID;
+	entry->expiration = expiration;
 	entry->missing = missing;
 	entry->generation = fCurrentGeneration;
 	entry->index = kEntryNotInArray;
 	strcpy(entry->name, name);
 
+	// make the entry complete before lockless lookups can see it
+	memory_write_barrier();
+
 	fEntries.Insert(entry);
 
+	if (missing) {
+		fMissingCount++;
+		COUNT(negative_additions);
+	} else
+		COUNT(additions);
+
 	_AddEntryToCurrentGeneration(entry);
+	_FreeRetiredEntries();
 
 	return B_OK;
 }
@@ -131,28 +247,17 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 status_t
 EntryCache::Remove(ino_t dirID, const char* name)
 {
-	EntryCacheKey key(dirID, name);
-
-	WriteLocker writeLocker(fLock);
-
-	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
-		return B_ENTRY_NOT_FOUND;
+	return _Remove(dirID, name, false);
+}
 
-	fEntries.Remove(entry);
 
-	if (entry->index >= 0) {
-		// remove the entry from its generation and delete it
-		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
-	} else {
-		// We can't free it, since another thread is about to try to move it
-		// to another generation. We mark it removed and the other thread will
-		// take care of deleting it.
-		entry->index = kEntryRemoved;
-	}
-
-	return B_OK;
+/*!	Removes the entry only if it is a missing one, ie. when an entry of that
+	name has been created.
+*/
+status_t
+EntryCache::RemoveMissing(ino_t dirID, const char* name)
+{
+	return _Remove(dirID, name, true);
 }
 
 
@@ -162,12 +267,20 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 {
 	EntryCacheKey key(dirID, name);
 
+	if (_LookupLockless(key, _nodeID, _missing))
+		return true;
+
 	ReadLocker readLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry == NULL)
 		return false;
 
+	if (_IsExpired(entry)) {
+		COUNT(expired);
+		return false;
+	}
+
 	int32 oldGeneration = atomic_get_and_set(&entry->generation,
 			fCurrentGeneration);
 	if (oldGeneration == fCurrentGeneration || entry->index < 0) {
@@ -175,6 +288,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 		// it by another thread.
 		_nodeID = entry->node_id;
 		_missing = entry->missing;
+		count_hit(_missing, false);
 		return true;
 	}
 
@@ -183,12 +297,13 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 	entry->index = kEntryNotInArray;
 
 	// add to the current generation
-	int32 index = atomic_add(&fGenerations[oldGeneration].next_index, 1);
+	int32 index = atomic_add(&fGenerations[fCurrentGeneration].next_index, 1);
 	if (index < kEntriesPerGeneration) {
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->index = index;
 		_nodeID = entry->node_id;
 		_missing = entry->missing;
+		count_hit(_missing, false);
 		return true;
 	}
 
@@ -199,7 +314,8 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 
 	if (entry->index == kEntryRemoved) {
 		// the entry has been removed in the meantime
-		free(entry);
+		_RetireEntry(entry);
+		_FreeRetiredEntries();
 		return false;
 	}
 
@@ -207,10 +323,53 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 
 	_nodeID = entry->node_id;
 	_missing = entry->missing;
+	_FreeRetiredEntries();
+
+	count_hit(_missing, false);
 	return true;
 }
 
 
+/*!	Looks up the entry without locking the cache. This only works for
+	entries of the current generation; for all others \c false is returned,
+	even if they are in the cache. Can be called with other locks held, but
+	not with interrupts disabled.
+*/
+bool
+EntryCache::LookupLockless(ino_t dirID, const char* name, ino_t& _nodeID,
+	bool& _missing)
+{
+	return _LookupLockless(EntryCacheKey(dirID, name), _nodeID, _missing);
+}
+
+
+bool
+EntryCache::_LookupLockless(const EntryCacheKey& key, ino_t& _nodeID,
+	bool& _missing)
+{
+	COUNT(lookups);
+
+	// Entries of the current generation can be looked up without locking:
+	// the table is never resized, entries are not changed while they are in
+	// it, and removed entries are only freed after every CPU has reenabled
+	// interrupts (cf. _FreeRetiredEntries()).
+	cpu_status state = disable_interrupts();
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry != NULL && entry->generation == fCurrentGeneration
+		&& !_IsExpired(entry)) {
+		_nodeID = entry->node_id;
+		_missing = entry->missing;
+		restore_interrupts(state);
+
+		count_hit(_missing, true);
+		return true;
+	}
+	restore_interrupts(state);
+
+	return false;
+}
+
+
 const char*
 EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 {
@@ -227,6 +386,87 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 }
 
 
+/*static*/ void
+EntryCache::GetStatistics(entry_cache_stats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		const entry_cache_stats& cpuStats = sStatistics[i].stats;
+		stats.lookups += cpuStats.lookups;
+		stats.hits += cpuStats.hits;
+		stats.lockless_hits += cpuStats.lockless_hits;
+		stats.negative_hits += cpuStats.negative_hits;
+		stats.expired += cpuStats.expired;
+		stats.additions += cpuStats.additions;
+		stats.negative_additions += cpuStats.negative_additions;
+		stats.removals += cpuStats.removals;
+		stats.invalidations += cpuStats.invalidations;
+		stats.evictions += cpuStats.evictions;
+	}
+}
+
+
+status_t
+EntryCache::_Remove(ino_t dirID, const char* name, bool missingOnly)
+{
+	EntryCacheKey key(dirID, name);
+
+	// Let AddExpiring() know that a lookup that ran concurrently may have
+	// returned an outdated result. This must happen before we check for the
+	// entry, so that an entry added in the meantime is found.
+	atomic_add((int32*)&fChangeCounts[dirID % kChangeCountSlots], 1);
+
+	// The VFS tries to remove entries on every change, most of them aren't in
+	// the cache, though. So we check first without locking.
+	cpu_status state = disable_interrupts();
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	bool found = entry != NULL && (!missingOnly || entry->missing);
+	restore_interrupts(state);
+
+	if (!found)
+		return B_ENTRY_NOT_FOUND;
+
+	WriteLocker writeLocker(fLock);
+
+	entry = fEntries.Lookup(key);
+	if (entry == NULL || (missingOnly && !entry->missing))
+		return B_ENTRY_NOT_FOUND;
+
+	_RemoveEntry(entry);
+
+	if (missingOnly)
+		COUNT(invalidations);
+	else
+		COUNT(removals);
+
+	_FreeRetiredEntries();
+	return B_OK;
+}
+
+
+/*!	Removes the entry from the table. The caller must hold the write lock. */
+void
+EntryCache::_RemoveEntry(EntryCacheEntry* entry)
+{
+	fEntries.Remove(entry);
+	if (entry->missing)
+		fMissingCount--;
+
+	if (entry->index >= 0) {
+		// remove the entry from its generation and delete it
+		fGenerations[entry->generation].entries[entry->index] = NULL;
+		_RetireEntry(entry);
+	} else {
+		// We can't free it, since another thread is about to try to move it
+		// to another generation. We mark it removed and the other thread will
+		// take care of deleting it.
+		entry->index = kEntryRemoved;
+	}
+}
+
+
 void
 EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
@@ -248,7 +488,10 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 
 		fGenerations[newGeneration].entries[i] = NULL;
 		fEntries.Remove(otherEntry);
-		free(otherEntry);
+		if (otherEntry->missing)
+			fMissingCount--;
+		_RetireEntry(otherEntry);
+		COUNT(evictions);
 	}
 
 	// set the new generation and add the entry
@@ -258,3 +501,42 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+/*!	Queues a removed entry for deletion. Lockless lookups might still access
+	it, so it can't be freed right away. The caller must hold the write lock.
+*/
+void
+EntryCache::_RetireEntry(EntryCacheEntry* entry)
+{
+	entry->retired_link = fRetiredEntries;
+	fRetiredEntries = entry;
+	fRetiredCount++;
+}
+
+
+/*!	Frees the retired entries, if there are enough of them. The caller must
+	hold the write lock, and must not have interrupts disabled.
+*/
+void
+EntryCache::_FreeRetiredEntries()
+{
+	if (fRetiredCount < kMaxRetiredEntries)
+		return;
+
+	call_all_cpus_sync(&retired_entries_barrier, NULL);
+
+	while (fRetiredEntries != NULL) {
+		EntryCacheEntry* entry = fRetiredEntries;
+		fRetiredEntries = entry->retired_link;
+		free(entry);
+	}
+	fRetiredCount = 0;
+}
+
+
+/*static*/ bool
+EntryCache::_IsExpired(const EntryCacheEntry* entry)
+{
+	return entry->expiration != 0 && system_time() >= entry->expiration;
+}
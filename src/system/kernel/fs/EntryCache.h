@@ -12,6 +12,8 @@
 #include <util/OpenHashTable.h>
 #include <util/StringHash.h>
 
+#include <entry_cache_defs.h>
+
 
 struct EntryCacheKey {
 	EntryCacheKey(ino_t dirID, const char* name)
@@ -30,10 +32,17 @@ struct EntryCacheKey {
 };
 
 
+/*!	Once inserted into the hash table, an entry's node_id, dir_id, missing,
+	expiration, and name fields are never changed anymore, since they might be
+	read without holding the cache's lock.
+*/
 struct EntryCacheEntry {
 			EntryCacheEntry*	hash_link;
+			EntryCacheEntry*	retired_link;
 			ino_t				node_id;
 			ino_t				dir_id;
+			bigtime_t			expiration;
+				// 0, if the entry doesn't expire
 			int32				generation;
 			int32				index;
 			bool				missing;
@@ -89,29 +98,64 @@ public:
 
 			status_t			Add(ino_t dirID, const char* name,
 									ino_t nodeID, bool missing);
+			status_t			AddExpiring(ino_t dirID, const char* name,
+									ino_t nodeID, bool missing,
+									uint32 changeCount);
+			uint32				ChangeCount(ino_t dirID) const;
 
 			status_t			Remove(ino_t dirID, const char* name);
+			status_t			RemoveMissing(ino_t dirID, const char* name);
 
 			bool				Lookup(ino_t dirID, const char* name,
 									ino_t& nodeID, bool& missing);
+			bool				LookupLockless(ino_t dirID, const char* name,
+									ino_t& nodeID, bool& missing);
+
+			int32				CountEntries() const
+									{ return fEntries.CountElements(); }
+			int32				CountMissingEntries() const
+									{ return fMissingCount; }
 
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
+	static	void				GetStatistics(entry_cache_stats& stats);
+
 private:
 	static	const int32			kGenerationCount = 8;
+	static	const int32			kChangeCountSlots = 64;
 
-			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
+			typedef BOpenHashTable<EntryCacheHashDefinition, false> EntryTable;
+				// The table must never be resized, as it is accessed without
+				// holding the lock.
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
 
 private:
+			status_t			_Add(ino_t dirID, const char* name,
+									ino_t nodeID, bool missing,
+									bigtime_t expiration);
+			bool				_LookupLockless(const EntryCacheKey& key,
+									ino_t& nodeID, bool& missing);
+			status_t			_Remove(ino_t dirID, const char* name,
+									bool missingOnly);
+			void				_RemoveEntry(EntryCacheEntry* entry);
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			void				_RetireEntry(EntryCacheEntry* entry);
+			void				_FreeRetiredEntries();
+
+	static	bool				_IsExpired(const EntryCacheEntry* entry);
 
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+			int32				fMissingCount;
+			EntryCacheEntry*	fRetiredEntries;
+			int32				fRetiredCount;
+			uint32				fChangeCounts[kChangeCountSlots];
+				// incremented for every change the file system announces
+				// in a directory, indexed by the directory's ID
 };
 
 
@@ -60,6 +60,10 @@ public:
 	inline	bool				IsCovering() const;
 	inline	void				SetCovering(bool covering);
 
+	// lockless; only a hint for the lockless path walk
+	inline	bool				IsSearchable() const;
+	inline	void				SetSearchable(bool searchable);
+
 	inline	uint32				Type() const;
 	inline	void				SetType(uint32 type);
 
@@ -78,6 +82,8 @@ private:
 	static	const uint32		kFlagsHot			= 0x00000040;
 	static	const uint32		kFlagsCovered		= 0x00000080;
 	static	const uint32		kFlagsCovering		= 0x00000100;
+	static	const uint32		kFlagsSearchable	= 0x00000200;
+		// the file system has granted root search permission
 	static	const uint32		kFlagsType			= 0xfffff000;
 
 	static	const uint32		kBucketCount		= 32;
@@ -229,6 +235,23 @@ vnode::SetCovering(bool covering)
 }
 
 
+bool
+vnode::IsSearchable() const
+{
+	return (fFlags & kFlagsSearchable) != 0;
+}
+
+
+void
+vnode::SetSearchable(bool searchable)
+{
+	if (searchable)
+		atomic_or(&fFlags, kFlagsSearchable);
+	else
+		atomic_and(&fFlags, ~kFlagsSearchable);
+}
+
+
 uint32
 vnode::Type() const
 {
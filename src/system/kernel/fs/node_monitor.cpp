@@ -1154,6 +1154,8 @@ status_t
 notify_entry_created(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_cache_entry_created(device, directory, name);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_CREATED,
 		device, directory, name, node);
 }
@@ -1172,6 +1174,8 @@ status_t
 notify_entry_removed(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_cache_entry_removed(device, directory, name);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_REMOVED,
 		device, directory, name, node);
 }
@@ -1193,6 +1197,12 @@ notify_entry_moved(dev_t device, ino_t fromDirectory,
 	const char *fromName, ino_t toDirectory, const char *toName,
 	ino_t node)
 {
+	vfs_entry_cache_entry_removed(device, fromDirectory, fromName);
+	vfs_entry_cache_entry_removed(device, toDirectory, toName);
+		// the move might have replaced an existing entry
+	if (fromDirectory != toDirectory)
+		vfs_entry_cache_entry_removed(device, node, "..");
+
 	return sNodeMonitorService.NotifyEntryMoved(device, fromDirectory,
 		fromName, toDirectory, toName, node);
 }
@@ -1213,6 +1223,9 @@ status_t
 notify_stat_changed(dev_t device, ino_t directory, ino_t node,
 	uint32 statFields)
 {
+	if ((statFields & (B_STAT_MODE | B_STAT_UID | B_STAT_GID)) != 0)
+		vfs_node_permissions_changed(device, node);
+
 	return sNodeMonitorService.NotifyStatChanged(device, directory, node,
 		statFields);
 }
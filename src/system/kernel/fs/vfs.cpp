@@ -26,12 +26,14 @@
 #include <fs_info.h>
 #include <fs_interface.h>
 #include <fs_volume.h>
+#include <NodeMonitor.h>
 #include <OS.h>
 #include <StorageDefs.h>
 
 #include <AutoDeleter.h>
 #include <block_cache.h>
 #include <boot/kernel_args.h>
+#include <cpu.h>
 #include <debug_heap.h>
 #include <disk_device_manager/KDiskDevice.h>
 #include <disk_device_manager/KDiskDeviceManager.h>
@@ -40,9 +42,11 @@
 #include <fd.h>
 #include <file_cache.h>
 #include <fs/node_monitor.h>
+#include <generic_syscall.h>
 #include <KPath.h>
 #include <lock.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <syscalls.h>
 #include <syscall_restart.h>
 #include <tracing.h>
@@ -110,6 +114,9 @@ const static size_t kMaxPathLength = 65536;
 	// The absolute maximum path length (for getcwd() - this is not depending
 	// on PATH_MAX
 
+const static size_t kMaxReadDirStatBufferSize = 64 * 1024;
+	// The maximum buffer size _user_read_dir_stat() fills in one call
+
 
 typedef DoublyLinkedList<vnode> VnodeList;
 
@@ -129,7 +136,8 @@ struct fs_mount {
 	fs_mount()
 		:
 		volume(NULL),
-		device_name(NULL)
+		device_name(NULL),
+		cache_lookups(false)
 	{
 		recursive_lock_init(&rlock, "mount rlock");
 	}
@@ -164,6 +172,9 @@ struct fs_mount {
 	EntryCache		entry_cache;
 	bool			unmounting;
 	bool			owns_file_device;
+	bool			cache_lookups;
+		// the file system announces all entry changes, so the VFS may
+		// cache its lookups, too
 };
 
 
@@ -248,6 +259,8 @@ static rw_lock sVnodeLock = RW_LOCK_INITIALIZER("vfs_vnode_lock");
 	Must be held when setting or getting the io_context::root field.
 	The only operation allowed while holding this lock besides getting or
 	setting the field is inc_vnode_ref_count() on io_context::root.
+	The lockless path walk reads the field without holding the lock, but with
+	sVnodeLock read locked, which guarantees that the vnode stays valid.
 */
 static mutex sIOContextRootLock = MUTEX_INITIALIZER("io_context::root lock");
 
@@ -330,6 +343,27 @@ static struct vnode* sRoot;
 static MountTable* sMountsTable;
 static dev_t sNextMountID = 1;
 
+/*!	\brief Whether paths are resolved without acquiring references to the
+	directories on the way, if possible (cf. lockless_path_walk()).
+*/
+static bool sLocklessPathWalk = true;
+
+/*!	\brief Sequence counter for changes of node permissions.
+
+	Whenever the permissions of a node might have changed, the counter is
+	incremented and the node's "searchable" hint is cleared. While the change
+	is in progress, sPermissionWriters is non-zero.
+*/
+static int32 sPermissionChanges = 0;
+static int32 sPermissionWriters = 0;
+
+struct path_walk_stats {
+	int64	walks;
+	int64	lockless_walks;
+} CACHE_LINE_ALIGN;
+
+static path_walk_stats sPathWalkStats[SMP_MAX_CPUS];
+
 #define MAX_TEMP_IO_VECS 8
 
 // How long to wait for busy vnodes (10s)
@@ -2085,11 +2119,29 @@ lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 	bool missing;
 
 	if (dir->mount->entry_cache.Lookup(dir->id, name, id, missing)) {
-		return missing ? B_ENTRY_NOT_FOUND
-			: get_vnode(dir->device, id, _vnode, true, false);
+		if (missing)
+			return B_ENTRY_NOT_FOUND;
+
+		status_t status = get_vnode(dir->device, id, _vnode, true, false);
+		if (status == B_OK)
+			return B_OK;
+
+		// the entry might be stale -- ask the file system
+		dir->mount->entry_cache.Remove(dir->id, name);
 	}
 
+	// If the file system announces all changes of its entries, remember the
+	// result for a while -- the entry will be removed when the file system
+	// announces a change of it, if it didn't already add it itself.
+	EntryCache& entryCache = dir->mount->entry_cache;
+	bool cacheLookup = dir->mount->cache_lookups;
+	uint32 changeCount = cacheLookup ? entryCache.ChangeCount(dir->id) : 0;
+
 	status_t status = FS_CALL(dir, lookup, name, &id);
+	if (cacheLookup && status == B_ENTRY_NOT_FOUND)
+		entryCache.AddExpiring(dir->id, name, -1, true, changeCount);
+	else if (cacheLookup && status == B_OK)
+		entryCache.AddExpiring(dir->id, name, id, false, changeCount);
 	if (status != B_OK)
 		return status;
 
@@ -2113,6 +2165,154 @@ lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 }
 
 
+/*!	Remembers that the file system's access() hook granted search permission
+	for \a directory, so that the lockless path walk can skip the hook.
+	\a permissionChanges is the value of sPermissionChanges before the hook
+	was called. Since the hint is only valid for root, nothing is done for
+	other users.
+*/
+static void
+set_vnode_searchable(struct vnode* directory, int32 permissionChanges)
+{
+	if (geteuid() != 0 || atomic_get(&sPermissionWriters) != 0)
+		return;
+
+	directory->SetSearchable(true);
+
+	// if the permissions might have changed in the meantime, revert
+	if (atomic_get(&sPermissionChanges) != permissionChanges
+		|| atomic_get(&sPermissionWriters) != 0) {
+		directory->SetSearchable(false);
+	}
+}
+
+
+/*!	Calls the file system's write_stat() hook, and invalidates the
+	"searchable" hint of the vnode, if its permissions are changed.
+*/
+static status_t
+write_vnode_stat(struct vnode* vnode, const struct stat* stat, int statMask)
+{
+	if (!HAS_FS_CALL(vnode, write_stat))
+		return B_READ_ONLY_DEVICE;
+
+	if ((statMask & (B_STAT_MODE | B_STAT_UID | B_STAT_GID)) == 0)
+		return FS_CALL(vnode, write_stat, stat, statMask);
+
+	atomic_add(&sPermissionWriters, 1);
+	atomic_add(&sPermissionChanges, 1);
+
+	status_t status = FS_CALL(vnode, write_stat, stat, statMask);
+
+	vnode->SetSearchable(false);
+	atomic_add(&sPermissionChanges, 1);
+	atomic_add(&sPermissionWriters, -1);
+
+	return status;
+}
+
+
+/*!	Tries to resolve \a path starting at \a start without acquiring
+	references to or locking the directories on the way.
+	Only entries in the EntryCache, vnodes that are already loaded, and
+	directories that are known to be searchable (cf. set_vnode_searchable())
+	are used. Symbolic links, and ".." are left to vnode_path_to_vnode().
+
+	The caller must hold sVnodeLock read locked, which guarantees that
+	\a start and all vnodes found in the hash table stay valid. \a path is not
+	modified.
+
+	\return \c B_OK with a reference to the vnode acquired for the caller,
+		\c B_ENTRY_NOT_FOUND, if a missing entry was found in the entry cache,
+		or \c B_WOULD_BLOCK, if the path has to be resolved the regular way.
+*/
+static status_t
+lockless_path_walk(struct vnode* start, const char* path,
+	bool traverseLeafLink, struct vnode** _vnode, ino_t* _parentID)
+{
+	if (geteuid() != 0)
+		return B_WOULD_BLOCK;
+
+	struct vnode* vnode = start;
+	ino_t parentID = start->id;
+
+	while (*path != '\0') {
+		// copy the next path component and skip the slashes after it
+		char name[B_FILE_NAME_LENGTH];
+		size_t length = 0;
+		while (path[length] != '\0' && path[length] != '/') {
+			if (length == B_FILE_NAME_LENGTH - 1)
+				return B_WOULD_BLOCK;
+			name[length] = path[length];
+			length++;
+		}
+		name[length] = '\0';
+
+		path += length;
+		while (*path == '/')
+			path++;
+
+		if (strcmp(name, "..") == 0)
+			return B_WOULD_BLOCK;
+
+		if (vnode->IsBusy() || !S_ISDIR(vnode->Type())
+			|| (HAS_FS_CALL(vnode, access) && !vnode->IsSearchable())) {
+			return B_WOULD_BLOCK;
+		}
+
+		ino_t id;
+		bool missing;
+		if (!vnode->mount->entry_cache.LookupLockless(vnode->id, name, id,
+				missing)) {
+			return B_WOULD_BLOCK;
+		}
+		if (missing)
+			return B_ENTRY_NOT_FOUND;
+
+		struct vnode* nextVnode = lookup_vnode(vnode->device, id);
+		if (nextVnode == NULL || nextVnode->IsBusy())
+			return B_WOULD_BLOCK;
+
+		if (S_ISLNK(nextVnode->Type())
+			&& (traverseLeafLink || *path != '\0')) {
+			return B_WOULD_BLOCK;
+		}
+
+		parentID = vnode->id;
+		vnode = nextVnode;
+
+		// see if we hit a covered node
+		while (vnode->covered_by != NULL)
+			vnode = vnode->covered_by;
+	}
+
+	// acquire a reference to the vnode we found, like get_vnode() does
+	AutoLocker<Vnode> nodeLocker(vnode);
+	if (vnode->IsBusy())
+		return B_WOULD_BLOCK;
+
+	if (vnode->ref_count == 0)
+		vnode_used(vnode);
+	inc_vnode_ref_count(vnode);
+
+	*_vnode = vnode;
+	if (_parentID != NULL)
+		*_parentID = parentID;
+
+	return B_OK;
+}
+
+
+static inline void
+count_path_walk(bool lockless)
+{
+	path_walk_stats& stats = sPathWalkStats[smp_get_current_cpu()];
+	atomic_add64(&stats.walks, 1);
+	if (lockless)
+		atomic_add64(&stats.lockless_walks, 1);
+}
+
+
 /*!	Returns the vnode for the relative path starting at the specified \a vnode.
 	\a path must not be NULL.
 	If it returns successfully, \a path contains the name of the last path
@@ -2141,6 +2341,9 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		return B_ENTRY_NOT_FOUND;
 	}
 
+	if (count == 0)
+		count_path_walk(false);
+
 	while (true) {
 		struct vnode* nextVnode;
 		char* nextPath;
@@ -2188,8 +2391,12 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		// Check if we have the right to search the current directory vnode.
 		// If a file system doesn't have the access() function, we assume that
 		// searching a directory is always allowed
-		if (status == B_OK && HAS_FS_CALL(vnode, access))
+		if (status == B_OK && HAS_FS_CALL(vnode, access)) {
+			int32 permissionChanges = atomic_get(&sPermissionChanges);
 			status = FS_CALL(vnode, access, X_OK);
+			if (status == B_OK && !vnode->IsSearchable())
+				set_vnode_searchable(vnode, permissionChanges);
+		}
 
 		// Tell the filesystem to get the vnode of this path component (if we
 		// got the permission from the call above)
@@ -2309,6 +2516,19 @@ static status_t
 vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 	int count, bool kernel, struct vnode** _vnode, ino_t* _parentID)
 {
+	if (count == 0 && sLocklessPathWalk && path != NULL && *path != '\0') {
+		rw_lock_read_lock(&sVnodeLock);
+		status_t status = lockless_path_walk(vnode, path, traverseLeafLink,
+			_vnode, _parentID);
+		rw_lock_read_unlock(&sVnodeLock);
+
+		if (status != B_WOULD_BLOCK) {
+			count_path_walk(true);
+			put_vnode(vnode);
+			return status;
+		}
+	}
+
 	return vnode_path_to_vnode(vnode, path, traverseLeafLink, count,
 		get_current_io_context(kernel), _vnode, _parentID);
 }
@@ -2328,6 +2548,33 @@ path_to_vnode(char* path, bool traverseLink, struct vnode** _vnode,
 	if (*path == '\0')
 		return B_ENTRY_NOT_FOUND;
 
+	if (sLocklessPathWalk && sRoot != NULL) {
+		// Try to resolve the path without referencing the root or the current
+		// directory either: the lockless path walk holds sVnodeLock, so they
+		// stay valid, even if they are changed in the meantime.
+		struct io_context* context = get_current_io_context(kernel);
+		const char* relativePath = path;
+		if (*relativePath == '/') {
+			while (*++relativePath == '/')
+				;
+			start = kernel || context->root == NULL ? sRoot : context->root;
+		} else
+			start = context->cwd;
+
+		if (start != NULL && *relativePath != '\0') {
+			rw_lock_read_lock(&sVnodeLock);
+			status_t status = lockless_path_walk(start, relativePath,
+				traverseLink, _vnode, _parentID);
+			rw_lock_read_unlock(&sVnodeLock);
+
+			if (status != B_WOULD_BLOCK) {
+				count_path_walk(true);
+				return status;
+			}
+		}
+		start = NULL;
+	}
+
 	// figure out if we need to start at root or at cwd
 	if (*path == '/') {
 		if (sRoot == NULL) {
@@ -2357,8 +2604,9 @@ path_to_vnode(char* path, bool traverseLink, struct vnode** _vnode,
 			return B_ERROR;
 	}
 
-	return vnode_path_to_vnode(start, path, traverseLink, 0, kernel, _vnode,
-		_parentID);
+	// the lockless path walk has already been tried
+	return vnode_path_to_vnode(start, path, traverseLink, 0,
+		get_current_io_context(kernel), _vnode, _parentID);
 }
 
 
@@ -2967,6 +3215,29 @@ resolve_covered_parent(struct vnode* parent, dev_t* _device, ino_t* _node,
 }
 
 
+/*!	Collects the entry cache statistics of all mounts.
+	The caller must hold sMountMutex, or be in the kernel debugger.
+*/
+static void
+get_entry_cache_stats(entry_cache_stats& stats)
+{
+	EntryCache::GetStatistics(stats);
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		stats.path_walks += sPathWalkStats[i].walks;
+		stats.lockless_path_walks += sPathWalkStats[i].lockless_walks;
+	}
+
+	MountTable::Iterator iterator(sMountsTable);
+	while (iterator.HasNext()) {
+		struct fs_mount* mount = iterator.Next();
+		stats.entries += mount->entry_cache.CountEntries();
+		stats.negative_entries += mount->entry_cache.CountMissingEntries();
+	}
+}
+
+
 #ifdef ADD_DEBUGGER_COMMANDS
 
 
@@ -3223,6 +3494,51 @@ dump_mounts(int argc, char** argv)
 }
 
 
+static int
+dump_entry_cache(int argc, char** argv)
+{
+	if (argc != 1) {
+		kprintf("usage: %s\n", argv[0]);
+		return 0;
+	}
+
+	entry_cache_stats stats;
+	get_entry_cache_stats(stats);
+
+	int64 misses = stats.lookups - stats.hits;
+	kprintf("lookups:            %" B_PRId64 "\n", stats.lookups);
+	kprintf("hits:               %" B_PRId64 " (%" B_PRId64 "%%)\n", stats.hits,
+		stats.lookups > 0 ? stats.hits * 100 / stats.lookups : 0);
+	kprintf("  lockless:         %" B_PRId64 "\n", stats.lockless_hits);
+	kprintf("  negative:         %" B_PRId64 "\n", stats.negative_hits);
+	kprintf("misses:             %" B_PRId64 "\n", misses);
+	kprintf("  expired:          %" B_PRId64 "\n", stats.expired);
+	kprintf("additions:          %" B_PRId64 "\n", stats.additions);
+	kprintf("negative additions: %" B_PRId64 "\n", stats.negative_additions);
+	kprintf("removals:           %" B_PRId64 "\n", stats.removals);
+	kprintf("invalidations:      %" B_PRId64 "\n", stats.invalidations);
+	kprintf("evictions:          %" B_PRId64 "\n", stats.evictions);
+	kprintf("entries:            %" B_PRId32 " (%" B_PRId32 " negative)\n",
+		stats.entries, stats.negative_entries);
+	kprintf("path walks:         %" B_PRId64 " (%" B_PRId64 " lockless%s)\n\n",
+		stats.path_walks, stats.lockless_path_walks,
+		sLocklessPathWalk ? "" : ", disabled");
+
+	kprintf("   id   entries  negative   fs_name\n");
+
+	MountTable::Iterator iterator(sMountsTable);
+	while (iterator.HasNext()) {
+		struct fs_mount* mount = iterator.Next();
+		kprintf("%5" B_PRIdDEV " %9" B_PRId32 " %9" B_PRId32 "   %s\n", mount->id,
+			mount->entry_cache.CountEntries(),
+			mount->entry_cache.CountMissingEntries(),
+			mount->volume->file_system_name);
+	}
+
+	return 0;
+}
+
+
 static int
 dump_vnode(int argc, char** argv)
 {
@@ -4124,6 +4440,23 @@ entry_cache_add_missing(dev_t mountID, ino_t dirID, const char* name)
 }
 
 
+/*!	Tells the VFS that the file system announces every change of its entries
+	via the node monitor, so that it can cache all lookups on the volume, too.
+	Meant to be called from the file system's mount() hook.
+*/
+extern "C" status_t
+entry_cache_set_lookup_caching(dev_t mountID, bool enabled)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return B_BAD_VALUE;
+
+	mount->cache_lookups = enabled;
+	return B_OK;
+}
+
+
 extern "C" status_t
 entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 {
@@ -4139,6 +4472,97 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 }
 
 
+static status_t
+entry_cache_control(const char* subsystem, uint32 function, void* buffer,
+	size_t bufferSize)
+{
+	switch (function) {
+		case ENTRY_CACHE_GET_STATS:
+		{
+			if (bufferSize < sizeof(entry_cache_stats))
+				return B_BAD_VALUE;
+			if (buffer == NULL || !IS_USER_ADDRESS(buffer))
+				return B_BAD_ADDRESS;
+
+			entry_cache_stats stats;
+			MutexLocker locker(sMountMutex);
+			get_entry_cache_stats(stats);
+			locker.Unlock();
+
+			return user_memcpy(buffer, &stats, sizeof(stats));
+		}
+
+		case ENTRY_CACHE_SET_LOCKLESS_PATH_WALK:
+		{
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			int32 enabled;
+			if (bufferSize < sizeof(enabled))
+				return B_BAD_VALUE;
+			if (buffer == NULL || !IS_USER_ADDRESS(buffer)
+				|| user_memcpy(&enabled, buffer, sizeof(enabled)) != B_OK) {
+				return B_BAD_ADDRESS;
+			}
+
+			sLocklessPathWalk = enabled != 0;
+			return B_OK;
+		}
+	}
+
+	return B_BAD_HANDLER;
+}
+
+
+/*!	Invalidates the "searchable" hint of the given node. Called by the node
+	monitor whenever the permissions of a node have been changed.
+*/
+void
+vfs_node_permissions_changed(dev_t mountID, ino_t vnodeID)
+{
+	atomic_add(&sPermissionChanges, 1);
+
+	ReadLocker locker(sVnodeLock);
+	struct vnode* vnode = lookup_vnode(mountID, vnodeID);
+	if (vnode != NULL)
+		vnode->SetSearchable(false);
+}
+
+
+/*!	Removes a missing entry \a name in directory \a dirID from the entry
+	cache. Called by the node monitor whenever an entry has been created.
+	The caller is required to make sure that the mount won't go away.
+*/
+void
+vfs_entry_cache_entry_created(dev_t mountID, ino_t dirID, const char* name)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.RemoveMissing(dirID, name);
+}
+
+
+/*!	Removes the entry \a name in directory \a dirID from the entry cache.
+	Called by the node monitor whenever an entry has been removed, or moved
+	away. The caller is required to make sure that the mount won't go away.
+*/
+void
+vfs_entry_cache_entry_removed(dev_t mountID, ino_t dirID, const char* name)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.Remove(dirID, name);
+}
+
+
 //	#pragma mark - private VFS API
 //	Functions the VFS exports for other parts of the kernel
 
@@ -5299,8 +5723,12 @@ vfs_init(kernel_args* args)
 		"info about the I/O context");
 	add_debugger_command("vnode_usage", &dump_vnode_usage,
 		"info about vnode usage");
+	add_debugger_command("entry_cache", &dump_entry_cache,
+		"entry cache statistics");
 #endif
 
+	register_generic_syscall(ENTRY_CACHE_SYSCALLS, entry_cache_control, 1, 0);
+
 	register_low_resource_handler(&vnode_low_resource_handler, NULL,
 		B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY
 			| B_KERNEL_RESOURCE_ADDRESS_SPACE,
@@ -6522,10 +6950,7 @@ common_write_stat(struct file_descriptor* descriptor, const struct stat* stat,
 	FUNCTION(("common_write_stat(vnode = %p, stat = %p, statMask = %d)\n",
 		vnode, stat, statMask));
 
-	if (!HAS_FS_CALL(vnode, write_stat))
-		return B_READ_ONLY_DEVICE;
-
-	return FS_CALL(vnode, write_stat, stat, statMask);
+	return write_vnode_stat(vnode, stat, statMask);
 }
 
 
@@ -6562,10 +6987,7 @@ common_path_write_stat(int fd, char* path, bool traverseLeafLink,
 	if (status != B_OK)
 		return status;
 
-	if (HAS_FS_CALL(vnode, write_stat))
-		status = FS_CALL(vnode, write_stat, stat, statMask);
-	else
-		status = B_READ_ONLY_DEVICE;
+	status = write_vnode_stat(vnode, stat, statMask);
 
 	put_vnode(vnode);
 
@@ -9546,6 +9968,221 @@ _user_write_stat(int fd, const char* userPath, bool traverseLeafLink,
 }
 
 
+/*!	Reads up to \a maxSize bytes of the attribute \a name of \a vnode into
+	\a buffer, and describes the result in \a attribute.
+*/
+static void
+read_dir_stat_attribute(struct vnode* vnode, const char* name, void* buffer,
+	size_t maxSize, dirent_stat_attr& attribute)
+{
+	attribute.type = 0;
+
+	if (!HAS_FS_CALL(vnode, open_attr) || !HAS_FS_CALL(vnode, read_attr)
+		|| !HAS_FS_CALL(vnode, read_attr_stat)) {
+		attribute.size = B_UNSUPPORTED;
+		return;
+	}
+
+	void* cookie;
+	status_t status = FS_CALL(vnode, open_attr, name, O_RDONLY, &cookie);
+	if (status != B_OK) {
+		attribute.size = status;
+		return;
+	}
+
+	struct stat stat;
+	status = FS_CALL(vnode, read_attr_stat, cookie, &stat);
+	if (status == B_OK) {
+		attribute.type = stat.st_type;
+
+		size_t length = min_c((off_t)maxSize, stat.st_size);
+		status = FS_CALL(vnode, read_attr, cookie, 0, buffer, &length);
+		if (status == B_OK)
+			attribute.size = length;
+	}
+	if (status != B_OK)
+		attribute.size = status;
+
+	if (HAS_FS_CALL(vnode, close_attr))
+		FS_CALL(vnode, close_attr, cookie);
+	if (HAS_FS_CALL(vnode, free_attr_cookie))
+		FS_CALL(vnode, free_attr_cookie, cookie);
+}
+
+
+/*!	Checks if the calling team may search the directory \a device,
+	\a directory, as it would need to in order to stat() its entries.
+*/
+static status_t
+check_read_dir_stat_access(dev_t device, ino_t directory)
+{
+	struct vnode* vnode;
+	status_t status = get_vnode(device, directory, &vnode, true, false);
+	if (status != B_OK)
+		return status;
+
+	// If a file system doesn't have the access() function, we assume that
+	// searching a directory is always allowed
+	if (HAS_FS_CALL(vnode, access))
+		status = FS_CALL(vnode, access, X_OK);
+
+	put_vnode(vnode);
+	return status;
+}
+
+
+/*!	Reads the next entries of a directory or query like _user_read_dir()
+	does, but also returns the stat, and the first \a maxAttributeSize bytes
+	of the given attributes of each entry. \a userAttributes contains the
+	names of the attributes, separated by null bytes.
+	This saves a listing that needs all of this a stat() and several
+	attribute syscalls per entry.
+*/
+ssize_t
+_user_read_dir_stat(int fd, struct dirent_stat* userBuffer, size_t bufferSize,
+	uint32 maxCount, const char* userAttributes, size_t attributesLength,
+	size_t maxAttributeSize)
+{
+	if (maxCount == 0)
+		return 0;
+
+	if (userBuffer == NULL || !IS_USER_ADDRESS(userBuffer)
+		|| (userAttributes != NULL && !IS_USER_ADDRESS(userAttributes)))
+		return B_BAD_ADDRESS;
+
+	if (userAttributes == NULL)
+		attributesLength = 0;
+	if (attributesLength
+			> VFS_READ_DIR_STAT_MAX_ATTRIBUTES * B_ATTR_NAME_LENGTH)
+		return B_BAD_VALUE;
+	if (maxAttributeSize > VFS_READ_DIR_STAT_MAX_ATTRIBUTE_SIZE)
+		maxAttributeSize = VFS_READ_DIR_STAT_MAX_ATTRIBUTE_SIZE;
+
+	// copy the attribute names
+	char* attributes = (char*)malloc(attributesLength + 1);
+	if (attributes == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter attributesDeleter(attributes);
+
+	if (attributesLength > 0
+		&& user_memcpy(attributes, userAttributes, attributesLength) != B_OK)
+		return B_BAD_ADDRESS;
+	attributes[attributesLength] = '\0';
+
+	const char* names[VFS_READ_DIR_STAT_MAX_ATTRIBUTES];
+	int32 attributeCount = 0;
+	for (size_t offset = 0; offset < attributesLength;) {
+		const char* name = attributes + offset;
+		size_t length = strlen(name);
+		if (length == 0 || length >= B_ATTR_NAME_LENGTH
+			|| attributeCount == VFS_READ_DIR_STAT_MAX_ATTRIBUTES)
+			return B_BAD_VALUE;
+
+		names[attributeCount++] = name;
+		offset += length + 1;
+	}
+
+	// restrict the buffer size, and only read as many entries as are
+	// guaranteed to fit
+	if (bufferSize > kMaxReadDirStatBufferSize)
+		bufferSize = kMaxReadDirStatBufferSize;
+
+	size_t maxRecordSize = ROUNDUP(sizeof(dirent_stat) + B_FILE_NAME_LENGTH, 8)
+		+ attributeCount
+			* ROUNDUP(sizeof(dirent_stat_attr) + maxAttributeSize, 8);
+	uint32 count = min_c(maxCount, bufferSize / maxRecordSize);
+	if (count == 0)
+		return B_BUFFER_OVERFLOW;
+
+	size_t direntsSize = count * (sizeof(struct dirent) + B_FILE_NAME_LENGTH);
+	uint8* buffer = (uint8*)calloc(1, bufferSize + direntsSize);
+		// the records are padded, and must not leak any kernel memory
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter bufferDeleter(buffer);
+
+	// read the entries
+	io_context* ioContext = get_current_io_context(false);
+	struct file_descriptor* descriptor = get_fd(ioContext, fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	struct dirent* entry = (struct dirent*)(buffer + bufferSize);
+	status_t status;
+	if ((descriptor->open_mode & O_DISCONNECTED) != 0)
+		status = B_FILE_ERROR;
+	else if (descriptor->ops->fd_read_dir == NULL)
+		status = B_UNSUPPORTED;
+	else {
+		status = descriptor->ops->fd_read_dir(ioContext, descriptor, entry,
+			direntsSize, &count);
+	}
+
+	put_fd(descriptor);
+
+	if (status != B_OK)
+		return status;
+
+	// Entries of a query can live in any directory, so the permission to
+	// search the parent directory is checked for each of them
+	dev_t checkedDevice = -1;
+	ino_t checkedDirectory = -1;
+	status_t accessStatus = B_OK;
+
+	size_t offset = 0;
+	for (uint32 i = 0; i < count; i++) {
+		dirent_stat* record = (dirent_stat*)(buffer + offset);
+		memcpy(&record->dirent, entry, entry->d_reclen);
+
+		size_t length = ROUNDUP(offsetof(dirent_stat, dirent)
+			+ entry->d_reclen, 8);
+		record->attr_offset = length;
+
+		if (entry->d_pdev != checkedDevice
+			|| entry->d_pino != checkedDirectory) {
+			checkedDevice = entry->d_pdev;
+			checkedDirectory = entry->d_pino;
+			accessStatus = check_read_dir_stat_access(checkedDevice,
+				checkedDirectory);
+		}
+
+		struct vnode* vnode;
+		record->status = accessStatus;
+		if (record->status == B_OK) {
+			record->status = get_vnode(entry->d_dev, entry->d_ino, &vnode,
+				true, false);
+		}
+		VNodePutter vnodePutter(record->status == B_OK ? vnode : NULL);
+		if (record->status == B_OK)
+			record->status = vfs_stat_vnode(vnode, &record->stat);
+
+		for (int32 j = 0; j < attributeCount; j++) {
+			dirent_stat_attr* attribute
+				= (dirent_stat_attr*)((uint8*)record + length);
+			if (record->status == B_OK) {
+				read_dir_stat_attribute(vnode, names[j], attribute + 1,
+					maxAttributeSize, *attribute);
+			} else {
+				attribute->type = 0;
+				attribute->size = record->status;
+			}
+
+			length += ROUNDUP(sizeof(dirent_stat_attr)
+				+ max_c(attribute->size, 0), 8);
+		}
+
+		record->reclen = length;
+		offset += length;
+		entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+	}
+
+	if (user_memcpy(userBuffer, buffer, offset) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return count;
+}
+
+
 int
 _user_open_attr_dir(int fd, const char* userPath, bool traverseLeafLink)
 {
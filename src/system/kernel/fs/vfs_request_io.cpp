@@ -365,6 +365,7 @@ synchronous_io(io_request* request, DoIO& io)
 		if (error != B_OK) {
 			TRACE_RIO("[%ld]   I/O failed: %#lx\n", find_thread(NULL), error);
 			buffer->FreeVirtualVecCookie(virtualVecCookie);
+			request->SetTransferredBytes(true, request->Length() - length);
 			request->SetStatusAndNotify(error);
 			return error;
 		}
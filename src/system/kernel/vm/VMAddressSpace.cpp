@@ -92,6 +92,7 @@ VMAddressSpace::VMAddressSpace(team_id id, addr_t base, size_t size,
 	fID(id),
 	fRefCount(1),
 	fFaultCount(0),
+	fFaultAroundPages(0),
 	fChangeCount(0),
 	fTranslationMap(NULL),
 	fRandomizingEnabled(true),
@@ -176,6 +177,7 @@ VMAddressSpace::Dump() const
 	kprintf("id: %" B_PRId32 "\n", fID);
 	kprintf("ref_count: %" B_PRId32 "\n", fRefCount);
 	kprintf("fault_count: %" B_PRId32 "\n", fFaultCount);
+	kprintf("fault_around_pages: %" B_PRId32 "\n", fFaultAroundPages);
 	kprintf("translation_map: %p\n", fTranslationMap);
 	kprintf("base: %#" B_PRIxADDR "\n", fBase);
 	kprintf("end: %#" B_PRIxADDR "\n", fEndAddress);
@@ -82,6 +82,18 @@
 #define SWAP_BLOCK_SHIFT 5		/* 1 << SWAP_BLOCK_SHIFT == SWAP_BLOCK_PAGES */
 #define SWAP_BLOCK_MASK  (SWAP_BLOCK_PAGES - 1)
 
+// maximum number of pages read ahead when a page is read from a swap file
+#define SWAP_READ_AHEAD_PAGES	16
+
+// slots starting with this one refer to the compressed swap tier rather than
+// to a swap file
+#define COMPRESSED_SWAP_FIRST_SLOT	0x80000000
+
+// The compressed swap tier stores pages in size classes of this granularity.
+// Pages that don't compress into the largest class go to a swap file.
+#define COMPRESSED_SWAP_CLASS_SIZE	512
+#define COMPRESSED_SWAP_CLASSES		6
+
 
 static const char* const kDefaultSwapPath = "/var/swap";
 
@@ -155,6 +167,22 @@ static mutex sAvailSwapSpaceLock;
 
 static object_cache* sSwapBlockCache;
 
+static int64 sSwapPagesRead = 0;
+static int64 sSwapPagesWritten = 0;
+static int64 sSwapReadAheadPages = 0;
+
+// the compressed swap tier
+static mutex sCompressedSwapLock;
+static radix_bitmap* sCompressedSwapBitmap = NULL;
+static uint8** sCompressedSwapPages = NULL;
+	// compressed page data, indexed by slot, each prefixed by its size
+static object_cache* sCompressedSwapCaches[COMPRESSED_SWAP_CLASSES];
+static uint8 sCompressedSwapBuffer[COMPRESSED_SWAP_CLASSES
+	* COMPRESSED_SWAP_CLASS_SIZE];
+static off_t sCompressedSwapMaxSize = 0;
+static off_t sCompressedSwapSize = 0;
+static int64 sCompressedSwapPageCount = 0;
+
 
 #if SWAP_TRACING
 namespace SwapTracing {
@@ -254,10 +282,301 @@ dump_swap_info(int argc, char** argv)
 	kprintf("used:      %9" B_PRIu32 "\n", totalSwapPages - freeSwapPages);
 	kprintf("free:      %9" B_PRIu32 "\n", freeSwapPages);
 
+	if (sCompressedSwapBitmap != NULL) {
+		kprintf("\n");
+		kprintf("compressed swap:\n");
+		kprintf("pages:     %9" B_PRId64 "\n", sCompressedSwapPageCount);
+		kprintf("size:      %9" B_PRIdOFF "\n", sCompressedSwapSize);
+		kprintf("max size:  %9" B_PRIdOFF "\n", sCompressedSwapMaxSize);
+	}
+
 	return 0;
 }
 
 
+// #pragma mark - compressed swap
+
+
+static inline uint32
+compression_dictionary_index(uint32 word)
+{
+	return ((word >> 10) * 2654435761U) >> 28;
+}
+
+
+/*!	Compresses a page with a variant of the WK algorithm, which works well on
+	the kind of data usually found in anonymous memory: lots of zeros, small
+	integers, and pointers into the same few regions.
+	Each 32 bit word is looked up in a small dictionary of recently seen words
+	by its upper 22 bits, and is encoded as a 2 bit tag, followed by nothing
+	for a zero word, the dictionary index for an exact match, the index and
+	the lower 10 bits for a partial match, or the full word for a miss.
+	Returns the compressed size, or 0, if it would exceed \a maxSize.
+*/
+static size_t
+compress_page(const uint32* page, uint8* buffer, size_t maxSize)
+{
+	const uint32 kWordCount = B_PAGE_SIZE / sizeof(uint32);
+	const size_t kTagsSize = kWordCount / 4;
+	if (maxSize < kTagsSize)
+		return 0;
+
+	uint32 dictionary[16] = {};
+	uint8* tags = buffer;
+	memset(tags, 0, kTagsSize);
+	uint8* output = buffer + kTagsSize;
+	const uint8* outputEnd = buffer + maxSize;
+
+	for (uint32 i = 0; i < kWordCount; i++) {
+		uint32 word = page[i];
+		if (word == 0)
+			continue;
+
+		if (outputEnd - output < 4)
+			return 0;
+
+		uint32 index = compression_dictionary_index(word);
+		uint32 tag;
+		if (dictionary[index] == word) {
+			tag = 1;
+			*output++ = index;
+		} else if ((dictionary[index] >> 10) == (word >> 10)) {
+			tag = 2;
+			uint16 value = (index << 10) | (word & 0x3ff);
+			memcpy(output, &value, sizeof(value));
+			output += sizeof(value);
+			dictionary[index] = word;
+		} else {
+			tag = 3;
+			memcpy(output, &word, sizeof(word));
+			output += sizeof(word);
+			dictionary[index] = word;
+		}
+
+		tags[i / 4] |= tag << (i % 4 * 2);
+	}
+
+	return output - buffer;
+}
+
+
+static bool
+decompress_page(const uint8* buffer, size_t size, uint32* page)
+{
+	const uint32 kWordCount = B_PAGE_SIZE / sizeof(uint32);
+	const size_t kTagsSize = kWordCount / 4;
+	if (size < kTagsSize)
+		return false;
+
+	uint32 dictionary[16] = {};
+	const uint8* tags = buffer;
+	const uint8* input = buffer + kTagsSize;
+	const uint8* inputEnd = buffer + size;
+
+	for (uint32 i = 0; i < kWordCount; i++) {
+		uint32 word;
+		switch ((tags[i / 4] >> (i % 4 * 2)) & 0x3) {
+			case 0:
+				word = 0;
+				break;
+			case 1:
+				if (input == inputEnd)
+					return false;
+				word = dictionary[*input++ & 0xf];
+				break;
+			case 2:
+			{
+				if (inputEnd - input < 2)
+					return false;
+				uint16 value;
+				memcpy(&value, input, sizeof(value));
+				input += sizeof(value);
+				uint32 index = value >> 10;
+				word = (dictionary[index] & ~(uint32)0x3ff) | (value & 0x3ff);
+				dictionary[index] = word;
+				break;
+			}
+			default:
+				if (inputEnd - input < 4)
+					return false;
+				memcpy(&word, input, sizeof(word));
+				input += sizeof(word);
+				dictionary[compression_dictionary_index(word)] = word;
+				break;
+		}
+
+		page[i] = word;
+	}
+
+	return input == inputEnd;
+}
+
+
+static inline bool
+is_compressed_swap_slot(swap_addr_t slotIndex)
+{
+	return slotIndex != SWAP_SLOT_NONE
+		&& slotIndex >= COMPRESSED_SWAP_FIRST_SLOT;
+}
+
+
+/*!	Tries to store the given page in the compressed swap tier.
+	Returns the page's new swap slot, or \c SWAP_SLOT_NONE, if the tier is
+	disabled or full, or if the page doesn't compress well enough.
+*/
+static swap_addr_t
+compressed_swap_store(phys_addr_t pageAddress)
+{
+	MutexLocker locker(sCompressedSwapLock);
+
+	if (sCompressedSwapBitmap == NULL
+		|| sCompressedSwapSize + COMPRESSED_SWAP_CLASS_SIZE
+			> sCompressedSwapMaxSize) {
+		return SWAP_SLOT_NONE;
+	}
+
+	addr_t pageData;
+	void* handle;
+	if (vm_get_physical_page(pageAddress, &pageData, &handle) != B_OK)
+		return SWAP_SLOT_NONE;
+
+	// leave room for the size
+	size_t size = compress_page((const uint32*)pageData,
+		sCompressedSwapBuffer + sizeof(uint16),
+		sizeof(sCompressedSwapBuffer) - sizeof(uint16));
+
+	vm_put_physical_page(pageData, handle);
+
+	if (size == 0)
+		return SWAP_SLOT_NONE;
+
+	uint32 sizeClass = (size + sizeof(uint16) - 1) / COMPRESSED_SWAP_CLASS_SIZE;
+	size_t allocationSize = (sizeClass + 1) * COMPRESSED_SWAP_CLASS_SIZE;
+	if (sCompressedSwapSize + (off_t)allocationSize > sCompressedSwapMaxSize)
+		return SWAP_SLOT_NONE;
+
+	uint8* data = (uint8*)object_cache_alloc(sCompressedSwapCaches[sizeClass],
+		CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
+	if (data == NULL)
+		return SWAP_SLOT_NONE;
+
+	swap_addr_t slotIndex = radix_bitmap_alloc(sCompressedSwapBitmap, 1);
+	if (slotIndex == SWAP_SLOT_NONE) {
+		object_cache_free(sCompressedSwapCaches[sizeClass], data,
+			CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
+		return SWAP_SLOT_NONE;
+	}
+
+	uint16 storedSize = size;
+	memcpy(sCompressedSwapBuffer, &storedSize, sizeof(storedSize));
+	memcpy(data, sCompressedSwapBuffer, size + sizeof(uint16));
+
+	sCompressedSwapPages[slotIndex] = data;
+	sCompressedSwapSize += allocationSize;
+	sCompressedSwapPageCount++;
+
+	return slotIndex + COMPRESSED_SWAP_FIRST_SLOT;
+}
+
+
+static status_t
+compressed_swap_load(swap_addr_t slotIndex, phys_addr_t pageAddress)
+{
+	mutex_lock(&sCompressedSwapLock);
+	const uint8* data
+		= sCompressedSwapPages[slotIndex - COMPRESSED_SWAP_FIRST_SLOT];
+	mutex_unlock(&sCompressedSwapLock);
+		// The data can't go away while we're reading it, since the slot
+		// remains allocated until the page has been read in.
+
+	uint16 size;
+	memcpy(&size, data, sizeof(size));
+
+	addr_t pageData;
+	void* handle;
+	status_t status = vm_get_physical_page(pageAddress, &pageData, &handle);
+	if (status != B_OK)
+		return status;
+
+	if (!decompress_page(data + sizeof(uint16), size, (uint32*)pageData)) {
+		panic("compressed_swap_load(): corrupt page in slot %" B_PRIu32,
+			slotIndex);
+		status = B_BAD_DATA;
+	}
+
+	vm_put_physical_page(pageData, handle);
+	return status;
+}
+
+
+static void
+compressed_swap_free(swap_addr_t slotIndex)
+{
+	slotIndex -= COMPRESSED_SWAP_FIRST_SLOT;
+
+	MutexLocker locker(sCompressedSwapLock);
+
+	uint8* data = sCompressedSwapPages[slotIndex];
+	sCompressedSwapPages[slotIndex] = NULL;
+	radix_bitmap_dealloc(sCompressedSwapBitmap, slotIndex, 1);
+
+	uint16 size;
+	memcpy(&size, data, sizeof(size));
+	uint32 sizeClass = (size + sizeof(uint16) - 1) / COMPRESSED_SWAP_CLASS_SIZE;
+	sCompressedSwapSize -= (sizeClass + 1) * COMPRESSED_SWAP_CLASS_SIZE;
+	sCompressedSwapPageCount--;
+
+	locker.Unlock();
+
+	object_cache_free(sCompressedSwapCaches[sizeClass], data,
+		CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
+}
+
+
+/*!	Enables the compressed swap tier, which keeps up to \a size bytes of
+	compressed pages in memory, before pages are written to a swap file.
+*/
+static status_t
+compressed_swap_init(off_t size)
+{
+	// each stored page needs at least one allocation of the smallest class
+	uint32 slotCount = min_c(size / COMPRESSED_SWAP_CLASS_SIZE,
+		(off_t)(SWAP_SLOT_NONE - COMPRESSED_SWAP_FIRST_SLOT));
+	if (slotCount == 0)
+		return B_BAD_VALUE;
+
+	for (uint32 i = 0; i < COMPRESSED_SWAP_CLASSES; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "compressed swap %" B_PRIu32,
+			(i + 1) * COMPRESSED_SWAP_CLASS_SIZE);
+		sCompressedSwapCaches[i] = create_object_cache(name,
+			(i + 1) * COMPRESSED_SWAP_CLASS_SIZE, sizeof(void*), NULL, NULL,
+			NULL);
+		if (sCompressedSwapCaches[i] == NULL)
+			return B_NO_MEMORY;
+	}
+
+	uint8** pages = (uint8**)calloc(slotCount, sizeof(uint8*));
+	radix_bitmap* bitmap = radix_bitmap_create(slotCount);
+	if (pages == NULL || bitmap == NULL) {
+		free(pages);
+		if (bitmap != NULL)
+			radix_bitmap_destroy(bitmap);
+		return B_NO_MEMORY;
+	}
+
+	MutexLocker locker(sCompressedSwapLock);
+	sCompressedSwapPages = pages;
+	sCompressedSwapMaxSize = size;
+	sCompressedSwapBitmap = bitmap;
+
+	return B_OK;
+}
+
+
+// #pragma mark -
+
+
 static swap_addr_t
 swap_slot_alloc(uint32 count)
 {
@@ -293,7 +612,10 @@ swap_slot_alloc(uint32 count)
 
 	if (j == sSwapFileCount) {
 		mutex_unlock(&sSwapFileListLock);
-		panic("swap_slot_alloc: swap space exhausted!\n");
+		// The caller can still try to allocate the slots for a cluster
+		// one by one.
+		if (count == 1)
+			panic("swap_slot_alloc: swap space exhausted!\n");
 		return SWAP_SLOT_NONE;
 	}
 
@@ -333,6 +655,13 @@ swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 	if (slotIndex == SWAP_SLOT_NONE)
 		return;
 
+	if (is_compressed_swap_slot(slotIndex)) {
+		// compressed pages are always allocated one by one
+		ASSERT(count == 1);
+		compressed_swap_free(slotIndex);
+		return;
+	}
+
 	mutex_lock(&sSwapFileListLock);
 	swap_file* swapFile = find_swap_file(slotIndex);
 	slotIndex -= swapFile->first_slot;
@@ -403,28 +732,33 @@ public:
 	{
 	}
 
-	void SetTo(page_num_t pageIndex, swap_addr_t slotIndex, bool newSlot)
+	void SetTo(page_num_t pageIndex, swap_addr_t slotIndex, uint32 pageCount,
+		generic_size_t compressedBytes)
 	{
 		fPageIndex = pageIndex;
 		fSlotIndex = slotIndex;
-		fNewSlot = newSlot;
+		fPageCount = pageCount;
+		fCompressedBytes = compressedBytes;
 	}
 
 	virtual void IOFinished(status_t status, bool partialTransfer,
 		generic_size_t bytesTransferred)
 	{
-		if (fNewSlot) {
-			if (status == B_OK) {
-				fCache->_SwapBlockBuild(fPageIndex, fSlotIndex, 1);
-			} else {
-				AutoLocker<VMCache> locker(fCache);
-				fCache->fAllocatedSwapSize -= B_PAGE_SIZE;
-				locker.Unlock();
+		if (status == B_OK) {
+			fCache->_SwapBlockBuild(fPageIndex, fSlotIndex, fPageCount);
+			atomic_add64(&sSwapPagesWritten, fPageCount);
+		} else {
+			AutoLocker<VMCache> locker(fCache);
+			fCache->fAllocatedSwapSize -= (off_t)fPageCount * B_PAGE_SIZE;
+			locker.Unlock();
 
-				swap_slot_dealloc(fSlotIndex, 1);
-			}
+			swap_slot_dealloc(fSlotIndex, fPageCount);
 		}
 
+		// the leading pages of the request have already been stored in the
+		// compressed swap tier, the transfer has to account for them, too
+		bytesTransferred += fCompressedBytes;
+
 		fNextCallback->IOFinished(status, partialTransfer, bytesTransferred);
 
 		delete this;
@@ -434,7 +768,55 @@ private:
 	VMAnonymousCache*	fCache;
 	page_num_t			fPageIndex;
 	swap_addr_t			fSlotIndex;
-	bool				fNewSlot;
+	uint32				fPageCount;
+	generic_size_t		fCompressedBytes;
+};
+
+
+class VMAnonymousCache::ReadAheadCallback : public AsyncIOCallback {
+public:
+	ReadAheadCallback(VMAnonymousCache* cache)
+		:
+		fCache(cache),
+		fPageCount(0)
+	{
+	}
+
+	void AddPage(vm_page* page)
+	{
+		fPages[fPageCount++] = page;
+	}
+
+	virtual void IOFinished(status_t status, bool partialTransfer,
+		generic_size_t bytesTransferred)
+	{
+		fCache->Lock();
+
+		for (uint32 i = 0; i < fPageCount; i++) {
+			vm_page* page = fPages[i];
+			DEBUG_PAGE_ACCESS_START(page);
+
+			if (status == B_OK
+				&& bytesTransferred >= (generic_size_t)(i + 1) * B_PAGE_SIZE) {
+				fCache->MarkPageUnbusy(page);
+				DEBUG_PAGE_ACCESS_END(page);
+			} else {
+				// on error remove and free the page
+				fCache->NotifyPageEvents(page, PAGE_EVENT_NOT_BUSY);
+				fCache->RemovePage(page);
+				vm_page_set_state(page, PAGE_STATE_FREE);
+			}
+		}
+
+		fCache->ReleaseRefAndUnlock();
+
+		delete this;
+	}
+
+private:
+	VMAnonymousCache*	fCache;
+	uint32				fPageCount;
+	vm_page*			fPages[SWAP_READ_AHEAD_PAGES];
 };
 
 
@@ -594,18 +976,46 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 	uint32 flags, generic_size_t* _numBytes)
 {
 	off_t pageIndex = offset >> PAGE_SHIFT;
+	swap_addr_t lastSlotIndex = SWAP_SLOT_NONE;
 
 	for (uint32 i = 0, j = 0; i < count; i = j) {
 		swap_addr_t startSlotIndex = _SwapBlockGetAddress(pageIndex + i);
+
+		T(ReadPage(this, pageIndex, startSlotIndex));
+			// TODO: Assumes that only one page is read.
+
+		if (is_compressed_swap_slot(startSlotIndex)) {
+			ASSERT((flags & B_PHYSICAL_IO_REQUEST) != 0);
+			status_t status = compressed_swap_load(startSlotIndex,
+				vecs[i].base);
+			if (status != B_OK)
+				return status;
+
+			// Unlike a swap file slot, the compressed copy occupies memory,
+			// so it is not kept around to spare writing the page again.
+			// The page is marked modified instead, so that it will be
+			// compressed or swapped out again, when needed.
+			AutoLocker<VMCache> locker(this);
+			swap_slot_dealloc(startSlotIndex, 1);
+			_SwapBlockFree(pageIndex + i, 1);
+			fAllocatedSwapSize -= B_PAGE_SIZE;
+
+			vm_page* page = LookupPage((off_t)(pageIndex + i) << PAGE_SHIFT);
+			if (page != NULL)
+				page->modified = true;
+			locker.Unlock();
+
+			j = i + 1;
+			lastSlotIndex = SWAP_SLOT_NONE;
+			continue;
+		}
+
 		for (j = i + 1; j < count; j++) {
 			swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + j);
 			if (slotIndex != startSlotIndex + j - i)
 				break;
 		}
 
-		T(ReadPage(this, pageIndex, startSlotIndex));
-			// TODO: Assumes that only one page is read.
-
 		swap_file* swapFile = find_swap_file(startSlotIndex);
 
 		off_t pos = (off_t)(startSlotIndex - swapFile->first_slot)
@@ -615,8 +1025,17 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 			vecs + i, j - i, flags, _numBytes);
 		if (status != B_OK)
 			return status;
+
+		atomic_add64(&sSwapPagesRead, j - i);
+		lastSlotIndex = startSlotIndex + j - i - 1;
 	}
 
+	// The pages following the ones just read in have likely been written to
+	// the swap file together with them, and are likely to be needed soon as
+	// well.
+	if (lastSlotIndex != SWAP_SLOT_NONE)
+		_ReadAhead(pageIndex + count, lastSlotIndex + 1);
+
 	return B_OK;
 }
 
@@ -627,20 +1046,13 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 {
 	off_t pageIndex = offset >> PAGE_SHIFT;
 
-	AutoLocker<VMCache> locker(this);
-
 	page_num_t totalPages = 0;
-	for (uint32 i = 0; i < count; i++) {
-		page_num_t pageCount = (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-		swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + totalPages);
-		if (slotIndex != SWAP_SLOT_NONE) {
-			swap_slot_dealloc(slotIndex, pageCount);
-			_SwapBlockFree(pageIndex + totalPages, pageCount);
-			fAllocatedSwapSize -= pageCount * B_PAGE_SIZE;
-		}
+	for (uint32 i = 0; i < count; i++)
+		totalPages += (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
 
-		totalPages += pageCount;
-	}
+	AutoLocker<VMCache> locker(this);
+
+	_FreeSwapSpace(pageIndex, totalPages);
 
 	off_t totalSize = totalPages * B_PAGE_SIZE;
 	if (fAllocatedSwapSize + totalSize > fCommittedSwapSize)
@@ -649,91 +1061,92 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 	fAllocatedSwapSize += totalSize;
 	locker.Unlock();
 
-	page_num_t pagesLeft = totalPages;
-	totalPages = 0;
-
-	for (uint32 i = 0; i < count; i++) {
-		page_num_t pageCount = (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	uint32 compressedPages = _WriteCompressed(pageIndex, vecs, count);
+	if (compressedPages == totalPages)
+		return B_OK;
 
-		generic_addr_t vectorBase = vecs[i].base;
-		generic_size_t vectorLength = vecs[i].length;
-		page_num_t n = pageCount;
+	return _WriteSwapPages(pageIndex, vecs, count, compressedPages, flags);
+}
 
-		for (page_num_t j = 0; j < pageCount; j += n) {
-			swap_addr_t slotIndex;
-			// try to allocate n slots, if fail, try to allocate n/2
-			while ((slotIndex = swap_slot_alloc(n)) == SWAP_SLOT_NONE && n >= 2)
-				n >>= 1;
 
-			if (slotIndex == SWAP_SLOT_NONE)
-				panic("VMAnonymousCache::Write(): can't allocate swap space\n");
+status_t
+VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
+	size_t count, generic_size_t numBytes, uint32 flags,
+	AsyncIOCallback* _callback)
+{
+	// The page writer passes at most MaxPagesPerAsyncWrite() pages.
+	page_num_t pageIndex = offset >> PAGE_SHIFT;
+	uint32 pageCount = (numBytes + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	ASSERT(pageCount <= SWAP_BLOCK_PAGES);
 
+	// Unless there's a compressed swap tier to try first, a single page that
+	// already has swap space in a swap file is simply written over.
+	if (pageCount == 1 && sCompressedSwapBitmap == NULL) {
+		swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex);
+		if (slotIndex != SWAP_SLOT_NONE) {
 			T(WritePage(this, pageIndex, slotIndex));
-				// TODO: Assumes that only one page is written.
+			atomic_add64(&sSwapPagesWritten, 1);
 
 			swap_file* swapFile = find_swap_file(slotIndex);
+			off_t pos = (off_t)(slotIndex - swapFile->first_slot)
+				* B_PAGE_SIZE;
 
-			off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
-
-			generic_size_t length = (phys_addr_t)n * B_PAGE_SIZE;
-			generic_io_vec vector[1];
-			vector->base = vectorBase;
-			vector->length = length;
-
-			status_t status = vfs_write_pages(swapFile->vnode, swapFile->cookie,
-				pos, vector, 1, flags, &length);
-			if (status != B_OK) {
-				locker.Lock();
-				fAllocatedSwapSize -= (off_t)pagesLeft * B_PAGE_SIZE;
-				locker.Unlock();
-
-				swap_slot_dealloc(slotIndex, n);
-				return status;
-			}
+			return vfs_asynchronous_write_pages(swapFile->vnode,
+				swapFile->cookie, pos, vecs, count, numBytes, flags,
+				_callback);
+		}
+	}
 
-			_SwapBlockBuild(pageIndex + totalPages, slotIndex, n);
-			pagesLeft -= n;
+	// Free the swap space the pages have been using so far, so that they can
+	// get contiguous swap space together.
+	AutoLocker<VMCache> locker(this);
 
-			if (n != pageCount) {
-				vectorBase = vectorBase + n * B_PAGE_SIZE;
-				vectorLength -= n * B_PAGE_SIZE;
-			}
-		}
+	_FreeSwapSpace(pageIndex, pageCount);
 
-		totalPages += pageCount;
+	off_t totalSize = (off_t)pageCount * B_PAGE_SIZE;
+	if (fAllocatedSwapSize + totalSize > fCommittedSwapSize) {
+		locker.Unlock();
+		_callback->IOFinished(B_ERROR, true, 0);
+		return B_ERROR;
 	}
 
-	ASSERT(pagesLeft == 0);
-	return B_OK;
-}
+	fAllocatedSwapSize += totalSize;
+	locker.Unlock();
 
+	// store as many pages as possible in the compressed swap tier
+	uint32 compressedPages = _WriteCompressed(pageIndex, vecs, count);
+	if (compressedPages == pageCount) {
+		_callback->IOFinished(B_OK, false, numBytes);
+		return B_OK;
+	}
 
-status_t
-VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
-	size_t count, generic_size_t numBytes, uint32 flags,
-	AsyncIOCallback* _callback)
-{
-	// TODO: Currently this method is only used for single pages. Either make
-	// more flexible use of it or change the interface!
-	// This implementation relies on the current usage!
-	ASSERT(count == 1);
-	ASSERT(numBytes <= B_PAGE_SIZE);
+	// write the other ones to a contiguous range of swap slots
+	uint32 diskPages = pageCount - compressedPages;
+	swap_addr_t slotIndex = swap_slot_alloc(diskPages);
+	if (slotIndex == SWAP_SLOT_NONE) {
+		// The swap space is too fragmented. Write the pages synchronously,
+		// in smaller clusters.
+		status_t status = _WriteSwapPages(pageIndex, vecs, count,
+			compressedPages, flags);
+		_callback->IOFinished(status, status != B_OK,
+			status == B_OK ? numBytes : 0);
+		return status;
+	}
 
-	page_num_t pageIndex = offset >> PAGE_SHIFT;
-	swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex);
-	bool newSlot = slotIndex == SWAP_SLOT_NONE;
-
-	// If the page doesn't have any swap space yet, allocate it.
-	if (newSlot) {
-		AutoLocker<VMCache> locker(this);
-		if (fAllocatedSwapSize + B_PAGE_SIZE > fCommittedSwapSize) {
-			_callback->IOFinished(B_ERROR, true, 0);
-			return B_ERROR;
+	// get the vectors of the remaining pages
+	generic_io_vec diskVecs[SWAP_BLOCK_PAGES];
+	size_t diskVecCount = 0;
+	generic_size_t skip = (generic_size_t)compressedPages * B_PAGE_SIZE;
+	for (size_t i = 0; i < count; i++) {
+		if (vecs[i].length <= skip) {
+			skip -= vecs[i].length;
+			continue;
 		}
 
-		fAllocatedSwapSize += B_PAGE_SIZE;
-
-		slotIndex = swap_slot_alloc(1);
+		diskVecs[diskVecCount].base = vecs[i].base + skip;
+		diskVecs[diskVecCount].length = vecs[i].length - skip;
+		diskVecCount++;
+		skip = 0;
 	}
 
 	// create our callback
@@ -741,29 +1154,28 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 		? new(malloc_flags(HEAP_PRIORITY_VIP)) WriteCallback(this, _callback)
 		: new(std::nothrow) WriteCallback(this, _callback);
 	if (callback == NULL) {
-		if (newSlot) {
-			AutoLocker<VMCache> locker(this);
-			fAllocatedSwapSize -= B_PAGE_SIZE;
-			locker.Unlock();
+		locker.Lock();
+		fAllocatedSwapSize -= (off_t)diskPages * B_PAGE_SIZE;
+		locker.Unlock();
 
-			swap_slot_dealloc(slotIndex, 1);
-		}
+		swap_slot_dealloc(slotIndex, diskPages);
 		_callback->IOFinished(B_NO_MEMORY, true, 0);
 		return B_NO_MEMORY;
 	}
-	// TODO: If the page already had swap space assigned, we don't need an own
-	// callback.
 
-	callback->SetTo(pageIndex, slotIndex, newSlot);
+	callback->SetTo(pageIndex + compressedPages, slotIndex, diskPages,
+		(generic_size_t)compressedPages * B_PAGE_SIZE);
 
-	T(WritePage(this, pageIndex, slotIndex));
+	T(WritePage(this, pageIndex + compressedPages, slotIndex));
 
-	// write the page asynchrounously
+	// write the pages asynchrounously
 	swap_file* swapFile = find_swap_file(slotIndex);
 	off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
 
 	return vfs_asynchronous_write_pages(swapFile->vnode, swapFile->cookie, pos,
-		vecs, 1, numBytes, flags, callback);
+		diskVecs, diskVecCount,
+		numBytes - (generic_size_t)compressedPages * B_PAGE_SIZE, flags,
+		callback);
 }
 
 
@@ -780,7 +1192,7 @@ VMAnonymousCache::CanWritePage(off_t offset)
 int32
 VMAnonymousCache::MaxPagesPerAsyncWrite() const
 {
-	return 1;
+	return SWAP_BLOCK_PAGES;
 }
 
 
@@ -965,6 +1377,191 @@ VMAnonymousCache::_SwapBlockGetAddress(off_t pageIndex)
 }
 
 
+/*!	Frees the swap space of the given pages, if they have any.
+	The cache must be locked.
+*/
+void
+VMAnonymousCache::_FreeSwapSpace(off_t pageIndex, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++) {
+		swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + i);
+		if (slotIndex == SWAP_SLOT_NONE)
+			continue;
+
+		swap_slot_dealloc(slotIndex, 1);
+		_SwapBlockFree(pageIndex + i, 1);
+		fAllocatedSwapSize -= B_PAGE_SIZE;
+	}
+}
+
+
+/*!	Stores the pages of the given vectors in the compressed swap tier, as
+	long as it accepts them. The swap space must already be accounted for.
+	Returns the number of pages, from the start, that have been stored.
+*/
+uint32
+VMAnonymousCache::_WriteCompressed(off_t pageIndex, const generic_io_vec* vecs,
+	size_t count)
+{
+	if (sCompressedSwapBitmap == NULL)
+		return 0;
+
+	uint32 storedPages = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (generic_size_t offset = 0; offset < vecs[i].length;
+				offset += B_PAGE_SIZE) {
+			swap_addr_t slotIndex
+				= compressed_swap_store(vecs[i].base + offset);
+			if (slotIndex == SWAP_SLOT_NONE)
+				return storedPages;
+
+			T(WritePage(this, pageIndex + storedPages, slotIndex));
+
+			_SwapBlockBuild(pageIndex + storedPages, slotIndex, 1);
+			storedPages++;
+		}
+	}
+
+	return storedPages;
+}
+
+
+/*!	Synchronously writes the pages of the given vectors to the swap files,
+	skipping the first \a firstPage pages. Allocates contiguous swap space for
+	as many pages as possible at once. The swap space must already be
+	accounted for; if writing fails, it is released for the pages that could
+	not be written.
+*/
+status_t
+VMAnonymousCache::_WriteSwapPages(off_t pageIndex, const generic_io_vec* vecs,
+	size_t count, uint32 firstPage, uint32 flags)
+{
+	page_num_t pagesLeft = 0;
+	for (uint32 i = 0; i < count; i++)
+		pagesLeft += (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	pagesLeft -= firstPage;
+
+	page_num_t vectorPageIndex = 0;
+	for (uint32 i = 0; i < count; i++) {
+		page_num_t pageCount = (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+		page_num_t j = 0;
+		if (firstPage > vectorPageIndex)
+			j = min_c(firstPage - vectorPageIndex, pageCount);
+		page_num_t n = pageCount - j;
+
+		for (; j < pageCount; j += n) {
+			n = min_c(n, pageCount - j);
+
+			swap_addr_t slotIndex;
+			// try to allocate n slots, if fail, try to allocate n/2
+			while ((slotIndex = swap_slot_alloc(n)) == SWAP_SLOT_NONE && n >= 2)
+				n >>= 1;
+
+			if (slotIndex == SWAP_SLOT_NONE)
+				panic("VMAnonymousCache::Write(): can't allocate swap space\n");
+
+			T(WritePage(this, pageIndex + vectorPageIndex + j, slotIndex));
+
+			swap_file* swapFile = find_swap_file(slotIndex);
+
+			off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
+
+			generic_size_t length = (phys_addr_t)n * B_PAGE_SIZE;
+			generic_io_vec vector[1];
+			vector->base = vecs[i].base + (phys_addr_t)j * B_PAGE_SIZE;
+			vector->length = length;
+
+			status_t status = vfs_write_pages(swapFile->vnode, swapFile->cookie,
+				pos, vector, 1, flags, &length);
+			if (status != B_OK) {
+				AutoLocker<VMCache> locker(this);
+				fAllocatedSwapSize -= (off_t)pagesLeft * B_PAGE_SIZE;
+				locker.Unlock();
+
+				swap_slot_dealloc(slotIndex, n);
+				return status;
+			}
+
+			_SwapBlockBuild(pageIndex + vectorPageIndex + j, slotIndex, n);
+			atomic_add64(&sSwapPagesWritten, n);
+			pagesLeft -= n;
+		}
+
+		vectorPageIndex += pageCount;
+	}
+
+	ASSERT(pagesLeft == 0);
+	return B_OK;
+}
+
+
+/*!	Starts reading in the pages following \a pageIndex asynchronously, as
+	long as they are swapped out to the slots following \a slotIndex, and
+	there are enough free pages.
+	The cache must not be locked.
+*/
+void
+VMAnonymousCache::_ReadAhead(off_t pageIndex, swap_addr_t slotIndex)
+{
+	AutoLocker<VMCache> locker(this);
+
+	uint32 pageCount = 0;
+	while (pageCount < SWAP_READ_AHEAD_PAGES) {
+		off_t offset = (pageIndex + pageCount) << PAGE_SHIFT;
+		if (offset >= virtual_end
+			|| _SwapBlockGetAddress(pageIndex + pageCount)
+				!= slotIndex + pageCount
+			|| LookupPage(offset) != NULL) {
+			break;
+		}
+		pageCount++;
+	}
+
+	if (pageCount == 0)
+		return;
+
+	// Don't make things worse, if memory is getting low.
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, pageCount, VM_PRIORITY_USER))
+		return;
+
+	ReadAheadCallback* callback
+		= new(std::nothrow) ReadAheadCallback(this);
+	if (callback == NULL) {
+		vm_page_unreserve_pages(&reservation);
+		return;
+	}
+
+	generic_io_vec vecs[SWAP_READ_AHEAD_PAGES];
+	for (uint32 i = 0; i < pageCount; i++) {
+		vm_page* page = vm_page_allocate_page(&reservation,
+			PAGE_STATE_CACHED | VM_PAGE_ALLOC_BUSY);
+		InsertPage(page, (pageIndex + i) << PAGE_SHIFT);
+		DEBUG_PAGE_ACCESS_END(page);
+
+		callback->AddPage(page);
+		vecs[i].base = (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+		vecs[i].length = B_PAGE_SIZE;
+	}
+
+	vm_page_unreserve_pages(&reservation);
+
+	// keep a reference until the pages have been read
+	AcquireRefLocked();
+	locker.Unlock();
+
+	atomic_add64(&sSwapPagesRead, pageCount);
+	atomic_add64(&sSwapReadAheadPages, pageCount);
+
+	swap_file* swapFile = find_swap_file(slotIndex);
+	off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
+
+	vfs_asynchronous_read_pages(swapFile->vnode, swapFile->cookie, pos, vecs,
+		pageCount, (generic_size_t)pageCount * B_PAGE_SIZE,
+		B_PHYSICAL_IO_REQUEST, callback);
+}
+
+
 status_t
 VMAnonymousCache::_Commit(off_t size, int priority)
 {
@@ -1433,6 +2030,8 @@ swap_init(void)
 	mutex_init(&sAvailSwapSpaceLock, "avail swap space");
 	sAvailSwapSpace = 0;
 
+	mutex_init(&sCompressedSwapLock, "compressed swap");
+
 	add_debugger_command_etc("swap", &dump_swap_info,
 		"Print infos about the swap usage",
 		"\n"
@@ -1451,6 +2050,7 @@ swap_init_post_modules()
 	bool swapEnabled = true;
 	bool swapAutomatic = true;
 	off_t swapSize = 0;
+	off_t compressedSwapSize = 0;
 
 	dev_t swapDeviceID = -1;
 	VolumeInfo selectedVolume = {};
@@ -1502,6 +2102,13 @@ swap_init_post_modules()
 				}
 			}
 		}
+
+		// The compressed swap tier is optional and off by default.
+		const char* compressedSize = get_driver_parameter(settings,
+			"swap_compressed_size", NULL, NULL);
+		if (compressedSize != NULL)
+			compressedSwapSize = atoll(compressedSize);
+
 		unload_driver_settings(settings);
 	}
 
@@ -1614,6 +2221,15 @@ swap_init_post_modules()
 	if (error != B_OK) {
 		dprintf("%s: Failed to add swap file %s: %s\n", __func__, swapPath,
 			strerror(error));
+		return;
+	}
+
+	if (compressedSwapSize > 0) {
+		error = compressed_swap_init(compressedSwapSize);
+		if (error != B_OK) {
+			dprintf("%s: Failed to init compressed swap: %s\n", __func__,
+				strerror(error));
+		}
 	}
 }
 
@@ -1681,3 +2297,22 @@ swap_get_info(system_info* info)
 #endif
 }
 
+
+void
+swap_get_stats(vm_stats* stats)
+{
+#if ENABLE_SWAP_SUPPORT
+	stats->swap_pages_read = sSwapPagesRead;
+	stats->swap_pages_written = sSwapPagesWritten;
+	stats->swap_read_ahead_pages = sSwapReadAheadPages;
+	stats->compressed_swap_pages = sCompressedSwapPageCount;
+	stats->compressed_swap_size = sCompressedSwapSize;
+#else
+	stats->swap_pages_read = 0;
+	stats->swap_pages_written = 0;
+	stats->swap_read_ahead_pages = 0;
+	stats->compressed_swap_pages = 0;
+	stats->compressed_swap_size = 0;
+#endif
+}
+
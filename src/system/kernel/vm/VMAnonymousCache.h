@@ -72,11 +72,21 @@ protected:
 private:
 			class WriteCallback;
 			friend class WriteCallback;
+			class ReadAheadCallback;
 
 			void				_SwapBlockBuild(off_t pageIndex,
 									swap_addr_t slotIndex, uint32 count);
 			void        		_SwapBlockFree(off_t pageIndex, uint32 count);
 			swap_addr_t			_SwapBlockGetAddress(off_t pageIndex);
+			void				_FreeSwapSpace(off_t pageIndex,
+									uint32 count);
+			uint32				_WriteCompressed(off_t pageIndex,
+									const generic_io_vec* vecs, size_t count);
+			status_t			_WriteSwapPages(off_t pageIndex,
+									const generic_io_vec* vecs, size_t count,
+									uint32 firstPage, uint32 flags);
+			void				_ReadAhead(off_t pageIndex,
+									swap_addr_t slotIndex);
 			status_t			_Commit(off_t size, int priority);
 
 			void				_MergePagesSmallerSource(
@@ -99,7 +109,11 @@ private:
 #endif	// ENABLE_SWAP_SUPPORT
 
 
+struct vm_stats;
+
+
 extern "C" void swap_get_info(system_info* info);
+extern "C" void swap_get_stats(vm_stats* stats);
 
 
 #endif	/* _KERNEL_VM_STORE_ANONYMOUS_H */
@@ -628,6 +628,9 @@ VMCache::Init(uint32 cacheType, uint32 allocationFlags)
 	temporary = 0;
 	page_count = 0;
 	fWiredPagesCount = 0;
+	fWorkingSetGeneration = 0;
+	fAccessedPages = 0;
+	fPreviousAccessedPages = 0;
 	type = cacheType;
 	fPageEventWaiters = NULL;
 
@@ -1330,6 +1333,9 @@ VMCache::Dump(bool showPages) const
 	kprintf("  virtual_base: 0x%" B_PRIx64 "\n", virtual_base);
 	kprintf("  virtual_end:  0x%" B_PRIx64 "\n", virtual_end);
 	kprintf("  temporary:    %" B_PRIu32 "\n", temporary);
+	kprintf("  accessed:     %" B_PRIu32 " (previous %" B_PRIu32
+		", generation %" B_PRIu32 ")\n", fAccessedPages,
+		fPreviousAccessedPages, fWorkingSetGeneration);
 	kprintf("  lock:         %p\n", &fLock);
 #if KDEBUG
 	kprintf("  lock.holder:  %" B_PRId32 "\n", fLock.holder);
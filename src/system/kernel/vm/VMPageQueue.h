@@ -40,8 +40,12 @@ public:
 	inline	void				AppendUnlocked(vm_page* page);
 	inline	void				AppendUnlocked(PageList& pages, uint32 count);
 	inline	void				PrependUnlocked(vm_page* page);
+	inline	void				PrependUnlocked(vm_page* const* pages,
+									uint32 count);
 	inline	void				RemoveUnlocked(vm_page* page);
 	inline	vm_page*			RemoveHeadUnlocked();
+	inline	uint32				RemoveHeadUnlocked(vm_page** pages,
+									uint32 count);
 	inline	void				RequeueUnlocked(vm_page* page, bool tail);
 
 	inline	vm_page*			Head() const;
@@ -217,6 +221,15 @@ VMPageQueue::PrependUnlocked(vm_page* page)
 }
 
 
+void
+VMPageQueue::PrependUnlocked(vm_page* const* pages, uint32 count)
+{
+	InterruptsSpinLocker locker(fLock);
+	for (uint32 i = 0; i < count; i++)
+		Prepend(pages[i]);
+}
+
+
 void
 VMPageQueue::RemoveUnlocked(vm_page* page)
 {
@@ -233,6 +246,23 @@ VMPageQueue::RemoveHeadUnlocked()
 }
 
 
+/*!	Removes up to \a count pages from the head of the queue and stores them
+	in \a pages.
+	\return The number of pages actually removed.
+*/
+uint32
+VMPageQueue::RemoveHeadUnlocked(vm_page** pages, uint32 count)
+{
+	InterruptsSpinLocker locker(fLock);
+
+	uint32 removed = 0;
+	while (removed < count && (pages[removed] = RemoveHead()) != NULL)
+		removed++;
+
+	return removed;
+}
+
+
 void
 VMPageQueue::RequeueUnlocked(vm_page* page, bool tail)
 {
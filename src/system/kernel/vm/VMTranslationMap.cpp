@@ -31,6 +31,31 @@ VMTranslationMap::~VMTranslationMap()
 }
 
 
+/*!	Returns the size of the large pages the map supports, or 0, if it
+	doesn't support them at all.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Maps a large page of LargePageSize() bytes. Both addresses must be aligned
+	to that size, and the range must not contain any mappings yet.
+	The map must be locked. The large page counts as LargePageSize() /
+	B_PAGE_SIZE mapped pages. Any operation that addresses only a part of it
+	splits it up into normal pages again.
+*/
+status_t
+VMTranslationMap::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 status_t
 VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -251,6 +251,19 @@ static off_t sNeededMemory;
 static mutex sAvailableMemoryLock = MUTEX_INITIALIZER("available memory lock");
 static uint32 sPageFaults;
 
+// After a large page couldn't be allocated, we don't try again for a while,
+// since looking for a physically contiguous run of free pages is expensive.
+static const bigtime_t kLargePageRetryDelay = 100000;
+static int64 sLargePageFaults;
+static int64 sLargePageAllocationFailures;
+static bigtime_t sLargePageRetryTime;
+
+// The number of resident pages mapped around a faulting one in file mappings
+// by default, and at most. Both must be powers of two.
+static const uint16 kDefaultFaultAroundPages = 16;
+static const uint16 kMaxFaultAroundPages = 64;
+static int64 sFaultAroundPages;
+
 static VMPhysicalPageMapper* sPhysicalPageMapper;
 
 #if DEBUG_CACHE_LIST
@@ -732,6 +745,8 @@ cut_area(VMAddressSpace* addressSpace, VMArea* area, addr_t address,
 	// We need a cache reference for the new area.
 	cache->AcquireRefLocked();
 
+	secondArea->fault_around = area->fault_around;
+
 	if (_secondArea != NULL)
 		*_secondArea = secondArea;
 
@@ -2001,6 +2016,7 @@ _vm_map_file(team_id team, const char* name, void** _address,
 		return status;
 
 	area->cache_type = CACHE_TYPE_VNODE;
+	area->fault_around = kDefaultFaultAroundPages;
 	return area->id;
 }
 
@@ -2191,8 +2207,10 @@ vm_clone_area(team_id team, const char* name, void** address,
 			vm_page_unreserve_pages(&reservation);
 		}
 	}
-	if (status == B_OK)
+	if (status == B_OK) {
 		newArea->cache_type = sourceArea->cache_type;
+		newArea->fault_around = sourceArea->fault_around;
+	}
 
 	vm_area_put_locked_cache(cache);
 
@@ -2514,6 +2532,8 @@ vm_copy_area(team_id team, const char* name, void** _address,
 		cache->AcquireRefLocked();
 	}
 
+	target->fault_around = source->fault_around;
+
 	// If the source area is writable, we need to move it one layer up as well
 
 	if (!sharedArea) {
@@ -4543,6 +4563,224 @@ fault_get_page(PageFaultContext& context)
 }
 
 
+/*!	Tries to resolve the page fault by mapping a large page covering the
+	faulting address.
+	This is only done for areas that asked for it (B_LARGE_PAGES_AREA), whose
+	top cache is a fully committed anonymous cache without a source, and only
+	if neither the cache nor its backing store has any of the pages the large
+	page would cover yet. The caller must hold the locks of the address space
+	and the top cache.
+	Returns \c true, if the large page has been mapped, \c false, if the
+	fault has to be resolved the usual way.
+*/
+static bool
+fault_map_large_page(PageFaultContext& context, VMArea* area, addr_t address,
+	uint32 protection)
+{
+	VMCache* cache = context.topCache;
+	if ((area->protection & B_LARGE_PAGES_AREA) == 0
+		|| area->wiring != B_NO_LOCK || area->page_protections != NULL
+		|| cache->type != CACHE_TYPE_RAM || cache->source != NULL
+		|| cache->committed_size < cache->virtual_end - cache->virtual_base) {
+		return false;
+	}
+
+	size_t largePageSize = context.map->LargePageSize();
+	if (largePageSize == 0)
+		return false;
+
+	addr_t base = ROUNDDOWN(address, largePageSize);
+	if (base < area->Base()
+		|| base + (largePageSize - 1) > area->Base() + (area->Size() - 1)) {
+		return false;
+	}
+
+	if (system_time() < sLargePageRetryTime)
+		return false;
+
+	// none of the pages may exist yet
+	off_t cacheOffset = base - area->Base() + area->cache_offset;
+	page_num_t pageCount = largePageSize / B_PAGE_SIZE;
+	page_num_t firstPage = cacheOffset / B_PAGE_SIZE;
+	vm_page* page = cache->pages.GetIterator(firstPage, true, true).Next();
+	if (page != NULL && page->cache_offset < firstPage + pageCount)
+		return false;
+
+	for (page_num_t i = 0; i < pageCount; i++) {
+		if (cache->HasPage(cacheOffset + i * B_PAGE_SIZE))
+			return false;
+	}
+
+	// allocate the pages and the mapping objects
+	physical_address_restrictions restrictions = {};
+	restrictions.alignment = largePageSize;
+	vm_page* pages = vm_page_allocate_page_run(
+		PAGE_STATE_ACTIVE | VM_PAGE_ALLOC_CLEAR | VM_PAGE_ALLOC_DONT_WAIT,
+		pageCount, &restrictions, VM_PRIORITY_USER);
+	if (pages == NULL) {
+		atomic_add64(&sLargePageAllocationFailures, 1);
+		sLargePageRetryTime = system_time() + kLargePageRetryDelay;
+		return false;
+	}
+
+	VMAreaMappings mappings;
+	page_num_t mappingCount = 0;
+	for (; mappingCount < pageCount; mappingCount++) {
+		vm_page_mapping* mapping = (vm_page_mapping*)object_cache_alloc(
+			gPageMappingsObjectCache, CACHE_DONT_WAIT_FOR_MEMORY);
+		if (mapping == NULL)
+			break;
+		mappings.Add(mapping);
+	}
+
+	for (page_num_t i = 0; i < pageCount; i++)
+		cache->InsertPage(&pages[i], cacheOffset + i * B_PAGE_SIZE);
+
+	status_t status = B_NO_MEMORY;
+	if (mappingCount == pageCount) {
+		context.map->Lock();
+
+		status = context.map->MapLargePage(base,
+			pages[0].physical_page_number * B_PAGE_SIZE, protection,
+			area->MemoryType(), &context.reservation);
+		if (status == B_OK) {
+			for (page_num_t i = 0; i < pageCount; i++) {
+				vm_page_mapping* mapping = mappings.RemoveHead();
+				mapping->page = &pages[i];
+				mapping->area = area;
+				pages[i].mappings.Add(mapping);
+				area->mappings.Add(mapping);
+			}
+		}
+
+		context.map->Unlock();
+	}
+
+	if (status != B_OK) {
+		for (page_num_t i = 0; i < pageCount; i++) {
+			cache->RemovePage(&pages[i]);
+			vm_page_free_etc(cache, &pages[i], NULL);
+		}
+
+		while (vm_page_mapping* mapping = mappings.RemoveHead()) {
+			object_cache_free(gPageMappingsObjectCache, mapping,
+				CACHE_DONT_WAIT_FOR_MEMORY);
+		}
+
+		atomic_add64(&sLargePageAllocationFailures, 1);
+		return false;
+	}
+
+	atomic_add(&gMappedPagesCount, pageCount);
+	atomic_add64(&sLargePageFaults, 1);
+
+	for (page_num_t i = 0; i < pageCount; i++)
+		DEBUG_PAGE_ACCESS_END(&pages[i]);
+
+	return true;
+}
+
+
+/*!	Returns the resident page at \a cacheOffset the fault handler would find,
+	if it isn't busy and no cache above it would have to read it in first.
+	The whole cache chain must be locked.
+*/
+static vm_page*
+fault_around_lookup_page(VMCache* cache, off_t cacheOffset)
+{
+	for (; cache != NULL; cache = cache->source) {
+		vm_page* page = cache->LookupPage(cacheOffset);
+		if (page != NULL)
+			return page->busy ? NULL : page;
+
+		if (cache->HasPage(cacheOffset))
+			return NULL;
+	}
+
+	return NULL;
+}
+
+
+/*!	Maps the already resident pages around the faulting \a address, so that
+	accesses to them don't fault, too. The window is \c area->fault_around
+	pages large and aligned to its size.
+	The pages are mapped read-only, so that writes still go through the fault
+	handler, which takes care of copy-on-write and the modified state.
+	The caller must hold the locks of the address space and of the caches from
+	the top cache to the one the faulting page lives in.
+*/
+static void
+fault_around(PageFaultContext& context, VMArea* area, addr_t address)
+{
+	if (area->fault_around <= 1 || area->wiring != B_NO_LOCK)
+		return;
+
+	size_t windowSize = (size_t)area->fault_around * B_PAGE_SIZE;
+	addr_t start = std::max(ROUNDDOWN(address, windowSize), area->Base());
+	addr_t end = std::min(start + (windowSize - 1),
+		area->Base() + (area->Size() - 1));
+
+	// We must not wait for pages with the caches locked, so we just give up,
+	// if memory is tight.
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation,
+			context.map->MaxPagesNeededToMap(start, end),
+			area->address_space == VMAddressSpace::Kernel()
+				? VM_PRIORITY_SYSTEM : VM_PRIORITY_USER)) {
+		return;
+	}
+
+	int32 mappedPages = 0;
+
+	// The caches must be locked before the map, so we lock the remaining ones
+	// now, and the map only once for the whole window.
+	context.cacheChainLocker.LockAllSourceCaches();
+	context.map->Lock();
+
+	for (addr_t pageAddress = start; pageAddress < end;
+			pageAddress += B_PAGE_SIZE) {
+		if (pageAddress == address)
+			continue;
+
+		uint32 protection = get_area_page_protection(area, pageAddress);
+		if ((protection & (B_READ_AREA | B_KERNEL_READ_AREA)) == 0)
+			continue;
+
+		// skip addresses that are mapped already
+		phys_addr_t physicalAddress;
+		uint32 flags;
+		if (context.map->Query(pageAddress, &physicalAddress, &flags) == B_OK
+			&& (flags & PAGE_PRESENT) != 0) {
+			continue;
+		}
+
+		vm_page* page = fault_around_lookup_page(context.topCache,
+			pageAddress - area->Base() + area->cache_offset);
+		if (page == NULL)
+			continue;
+
+		DEBUG_PAGE_ACCESS_START(page);
+		status_t status = map_page(area, page, pageAddress,
+			protection & ~(B_WRITE_AREA | B_KERNEL_WRITE_AREA), &reservation);
+		DEBUG_PAGE_ACCESS_END(page);
+
+		if (status != B_OK)
+			break;
+
+		mappedPages++;
+	}
+
+	context.map->Unlock();
+
+	vm_page_unreserve_pages(&reservation);
+
+	if (mappedPages > 0) {
+		area->address_space->AddFaultAroundPages(mappedPages);
+		atomic_add64(&sFaultAroundPages, mappedPages);
+	}
+}
+
+
 /*!	Makes sure the address in the given address space is mapped.
 
 	\param addressSpace The address space.
@@ -4648,6 +4886,13 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 				break;
 		}
 
+		// Try to map a large page, unless the caller wants a page wired.
+		if (wirePage == NULL
+			&& fault_map_large_page(context, area, address, protection)) {
+			status = B_OK;
+			break;
+		}
+
 		// The top most cache has no fault handler, so let's see if the cache or
 		// its sources already have the page we're searching for (we're going
 		// from top to bottom).
@@ -4770,6 +5015,10 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 		} else if (context.page->State() == PAGE_STATE_INACTIVE)
 			vm_page_set_state(context.page, PAGE_STATE_ACTIVE);
 
+		// map the resident pages around it as well
+		if (wirePage == NULL && mapPage)
+			fault_around(context, area, address);
+
 		// also wire the page, if requested
 		if (wirePage != NULL && status == B_OK) {
 			increment_page_wired_count(context.page);
@@ -6673,10 +6922,71 @@ _user_sync_memory(void* _address, size_t size, uint32 flags)
 }
 
 
+/*!	Only the access pattern advice is implemented. It sets the fault-around
+	window of all areas intersecting the given range as a whole.
+*/
 status_t
-_user_memory_advice(void* address, size_t size, uint32 advice)
+_user_memory_advice(void* _address, size_t size, uint32 advice)
 {
-	// TODO: Implement!
+	addr_t address = (addr_t)_address;
+	size = PAGE_ALIGN(size);
+
+	// check params
+	if ((address % B_PAGE_SIZE) != 0)
+		return B_BAD_VALUE;
+	if ((addr_t)address + size < (addr_t)address || !IS_USER_ADDRESS(address)
+		|| !IS_USER_ADDRESS((addr_t)address + size)) {
+		// weird error code required by POSIX
+		return ENOMEM;
+	}
+
+	switch (advice) {
+		case POSIX_MADV_NORMAL:
+		case POSIX_MADV_SEQUENTIAL:
+		case POSIX_MADV_RANDOM:
+			break;
+
+		case POSIX_MADV_WILLNEED:
+		case POSIX_MADV_DONTNEED:
+			// TODO: Implement!
+			return B_OK;
+
+		default:
+			return B_BAD_VALUE;
+	}
+
+	if (size == 0)
+		return B_OK;
+
+	AddressSpaceWriteLocker locker;
+	status_t error = locker.SetTo(team_get_current_team_id());
+	if (error != B_OK)
+		return error;
+
+	addr_t end = address + (size - 1);
+	while (address <= end) {
+		VMArea* area = locker.AddressSpace()->LookupArea(address);
+		if (area == NULL)
+			return B_NO_MEMORY;
+
+		switch (advice) {
+			case POSIX_MADV_NORMAL:
+				area->fault_around = area->cache_type == CACHE_TYPE_VNODE
+					? kDefaultFaultAroundPages : 0;
+				break;
+			case POSIX_MADV_SEQUENTIAL:
+				area->fault_around = kMaxFaultAroundPages;
+				break;
+			case POSIX_MADV_RANDOM:
+				area->fault_around = 0;
+				break;
+		}
+
+		if (area->Base() + (area->Size() - 1) >= end)
+			break;
+		address = area->Base() + area->Size();
+	}
+
 	return B_OK;
 }
 
@@ -6716,6 +7026,54 @@ _user_get_memory_properties(team_id teamID, const void* address,
 }
 
 
+/*!	Copies the VM statistics to \a userStats. \a size is the size of the
+	caller's structure, which may be smaller than the current one, so that
+	fields can be added to vm_stats without breaking older callers.
+*/
+status_t
+_user_get_vm_stats(vm_stats* userStats, size_t size)
+{
+	if (userStats == NULL || !IS_USER_ADDRESS(userStats))
+		return B_BAD_ADDRESS;
+
+	vm_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.large_pages_mapped = gMappedLargePagesCount;
+	stats.large_page_faults = sLargePageFaults;
+	stats.large_page_allocation_failures = sLargePageAllocationFailures;
+	stats.large_page_demotions = gLargePageDemotions;
+	stats.fault_around_pages = sFaultAroundPages;
+	swap_get_stats(&stats);
+	vm_page_get_daemon_stats(&stats);
+
+	return user_memcpy(userStats, &stats, std::min(size, sizeof(stats)));
+}
+
+
+status_t
+_user_get_team_vm_stats(team_id team, team_vm_stats* userStats, size_t size)
+{
+	if (userStats == NULL || !IS_USER_ADDRESS(userStats))
+		return B_BAD_ADDRESS;
+
+	if (team == B_CURRENT_TEAM)
+		team = team_get_current_team_id();
+
+	VMAddressSpace* addressSpace = VMAddressSpace::Get(team);
+	if (addressSpace == NULL)
+		return B_BAD_TEAM_ID;
+
+	team_vm_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.page_faults = addressSpace->FaultCount();
+	stats.fault_around_pages = addressSpace->FaultAroundPages();
+
+	addressSpace->Put();
+
+	return user_memcpy(userStats, &stats, std::min(size, sizeof(stats)));
+}
+
+
 // #pragma mark -- compatibility
 
 
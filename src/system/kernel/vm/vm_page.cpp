@@ -27,6 +27,7 @@
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -80,6 +81,13 @@ static const size_t kPageReserveForPriority[] = {
 	0							// VIP
 };
 
+// Number of free and of clear pages each CPU caches, and the number of pages
+// moved between the caches and the queues at once.
+static const uint32 kPageCPUCacheSize = 32;
+static const uint32 kPageCPUCacheBatchSize = kPageCPUCacheSize / 2;
+// Maximum number of page reservations each CPU caches.
+static const int32 kMaxCachedPageReservations = 64;
+
 // Minimum number of free pages the page daemon will try to achieve.
 static uint32 sFreePagesTarget;
 static uint32 sFreeOrCachedPagesTarget;
@@ -93,6 +101,13 @@ static const bigtime_t kBusyScanWaitInterval = 500000LL;	// 0.5 sec
 // queue.
 static const uint32 kIdleRunsForFullQueue = 20;
 
+// Maximum number of slices the page array is partitioned into for the page
+// daemon, each scanned by a thread of its own.
+static const uint32 kMaxPageDaemonSlices = 8;
+// Minimum number of pages a page daemon slice should cover.
+static const page_num_t kMinPagesPerPageDaemonSlice
+	= 2LL * 1024 * 1024 * 1024 / B_PAGE_SIZE;
+
 // Maximum limit for the vm_page::usage_count.
 static const int32 kPageUsageMax = 64;
 // vm_page::usage_count buff an accessed page receives in a scan.
@@ -101,6 +116,8 @@ static const int32 kPageUsageAdvance = 3;
 static const int32 kPageUsageDecline = 1;
 
 int32 gMappedPagesCount;
+int32 gMappedLargePagesCount;
+int64 gLargePageDemotions;
 
 static VMPageQueue sPageQueues[PAGE_STATE_COUNT];
 
@@ -133,6 +150,9 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+static int32 cached_page_reservations();
+static page_num_t cached_free_pages();
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -257,6 +277,48 @@ static DaemonCondition sPageWriterCondition;
 static DaemonCondition sPageDaemonCondition;
 
 
+/*!	A contiguous part of the sPages array, scanned by one page daemon thread.
+	The active and inactive pages are scanned clock-wise, each with a hand of
+	its own, so that a scan continues where the previous one left off.
+*/
+struct PageDaemonSlice {
+	page_num_t			start;
+	page_num_t			end;
+	page_num_t			activeHand;
+	page_num_t			inactiveHand;
+	DaemonCondition		condition;
+};
+
+enum {
+	PAGE_DAEMON_IDLE_SCAN,
+	PAGE_DAEMON_INACTIVE_SCAN,
+	PAGE_DAEMON_ACTIVE_SCAN
+};
+
+static PageDaemonSlice sPageDaemonSlices[kMaxPageDaemonSlices];
+static uint32 sPageDaemonSliceCount = 1;
+static int32 sPendingPageDaemonSlices;
+static ConditionVariable sPageDaemonSlicesCondition;
+
+// the current page daemon scan job
+static uint32 sPageDaemonJob;
+static int32 sPageDaemonDespairLevel;
+static int32 sPagesToFree;
+static int32 sPagesToFlush;
+static int32 sPagesToDeactivate;
+
+// Generation of the caches' working set estimates. The page daemon starts a
+// new one in regular intervals.
+static uint32 sWorkingSetGeneration;
+
+// page daemon statistics
+static int64 sPagesScanned;
+static int64 sPageScanTime;
+static int64 sPagesReclaimed;
+static int64 sReclaimWaits;
+static int64 sReclaimWaitTime;
+
+
 #if PAGE_ALLOCATION_TRACING
 
 namespace PageAllocationTracing {
@@ -1093,7 +1155,8 @@ dump_page_stats(int argc, char **argv)
 	kprintf("free: %" B_PRIuSIZE "\n", counter[PAGE_STATE_FREE]);
 	kprintf("clear: %" B_PRIuSIZE "\n", counter[PAGE_STATE_CLEAR]);
 
-	kprintf("unreserved free pages: %" B_PRId32 "\n", sUnreservedFreePages);
+	kprintf("unreserved free pages: %" B_PRId32 " (+ %" B_PRId32
+		" cached by CPUs)\n", sUnreservedFreePages, cached_page_reservations());
 	kprintf("unsatisfied page reservations: %" B_PRId32 "\n",
 		sUnsatisfiedPageReservations);
 	kprintf("mapped pages: %" B_PRId32 "\n", gMappedPagesCount);
@@ -1117,6 +1180,8 @@ dump_page_stats(int argc, char **argv)
 		sFreePageQueue.Count());
 	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
 		sClearPageQueue.Count());
+	kprintf("free/clear pages cached by CPUs: %" B_PRIuPHYSADDR "\n",
+		cached_free_pages());
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1382,7 +1447,8 @@ vm_page::SetState(uint8 newState)
 static void
 get_page_stats(page_stats& _pageStats)
 {
-	_pageStats.totalFreePages = sUnreservedFreePages;
+	_pageStats.totalFreePages = sUnreservedFreePages
+		+ cached_page_reservations();
 	_pageStats.cachedPages = sCachedPageQueue.Count();
 	_pageStats.unsatisfiedReservations = sUnsatisfiedPageReservations;
 	// TODO: We don't get an actual snapshot here!
@@ -1452,10 +1518,359 @@ wake_up_page_reservation_waiters()
 }
 
 
+// #pragma mark - per-CPU page caches
+
+
+/*!	To keep the free/clear page queues and \c sUnreservedFreePages from
+	bouncing between the CPUs, each CPU caches a few free and clear pages, and
+	a few page reservations.
+
+	The cached pages remain in state \c PAGE_STATE_FREE or \c PAGE_STATE_CLEAR,
+	but are not in any queue. Their state is only changed with the cache's
+	lock held, and they are only moved between a cache and the queues with
+	\c sFreePageQueuesLock read locked. Hence, write locking
+	\c sFreePageQueuesLock and draining the caches via
+	disable_page_cpu_caches() puts all free pages back into the queues.
+
+	The cached reservations have already been subtracted from
+	\c sUnreservedFreePages. They are flushed back before anyone starts
+	waiting for pages.
+*/
+struct page_cpu_cache {
+	spinlock	lock;
+	uint32		free_count;
+	uint32		clear_count;
+	int32		reserved;
+	vm_page*	free_pages[kPageCPUCacheSize];
+	vm_page*	clear_pages[kPageCPUCacheSize];
+} CACHE_LINE_ALIGN;
+
+static page_cpu_cache sPageCPUCaches[SMP_MAX_CPUS];
+static int32 sPageCPUCachesDisabled;
+
+
+static inline page_cpu_cache&
+lock_current_page_cpu_cache(cpu_status& state)
+{
+	state = disable_interrupts();
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	acquire_spinlock(&cache.lock);
+	return cache;
+}
+
+
+static inline void
+unlock_page_cpu_cache(page_cpu_cache& cache, cpu_status state)
+{
+	release_spinlock(&cache.lock);
+	restore_interrupts(state);
+}
+
+
+/*!	Takes up to \a count reservations from the current CPU's cache. If that
+	doesn't suffice and there's plenty of free memory, a batch of reservations
+	is taken from \c sUnreservedFreePages, and what's left over is cached.
+	\return The number of actually reserved pages.
+*/
+static uint32
+reserve_cached_pages(uint32 count)
+{
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+		// it doesn't matter, if we're migrated to another CPU in the meantime
+
+	uint32 reserved = 0;
+	while (true) {
+		int32 available = atomic_get(&cache.reserved);
+		if (available <= 0)
+			break;
+
+		int32 toReserve = std::min((int32)count, available);
+		if (atomic_test_and_set(&cache.reserved, available - toReserve,
+				available) == available) {
+			reserved = toReserve;
+			break;
+		}
+	}
+
+	if (reserved == count || count > (uint32)kMaxCachedPageReservations)
+		return reserved;
+
+	// Refill the cache, but only as long as the page daemon doesn't need to
+	// do anything -- the last pages must go to those who actually need them.
+	uint32 missing = count - reserved;
+	uint32 refilled = reserve_some_pages(
+		missing + kMaxCachedPageReservations / 2,
+		kPageReserveForPriority[VM_PRIORITY_USER] + sFreePagesTarget);
+	if (refilled > missing) {
+		atomic_add(&cache.reserved, refilled - missing);
+		refilled = missing;
+	}
+
+	return reserved + refilled;
+}
+
+
+/*!	Puts up to \a count unreserved pages into the current CPU's reservation
+	cache, unless someone is waiting for pages.
+	\return The number of pages that have been taken care of.
+*/
+static uint32
+unreserve_cached_pages(uint32 count)
+{
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+
+	int32 toCache = std::min((int32)count,
+		kMaxCachedPageReservations - atomic_get(&cache.reserved));
+	if (toCache <= 0)
+		return 0;
+
+	atomic_add(&cache.reserved, toCache);
+
+	// Someone might have started to wait for pages in the meantime. Since
+	// reserve_pages() flushes the caches after announcing its need, either
+	// of us will see the other.
+	if (atomic_get(&sUnsatisfiedPageReservations) != 0) {
+		int32 flushed = atomic_get_and_set(&cache.reserved, 0);
+		if (flushed > 0)
+			atomic_add(&sUnreservedFreePages, flushed);
+	}
+
+	return toCache;
+}
+
+
+/*!	Returns the reservations cached by all CPUs to \c sUnreservedFreePages.
+	\return The number of pages that were returned.
+*/
+static int32
+flush_cached_page_reservations()
+{
+	int32 flushed = 0;
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		int32 reserved = atomic_get_and_set(&sPageCPUCaches[i].reserved, 0);
+		if (reserved > 0)
+			flushed += reserved;
+	}
+
+	if (flushed > 0)
+		atomic_add(&sUnreservedFreePages, flushed);
+
+	return flushed;
+}
+
+
+static int32
+cached_page_reservations()
+{
+	int32 reserved = 0;
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++)
+		reserved += atomic_get(&sPageCPUCaches[i].reserved);
+
+	return reserved;
+}
+
+
+static page_num_t
+cached_free_pages()
+{
+	page_num_t count = 0;
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		count += sPageCPUCaches[i].free_count
+			+ sPageCPUCaches[i].clear_count;
+	}
+
+	return count;
+}
+
+
+/*!	Moves all pages of the given CPU's cache back into the free/clear queues.
+	The caller must hold \c sFreePageQueuesLock.
+*/
+static void
+drain_page_cpu_cache(page_cpu_cache& cache)
+{
+	InterruptsSpinLocker locker(cache.lock);
+
+	sFreePageQueue.PrependUnlocked(cache.free_pages, cache.free_count);
+	sClearPageQueue.PrependUnlocked(cache.clear_pages, cache.clear_count);
+	cache.free_count = 0;
+	cache.clear_count = 0;
+}
+
+
+/*!	Prevents the CPUs from caching free pages, and moves all cached pages back
+	into the free/clear queues, so that the page states can be relied upon.
+	The caller must have write locked \c sFreePageQueuesLock, and must call
+	enable_page_cpu_caches() when done.
+*/
+static void
+disable_page_cpu_caches()
+{
+	atomic_add(&sPageCPUCachesDisabled, 1);
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++)
+		drain_page_cpu_cache(sPageCPUCaches[i]);
+}
+
+
+static inline void
+enable_page_cpu_caches()
+{
+	atomic_add(&sPageCPUCachesDisabled, -1);
+}
+
+
+/*!	Pops a page from \a cache, preferring a clear page if \a clear is \c true,
+	and sets its state to \a pageState.
+	The caller must hold the cache's lock.
+*/
+static inline vm_page*
+pop_cached_page(page_cpu_cache& cache, bool clear, uint32 pageState,
+	int& _oldPageState)
+{
+	vm_page* page;
+	if (clear && cache.clear_count > 0)
+		page = cache.clear_pages[--cache.clear_count];
+	else if (cache.free_count > 0)
+		page = cache.free_pages[--cache.free_count];
+	else if (cache.clear_count > 0)
+		page = cache.clear_pages[--cache.clear_count];
+	else
+		return NULL;
+
+	DEBUG_PAGE_ACCESS_START(page);
+
+	_oldPageState = page->State();
+	page->SetState(pageState);
+	return page;
+}
+
+
+/*!	Refills the empty \a cache with a batch of pages from the free/clear
+	queues, preferring clear pages if \a clear is \c true.
+	The caller must hold the cache's lock and \c sFreePageQueuesLock.
+*/
+static void
+refill_page_cpu_cache(page_cpu_cache& cache, bool clear)
+{
+	if (clear) {
+		cache.clear_count += sClearPageQueue.RemoveHeadUnlocked(
+			cache.clear_pages + cache.clear_count, kPageCPUCacheBatchSize);
+		if (cache.clear_count > 0)
+			return;
+	}
+
+	cache.free_count += sFreePageQueue.RemoveHeadUnlocked(
+		cache.free_pages + cache.free_count, kPageCPUCacheBatchSize);
+	if (cache.free_count == 0 && !clear) {
+		cache.clear_count += sClearPageQueue.RemoveHeadUnlocked(
+			cache.clear_pages + cache.clear_count, kPageCPUCacheBatchSize);
+	}
+}
+
+
+/*!	Allocates a reserved page from the current CPU's cache, refilling it from
+	the free/clear queues, if necessary.
+	\return The page, or \c NULL, if the caches are disabled, or the queues
+		didn't have any pages left.
+*/
+static vm_page*
+allocate_page_from_cpu_cache(bool clear, uint32 pageState,
+	int& _oldPageState)
+{
+	cpu_status state;
+	page_cpu_cache* cache = &lock_current_page_cpu_cache(state);
+
+	vm_page* page = NULL;
+	if (atomic_get(&sPageCPUCachesDisabled) == 0)
+		page = pop_cached_page(*cache, clear, pageState, _oldPageState);
+
+	unlock_page_cpu_cache(*cache, state);
+
+	if (page != NULL)
+		return page;
+
+	ReadLocker locker(sFreePageQueuesLock);
+
+	// we may have been migrated to another CPU
+	cache = &lock_current_page_cpu_cache(state);
+
+	if (atomic_get(&sPageCPUCachesDisabled) == 0) {
+		page = pop_cached_page(*cache, clear, pageState, _oldPageState);
+		if (page == NULL) {
+			refill_page_cpu_cache(*cache, clear);
+			page = pop_cached_page(*cache, clear, pageState, _oldPageState);
+		}
+	}
+
+	unlock_page_cpu_cache(*cache, state);
+
+	return page;
+}
+
+
+/*!	Puts the free \a page into the current CPU's cache, moving the older half
+	of the cache to the free/clear queues, if it's full.
+*/
+static void
+free_page_to_cpu_cache(vm_page* page, bool clear)
+{
+	uint8 pageState = clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE;
+
+	cpu_status state;
+	page_cpu_cache* cache = &lock_current_page_cpu_cache(state);
+
+	if (atomic_get(&sPageCPUCachesDisabled) == 0) {
+		uint32& count = clear ? cache->clear_count : cache->free_count;
+		if (count < kPageCPUCacheSize) {
+			page->SetState(pageState);
+			(clear ? cache->clear_pages : cache->free_pages)[count++] = page;
+			unlock_page_cpu_cache(*cache, state);
+			return;
+		}
+	}
+
+	unlock_page_cpu_cache(*cache, state);
+
+	ReadLocker locker(sFreePageQueuesLock);
+
+	cache = &lock_current_page_cpu_cache(state);
+
+	VMPageQueue& queue = clear ? sClearPageQueue : sFreePageQueue;
+	page->SetState(pageState);
+
+	if (atomic_get(&sPageCPUCachesDisabled) == 0) {
+		uint32& count = clear ? cache->clear_count : cache->free_count;
+		vm_page** pages = clear ? cache->clear_pages : cache->free_pages;
+		if (count == kPageCPUCacheSize) {
+			queue.PrependUnlocked(pages, kPageCPUCacheBatchSize);
+			count -= kPageCPUCacheBatchSize;
+			memmove(pages, pages + kPageCPUCacheBatchSize,
+				count * sizeof(vm_page*));
+		}
+		pages[count++] = page;
+	} else
+		queue.PrependUnlocked(page);
+
+	unlock_page_cpu_cache(*cache, state);
+}
+
+
+// #pragma mark -
+
+
 static inline void
 unreserve_pages(uint32 count)
 {
-	atomic_add(&sUnreservedFreePages, count);
+	if (atomic_get(&sUnsatisfiedPageReservations) == 0)
+		count -= unreserve_cached_pages(count);
+
+	if (count > 0)
+		atomic_add(&sUnreservedFreePages, count);
 	if (atomic_get(&sUnsatisfiedPageReservations) != 0)
 		wake_up_page_reservation_waiters();
 }
@@ -1511,19 +1926,9 @@ free_page(vm_page* page, bool clear)
 	page->allocation_tracking_info.Clear();
 #endif
 
-	ReadLocker locker(sFreePageQueuesLock);
-
 	DEBUG_PAGE_ACCESS_END(page);
 
-	if (clear) {
-		page->SetState(PAGE_STATE_CLEAR);
-		sClearPageQueue.PrependUnlocked(page);
-	} else {
-		page->SetState(PAGE_STATE_FREE);
-		sFreePageQueue.PrependUnlocked(page);
-	}
-
-	locker.Unlock();
+	free_page_to_cpu_cache(page, clear);
 }
 
 
@@ -1686,6 +2091,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 	}
 
 	WriteLocker locker(sFreePageQueuesLock);
+	disable_page_cpu_caches();
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1721,6 +2127,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 		}
 	}
 
+	enable_page_cpu_caches();
 	return B_OK;
 }
 
@@ -2263,6 +2670,51 @@ PageWriterRun::PageWritten(PageWriteTransfer* transfer, status_t status,
 }
 
 
+#if ENABLE_SWAP_SUPPORT
+
+/*!	Adds the modified pages directly following \a page in its cache to \a run,
+	up to the cache's maximum number of pages per write.
+	The page's cache must be locked.
+	\return The number of pages added.
+*/
+static uint32
+add_swap_cluster_pages(PageWriterRun& run, vm_page* page, uint32 maxPages)
+{
+	VMCache* cache = page->Cache();
+	int32 clusterPages = cache->MaxPagesPerAsyncWrite();
+	if (clusterPages >= 0 && (uint32)clusterPages - 1 < maxPages)
+		maxPages = clusterPages - 1;
+
+	uint32 addedPages = 0;
+	while (addedPages < maxPages) {
+		off_t offset
+			= (off_t)(page->cache_offset + addedPages + 1) << PAGE_SHIFT;
+		vm_page* nextPage = cache->LookupPage(offset);
+		if (nextPage == NULL || nextPage->busy
+			|| nextPage->State() != PAGE_STATE_MODIFIED
+			|| nextPage->WiredCount() > 0 || !cache->CanWritePage(offset)) {
+			break;
+		}
+
+		DEBUG_PAGE_ACCESS_START(nextPage);
+
+		cache->AcquireStoreRef();
+		run.AddPage(nextPage);
+
+		DEBUG_PAGE_ACCESS_END(nextPage);
+
+		TPW(WritePage(nextPage));
+
+		cache->AcquireRefLocked();
+		addedPages++;
+	}
+
+	return addedPages;
+}
+
+#endif	// ENABLE_SWAP_SUPPORT
+
+
 /*!	The page writer continuously takes some pages from the modified
 	queue, writes them back, and moves them back to the active queue.
 	It runs in its own thread, and is only there to keep the number
@@ -2407,6 +2859,16 @@ page_writer(void* /*unused*/)
 
 			cache->AcquireRefLocked();
 			numPages++;
+
+#if ENABLE_SWAP_SUPPORT
+			// Swap space is allocated when writing, so we write the modified
+			// pages following this one along with it, in order to get them
+			// swapped out contiguously, and read back in together.
+			if (cache->temporary && numPages < kNumPages) {
+				numPages += add_swap_cluster_pages(run, page,
+					kNumPages - numPages);
+			}
+#endif
 		}
 
 #ifdef TRACE_VM_PAGE
@@ -2588,42 +3050,76 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 }
 
 
-static void
-idle_scan_active_pages(page_stats& pageStats)
+/*!	Returns the page at the given clock hand of the slice, and advances the
+	hand, wrapping around at the end of the slice.
+*/
+static inline vm_page*
+next_slice_page(const PageDaemonSlice& slice, page_num_t& hand)
+{
+	vm_page* page = &sPages[hand];
+	if (++hand == slice.end)
+		hand = slice.start;
+	return page;
+}
+
+
+/*!	Locks the cache of the given page, if the page is in the given state and
+	not busy. Returns \c NULL otherwise, or if the cache couldn't be locked
+	without waiting.
+*/
+static VMCache*
+lock_slice_page_cache(vm_page* page, uint8 state)
 {
-	VMPageQueue& queue = sActivePageQueue;
+	// We don't bother to lock anything for the first check. We have to lock
+	// the page's cache anyway, and we'll recheck afterwards.
+	if (page->State() != state || page->busy)
+		return NULL;
 
-	// We want to scan the whole queue in roughly kIdleRunsForFullQueue runs.
-	uint32 maxToScan = queue.Count() / kIdleRunsForFullQueue + 1;
+	VMCache* cache = vm_cache_acquire_locked_page_cache(page, true);
+	if (cache == NULL)
+		return NULL;
+
+	if (page->State() != state || page->busy) {
+		// page is no longer in the cache or in this state
+		cache->ReleaseRefAndUnlock();
+		return NULL;
+	}
+
+	return cache;
+}
+
+
+/*!	Returns whether a good part of the pages of the given cache have been
+	accessed recently. The page daemon leaves the inactive pages of such caches
+	alone as long as things aren't desperate, so that the pages of caches that
+	are no longer in use are reclaimed first.
+	The caller must hold the cache lock.
+*/
+static inline bool
+is_working_set_cache(VMCache* cache)
+{
+	return cache->WorkingSetSize(sWorkingSetGeneration) * 2
+		>= cache->page_count;
+}
+
+
+static void
+idle_scan_active_pages(PageDaemonSlice& slice)
+{
+	// We want to scan the whole slice in roughly kIdleRunsForFullQueue runs.
+	page_num_t maxToScan = (slice.end - slice.start) / kIdleRunsForFullQueue
+		+ 1;
+	uint32 pagesScanned = 0;
 
 	while (maxToScan > 0) {
 		maxToScan--;
 
-		// Get the next page. Note that we don't bother to lock here. We go with
-		// the assumption that on all architectures reading/writing pointers is
-		// atomic. Beyond that it doesn't really matter. We have to unlock the
-		// queue anyway to lock the page's cache, and we'll recheck afterwards.
-		vm_page* page = queue.Head();
-		if (page == NULL)
-			break;
-
-		// lock the page's cache
-		VMCache* cache = vm_cache_acquire_locked_page_cache(page, true);
+		vm_page* page = next_slice_page(slice, slice.activeHand);
+		VMCache* cache = lock_slice_page_cache(page, PAGE_STATE_ACTIVE);
 		if (cache == NULL)
 			continue;
 
-		if (page->State() != PAGE_STATE_ACTIVE) {
-			// page is no longer in the cache or in this queue
-			cache->ReleaseRefAndUnlock();
-			continue;
-		}
-
-		if (page->busy) {
-			// page is busy -- requeue at the end
-			vm_page_requeue(page, true);
-			cache->ReleaseRefAndUnlock();
-			continue;
-		}
+		pagesScanned++;
 
 		DEBUG_PAGE_ACCESS_START(page);
 
@@ -2642,6 +3138,7 @@ idle_scan_active_pages(page_stats& pageStats)
 			usageCount = vm_remove_all_page_mappings_if_unaccessed(page);
 
 		if (usageCount > 0) {
+			cache->PageAccessed(page, sWorkingSetGeneration);
 			usageCount += page->usage_count + kPageUsageAdvance;
 			if (usageCount > kPageUsageMax)
 				usageCount = kPageUsageMax;
@@ -2660,65 +3157,29 @@ idle_scan_active_pages(page_stats& pageStats)
 
 		cache->ReleaseRefAndUnlock();
 	}
+
+	atomic_add64(&sPagesScanned, pagesScanned);
 }
 
 
 static void
-full_scan_inactive_pages(page_stats& pageStats, int32 despairLevel)
+full_scan_inactive_pages(PageDaemonSlice& slice, int32 despairLevel)
 {
-	int32 pagesToFree = pageStats.unsatisfiedReservations
-		+ sFreeOrCachedPagesTarget
-		- (pageStats.totalFreePages + pageStats.cachedPages);
-	if (pagesToFree <= 0)
-		return;
-
 	bigtime_t time = system_time();
 	uint32 pagesScanned = 0;
 	uint32 pagesToCached = 0;
 	uint32 pagesToModified = 0;
 	uint32 pagesToActive = 0;
 
-	// Determine how many pages at maximum to send to the modified queue. Since
-	// it is relatively expensive to page out pages, we do that on a grander
-	// scale only when things get desperate.
-	uint32 maxToFlush = despairLevel <= 1 ? 32 : 10000;
+	page_num_t maxToScan = slice.end - slice.start;
 
-	vm_page marker;
-	init_page_marker(marker);
-
-	VMPageQueue& queue = sInactivePageQueue;
-	InterruptsSpinLocker queueLocker(queue.GetLock());
-	uint32 maxToScan = queue.Count();
-
-	vm_page* nextPage = queue.Head();
-
-	while (pagesToFree > 0 && maxToScan > 0) {
+	while (atomic_get(&sPagesToFree) > 0 && maxToScan > 0) {
 		maxToScan--;
 
-		// get the next page
-		vm_page* page = nextPage;
-		if (page == NULL)
-			break;
-		nextPage = queue.Next(page);
-
-		if (page->busy)
-			continue;
-
-		// mark the position
-		queue.InsertAfter(page, &marker);
-		queueLocker.Unlock();
-
-		// lock the page's cache
-		VMCache* cache = vm_cache_acquire_locked_page_cache(page, true);
-		if (cache == NULL || page->busy
-				|| page->State() != PAGE_STATE_INACTIVE) {
-			if (cache != NULL)
-				cache->ReleaseRefAndUnlock();
-			queueLocker.Lock();
-			nextPage = queue.Next(&marker);
-			queue.Remove(&marker);
+		vm_page* page = next_slice_page(slice, slice.inactiveHand);
+		VMCache* cache = lock_slice_page_cache(page, PAGE_STATE_INACTIVE);
+		if (cache == NULL)
 			continue;
-		}
 
 		pagesScanned++;
 
@@ -2734,6 +3195,7 @@ full_scan_inactive_pages(page_stats& pageStats, int32 despairLevel)
 
 		// update usage count
 		if (usageCount > 0) {
+			cache->PageAccessed(page, sWorkingSetGeneration);
 			usageCount += page->usage_count + kPageUsageAdvance;
 			if (usageCount > kPageUsageMax)
 				usageCount = kPageUsageMax;
@@ -2745,9 +3207,11 @@ full_scan_inactive_pages(page_stats& pageStats, int32 despairLevel)
 
 		page->usage_count = usageCount;
 
-		// Move to fitting queue or requeue:
+		// Move to fitting queue or leave the page where it is:
 		// * Active mapped pages go to the active queue.
-		// * Inactive mapped (i.e. wired) pages are requeued.
+		// * Inactive mapped (i.e. wired) pages stay.
+		// * Unless things are desperate, so do the pages of caches that are
+		//   part of the working set.
 		// * The remaining pages are cachable. Thus, if unmodified they go to
 		//   the cached queue, otherwise to the modified queue (up to a limit).
 		//   Note that until in the idle scanning we don't exempt pages of
@@ -2758,38 +3222,33 @@ full_scan_inactive_pages(page_stats& pageStats, int32 despairLevel)
 			if (isMapped) {
 				set_page_state(page, PAGE_STATE_ACTIVE);
 				pagesToActive++;
-			} else
-				vm_page_requeue(page, true);
-		} else if (isMapped) {
-			vm_page_requeue(page, true);
-		} else if (!page->modified) {
-			set_page_state(page, PAGE_STATE_CACHED);
-			pagesToFree--;
-			pagesToCached++;
-		} else if (maxToFlush > 0) {
-			set_page_state(page, PAGE_STATE_MODIFIED);
-			maxToFlush--;
-			pagesToModified++;
-		} else
-			vm_page_requeue(page, true);
+			}
+		} else if (!isMapped
+			&& (despairLevel > 1 || !is_working_set_cache(cache))) {
+			if (!page->modified) {
+				set_page_state(page, PAGE_STATE_CACHED);
+				atomic_add(&sPagesToFree, -1);
+				pagesToCached++;
+			} else if (atomic_add(&sPagesToFlush, -1) > 0) {
+				set_page_state(page, PAGE_STATE_MODIFIED);
+				pagesToModified++;
+			}
+		}
 
 		DEBUG_PAGE_ACCESS_END(page);
 
 		cache->ReleaseRefAndUnlock();
-
-		// remove the marker
-		queueLocker.Lock();
-		nextPage = queue.Next(&marker);
-		queue.Remove(&marker);
 	}
 
-	queueLocker.Unlock();
+	atomic_add64(&sPagesScanned, pagesScanned);
+	atomic_add64(&sPagesReclaimed, pagesToCached);
+		// the modified pages have only been queued for writing
 
 	time = system_time() - time;
-	TRACE_DAEMON("  -> inactive scan (%7" B_PRId64 " us): scanned: %7" B_PRIu32
-		", moved: %" B_PRIu32 " -> cached, %" B_PRIu32 " -> modified, %"
-		B_PRIu32 " -> active\n", time, pagesScanned, pagesToCached,
-		pagesToModified, pagesToActive);
+	TRACE_DAEMON("  -> inactive scan %" B_PRIuPHYSADDR " (%7" B_PRId64 " us): "
+		"scanned: %7" B_PRIu32 ", moved: %" B_PRIu32 " -> cached, %" B_PRIu32
+		" -> modified, %" B_PRIu32 " -> active\n", slice.start, time,
+		pagesScanned, pagesToCached, pagesToModified, pagesToActive);
 
 	// wake up the page writer, if we tossed it some pages
 	if (pagesToModified > 0)
@@ -2798,55 +3257,22 @@ full_scan_inactive_pages(page_stats& pageStats, int32 despairLevel)
 
 
 static void
-full_scan_active_pages(page_stats& pageStats, int32 despairLevel)
+full_scan_active_pages(PageDaemonSlice& slice)
 {
-	vm_page marker;
-	init_page_marker(marker);
-
-	VMPageQueue& queue = sActivePageQueue;
-	InterruptsSpinLocker queueLocker(queue.GetLock());
-	uint32 maxToScan = queue.Count();
-
-	int32 pagesToDeactivate = pageStats.unsatisfiedReservations
-		+ sFreeOrCachedPagesTarget
-		- (pageStats.totalFreePages + pageStats.cachedPages)
-		+ std::max((int32)sInactivePagesTarget - (int32)maxToScan, (int32)0);
-	if (pagesToDeactivate <= 0)
-		return;
-
 	bigtime_t time = system_time();
 	uint32 pagesAccessed = 0;
 	uint32 pagesToInactive = 0;
 	uint32 pagesScanned = 0;
 
-	vm_page* nextPage = queue.Head();
+	page_num_t maxToScan = slice.end - slice.start;
 
-	while (pagesToDeactivate > 0 && maxToScan > 0) {
+	while (atomic_get(&sPagesToDeactivate) > 0 && maxToScan > 0) {
 		maxToScan--;
 
-		// get the next page
-		vm_page* page = nextPage;
-		if (page == NULL)
-			break;
-		nextPage = queue.Next(page);
-
-		if (page->busy)
-			continue;
-
-		// mark the position
-		queue.InsertAfter(page, &marker);
-		queueLocker.Unlock();
-
-		// lock the page's cache
-		VMCache* cache = vm_cache_acquire_locked_page_cache(page, true);
-		if (cache == NULL || page->busy || page->State() != PAGE_STATE_ACTIVE) {
-			if (cache != NULL)
-				cache->ReleaseRefAndUnlock();
-			queueLocker.Lock();
-			nextPage = queue.Next(&marker);
-			queue.Remove(&marker);
+		vm_page* page = next_slice_page(slice, slice.activeHand);
+		VMCache* cache = lock_slice_page_cache(page, PAGE_STATE_ACTIVE);
+		if (cache == NULL)
 			continue;
-		}
 
 		pagesScanned++;
 
@@ -2856,6 +3282,7 @@ full_scan_active_pages(page_stats& pageStats, int32 despairLevel)
 		int32 usageCount = vm_clear_page_mapping_accessed_flags(page);
 
 		if (usageCount > 0) {
+			cache->PageAccessed(page, sWorkingSetGeneration);
 			usageCount += page->usage_count + kPageUsageAdvance;
 			if (usageCount > kPageUsageMax)
 				usageCount = kPageUsageMax;
@@ -2866,6 +3293,7 @@ full_scan_active_pages(page_stats& pageStats, int32 despairLevel)
 			if (usageCount <= 0) {
 				usageCount = 0;
 				set_page_state(page, PAGE_STATE_INACTIVE);
+				atomic_add(&sPagesToDeactivate, -1);
 				pagesToInactive++;
 			}
 		}
@@ -2875,17 +3303,81 @@ full_scan_active_pages(page_stats& pageStats, int32 despairLevel)
 		DEBUG_PAGE_ACCESS_END(page);
 
 		cache->ReleaseRefAndUnlock();
-
-		// remove the marker
-		queueLocker.Lock();
-		nextPage = queue.Next(&marker);
-		queue.Remove(&marker);
 	}
 
+	atomic_add64(&sPagesScanned, pagesScanned);
+
 	time = system_time() - time;
-	TRACE_DAEMON("  ->   active scan (%7" B_PRId64 " us): scanned: %7" B_PRIu32
-		", moved: %" B_PRIu32 " -> inactive, encountered %" B_PRIu32 " accessed"
-		" ones\n", time, pagesScanned, pagesToInactive, pagesAccessed);
+	TRACE_DAEMON("  ->   active scan %" B_PRIuPHYSADDR " (%7" B_PRId64 " us): "
+		"scanned: %7" B_PRIu32 ", moved: %" B_PRIu32 " -> inactive, "
+		"encountered %" B_PRIu32 " accessed ones\n", slice.start, time,
+		pagesScanned, pagesToInactive, pagesAccessed);
+}
+
+
+static void
+scan_page_daemon_slice(PageDaemonSlice& slice)
+{
+	switch (sPageDaemonJob) {
+		case PAGE_DAEMON_IDLE_SCAN:
+			idle_scan_active_pages(slice);
+			break;
+		case PAGE_DAEMON_INACTIVE_SCAN:
+			full_scan_inactive_pages(slice, sPageDaemonDespairLevel);
+			break;
+		case PAGE_DAEMON_ACTIVE_SCAN:
+			full_scan_active_pages(slice);
+			break;
+	}
+}
+
+
+/*!	Runs the given scan job on all page daemon slices. The calling page daemon
+	thread scans the first slice itself, the page scanner threads the others.
+	Returns when all slices have been scanned.
+*/
+static void
+run_page_daemon_slices(uint32 job)
+{
+	sPageDaemonJob = job;
+
+	bigtime_t startTime = system_time();
+
+	ConditionVariableEntry entry;
+	if (sPageDaemonSliceCount > 1) {
+		sPageDaemonSlicesCondition.Add(&entry);
+		atomic_set(&sPendingPageDaemonSlices, sPageDaemonSliceCount - 1);
+
+		for (uint32 i = 1; i < sPageDaemonSliceCount; i++)
+			sPageDaemonSlices[i].condition.WakeUp();
+	}
+
+	scan_page_daemon_slice(sPageDaemonSlices[0]);
+
+	if (sPageDaemonSliceCount > 1)
+		entry.Wait();
+
+	atomic_add64(&sPageScanTime, system_time() - startTime);
+}
+
+
+static status_t
+page_scanner(void* data)
+{
+	PageDaemonSlice& slice = *(PageDaemonSlice*)data;
+
+	while (true) {
+		if (!slice.condition.Wait(B_INFINITE_TIMEOUT, false))
+			continue;
+		slice.condition.ClearActivated();
+
+		scan_page_daemon_slice(slice);
+
+		if (atomic_add(&sPendingPageDaemonSlices, -1) == 1)
+			sPageDaemonSlicesCondition.NotifyAll();
+	}
+
+	return B_OK;
 }
 
 
@@ -2904,28 +3396,37 @@ page_daemon_idle_scan(page_stats& pageStats)
 		get_page_stats(pageStats);
 	}
 
-	// Walk the active list and move pages to the inactive queue.
-	get_page_stats(pageStats);
-	idle_scan_active_pages(pageStats);
+	// Walk the active pages and move pages to the inactive queue.
+	run_page_daemon_slices(PAGE_DAEMON_IDLE_SCAN);
 }
 
 
 static void
 page_daemon_full_scan(page_stats& pageStats, int32 despairLevel)
 {
+	int32 pagesToFree = pageStats.unsatisfiedReservations
+		+ sFreeOrCachedPagesTarget
+		- (pageStats.totalFreePages + pageStats.cachedPages);
+
 	TRACE_DAEMON("page daemon: full run: free: %" B_PRIu32 ", cached: %"
-		B_PRIu32 ", to free: %" B_PRIu32 "\n", pageStats.totalFreePages,
-		pageStats.cachedPages, pageStats.unsatisfiedReservations
-			+ sFreeOrCachedPagesTarget
-			- (pageStats.totalFreePages + pageStats.cachedPages));
+		B_PRIu32 ", to free: %" B_PRId32 "\n", pageStats.totalFreePages,
+		pageStats.cachedPages, pagesToFree);
 
-	// Walk the inactive list and transfer pages to the cached and modified
+	// Walk the inactive pages and transfer pages to the cached and modified
 	// queues.
-	full_scan_inactive_pages(pageStats, despairLevel);
+	if (pagesToFree > 0) {
+		// Determine how many pages at maximum to send to the modified queue.
+		// Since it is relatively expensive to page out pages, we do that on a
+		// grander scale only when things get desperate.
+		atomic_set(&sPagesToFree, pagesToFree);
+		atomic_set(&sPagesToFlush, despairLevel <= 1 ? 32 : 10000);
+		sPageDaemonDespairLevel = despairLevel;
+		run_page_daemon_slices(PAGE_DAEMON_INACTIVE_SCAN);
+	}
 
 	// Free cached pages. Also wake up reservation waiters.
 	get_page_stats(pageStats);
-	int32 pagesToFree = pageStats.unsatisfiedReservations + sFreePagesTarget
+	pagesToFree = pageStats.unsatisfiedReservations + sFreePagesTarget
 		- (pageStats.totalFreePages);
 	if (pagesToFree > 0) {
 		uint32 freed = free_cached_pages(pagesToFree, true);
@@ -2933,9 +3434,17 @@ page_daemon_full_scan(page_stats& pageStats, int32 despairLevel)
 			unreserve_pages(freed);
 	}
 
-	// Walk the active list and move pages to the inactive queue.
+	// Walk the active pages and move pages to the inactive queue.
 	get_page_stats(pageStats);
-	full_scan_active_pages(pageStats, despairLevel);
+	int32 pagesToDeactivate = pageStats.unsatisfiedReservations
+		+ sFreeOrCachedPagesTarget
+		- (pageStats.totalFreePages + pageStats.cachedPages)
+		+ std::max((int32)sInactivePagesTarget
+			- (int32)sActivePageQueue.Count(), (int32)0);
+	if (pagesToDeactivate > 0) {
+		atomic_set(&sPagesToDeactivate, pagesToDeactivate);
+		run_page_daemon_slices(PAGE_DAEMON_ACTIVE_SCAN);
+	}
 }
 
 
@@ -2943,10 +3452,21 @@ static status_t
 page_daemon(void* /*unused*/)
 {
 	int32 despairLevel = 0;
+	uint32 runs = 0;
 
 	while (true) {
 		sPageDaemonCondition.ClearActivated();
 
+		// Start a new working set generation every kIdleRunsForFullQueue
+		// runs, i.e. about whenever the idle scan has covered all pages.
+		if (++runs % kIdleRunsForFullQueue == 0) {
+			// Skip the generations that look like unstamped pages
+			if ((uint8)++sWorkingSetGeneration
+					== VM_PAGE_NO_WORKING_SET_GENERATION) {
+				sWorkingSetGeneration++;
+			}
+		}
+
 		// evaluate the free pages situation
 		page_stats pageStats;
 		get_page_stats(pageStats);
@@ -2959,15 +3479,15 @@ page_daemon(void* /*unused*/)
 			sPageDaemonCondition.Wait(kIdleScanWaitInterval, false);
 		} else {
 			// Not enough free pages. We need to do some real work.
-			despairLevel = std::max(despairLevel + 1, (int32)3);
+			despairLevel = std::min(despairLevel + 1, (int32)3);
 			page_daemon_full_scan(pageStats, despairLevel);
 
 			// Don't wait after the first full scan, but rather immediately
 			// check whether we were successful in freeing enough pages and
 			// re-run with increased despair level. The first scan is
 			// conservative with respect to moving inactive modified pages to
-			// the modified list to avoid thrashing. The second scan, however,
-			// will not hold back.
+			// the modified list to avoid thrashing and spares the caches in
+			// the working set. The second scan, however, will not hold back.
 			if (despairLevel > 1)
 				snooze(kBusyScanWaitInterval);
 		}
@@ -2984,11 +3504,19 @@ reserve_pages(uint32 count, int priority, bool dontWait)
 {
 	int32 dontTouch = kPageReserveForPriority[priority];
 
+	count -= reserve_cached_pages(count);
+	if (count == 0)
+		return 0;
+
 	while (true) {
 		count -= reserve_some_pages(count, dontTouch);
 		if (count == 0)
 			return 0;
 
+		// other CPUs might still cache some reservations
+		if (flush_cached_page_reservations() > 0)
+			continue;
+
 		if (sUnsatisfiedPageReservations == 0) {
 			count -= free_cached_pages(count, dontWait);
 			if (count == 0)
@@ -3003,11 +3531,14 @@ reserve_pages(uint32 count, int priority, bool dontWait)
 		MutexLocker pageDeficitLocker(sPageDeficitLock);
 
 		bool notifyDaemon = sUnsatisfiedPageReservations == 0;
-		sUnsatisfiedPageReservations += count;
+		atomic_add(&sUnsatisfiedPageReservations, count);
+
+		// make sure no CPU keeps reservations cached that we need
+		flush_cached_page_reservations();
 
 		if (atomic_get(&sUnreservedFreePages) > dontTouch) {
 			// the situation changed
-			sUnsatisfiedPageReservations -= count;
+			atomic_add(&sUnsatisfiedPageReservations, -(int32)count);
 			continue;
 		}
 
@@ -3036,9 +3567,14 @@ reserve_pages(uint32 count, int priority, bool dontWait)
 
 		pageDeficitLocker.Unlock();
 
+		bigtime_t waitStartTime = system_time();
+
 		low_resource(B_KERNEL_RESOURCE_PAGES, count, B_RELATIVE_TIMEOUT, 0);
 		thread_block();
 
+		atomic_add64(&sReclaimWaits, 1);
+		atomic_add64(&sReclaimWaitTime, system_time() - waitStartTime);
+
 		pageDeficitLocker.Lock();
 
 		return 0;
@@ -3421,6 +3957,33 @@ vm_page_init_post_thread(kernel_args *args)
 
 	sPageDaemonCondition.Init("page daemon");
 
+	// Partition the page array into slices, one per CPU, as long as they don't
+	// get too small. The page daemon scans the first slice itself and spawns
+	// a page scanner thread for each of the others.
+	page_num_t sliceCount = (sNumPages - sNonExistingPages)
+		/ kMinPagesPerPageDaemonSlice;
+	sliceCount = std::min(sliceCount, (page_num_t)smp_get_num_cpus());
+	sliceCount = std::min(sliceCount, (page_num_t)kMaxPageDaemonSlices);
+	sPageDaemonSliceCount = std::max(sliceCount, (page_num_t)1);
+
+	sPageDaemonSlicesCondition.Init(&sPageDaemonSlices, "page daemon slices");
+
+	for (uint32 i = 0; i < sPageDaemonSliceCount; i++) {
+		PageDaemonSlice& slice = sPageDaemonSlices[i];
+		slice.start = sNumPages * i / sPageDaemonSliceCount;
+		slice.end = sNumPages * (i + 1) / sPageDaemonSliceCount;
+		slice.activeHand = slice.start;
+		slice.inactiveHand = slice.start;
+		slice.condition.Init("page scanner");
+
+		if (i == 0)
+			continue;
+
+		thread = spawn_kernel_thread(&page_scanner, "page scanner",
+			B_NORMAL_PRIORITY, &slice);
+		resume_thread(thread);
+	}
+
 	thread = spawn_kernel_thread(&page_daemon, "page daemon",
 		B_NORMAL_PRIORITY, NULL);
 	resume_thread(thread);
@@ -3513,66 +4076,61 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
+	int oldPageState;
 
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
-
-	ReadLocker locker(sFreePageQueuesLock);
-
-	vm_page* page = queue->RemoveHeadUnlocked();
+	vm_page* page = allocate_page_from_cpu_cache(clear, pageState,
+		oldPageState);
 	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		// Unlikely, but possible: the page we have reserved is in another
+		// CPU's cache, or the caches are disabled. Grab the write locker to
+		// get all pages back into the queues.
+		VMPageQueue* queue;
+		VMPageQueue* otherQueue;
+
+		if (clear) {
+			queue = &sClearPageQueue;
+			otherQueue = &sFreePageQueue;
+		} else {
+			queue = &sFreePageQueue;
+			otherQueue = &sClearPageQueue;
+		}
 
-		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
+		WriteLocker writeLocker(sFreePageQueuesLock);
 
-			page = queue->RemoveHead();
-			if (page == NULL)
-				otherQueue->RemoveHead();
+		disable_page_cpu_caches();
+		enable_page_cpu_caches();
 
-			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
-			}
+		page = queue->RemoveHead();
+		if (page == NULL)
+			page = otherQueue->RemoveHead();
 
-			// downgrade to read lock
-			locker.Lock();
+		if (page == NULL) {
+			panic("Had reserved page, but there is none!");
+			return NULL;
 		}
+
+		DEBUG_PAGE_ACCESS_START(page);
+
+		oldPageState = page->State();
+		page->SetState(pageState);
 	}
 
 	if (page->CacheRef() != NULL)
 		panic("supposed to be free page %p has cache\n", page);
 
-	DEBUG_PAGE_ACCESS_START(page);
-
-	int oldPageState = page->State();
-	page->SetState(pageState);
 	page->busy = (flags & VM_PAGE_ALLOC_BUSY) != 0;
 	page->usage_count = 0;
+	page->working_set_generation = VM_PAGE_NO_WORKING_SET_GENERATION;
 	page->accessed = false;
 	page->modified = false;
 
-	locker.Unlock();
-
 	if (pageState < PAGE_STATE_FIRST_UNQUEUED)
 		sPageQueues[pageState].AppendUnlocked(page);
 
 	// clear the page, if we had to take it from the free queue and a clear
 	// page was requested
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0 && oldPageState != PAGE_STATE_CLEAR)
+	if (clear && oldPageState != PAGE_STATE_CLEAR)
 		clear_page(page);
 
 #if VM_PAGE_ALLOCATION_TRACKING_AVAILABLE
@@ -3676,6 +4234,7 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 			page.SetState(flags & VM_PAGE_ALLOC_STATE);
 			page.busy = (flags & VM_PAGE_ALLOC_BUSY) != 0;
 			page.usage_count = 0;
+			page.working_set_generation = VM_PAGE_NO_WORKING_SET_GENERATION;
 			page.accessed = false;
 			page.modified = false;
 		}
@@ -3719,6 +4278,7 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 			page.SetState(flags & VM_PAGE_ALLOC_STATE);
 			page.busy = (flags & VM_PAGE_ALLOC_BUSY) != 0;
 			page.usage_count = 0;
+			page.working_set_generation = VM_PAGE_NO_WORKING_SET_GENERATION;
 			page.accessed = false;
 			page.modified = false;
 
@@ -3777,8 +4337,10 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 
 	\param flags Page allocation flags. Encodes the state the function shall
 		set the allocated pages to, whether the pages shall be marked busy
-		(VM_PAGE_ALLOC_BUSY), and whether the pages shall be cleared
-		(VM_PAGE_ALLOC_CLEAR).
+		(VM_PAGE_ALLOC_BUSY), whether the pages shall be cleared
+		(VM_PAGE_ALLOC_CLEAR), and whether the function may wait for pages
+		(not with VM_PAGE_ALLOC_DONT_WAIT). In the latter case only free pages
+		are considered, and cached pages are never stolen.
 	\param length The number of contiguous pages to allocate.
 	\param restrictions Restrictions to the physical addresses of the page run
 		to allocate, including \c low_address, the first acceptable physical
@@ -3830,17 +4392,29 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 		boundaryMask = -boundary;
 	}
 
+	bool dontWait = (flags & VM_PAGE_ALLOC_DONT_WAIT) != 0;
+
 	vm_page_reservation reservation;
-	vm_page_reserve_pages(&reservation, length, priority);
+	if (dontWait) {
+		if (!vm_page_try_reserve_pages(&reservation, length, priority))
+			return NULL;
+	} else
+		vm_page_reserve_pages(&reservation, length, priority);
 
 	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
 
+	// the page states have to be accurate while we're looking for a run
+	disable_page_cpu_caches();
+
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
 	// ones, the odds are that we won't find enough contiguous ones, so we skip
 	// the first iteration in this case.
+	// Freeing cached pages requires locking their caches, so we never do that
+	// when we must not wait.
 	int32 freePages = sUnreservedFreePages;
-	int useCached = freePages > 0 && (page_num_t)freePages > 2 * length ? 0 : 1;
+	int useCached = dontWait
+		|| (freePages > 0 && (page_num_t)freePages > 2 * length) ? 0 : 1;
 
 	for (;;) {
 		if (alignmentMask != 0 || boundaryMask != 0) {
@@ -3860,7 +4434,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 		}
 
 		if (start + length > end) {
-			if (useCached == 0) {
+			if (useCached == 0 && !dontWait) {
 				// The first iteration with free pages only was unsuccessful.
 				// Try again also considering cached pages.
 				useCached = 1;
@@ -3868,13 +4442,17 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 				continue;
 			}
 
-			dprintf("vm_page_allocate_page_run(): Failed to allocate run of "
-				"length %" B_PRIuPHYSADDR " (%" B_PRIuPHYSADDR " %"
-				B_PRIuPHYSADDR ") in second iteration (align: %" B_PRIuPHYSADDR
-				" boundary: %" B_PRIuPHYSADDR ")!\n", length, requestedStart,
-				end, restrictions->alignment, restrictions->boundary);
+			if (!dontWait) {
+				dprintf("vm_page_allocate_page_run(): Failed to allocate run "
+					"of length %" B_PRIuPHYSADDR " (%" B_PRIuPHYSADDR " %"
+					B_PRIuPHYSADDR ") in second iteration (align: %"
+					B_PRIuPHYSADDR " boundary: %" B_PRIuPHYSADDR ")!\n",
+					length, requestedStart, end, restrictions->alignment,
+					restrictions->boundary);
+			}
 
 			freeClearQueueLocker.Unlock();
+			enable_page_cpu_caches();
 			vm_page_unreserve_pages(&reservation);
 			return NULL;
 		}
@@ -3893,8 +4471,10 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 
 		if (foundRun) {
 			i = allocate_page_run(start, length, flags, freeClearQueueLocker);
-			if (i == length)
+			if (i == length) {
+				enable_page_cpu_caches();
 				return &sPages[start];
+			}
 
 			// apparently a cached page couldn't be allocated -- skip it and
 			// continue
@@ -4049,7 +4629,8 @@ vm_page_num_available_pages(void)
 page_num_t
 vm_page_num_free_pages(void)
 {
-	int32 count = sUnreservedFreePages + sCachedPageQueue.Count();
+	int32 count = sUnreservedFreePages + cached_page_reservations()
+		+ sCachedPageQueue.Count();
 	return count > 0 ? count : 0;
 }
 
@@ -4057,7 +4638,7 @@ vm_page_num_free_pages(void)
 page_num_t
 vm_page_num_unused_pages(void)
 {
-	int32 count = sUnreservedFreePages;
+	int32 count = sUnreservedFreePages + cached_page_reservations();
 	return count > 0 ? count : 0;
 }
 
@@ -4095,7 +4676,7 @@ vm_page_get_stats(system_info *info)
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
 	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+		+ sClearPageQueue.Count() + cached_free_pages();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -4112,6 +4693,19 @@ vm_page_get_stats(system_info *info)
 }
 
 
+/*!	Fills in the page daemon related fields of the given VM statistics. */
+void
+vm_page_get_daemon_stats(vm_stats* stats)
+{
+	stats->page_daemon_threads = sPageDaemonSliceCount;
+	stats->pages_scanned = atomic_get64(&sPagesScanned);
+	stats->page_scan_time = atomic_get64(&sPageScanTime);
+	stats->pages_reclaimed = atomic_get64(&sPagesReclaimed);
+	stats->reclaim_waits = atomic_get64(&sReclaimWaits);
+	stats->reclaim_wait_time = atomic_get64(&sReclaimWaitTime);
+}
+
+
 /*!	Returns the greatest address within the last page of accessible physical
 	memory.
 	The value is inclusive, i.e. in case of a 32 bit phys_addr_t 0xffffffff
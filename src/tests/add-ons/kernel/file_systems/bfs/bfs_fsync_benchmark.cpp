@@ -0,0 +1,217 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the fsync() throughput of an increasing number of threads that
+	each append small records to their own file, like a database writing its
+	log would do. Prints the journal statistics of the BFS volume for each
+	run, which show how many of the commits could be shared.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+#include "bfs_control.h"
+
+
+static const int32 kMaxThreads = 64;
+
+static const char* sBaseDirectory = "/boot/home/bfs_fsync_benchmark";
+static size_t sRecordSize = 512;
+static bigtime_t sDuration = 1000000LL;
+static int sDirectoryFD = -1;
+static int32 sStop;
+
+
+static bool
+get_journal_stats(journal_stats& stats)
+{
+	return ioctl(sDirectoryFD, BFS_IOCTL_GET_JOURNAL_STATS, &stats,
+		sizeof(stats)) == 0;
+}
+
+
+static status_t
+fsync_thread(void* _data)
+{
+	int32 index = (int32)(addr_t)_data;
+	int64 count = 0;
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/log%" B_PRId32, sBaseDirectory, index);
+
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", path,
+			strerror(errno));
+		exit(1);
+	}
+
+	char* record = (char*)malloc(sRecordSize);
+	if (record == NULL) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+	memset(record, 'a' + index % 26, sRecordSize);
+
+	while (atomic_get(&sStop) == 0) {
+		if (write(fd, record, sRecordSize) != (ssize_t)sRecordSize
+			|| fsync(fd) != 0) {
+			fprintf(stderr, "Could not write \"%s\": %s\n", path,
+				strerror(errno));
+			exit(1);
+		}
+		count++;
+	}
+
+	free(record);
+	close(fd);
+	unlink(path);
+
+	return count > INT32_MAX ? INT32_MAX : (status_t)count;
+}
+
+
+static void
+print_latency_histogram(const journal_stats& before,
+	const journal_stats& after)
+{
+	bigtime_t limit = 32;
+	for (int32 i = 0; i < BFS_JOURNAL_LATENCY_SLOTS; i++, limit *= 2) {
+		uint64 count = after.commit_latency[i] - before.commit_latency[i];
+		if (count == 0)
+			continue;
+
+		if (i == BFS_JOURNAL_LATENCY_SLOTS - 1)
+			printf("\t      >= %8" B_PRIdBIGTIME " us", limit / 2);
+		else
+			printf("\t%8" B_PRIdBIGTIME " us", limit);
+		printf(": %10" B_PRIu64 "\n", count);
+	}
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	sStop = 0;
+
+	journal_stats before;
+	bool haveStats = get_journal_stats(before);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&fsync_thread, "fsync storm",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+	}
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	snooze(sDuration);
+	atomic_set(&sStop, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t count;
+		wait_for_thread(threads[i], &count);
+		total += count;
+	}
+	bigtime_t time = system_time() - start;
+
+	printf("%3" B_PRId32 " threads: %8" B_PRId64 " fsyncs, %7.0f per second",
+		threadCount, total, total * 1000000.0 / time);
+
+	journal_stats after;
+	if (haveStats && get_journal_stats(after)) {
+		uint64 requests = after.sync_requests - before.sync_requests;
+		printf(", %" B_PRIu64 " log writes, %" B_PRIu64 "%% shared, "
+			"%" B_PRIu64 " checkpoints, %" B_PRIu64 " log full\n",
+			after.log_writes - before.log_writes,
+			requests > 0
+				? (after.shared_syncs - before.shared_syncs) * 100 / requests
+				: 0,
+			after.checkpoints - before.checkpoints,
+			after.log_full_waits - before.log_full_waits);
+		print_latency_histogram(before, after);
+	} else
+		putchar('\n');
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-t <max-threads>] [-s <record-size>] "
+		"[-d <seconds-per-run>] [-b <base-directory>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 32;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:s:d:b:h")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = atol(optarg);
+				break;
+			case 's':
+				sRecordSize = atol(optarg);
+				break;
+			case 'd':
+				sDuration = atol(optarg) * 1000000LL;
+				break;
+			case 'b':
+				sBaseDirectory = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (maxThreads < 1 || maxThreads > kMaxThreads || sRecordSize < 1
+		|| sRecordSize > 65536 || sDuration <= 0)
+		usage(argv[0]);
+
+	if (mkdir(sBaseDirectory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", sBaseDirectory,
+			strerror(errno));
+		return 1;
+	}
+
+	sDirectoryFD = open(sBaseDirectory, O_RDONLY);
+	if (sDirectoryFD < 0) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", sBaseDirectory,
+			strerror(errno));
+		return 1;
+	}
+
+	journal_stats stats;
+	if (!get_journal_stats(stats)) {
+		fprintf(stderr, "\"%s\" is not on a BFS volume, no journal "
+			"statistics available.\n", sBaseDirectory);
+	}
+
+	printf("write(%zu bytes) + fsync() in \"%s\"\n", sRecordSize,
+		sBaseDirectory);
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+		run_test(threads);
+
+	close(sDirectoryFD);
+	rmdir(sBaseDirectory);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Prints the memory a package file system volume uses for its nodes and
+	strings, and measures how long it takes to read all of its directories,
+	and to stat all of its entries.
+	Run it before and after a change of the packagefs node representation to
+	compare them.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+#include <packagefs.h>
+
+
+static const char* sMountPoint = "/boot/system";
+static int32 sRuns = 5;
+
+
+struct walk_statistics {
+	uint32	directories;
+	uint32	entries;
+};
+
+
+static void
+walk_directory(int dirFD, walk_statistics& statistics)
+{
+	DIR* dir = fdopendir(dirFD);
+	if (dir == NULL) {
+		close(dirFD);
+		return;
+	}
+
+	statistics.directories++;
+
+	while (struct dirent* entry = readdir(dir)) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		statistics.entries++;
+
+		struct stat st;
+		if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0
+			|| !S_ISDIR(st.st_mode)) {
+			continue;
+		}
+
+		// don't leave the volume
+		if (st.st_dev != entry->d_dev)
+			continue;
+
+		int fd = openat(dirfd(dir), entry->d_name, O_RDONLY | O_DIRECTORY);
+		if (fd >= 0)
+			walk_directory(fd, statistics);
+	}
+
+	closedir(dir);
+}
+
+
+static bool
+print_memory_usage(int fd)
+{
+	PackageFSMemoryUsage usage;
+	if (ioctl(fd, PACKAGE_FS_OPERATION_GET_MEMORY_USAGE, &usage,
+			sizeof(usage)) != 0) {
+		fprintf(stderr, "Failed to get the memory usage of \"%s\": %s\n",
+			sMountPoint, strerror(errno));
+		return false;
+	}
+
+	printf("%s: %" B_PRIu32 " packages\n", sMountPoint, usage.packageCount);
+	printf("  nodes:      %8" B_PRIu32 ", attributes: %" B_PRIu32 ", %"
+		B_PRIu64 " KiB (%" B_PRIu64 " bytes per node)\n", usage.nodeCount,
+		usage.attributeCount, usage.nodeBytes / 1024,
+		usage.nodeCount > 0 ? usage.nodeBytes / usage.nodeCount : 0);
+	printf("  strings:    %8" B_PRIu32 ", references: %" B_PRIu32 ", %"
+		B_PRIu64 " KiB\n", usage.stringCount, usage.stringReferenceCount,
+		usage.stringBytes / 1024);
+	printf("  all pooled: %8" B_PRIu32 ", %" B_PRIu64 " KiB\n",
+		usage.poolStringCount, usage.poolStringBytes / 1024);
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-r <runs>] [<packagefs mount point>]\n",
+		programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "r:h")) != -1) {
+		switch (option) {
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		sMountPoint = argv[optind++];
+	if (optind < argc || sRuns < 1)
+		usage(argv[0]);
+
+	int fd = open(sMountPoint, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open \"%s\": %s\n", sMountPoint,
+			strerror(errno));
+		return 1;
+	}
+
+	bool success = print_memory_usage(fd);
+	close(fd);
+	if (!success)
+		return 1;
+
+	for (int32 run = 0; run < sRuns; run++) {
+		fd = open(sMountPoint, O_RDONLY | O_DIRECTORY);
+		if (fd < 0)
+			return 1;
+
+		walk_statistics statistics = {};
+		bigtime_t startTime = system_time();
+		walk_directory(fd, statistics);
+		bigtime_t time = system_time() - startTime;
+
+		printf("readdir/stat of %" B_PRIu32 " directories, %" B_PRIu32
+			" entries: %" B_PRIdBIGTIME " usecs\n", statistics.directories,
+			statistics.entries, time);
+	}
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Recompresses the heap chunks of the given packages with each of the
+	supported heap compression algorithms, and compares the amount of data
+	that has to be read from disk when all of it is accessed, like on an
+	application launch, as well as the time it takes to decompress it again.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <package/hpkg/HPKGDefs.h>
+#include <package/hpkg/PackageFileHeapReader.h>
+#include <package/hpkg/PackageReaderImpl.h>
+#include <package/hpkg/StandardErrorOutput.h>
+
+#include <Lz4CompressionAlgorithm.h>
+#include <ZlibCompressionAlgorithm.h>
+
+
+using namespace BPackageKit::BHPKG;
+using BPackageKit::BHPKG::BPrivate::PackageFileHeapReader;
+using BPackageKit::BHPKG::BPrivate::PackageReaderImpl;
+
+
+static const size_t kChunkSize = PackageFileHeapReader::kChunkSize;
+
+
+struct Algorithm {
+	const char*					name;
+	BCompressionAlgorithm*		algorithm;
+	BCompressionParameters*		parameters;
+	uint64						compressedSize;
+	bigtime_t					compressionTime;
+	bigtime_t					decompressionTime;
+};
+
+
+struct Chunk {
+	uint8*	data;
+	size_t	size;
+		// == the uncompressed size, if stored uncompressed
+	size_t	uncompressedSize;
+};
+
+
+static int32 sRuns = 5;
+
+
+static bool
+benchmark_package(const char* fileName, Algorithm* algorithms,
+	int32 algorithmCount, uint64& _uncompressedSize, uint64& _originalSize)
+{
+	BStandardErrorOutput errorOutput;
+	PackageReaderImpl reader(&errorOutput);
+	status_t error = reader.Init(fileName, 0);
+	if (error != B_OK) {
+		fprintf(stderr, "Failed to open package \"%s\": %s\n", fileName,
+			strerror(error));
+		return false;
+	}
+
+	PackageFileHeapReader* heapReader = reader.RawHeapReader();
+	uint64 heapSize = heapReader->UncompressedHeapSize();
+	size_t chunkCount = (heapSize + kChunkSize - 1) / kChunkSize;
+
+	_uncompressedSize += heapSize;
+	_originalSize += heapReader->CompressedHeapSize();
+
+	uint8* uncompressed = (uint8*)malloc(heapSize + 1);
+	uint8* buffer = (uint8*)malloc(kChunkSize);
+	Chunk* chunks = (Chunk*)calloc(chunkCount + 1, sizeof(Chunk));
+	if (uncompressed == NULL || buffer == NULL || chunks == NULL) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+
+	error = heapReader->ReadData(0, uncompressed, heapSize);
+	if (error != B_OK) {
+		fprintf(stderr, "Failed to read heap of \"%s\": %s\n", fileName,
+			strerror(error));
+		free(chunks);
+		free(buffer);
+		free(uncompressed);
+		return false;
+	}
+
+	for (int32 i = 0; i < algorithmCount; i++) {
+		Algorithm& algorithm = algorithms[i];
+
+		// compress all chunks, just like the package writer does
+		bigtime_t startTime = system_time();
+		for (size_t k = 0; k < chunkCount; k++) {
+			Chunk& chunk = chunks[k];
+			uint8* data = uncompressed + k * kChunkSize;
+			chunk.uncompressedSize = k + 1 < chunkCount
+				? kChunkSize : heapSize - k * kChunkSize;
+
+			size_t compressedSize;
+			if (algorithm.algorithm->CompressBuffer(data,
+					chunk.uncompressedSize, buffer, chunk.uncompressedSize,
+					compressedSize, algorithm.parameters) != B_OK
+				|| compressedSize == chunk.uncompressedSize) {
+				compressedSize = chunk.uncompressedSize;
+				memcpy(buffer, data, compressedSize);
+			}
+
+			chunk.data = (uint8*)malloc(compressedSize);
+			if (chunk.data == NULL) {
+				fprintf(stderr, "Out of memory!\n");
+				exit(1);
+			}
+			memcpy(chunk.data, buffer, compressedSize);
+			chunk.size = compressedSize;
+			algorithm.compressedSize += compressedSize;
+		}
+		algorithm.compressionTime += system_time() - startTime;
+
+		// decompress them again, take the best run
+		bigtime_t bestTime = B_INFINITE_TIMEOUT;
+		for (int32 run = 0; run < sRuns; run++) {
+			startTime = system_time();
+			for (size_t k = 0; k < chunkCount; k++) {
+				Chunk& chunk = chunks[k];
+				if (chunk.size == chunk.uncompressedSize) {
+					memcpy(buffer, chunk.data, chunk.size);
+					continue;
+				}
+
+				size_t size;
+				error = algorithm.algorithm->DecompressBuffer(chunk.data,
+					chunk.size, buffer, kChunkSize, size);
+				if (error != B_OK || size != chunk.uncompressedSize
+					|| memcmp(buffer, uncompressed + k * kChunkSize,
+						size) != 0) {
+					fprintf(stderr, "%s: chunk %zu of \"%s\" does not "
+						"decompress correctly\n", algorithm.name, k, fileName);
+					exit(1);
+				}
+			}
+
+			bigtime_t time = system_time() - startTime;
+			if (time < bestTime)
+				bestTime = time;
+		}
+		algorithm.decompressionTime += bestTime;
+
+		for (size_t k = 0; k < chunkCount; k++)
+			free(chunks[k].data);
+	}
+
+	free(chunks);
+	free(buffer);
+	free(uncompressed);
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-r <runs>] <package> ...\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "r:h")) != -1) {
+		switch (option) {
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind >= argc || sRuns < 1)
+		usage(argv[0]);
+
+	BZlibCompressionAlgorithm zlibAlgorithm;
+	BZlibCompressionParameters zlibParameters(
+		B_HPKG_COMPRESSION_LEVEL_BEST);
+	BLz4CompressionAlgorithm lz4Algorithm;
+	BLz4CompressionParameters lz4Parameters;
+
+	Algorithm algorithms[] = {
+		{ "zlib", &zlibAlgorithm, &zlibParameters, 0, 0, 0 },
+		{ "lz4", &lz4Algorithm, &lz4Parameters, 0, 0, 0 },
+	};
+	const int32 algorithmCount = sizeof(algorithms) / sizeof(algorithms[0]);
+
+	uint64 uncompressedSize = 0;
+	uint64 originalSize = 0;
+	int32 packageCount = 0;
+	for (int32 i = optind; i < argc; i++) {
+		if (benchmark_package(argv[i], algorithms, algorithmCount,
+				uncompressedSize, originalSize)) {
+			packageCount++;
+		}
+	}
+
+	if (packageCount == 0)
+		return 1;
+
+	printf("%" B_PRId32 " packages, %" B_PRIu64 " bytes uncompressed, %"
+		B_PRIu64 " bytes as stored\n", packageCount, uncompressedSize,
+		originalSize);
+	printf("algorithm  bytes to read   ratio  compress    decompress"
+		"  MB/s\n");
+	for (int32 i = 0; i < algorithmCount; i++) {
+		Algorithm& algorithm = algorithms[i];
+		printf("%-9s  %13" B_PRIu64 "  %5.1f%%  %7" B_PRId64 " ms  %7"
+			B_PRId64 " ms  %6.1f\n", algorithm.name, algorithm.compressedSize,
+			uncompressedSize > 0
+				? 100.0 * algorithm.compressedSize / uncompressedSize : 0.0,
+			algorithm.compressionTime / 1000,
+			algorithm.decompressionTime / 1000,
+			algorithm.decompressionTime > 0
+				? (double)uncompressedSize / algorithm.decompressionTime : 0.0);
+	}
+
+	return 0;
+}
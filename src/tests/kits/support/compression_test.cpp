@@ -12,6 +12,7 @@
 
 #include <File.h>
 
+#include <Lz4CompressionAlgorithm.h>
 #include <ZlibCompressionAlgorithm.h>
 
 
@@ -41,6 +42,9 @@ static const char* kUsage =
 	"      Print this usage info.\n"
 	"  -i, --input-stream\n"
 	"      Use the input stream API (default is output stream API).\n"
+	"  -t, --test-lz4\n"
+	"      Run the LZ4 round-trip and malformed input tests instead, and\n"
+	"      exit.\n"
 ;
 
 
@@ -52,6 +56,192 @@ print_usage_and_exit(bool error)
 }
 
 
+// #pragma mark - LZ4 tests
+
+
+static int sLz4Failures = 0;
+
+
+static void
+lz4_check(bool condition, const char* test, const char* what)
+{
+	if (condition)
+		return;
+
+	fprintf(stderr, "LZ4 test \"%s\" failed: %s\n", test, what);
+	sLz4Failures++;
+}
+
+
+static void
+lz4_test_round_trip(const char* test, const uint8* data, size_t size)
+{
+	BLz4CompressionAlgorithm algorithm;
+
+	// the worst case of incompressible data, plus the length bytes
+	size_t compressedCapacity = size + size / 255 + 16;
+	uint8* compressed = (uint8*)malloc(compressedCapacity);
+	uint8* decompressed = (uint8*)malloc(size + 1);
+	if (compressed == NULL || decompressed == NULL) {
+		lz4_check(false, test, "out of memory");
+		free(compressed);
+		free(decompressed);
+		return;
+	}
+
+	size_t compressedSize;
+	status_t error = algorithm.CompressBuffer(data, size, compressed,
+		compressedCapacity, compressedSize);
+	lz4_check(error == B_OK, test, "compression failed");
+
+	if (error == B_OK) {
+		size_t decompressedSize;
+		error = algorithm.DecompressBuffer(compressed, compressedSize,
+			decompressed, size, decompressedSize);
+		lz4_check(error == B_OK, test, "decompression failed");
+		lz4_check(error != B_OK
+			|| (decompressedSize == size
+				&& memcmp(decompressed, data, size) == 0),
+			test, "data differs after the round trip");
+
+		// the output buffer must be large enough for all of it
+		if (size > 0) {
+			error = algorithm.DecompressBuffer(compressed, compressedSize,
+				decompressed, size - 1, decompressedSize);
+			lz4_check(error == B_BUFFER_OVERFLOW, test,
+				"decompressing into a too small buffer didn't fail");
+		}
+
+		// a truncated block must never decompress to the whole data; check
+		// all lengths at the start and the end of the block, and some
+		// between them
+		size_t step = compressedSize / 64 > 1 ? compressedSize / 64 : 1;
+		for (size_t length = 0; length < compressedSize;
+				length += length < 64 || compressedSize - length <= 64
+					? 1 : step) {
+			error = algorithm.DecompressBuffer(compressed, length,
+				decompressed, size + 1, decompressedSize);
+			if (error == B_OK && decompressedSize >= size) {
+				lz4_check(false, test, "truncated block was accepted");
+				break;
+			}
+		}
+	}
+
+	free(compressed);
+	free(decompressed);
+}
+
+
+static void
+lz4_test_decompress(const char* test, const uint8* block, size_t blockSize,
+	size_t outputSize, status_t expectedError)
+{
+	BLz4CompressionAlgorithm algorithm;
+	uint8 output[64];
+	if (outputSize > sizeof(output))
+		outputSize = sizeof(output);
+
+	size_t decompressedSize;
+	status_t error = algorithm.DecompressBuffer(block, blockSize, output,
+		outputSize, decompressedSize);
+	lz4_check(error == expectedError, test, strerror(error));
+}
+
+
+static int
+test_lz4()
+{
+	const size_t kSize = 256 * 1024;
+	uint8* data = (uint8*)malloc(kSize);
+	if (data == NULL) {
+		fprintf(stderr, "Error: Out of memory\n");
+		return 1;
+	}
+
+	// round trips
+
+	memset(data, 'x', kSize);
+	lz4_test_round_trip("empty", data, 0);
+	lz4_test_round_trip("single byte", data, 1);
+	lz4_test_round_trip("shorter than a match", data, 12);
+	lz4_test_round_trip("zeros", data, kSize);
+
+	for (size_t i = 0; i < kSize; i++)
+		data[i] = "ab"[i % 2];
+	lz4_test_round_trip("overlapping match", data, kSize);
+
+	srand(42);
+	for (size_t i = 0; i < kSize; i++)
+		data[i] = rand();
+	lz4_test_round_trip("random", data, kSize);
+
+	// long literal runs between long matches
+	for (size_t i = 0; i < kSize; i++) {
+		if (i % 4096 < 1024)
+			data[i] = rand();
+		else
+			data[i] = i % 4096 < 2048 ? 'y' : "0123456789"[i % 10];
+	}
+	lz4_test_round_trip("mixed", data, kSize);
+
+	const char* text = "The quick brown fox jumps over the lazy dog. ";
+	size_t textLength = strlen(text);
+	for (size_t i = 0; i < kSize; i++)
+		data[i] = text[(i + i / 977) % textLength];
+	lz4_test_round_trip("text", data, kSize);
+
+	free(data);
+
+	// malformed input
+
+	// literals: "abcd"; match: offset 4, length 4; literals: "efghi"
+	static const uint8 kValid[] = { 0x40, 'a', 'b', 'c', 'd', 0x04, 0x00,
+		0x50, 'e', 'f', 'g', 'h', 'i' };
+	lz4_test_decompress("valid block", kValid, sizeof(kValid), 13, B_OK);
+
+	lz4_test_decompress("no input", kValid, 0, 64, B_BAD_DATA);
+	lz4_test_decompress("truncated literals", kValid, 3, 64, B_BAD_DATA);
+	lz4_test_decompress("truncated offset", kValid, 6, 64, B_BAD_DATA);
+	lz4_test_decompress("truncated final literals", kValid, 12, 64,
+		B_BAD_DATA);
+
+	static const uint8 kTruncatedLiteralLength[] = { 0xf0, 0xff };
+	lz4_test_decompress("truncated literal length", kTruncatedLiteralLength,
+		sizeof(kTruncatedLiteralLength), 64, B_BAD_DATA);
+
+	static const uint8 kTruncatedMatchLength[] = { 0x4f, 'a', 'b', 'c', 'd',
+		0x04, 0x00, 0xff };
+	lz4_test_decompress("truncated match length", kTruncatedMatchLength,
+		sizeof(kTruncatedMatchLength), 64, B_BAD_DATA);
+
+	static const uint8 kOffsetTooLarge[] = { 0x40, 'a', 'b', 'c', 'd', 0x05,
+		0x00, 0x50, 'e', 'f', 'g', 'h', 'i' };
+	lz4_test_decompress("offset before the output", kOffsetTooLarge,
+		sizeof(kOffsetTooLarge), 64, B_BAD_DATA);
+
+	static const uint8 kOffsetZero[] = { 0x40, 'a', 'b', 'c', 'd', 0x00, 0x00,
+		0x50, 'e', 'f', 'g', 'h', 'i' };
+	lz4_test_decompress("zero offset", kOffsetZero, sizeof(kOffsetZero), 64,
+		B_BAD_DATA);
+
+	lz4_test_decompress("literals overrun the output", kValid, sizeof(kValid),
+		3, B_BUFFER_OVERFLOW);
+	lz4_test_decompress("match overruns the output", kValid, sizeof(kValid),
+		7, B_BUFFER_OVERFLOW);
+	lz4_test_decompress("final literals overrun the output", kValid,
+		sizeof(kValid), 12, B_BUFFER_OVERFLOW);
+
+	if (sLz4Failures > 0) {
+		fprintf(stderr, "%d LZ4 test(s) failed\n", sLz4Failures);
+		return 1;
+	}
+
+	printf("All LZ4 tests passed\n");
+	return 0;
+}
+
+
 int
 main(int argc, const char* const* argv)
 {
@@ -65,11 +255,12 @@ main(int argc, const char* const* argv)
 			{ "decompress", no_argument, 0, 'd' },
 			{ "help", no_argument, 0, 'h' },
 			{ "input-stream", no_argument, 0, 'i' },
+			{ "test-lz4", no_argument, 0, 't' },
 			{ 0, 0, 0, 0 }
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+0123456789df:hi",
+		int c = getopt_long(argc, (char**)argv, "+0123456789df:hit",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -112,6 +303,9 @@ main(int argc, const char* const* argv)
 				useInputStream = true;
 				break;
 
+			case 't':
+				return test_lz4();
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the get/put throughput of the block cache for an increasing
+	number of threads. Every thread works on its own range of blocks (like
+	metadata lookups in different directories would), with a few blocks that
+	are shared by all threads (like the super block, or the root directory).
+*/
+
+
+#define write_pos	block_cache_write_pos
+#define read_pos	block_cache_read_pos
+
+#include "block_cache.cpp"
+
+#undef write_pos
+#undef read_pos
+
+#include <OS.h>
+
+
+static const size_t kBlockSize = 2048;
+static const off_t kBlocksPerThread = 256;
+static const off_t kSharedBlocks = 4;
+static const int32 kMaxThreads = 32;
+
+static void* sCache;
+static bigtime_t sDuration = 1000000LL;
+static int32 sSharedPercentage = 10;
+static int32 sStop;
+
+
+ssize_t
+block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
+{
+	return size;
+}
+
+
+ssize_t
+block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
+{
+	memset(buffer, 0, size);
+	*(off_t*)buffer = offset / kBlockSize;
+	return size;
+}
+
+
+static status_t
+stress_thread(void* _data)
+{
+	int32 index = (int32)(addr_t)_data;
+	off_t firstBlock = kSharedBlocks + index * kBlocksPerThread;
+	uint32 random = index * 7919 + 1;
+	int64 count = 0;
+
+	while (atomic_get(&sStop) == 0) {
+		random = random * 1103515245 + 12345;
+
+		off_t blockNumber;
+		if ((int32)((random >> 8) % 100) < sSharedPercentage)
+			blockNumber = (random >> 16) % kSharedBlocks;
+		else
+			blockNumber = firstBlock + (random >> 16) % kBlocksPerThread;
+
+		const void* block = block_cache_get(sCache, blockNumber);
+		if (block == NULL || *(off_t*)block != blockNumber) {
+			fprintf(stderr, "block %" B_PRIdOFF " has wrong contents!\n",
+				blockNumber);
+			exit(1);
+		}
+		block_cache_put(sCache, blockNumber);
+		count++;
+	}
+
+	return count > INT32_MAX ? INT32_MAX : (status_t)count;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	sStop = 0;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&stress_thread, "block cache stress",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+	}
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	snooze(sDuration);
+	atomic_set(&sStop, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t count;
+		wait_for_thread(threads[i], &count);
+		total += count;
+	}
+	bigtime_t time = system_time() - start;
+
+	printf("%3" B_PRId32 " threads: %10" B_PRId64 " get/put pairs, "
+		"%8.0f per second\n", threadCount, total, total * 1000000.0 / time);
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-t <max-threads>] [-s <shared-percentage>] "
+		"[-d <seconds-per-run>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+	int32 maxThreads = info.cpu_count * 2;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:s:d:h")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = atol(optarg);
+				break;
+			case 's':
+				sSharedPercentage = atol(optarg);
+				break;
+			case 'd':
+				sDuration = atol(optarg) * 1000000LL;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (maxThreads < 1 || maxThreads > kMaxThreads || sSharedPercentage < 0
+		|| sSharedPercentage > 100 || sDuration <= 0)
+		usage(argv[0]);
+
+	block_cache_init();
+
+	sCache = block_cache_create(-1, kSharedBlocks
+		+ kMaxThreads * kBlocksPerThread, kBlockSize, true);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache!\n");
+		return 1;
+	}
+
+	// warm up the cache, so that only cache hits are measured
+	for (off_t i = 0; i < kSharedBlocks + maxThreads * kBlocksPerThread; i++) {
+		block_cache_get(sCache, i);
+		block_cache_put(sCache, i);
+	}
+
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+		run_test(threads);
+
+	block_cache_delete(sCache, false);
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include "io_scheduler_benchmark.h"
+
+
+static const char* const kClassNames[IO_BENCHMARK_CLASS_COUNT] = {
+	"read",
+	"write",
+	"background"
+};
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-s <scheduler>] [-q <queue-depth>] "
+		"[-p <device-queues>]\n"
+		"    [-b <request-size>] [-w <write-%%>] [-g <background-%%>] "
+		"[-d <seconds>] <file>\n\n"
+		"Runs the I/O scheduler benchmark driver on the given regular file.\n"
+		"The scheduler can be \"simple\", or \"multiqueue\"; without -s, both "
+		"are run.\n"
+		"Note: write requests overwrite the contents of the file!\n",
+		programName);
+	exit(1);
+}
+
+
+static int
+run(int fd, io_scheduler_benchmark_args& args)
+{
+	if (ioctl(fd, IO_SCHEDULER_BENCHMARK_RUN, &args, sizeof(args)) != 0) {
+		fprintf(stderr, "Running the benchmark failed: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	printf("%s scheduler, queue depth %" B_PRIu32 ", %" B_PRIu32
+		" device queues, %" B_PRIu32 " bytes per request:\n", args.scheduler,
+		args.queue_depth, args.device_queues, args.request_size);
+
+	uint64 total = 0;
+	for (int32 i = 0; i < IO_BENCHMARK_CLASS_COUNT; i++) {
+		const io_scheduler_benchmark_result& result = args.results[i];
+		total += result.requests;
+		if (result.requests == 0)
+			continue;
+
+		printf("  %-10s %10" B_PRIu64 " requests, latency avg %8" B_PRId64
+			" us, max %8" B_PRId64 " us\n", kClassNames[i], result.requests,
+			result.total_latency / (bigtime_t)result.requests,
+			result.max_latency);
+	}
+
+	double seconds = args.elapsed / 1000000.0;
+	printf("  %.0f requests/s, %.1f MB/s\n", total / seconds,
+		total * args.request_size / seconds / (1024 * 1024));
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	io_scheduler_benchmark_args args;
+	memset(&args, 0, sizeof(args));
+	args.queue_depth = 32;
+	args.device_queues = 4;
+	args.request_size = 4096;
+	args.write_percentage = 30;
+	args.background_percentage = 10;
+	args.duration = 5000000;
+
+	int option;
+	while ((option = getopt(argc, argv, "s:q:p:b:w:g:d:h")) != -1) {
+		switch (option) {
+			case 's':
+				strlcpy(args.scheduler, optarg, sizeof(args.scheduler));
+				break;
+			case 'q':
+				args.queue_depth = strtoul(optarg, NULL, 0);
+				break;
+			case 'p':
+				args.device_queues = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				args.request_size = strtoul(optarg, NULL, 0);
+				break;
+			case 'w':
+				args.write_percentage = strtoul(optarg, NULL, 0);
+				break;
+			case 'g':
+				args.background_percentage = strtoul(optarg, NULL, 0);
+				break;
+			case 'd':
+				args.duration = strtoul(optarg, NULL, 0) * 1000000LL;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind + 1 != argc)
+		usage(argv[0]);
+
+	if (realpath(argv[optind], args.path) == NULL) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	int fd = open("/dev/" IO_SCHEDULER_BENCHMARK_DEVICE, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open the benchmark device: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	int result = 0;
+	if (args.scheduler[0] != '\0')
+		result = run(fd, args);
+	else {
+		strlcpy(args.scheduler, "simple", sizeof(args.scheduler));
+		result = run(fd, args);
+		strlcpy(args.scheduler, "multiqueue", sizeof(args.scheduler));
+		if (result == 0)
+			result = run(fd, args);
+	}
+
+	close(fd);
+	return result;
+}
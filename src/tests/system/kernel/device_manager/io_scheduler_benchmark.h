@@ -0,0 +1,50 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_BENCHMARK_H
+#define IO_SCHEDULER_BENCHMARK_H
+
+
+#include <Drivers.h>
+
+
+#define IO_SCHEDULER_BENCHMARK_DEVICE	"misc/io_scheduler_benchmark"
+
+#define IO_SCHEDULER_BENCHMARK_RUN		(B_DEVICE_OP_CODES_END + 0x4242)
+
+enum {
+	IO_BENCHMARK_READ = 0,
+	IO_BENCHMARK_WRITE,
+	IO_BENCHMARK_BACKGROUND,
+
+	IO_BENCHMARK_CLASS_COUNT
+};
+
+struct io_scheduler_benchmark_result {
+	uint64		requests;
+	bigtime_t	total_latency;
+	bigtime_t	max_latency;
+};
+
+struct io_scheduler_benchmark_args {
+	char		path[B_PATH_NAME_LENGTH];
+		// the regular file that backs the device
+	char		scheduler[32];
+		// "simple", or "multiqueue"
+	uint32		queue_depth;
+		// number of requests in flight
+	uint32		device_queues;
+		// number of requests the device processes in parallel
+	uint32		request_size;
+	uint32		write_percentage;
+	uint32		background_percentage;
+	bigtime_t	duration;
+
+	// results
+	bigtime_t	elapsed;
+	io_scheduler_benchmark_result results[IO_BENCHMARK_CLASS_COUNT];
+};
+
+
+#endif	// IO_SCHEDULER_BENCHMARK_H
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the throughput and per class latency of the I/O schedulers.
+
+	A FileDevice on a regular file acts as the device: its operations are
+	executed by a number of "device queue" threads, which emulate a device
+	that can process several requests in parallel. A number of load threads
+	keeps the given queue depth of requests scheduled.
+	The benchmark is started via ioctl() on the published device, see the
+	io_scheduler_benchmark command.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <Drivers.h>
+#include <KernelExport.h>
+
+#include <AutoDeleter.h>
+#include <condition_variable.h>
+#include <kernel.h>
+#include <lock.h>
+#include <util/AutoLock.h>
+
+#include "FileDevice.h"
+#include "IORequest.h"
+#include "IOSchedulerRoster.h"
+
+#include "io_scheduler_benchmark.h"
+
+
+static const int32 kMaxThreads = 64;
+
+int32 api_version = B_CUR_DRIVER_API_VERSION;
+
+static const char* sDeviceNames[] = {
+	IO_SCHEDULER_BENCHMARK_DEVICE,
+	NULL
+};
+
+static mutex sBenchmarkLock = MUTEX_INITIALIZER("io scheduler benchmark");
+
+
+struct Benchmark {
+	io_scheduler_benchmark_args	args;
+	FileDevice*			device;
+	void*				deviceCookie;
+	off_t				blockCount;
+	IOScheduler*		scheduler;
+
+	// operations waiting for a device queue
+	mutex				lock;
+	ConditionVariable	condition;
+	IOOperationList		operations;
+	volatile bool		terminating;
+
+	io_scheduler_benchmark_result results[kMaxThreads][IO_BENCHMARK_CLASS_COUNT];
+	int32				nextThreadIndex;
+};
+
+
+static status_t
+do_io(void* data, IOOperation* operation)
+{
+	Benchmark* benchmark = (Benchmark*)data;
+
+	MutexLocker locker(benchmark->lock);
+	benchmark->operations.Add(operation);
+	benchmark->condition.NotifyOne();
+	return B_OK;
+}
+
+
+/*!	Executes the operations as the device would. */
+static status_t
+device_queue_thread(void* data)
+{
+	Benchmark* benchmark = (Benchmark*)data;
+
+	while (true) {
+		MutexLocker locker(benchmark->lock);
+		IOOperation* operation = benchmark->operations.RemoveHead();
+		if (operation == NULL) {
+			if (benchmark->terminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			benchmark->condition.Add(&entry);
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+		locker.Unlock();
+
+		off_t offset = operation->Offset();
+		generic_size_t transferred = 0;
+		status_t status = B_OK;
+		generic_io_vec* vecs = operation->Vecs();
+
+		for (uint32 i = 0; i < operation->VecCount() && status == B_OK; i++) {
+			size_t length = vecs[i].length;
+			if (operation->IsWrite()) {
+				status = benchmark->device->Write(benchmark->deviceCookie,
+					offset, (void*)(addr_t)vecs[i].base, &length);
+			} else {
+				status = benchmark->device->Read(benchmark->deviceCookie,
+					offset, (void*)(addr_t)vecs[i].base, &length);
+			}
+
+			offset += length;
+			transferred += length;
+		}
+
+		benchmark->scheduler->OperationCompleted(operation, status,
+			transferred);
+	}
+}
+
+
+static status_t
+load_thread(void* data)
+{
+	Benchmark* benchmark = (Benchmark*)data;
+	io_scheduler_benchmark_args& args = benchmark->args;
+
+	int32 index = atomic_add(&benchmark->nextThreadIndex, 1);
+	io_scheduler_benchmark_result* results = benchmark->results[index];
+	memset(results, 0, sizeof(benchmark->results[index]));
+
+	void* buffer = malloc(args.request_size);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+	memset(buffer, index, args.request_size);
+
+	uint32 blocksPerRequest = args.request_size / 512;
+	uint32 random = index * 7919 + 1;
+	bigtime_t end = system_time() + args.duration;
+
+	while (system_time() < end) {
+		random = random * 1103515245 + 12345;
+		off_t offset = ((random >> 4)
+			% (benchmark->blockCount - blocksPerRequest + 1)) * 512;
+		random = random * 1103515245 + 12345;
+		bool write = (random >> 8) % 100 < args.write_percentage;
+		random = random * 1103515245 + 12345;
+		bool background = (random >> 8) % 100 < args.background_percentage;
+
+		IORequest request;
+		status_t status = request.Init(offset, (addr_t)buffer,
+			args.request_size, write,
+			background ? B_BACKGROUND_IO_REQUEST : 0);
+		if (status != B_OK)
+			break;
+
+		bigtime_t start = system_time();
+		status = benchmark->scheduler->ScheduleRequest(&request);
+		if (status == B_OK)
+			status = request.Wait(0, 0);
+		if (status != B_OK)
+			break;
+
+		bigtime_t latency = system_time() - start;
+		io_scheduler_benchmark_result& result = results[background
+			? IO_BENCHMARK_BACKGROUND
+			: write ? IO_BENCHMARK_WRITE : IO_BENCHMARK_READ];
+		result.requests++;
+		result.total_latency += latency;
+		if (latency > result.max_latency)
+			result.max_latency = latency;
+	}
+
+	free(buffer);
+	return B_OK;
+}
+
+
+static status_t
+run_benchmark(io_scheduler_benchmark_args& args)
+{
+	if (args.queue_depth < 1 || args.queue_depth > kMaxThreads
+		|| args.device_queues < 1 || args.device_queues > kMaxThreads
+		|| args.request_size < 512 || args.request_size % 512 != 0
+		|| args.write_percentage > 100 || args.background_percentage > 100
+		|| args.duration <= 0) {
+		return B_BAD_VALUE;
+	}
+
+	args.path[sizeof(args.path) - 1] = '\0';
+	args.scheduler[sizeof(args.scheduler) - 1] = '\0';
+
+	struct stat st;
+	if (stat(args.path, &st) != 0)
+		return errno;
+
+	Benchmark* benchmark = new(std::nothrow) Benchmark;
+	if (benchmark == NULL)
+		return B_NO_MEMORY;
+	ObjectDeleter<Benchmark> benchmarkDeleter(benchmark);
+
+	benchmark->args = args;
+	benchmark->blockCount = st.st_size / 512;
+	benchmark->terminating = false;
+	benchmark->nextThreadIndex = 0;
+	mutex_init(&benchmark->lock, "io scheduler benchmark device");
+	benchmark->condition.Init(benchmark, "io scheduler benchmark device");
+
+	if (benchmark->blockCount < args.request_size / 512) {
+		mutex_destroy(&benchmark->lock);
+		return B_BAD_VALUE;
+	}
+
+	benchmark->device = new(std::nothrow) FileDevice;
+	if (benchmark->device == NULL) {
+		mutex_destroy(&benchmark->lock);
+		return B_NO_MEMORY;
+	}
+
+	status_t status = benchmark->device->Init(args.path);
+	if (status == B_OK) {
+		status = benchmark->device->Open(args.path, O_RDWR,
+			&benchmark->deviceCookie);
+	}
+	if (status != B_OK) {
+		delete benchmark->device;
+		mutex_destroy(&benchmark->lock);
+		return status;
+	}
+
+	benchmark->scheduler = IOSchedulerRoster::Default()->CreateScheduler(NULL,
+		args.scheduler[0] != '\0' ? args.scheduler : NULL);
+	if (benchmark->scheduler == NULL)
+		status = B_NO_MEMORY;
+	else
+		status = benchmark->scheduler->Init("benchmark");
+
+	thread_id deviceThreads[kMaxThreads];
+	thread_id loadThreads[kMaxThreads];
+	uint32 deviceThreadCount = 0;
+	uint32 loadThreadCount = 0;
+
+	if (status == B_OK) {
+		benchmark->scheduler->SetCallback(&do_io, benchmark);
+
+		for (; deviceThreadCount < args.device_queues; deviceThreadCount++) {
+			thread_id thread = spawn_kernel_thread(&device_queue_thread,
+				"benchmark device queue", B_NORMAL_PRIORITY, benchmark);
+			if (thread < 0) {
+				status = thread;
+				break;
+			}
+			deviceThreads[deviceThreadCount] = thread;
+			resume_thread(thread);
+		}
+	}
+
+	bigtime_t start = system_time();
+
+	while (status == B_OK && loadThreadCount < args.queue_depth) {
+		thread_id thread = spawn_kernel_thread(&load_thread, "benchmark load",
+			B_NORMAL_PRIORITY, benchmark);
+		if (thread < 0) {
+			status = thread;
+			break;
+		}
+		loadThreads[loadThreadCount++] = thread;
+		resume_thread(thread);
+	}
+
+	for (uint32 i = 0; i < loadThreadCount; i++)
+		wait_for_thread(loadThreads[i], NULL);
+
+	args.elapsed = system_time() - start;
+
+	mutex_lock(&benchmark->lock);
+	benchmark->terminating = true;
+	benchmark->condition.NotifyAll();
+	mutex_unlock(&benchmark->lock);
+
+	for (uint32 i = 0; i < deviceThreadCount; i++)
+		wait_for_thread(deviceThreads[i], NULL);
+
+	// sum up the results of all load threads
+	memset(args.results, 0, sizeof(args.results));
+	for (int32 i = 0; i < benchmark->nextThreadIndex; i++) {
+		for (int32 j = 0; j < IO_BENCHMARK_CLASS_COUNT; j++) {
+			io_scheduler_benchmark_result& result = benchmark->results[i][j];
+			args.results[j].requests += result.requests;
+			args.results[j].total_latency += result.total_latency;
+			if (result.max_latency > args.results[j].max_latency)
+				args.results[j].max_latency = result.max_latency;
+		}
+	}
+
+	delete benchmark->scheduler;
+	benchmark->device->Close(benchmark->deviceCookie);
+	benchmark->device->Free(benchmark->deviceCookie);
+	delete benchmark->device;
+	mutex_destroy(&benchmark->lock);
+
+	return status;
+}
+
+
+//	#pragma mark - device hooks
+
+
+static status_t
+benchmark_open(const char* name, uint32 flags, void** _cookie)
+{
+	*_cookie = NULL;
+	return B_OK;
+}
+
+
+static status_t
+benchmark_close(void* cookie)
+{
+	return B_OK;
+}
+
+
+static status_t
+benchmark_free(void* cookie)
+{
+	return B_OK;
+}
+
+
+static status_t
+benchmark_control(void* cookie, uint32 op, void* buffer, size_t length)
+{
+	if (op != IO_SCHEDULER_BENCHMARK_RUN)
+		return B_DEV_INVALID_IOCTL;
+
+	io_scheduler_benchmark_args args;
+	if (length < sizeof(args) || !IS_USER_ADDRESS(buffer)
+		|| user_memcpy(&args, buffer, sizeof(args)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	// only run one benchmark at a time
+	MutexLocker locker(sBenchmarkLock);
+
+	status_t status = run_benchmark(args);
+	if (status != B_OK)
+		return status;
+
+	if (user_memcpy(buffer, &args, sizeof(args)) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
+
+
+static status_t
+benchmark_read(void* cookie, off_t pos, void* buffer, size_t* _length)
+{
+	*_length = 0;
+	return B_OK;
+}
+
+
+static status_t
+benchmark_write(void* cookie, off_t pos, const void* buffer, size_t* _length)
+{
+	return B_NOT_ALLOWED;
+}
+
+
+//	#pragma mark - driver API
+
+
+status_t
+init_hardware()
+{
+	return B_OK;
+}
+
+
+status_t
+init_driver()
+{
+	return B_OK;
+}
+
+
+void
+uninit_driver()
+{
+}
+
+
+const char**
+publish_devices()
+{
+	return sDeviceNames;
+}
+
+
+device_hooks*
+find_device(const char* name)
+{
+	static device_hooks hooks = {
+		&benchmark_open,
+		&benchmark_close,
+		&benchmark_free,
+		&benchmark_control,
+		&benchmark_read,
+		&benchmark_write,
+	};
+
+	if (strcmp(name, IO_SCHEDULER_BENCHMARK_DEVICE) == 0)
+		return &hooks;
+
+	return NULL;
+}
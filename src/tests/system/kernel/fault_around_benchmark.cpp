@@ -0,0 +1,142 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Maps a file, whose pages should be in the file cache already, and reads
+	one byte of each of its pages, once for each access pattern advice. With
+	POSIX_MADV_RANDOM every page takes a fault of its own, while with the
+	others the VM maps the resident pages around a faulting one as well.
+	Prints the number of faults the team took, and how many pages have been
+	mapped by fault-around.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+#include <syscalls.h>
+#include <vm_defs.h>
+
+
+static const char* sFile = "/boot/system/lib/libbe.so";
+static int32 sRuns = 3;
+
+
+struct Advice {
+	const char*	name;
+	int			advice;
+};
+
+
+static bool
+read_file(int fd, size_t size, int advice, bigtime_t& _time,
+	team_vm_stats& _stats)
+{
+	uint8* address = (uint8*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (address == MAP_FAILED) {
+		fprintf(stderr, "Failed to map \"%s\": %s\n", sFile, strerror(errno));
+		return false;
+	}
+
+	posix_madvise(address, size, advice);
+
+	team_vm_stats before;
+	_kern_get_team_vm_stats(B_CURRENT_TEAM, &before, sizeof(before));
+
+	bigtime_t startTime = system_time();
+	uint32 sum = 0;
+	for (size_t offset = 0; offset < size; offset += B_PAGE_SIZE)
+		sum += address[offset];
+	_time = system_time() - startTime;
+
+	_kern_get_team_vm_stats(B_CURRENT_TEAM, &_stats, sizeof(_stats));
+	_stats.page_faults -= before.page_faults;
+	_stats.fault_around_pages -= before.fault_around_pages;
+
+	munmap(address, size);
+
+	// make sure the compiler doesn't optimize the accesses away
+	if (sum == 0xffffffff)
+		putchar(' ');
+
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-r <runs>] [<file>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "r:h")) != -1) {
+		switch (option) {
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind + 1 == argc)
+		sFile = argv[optind];
+	else if (optind != argc || sRuns < 1)
+		usage(argv[0]);
+
+	int fd = open(sFile, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Failed to open \"%s\": %s\n", sFile, strerror(errno));
+		return 1;
+	}
+	size_t size = st.st_size;
+	if (size == 0) {
+		fprintf(stderr, "\"%s\" is empty\n", sFile);
+		return 1;
+	}
+
+	// read the file once, so that all of its pages are in the file cache
+	team_vm_stats stats;
+	bigtime_t time;
+	if (!read_file(fd, size, POSIX_MADV_RANDOM, time, stats))
+		return 1;
+
+	const Advice advices[] = {
+		{ "random", POSIX_MADV_RANDOM },
+		{ "normal", POSIX_MADV_NORMAL },
+		{ "sequential", POSIX_MADV_SEQUENTIAL },
+	};
+
+	printf("%s: %zu pages\n", sFile, (size + B_PAGE_SIZE - 1) / B_PAGE_SIZE);
+	printf("advice        faults  fault-around     time\n");
+
+	for (int32 run = 0; run < sRuns; run++) {
+		for (size_t i = 0; i < sizeof(advices) / sizeof(advices[0]); i++) {
+			if (!read_file(fd, size, advices[i].advice, time, stats))
+				return 1;
+
+			printf("%-10s  %8" B_PRIu64 "  %12" B_PRIu64 "  %4" B_PRId64
+				" us\n", advices[i].name, stats.page_faults,
+				stats.fault_around_pages, time);
+		}
+	}
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the stat() throughput for missing files, like a compiler
+	searching its headers through a long list of include directories would
+	cause. Every header is only found in the last include directory, so all
+	other lookups go to missing entries.
+	Prints the entry cache statistics for each run, and verifies that a
+	created entry is visible right away.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+#include <entry_cache_defs.h>
+#include <syscalls.h>
+
+
+static const int32 kMaxThreads = 64;
+
+static const char* sBaseDirectory = "/tmp/entry_cache_benchmark";
+static int32 sDirectoryCount = 32;
+static int32 sHeaderCount = 64;
+static bigtime_t sDuration = 1000000LL;
+static int32 sStop;
+
+
+static void
+make_path(char* path, size_t size, int32 directory, int32 header)
+{
+	snprintf(path, size, "%s/include%" B_PRId32 "/header%" B_PRId32 ".h",
+		sBaseDirectory, directory, header);
+}
+
+
+static bool
+get_entry_cache_stats(entry_cache_stats& stats)
+{
+	return _kern_generic_syscall(ENTRY_CACHE_SYSCALLS, ENTRY_CACHE_GET_STATS,
+		&stats, sizeof(stats)) == B_OK;
+}
+
+
+static status_t
+stat_thread(void* _data)
+{
+	int32 index = (int32)(addr_t)_data;
+	int32 header = index % sHeaderCount;
+	int64 count = 0;
+
+	while (atomic_get(&sStop) == 0) {
+		// search the header in all include directories
+		for (int32 directory = 0; directory < sDirectoryCount; directory++) {
+			char path[PATH_MAX];
+			make_path(path, sizeof(path), directory, header);
+
+			struct stat st;
+			bool exists = stat(path, &st) == 0;
+			count++;
+
+			if (exists != (directory == sDirectoryCount - 1)) {
+				fprintf(stderr, "stat(\"%s\") returned a wrong result!\n",
+					path);
+				exit(1);
+			}
+			if (exists)
+				break;
+		}
+
+		header = (header + 1) % sHeaderCount;
+	}
+
+	return count > INT32_MAX ? INT32_MAX : (status_t)count;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	sStop = 0;
+
+	entry_cache_stats before;
+	bool haveStats = get_entry_cache_stats(before);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&stat_thread, "stat storm",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+	}
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	snooze(sDuration);
+	atomic_set(&sStop, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t count;
+		wait_for_thread(threads[i], &count);
+		total += count;
+	}
+	bigtime_t time = system_time() - start;
+
+	printf("%3" B_PRId32 " threads: %10" B_PRId64 " stats, %9.0f per second",
+		threadCount, total, total * 1000000.0 / time);
+
+	entry_cache_stats after;
+	if (haveStats && get_entry_cache_stats(after)) {
+		int64 lookups = after.lookups - before.lookups;
+		int64 hits = after.hits - before.hits;
+		printf(", entry cache: %" B_PRId64 "%% hits, %" B_PRId64 "%% lockless, "
+			"%" B_PRId64 " negative",
+			lookups > 0 ? hits * 100 / lookups : 0,
+			hits > 0 ? (after.lockless_hits - before.lockless_hits) * 100 / hits
+				: 0,
+			after.negative_hits - before.negative_hits);
+	}
+	putchar('\n');
+}
+
+
+static bool
+create_file(const char* path)
+{
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", path,
+			strerror(errno));
+		return false;
+	}
+
+	close(fd);
+	return true;
+}
+
+
+static bool
+create_tree()
+{
+	if (mkdir(sBaseDirectory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", sBaseDirectory,
+			strerror(errno));
+		return false;
+	}
+
+	for (int32 directory = 0; directory < sDirectoryCount; directory++) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/include%" B_PRId32, sBaseDirectory,
+			directory);
+		if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", path,
+				strerror(errno));
+			return false;
+		}
+	}
+
+	for (int32 header = 0; header < sHeaderCount; header++) {
+		char path[PATH_MAX];
+		make_path(path, sizeof(path), sDirectoryCount - 1, header);
+		if (!create_file(path))
+			return false;
+	}
+
+	return true;
+}
+
+
+static void
+remove_tree()
+{
+	for (int32 directory = 0; directory < sDirectoryCount; directory++) {
+		char path[PATH_MAX];
+		for (int32 header = 0; header < sHeaderCount; header++) {
+			make_path(path, sizeof(path), directory, header);
+			unlink(path);
+		}
+
+		snprintf(path, sizeof(path), "%s/include%" B_PRId32, sBaseDirectory,
+			directory);
+		rmdir(path);
+	}
+
+	rmdir(sBaseDirectory);
+}
+
+
+/*!	Makes sure that a missing entry that has just been looked up is not
+	reported missing anymore after it has been created.
+*/
+static bool
+check_invalidation()
+{
+	char path[PATH_MAX];
+	make_path(path, sizeof(path), 0, 0);
+
+	struct stat st;
+	if (stat(path, &st) == 0) {
+		fprintf(stderr, "\"%s\" should not exist!\n", path);
+		return false;
+	}
+
+	if (!create_file(path))
+		return false;
+
+	bool exists = stat(path, &st) == 0;
+	unlink(path);
+
+	if (!exists) {
+		fprintf(stderr, "Created \"%s\" is still missing!\n", path);
+		return false;
+	}
+
+	if (stat(path, &st) == 0) {
+		fprintf(stderr, "Removed \"%s\" still exists!\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-t <max-threads>] [-i <include-dirs>] "
+		"[-n <headers>] [-d <seconds-per-run>] [-b <base-directory>]\n",
+		programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+	int32 maxThreads = info.cpu_count * 2;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:i:n:d:b:h")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = atol(optarg);
+				break;
+			case 'i':
+				sDirectoryCount = atol(optarg);
+				break;
+			case 'n':
+				sHeaderCount = atol(optarg);
+				break;
+			case 'd':
+				sDuration = atol(optarg) * 1000000LL;
+				break;
+			case 'b':
+				sBaseDirectory = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (maxThreads < 1 || maxThreads > kMaxThreads || sDirectoryCount < 1
+		|| sHeaderCount < 1 || sDuration <= 0)
+		usage(argv[0]);
+
+	if (!create_tree()) {
+		remove_tree();
+		return 1;
+	}
+
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+		run_test(threads);
+
+	bool success = check_invalidation();
+	remove_tree();
+
+	entry_cache_stats stats;
+	if (get_entry_cache_stats(stats)) {
+		printf("entry cache: %" B_PRId32 " entries, %" B_PRId32 " negative, "
+			"%" B_PRId64 " invalidations, %" B_PRId64 " expired\n",
+			stats.entries, stats.negative_entries, stats.invalidations,
+			stats.expired);
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Verifies that the entry cache doesn't return stale entries after a
+	rename() replaced an existing file, or after a file has been created in
+	place of a missing entry, or removed.
+	The entries are looked up before each change, so that they are cached.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+
+static const char* sBaseDirectory = "/tmp/entry_cache_rename_test";
+static int32 sIterations = 100;
+
+
+static bool
+create_file(const char* path, ino_t& _node)
+{
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to create \"%s\": %s\n", path,
+			strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	bool success = fstat(fd, &st) == 0;
+	close(fd);
+
+	_node = st.st_ino;
+	return success;
+}
+
+
+static bool
+check_entry(const char* path, ino_t node)
+{
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "stat(\"%s\") failed: %s\n", path, strerror(errno));
+		return false;
+	}
+	if (st.st_ino != node) {
+		fprintf(stderr, "stat(\"%s\") returned node %" B_PRIdINO ", expected %"
+			B_PRIdINO "\n", path, st.st_ino, node);
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+check_missing(const char* path)
+{
+	struct stat st;
+	if (stat(path, &st) == 0 || errno != ENOENT) {
+		fprintf(stderr, "stat(\"%s\") didn't fail with ENOENT\n", path);
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+run_test()
+{
+	char source[PATH_MAX];
+	char target[PATH_MAX];
+	snprintf(source, sizeof(source), "%s/source", sBaseDirectory);
+	snprintf(target, sizeof(target), "%s/target", sBaseDirectory);
+
+	for (int32 i = 0; i < sIterations; i++) {
+		// a missing entry must become visible when it's created
+		ino_t targetNode;
+		if (!check_missing(target) || !create_file(target, targetNode)
+			|| !check_entry(target, targetNode)) {
+			return false;
+		}
+
+		// renaming over an existing file must replace its entry
+		ino_t sourceNode;
+		if (!create_file(source, sourceNode)
+			|| !check_entry(source, sourceNode)) {
+			return false;
+		}
+
+		if (rename(source, target) != 0) {
+			fprintf(stderr, "rename() failed: %s\n", strerror(errno));
+			return false;
+		}
+
+		if (!check_entry(target, sourceNode) || !check_missing(source))
+			return false;
+
+		// a removed entry must be gone
+		if (unlink(target) != 0) {
+			fprintf(stderr, "unlink() failed: %s\n", strerror(errno));
+			return false;
+		}
+		if (!check_missing(target))
+			return false;
+	}
+
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-d <directory>] [-i <iterations>]\n",
+		programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "d:i:h")) != -1) {
+		switch (option) {
+			case 'd':
+				sBaseDirectory = optarg;
+				break;
+			case 'i':
+				sIterations = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc || sIterations < 1)
+		usage(argv[0]);
+
+	if (mkdir(sBaseDirectory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Failed to create \"%s\": %s\n", sBaseDirectory,
+			strerror(errno));
+		return 1;
+	}
+
+	bool success = run_test();
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/source", sBaseDirectory);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/target", sBaseDirectory);
+	unlink(path);
+	rmdir(sBaseDirectory);
+
+	printf("%s\n", success ? "passed" : "FAILED");
+	return success ? 0 : 1;
+}
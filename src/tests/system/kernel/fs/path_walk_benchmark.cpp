@@ -0,0 +1,245 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the stat() throughput of an increasing number of threads that
+	resolve paths through the same deep directory hierarchy, once with the
+	lockless path walk of the VFS enabled, and once with it disabled.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+#include <entry_cache_defs.h>
+#include <syscalls.h>
+
+
+static const int32 kMaxThreads = 64;
+static const int32 kFileCount = 16;
+
+static const char* sBaseDirectory = "/tmp/path_walk_benchmark";
+static int32 sDepth = 8;
+static bigtime_t sDuration = 1000000LL;
+static char sDirectory[PATH_MAX];
+static int32 sStop;
+
+
+static bool
+get_entry_cache_stats(entry_cache_stats& stats)
+{
+	return _kern_generic_syscall(ENTRY_CACHE_SYSCALLS, ENTRY_CACHE_GET_STATS,
+		&stats, sizeof(stats)) == B_OK;
+}
+
+
+static bool
+set_lockless_path_walk(bool enabled)
+{
+	int32 value = enabled ? 1 : 0;
+	return _kern_generic_syscall(ENTRY_CACHE_SYSCALLS,
+		ENTRY_CACHE_SET_LOCKLESS_PATH_WALK, &value, sizeof(value)) == B_OK;
+}
+
+
+static status_t
+stat_thread(void* _data)
+{
+	int32 index = (int32)(addr_t)_data;
+	int64 count = 0;
+
+	char path[PATH_MAX];
+	while (atomic_get(&sStop) == 0) {
+		snprintf(path, sizeof(path), "%s/file%" B_PRId32, sDirectory,
+			(int32)(count + index) % kFileCount);
+
+		struct stat st;
+		if (stat(path, &st) != 0) {
+			fprintf(stderr, "Could not stat \"%s\": %s\n", path,
+				strerror(errno));
+			exit(1);
+		}
+		count++;
+	}
+
+	return count > INT32_MAX ? INT32_MAX : (status_t)count;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[kMaxThreads];
+	sStop = 0;
+
+	entry_cache_stats before;
+	bool haveStats = get_entry_cache_stats(before);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&stat_thread, "stat path walk",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+	}
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	snooze(sDuration);
+	atomic_set(&sStop, 1);
+
+	int64 total = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t count;
+		wait_for_thread(threads[i], &count);
+		total += count;
+	}
+	bigtime_t time = system_time() - start;
+
+	printf("%3" B_PRId32 " threads: %10" B_PRId64 " stats, %9.0f per second",
+		threadCount, total, total * 1000000.0 / time);
+
+	entry_cache_stats after;
+	if (haveStats && get_entry_cache_stats(after)) {
+		int64 walks = after.path_walks - before.path_walks;
+		printf(", %" B_PRId64 "%% lockless", walks > 0
+			? (after.lockless_path_walks - before.lockless_path_walks) * 100
+				/ walks
+			: 0);
+	}
+	putchar('\n');
+}
+
+
+static bool
+create_tree()
+{
+	strlcpy(sDirectory, sBaseDirectory, sizeof(sDirectory));
+	if (mkdir(sDirectory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", sDirectory,
+			strerror(errno));
+		return false;
+	}
+
+	for (int32 i = 0; i < sDepth; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "/level%" B_PRId32, i);
+		strlcat(sDirectory, name, sizeof(sDirectory));
+
+		if (mkdir(sDirectory, 0755) != 0 && errno != EEXIST) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", sDirectory,
+				strerror(errno));
+			return false;
+		}
+	}
+
+	for (int32 i = 0; i < kFileCount; i++) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/file%" B_PRId32, sDirectory, i);
+
+		int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", path,
+				strerror(errno));
+			return false;
+		}
+		close(fd);
+	}
+
+	return true;
+}
+
+
+static void
+remove_tree()
+{
+	char path[PATH_MAX];
+	for (int32 i = 0; i < kFileCount; i++) {
+		snprintf(path, sizeof(path), "%s/file%" B_PRId32, sDirectory, i);
+		unlink(path);
+	}
+
+	// remove the directories from the deepest up
+	while (strcmp(sDirectory, sBaseDirectory) != 0) {
+		rmdir(sDirectory);
+		char* slash = strrchr(sDirectory, '/');
+		if (slash == NULL)
+			break;
+		*slash = '\0';
+	}
+	rmdir(sBaseDirectory);
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-t <max-threads>] [-l <depth>] "
+		"[-d <seconds-per-run>] [-b <base-directory>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+	int32 maxThreads = info.cpu_count * 2;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:l:d:b:h")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = atol(optarg);
+				break;
+			case 'l':
+				sDepth = atol(optarg);
+				break;
+			case 'd':
+				sDuration = atol(optarg) * 1000000LL;
+				break;
+			case 'b':
+				sBaseDirectory = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (maxThreads < 1 || maxThreads > kMaxThreads || sDepth < 0
+		|| sDuration <= 0)
+		usage(argv[0]);
+
+	if (!create_tree()) {
+		remove_tree();
+		return 1;
+	}
+
+	printf("stat() of \"%s/file*\"\n", sDirectory);
+
+	bool canSwitch = set_lockless_path_walk(true);
+	printf("\nlockless path walk:\n");
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+		run_test(threads);
+
+	if (canSwitch) {
+		set_lockless_path_walk(false);
+		printf("\nregular path walk:\n");
+		for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+			run_test(threads);
+
+		set_lockless_path_walk(true);
+	} else
+		fprintf(stderr, "\nCould not switch the path walk mode.\n");
+
+	remove_tree();
+	return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares listing a directory with the stat and some attributes of each
+	entry, like Tracker does, using readdir(), stat(), and fs_read_attr() on
+	one side, and _kern_read_dir_stat() on the other.
+	Also verifies that both ways return the same results.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <fs_attr.h>
+#include <OS.h>
+#include <TypeConstants.h>
+
+#include <syscalls.h>
+#include <vfs_defs.h>
+
+
+static const char* kAttributes[] = {"BEOS:TYPE", "test:value"};
+static const int32 kAttributeCount = 2;
+static const size_t kMaxAttributeSize = 256;
+
+static const char* sDirectory = "/tmp/read_dir_stat_benchmark";
+static int32 sFileCount = 2000;
+static int32 sRuns = 5;
+
+
+static bool
+create_files()
+{
+	if (mkdir(sDirectory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", sDirectory,
+			strerror(errno));
+		return false;
+	}
+
+	for (int32 i = 0; i < sFileCount; i++) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/file%" B_PRId32, sDirectory, i);
+
+		int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", path,
+				strerror(errno));
+			return false;
+		}
+
+		const char* type = "text/plain";
+		fs_write_attr(fd, kAttributes[0], B_MIME_STRING_TYPE, 0, type,
+			strlen(type) + 1);
+		if (i % 2 == 0)
+			fs_write_attr(fd, kAttributes[1], B_INT32_TYPE, 0, &i, sizeof(i));
+
+		close(fd);
+	}
+
+	return true;
+}
+
+
+static void
+remove_files()
+{
+	for (int32 i = 0; i < sFileCount; i++) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/file%" B_PRId32, sDirectory, i);
+		unlink(path);
+	}
+
+	rmdir(sDirectory);
+}
+
+
+/*!	Returns a checksum over the stat and attributes of all entries, so that
+	the results of both ways can be compared.
+*/
+static uint64
+list_single()
+{
+	DIR* dir = opendir(sDirectory);
+	if (dir == NULL)
+		return 0;
+
+	uint64 checksum = 0;
+	while (struct dirent* entry = readdir(dir)) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", sDirectory, entry->d_name);
+
+		struct stat st;
+		if (lstat(path, &st) != 0)
+			continue;
+
+		checksum += st.st_ino + st.st_size + st.st_mode;
+
+		int fd = open(path, O_RDONLY | O_NOTRAVERSE);
+		if (fd < 0)
+			continue;
+
+		for (int32 i = 0; i < kAttributeCount; i++) {
+			char buffer[kMaxAttributeSize];
+			ssize_t bytes = fs_read_attr(fd, kAttributes[i], B_ANY_TYPE, 0,
+				buffer, sizeof(buffer));
+			for (ssize_t j = 0; j < bytes; j++)
+				checksum += (uint8)buffer[j] * (j + 1);
+		}
+
+		close(fd);
+	}
+
+	closedir(dir);
+	return checksum;
+}
+
+
+static uint64
+list_batched()
+{
+	int fd = open(sDirectory, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return 0;
+
+	char names[B_ATTR_NAME_LENGTH * kAttributeCount];
+	size_t namesLength = 0;
+	for (int32 i = 0; i < kAttributeCount; i++) {
+		strcpy(names + namesLength, kAttributes[i]);
+		namesLength += strlen(kAttributes[i]) + 1;
+	}
+
+	uint8* buffer = (uint8*)malloc(65536);
+	if (buffer == NULL) {
+		close(fd);
+		return 0;
+	}
+
+	uint64 checksum = 0;
+	while (true) {
+		ssize_t count = _kern_read_dir_stat(fd, (dirent_stat*)buffer, 65536,
+			UINT32_MAX, names, namesLength, kMaxAttributeSize);
+		if (count <= 0)
+			break;
+
+		dirent_stat* record = (dirent_stat*)buffer;
+		for (ssize_t i = 0; i < count; i++) {
+			if (record->status == B_OK) {
+				checksum += record->stat.st_ino + record->stat.st_size
+					+ record->stat.st_mode;
+
+				uint8* data = (uint8*)record + record->attr_offset;
+				for (int32 j = 0; j < kAttributeCount; j++) {
+					dirent_stat_attr* attribute = (dirent_stat_attr*)data;
+					uint8* value = (uint8*)(attribute + 1);
+					for (int32 k = 0; k < attribute->size; k++)
+						checksum += value[k] * (k + 1);
+
+					data += (sizeof(dirent_stat_attr)
+						+ (attribute->size > 0 ? attribute->size : 0) + 7) & ~7;
+				}
+			}
+
+			record = (dirent_stat*)((uint8*)record + record->reclen);
+		}
+	}
+
+	free(buffer);
+	close(fd);
+	return checksum;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-n <files>] [-r <runs>] [-d <directory>]\n",
+		programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "n:r:d:h")) != -1) {
+		switch (option) {
+			case 'n':
+				sFileCount = atol(optarg);
+				break;
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			case 'd':
+				sDirectory = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (sFileCount < 1 || sRuns < 1)
+		usage(argv[0]);
+
+	if (!create_files()) {
+		remove_files();
+		return 1;
+	}
+
+	bool success = true;
+	for (int32 run = 0; run < sRuns; run++) {
+		bigtime_t start = system_time();
+		uint64 single = list_single();
+		bigtime_t singleTime = system_time() - start;
+
+		start = system_time();
+		uint64 batched = list_batched();
+		bigtime_t batchedTime = system_time() - start;
+
+		printf("%" B_PRId32 " entries: readdir/stat/attrs %" B_PRId64 " usecs, "
+			"read_dir_stat %" B_PRId64 " usecs\n", sFileCount, singleTime,
+			batchedTime);
+
+		if (single != batched) {
+			fprintf(stderr, "Results differ!\n");
+			success = false;
+		}
+	}
+
+	remove_files();
+	return success ? 0 : 1;
+}
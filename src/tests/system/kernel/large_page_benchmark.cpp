@@ -0,0 +1,140 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures random accesses to an area large enough to miss the TLB most of
+	the time, once with the area backed by normal pages, and once with
+	B_LARGE_PAGES_AREA set, so that the VM may back it with large pages.
+	Also prints how many large pages the VM has mapped and how many faults it
+	took to populate the area.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <syscalls.h>
+#include <vm_defs.h>
+
+
+static size_t sSize = 256 * 1024 * 1024;
+static int32 sAccesses = 20 * 1000 * 1000;
+static int32 sRuns = 3;
+
+
+static bool
+run_benchmark(bool largePages, bigtime_t& _populateTime,
+	bigtime_t& _accessTime, uint32& _faults, uint64& _largePages)
+{
+	uint32 protection = B_READ_AREA | B_WRITE_AREA
+		| (largePages ? B_LARGE_PAGES_AREA : 0);
+
+	uint8* address;
+	area_id area = create_area("large page benchmark", (void**)&address,
+		B_ANY_ADDRESS, sSize, B_NO_LOCK, protection);
+	if (area < 0) {
+		fprintf(stderr, "Failed to create area: %s\n", strerror(area));
+		return false;
+	}
+
+	system_info info;
+	get_system_info(&info);
+	uint32 faults = info.page_faults;
+
+	// touch all pages
+	bigtime_t startTime = system_time();
+	for (size_t offset = 0; offset < sSize; offset += B_PAGE_SIZE)
+		address[offset] = (uint8)(offset / B_PAGE_SIZE);
+	_populateTime = system_time() - startTime;
+
+	get_system_info(&info);
+	_faults = info.page_faults - faults;
+
+	vm_stats stats;
+	_largePages = _kern_get_vm_stats(&stats, sizeof(stats)) == B_OK
+		? stats.large_pages_mapped : 0;
+
+	// access random cache lines
+	uint64 state = 0x9e3779b97f4a7c15ULL;
+	uint32 sum = 0;
+	startTime = system_time();
+	for (int32 i = 0; i < sAccesses; i++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		sum += address[(state % sSize) & ~(size_t)63]++;
+	}
+	_accessTime = system_time() - startTime;
+
+	delete_area(area);
+
+	// make sure the compiler doesn't optimize the accesses away
+	if (sum == 0xffffffff)
+		putchar(' ');
+
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-s <size in MB>] [-a <accesses>] "
+		"[-r <runs>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "s:a:r:h")) != -1) {
+		switch (option) {
+			case 's':
+				sSize = (size_t)atol(optarg) * 1024 * 1024;
+				break;
+			case 'a':
+				sAccesses = atol(optarg);
+				break;
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc || sSize == 0 || sAccesses < 1 || sRuns < 1)
+		usage(argv[0]);
+
+	printf("%zu MB area, %" B_PRId32 " random accesses\n",
+		sSize / 1024 / 1024, sAccesses);
+	printf("pages   populate     faults  large pages     access  ns/access\n");
+
+	for (int32 run = 0; run < sRuns; run++) {
+		for (int32 i = 0; i < 2; i++) {
+			bool largePages = i == 1;
+			bigtime_t populateTime;
+			bigtime_t accessTime;
+			uint32 faults;
+			uint64 mappedLargePages;
+			if (!run_benchmark(largePages, populateTime, accessTime, faults,
+					mappedLargePages)) {
+				return 1;
+			}
+
+			printf("%-5s  %6" B_PRId64 " ms  %9" B_PRIu32 "  %11" B_PRIu64
+				"  %6" B_PRId64 " ms  %9.1f\n", largePages ? "large" : "4K",
+				populateTime / 1000, faults, mappedLargePages,
+				accessTime / 1000, accessTime * 1000.0 / sAccesses);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the page fault throughput with an increasing number of threads.
+	Each thread repeatedly creates an area, touches all of its pages, and
+	deletes it again, so that every fault has to allocate a page and every
+	deletion frees them again. If page allocation scales, the number of faults
+	per second should grow about linearly with the number of threads, up to
+	the number of CPUs.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+static int32 sPageCount = 1024;
+static int32 sRuns = 20;
+static int32 sMaxThreads = 0;
+	// 0 means twice the number of CPUs
+
+
+static status_t
+fault_thread(void* data)
+{
+	const size_t size = (size_t)sPageCount * B_PAGE_SIZE;
+
+	for (int32 run = 0; run < sRuns; run++) {
+		uint8* address;
+		area_id area = create_area("page fault benchmark", (void**)&address,
+			B_ANY_ADDRESS, size, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+		if (area < 0) {
+			fprintf(stderr, "Failed to create area: %s\n", strerror(area));
+			return area;
+		}
+
+		for (size_t offset = 0; offset < size; offset += B_PAGE_SIZE)
+			address[offset] = (uint8)offset;
+
+		delete_area(area);
+	}
+
+	return B_OK;
+}
+
+
+static bool
+run_benchmark(int32 threadCount, bigtime_t& _time)
+{
+	thread_id* threads = (thread_id*)malloc(threadCount * sizeof(thread_id));
+	if (threads == NULL) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&fault_thread, "page faulter",
+			B_NORMAL_PRIORITY, NULL);
+		if (threads[i] < 0) {
+			fprintf(stderr, "Failed to spawn thread: %s\n",
+				strerror(threads[i]));
+			exit(1);
+		}
+	}
+
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	bool success = true;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t result;
+		if (wait_for_thread(threads[i], &result) != B_OK || result != B_OK)
+			success = false;
+	}
+
+	_time = system_time() - startTime;
+
+	free(threads);
+	return success;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-p <pages>] [-r <runs>] [-t <max threads>]\n",
+		programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "p:r:t:h")) != -1) {
+		switch (option) {
+			case 'p':
+				sPageCount = atol(optarg);
+				break;
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			case 't':
+				sMaxThreads = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc || sPageCount < 1 || sRuns < 1 || sMaxThreads < 0)
+		usage(argv[0]);
+
+	system_info info;
+	get_system_info(&info);
+	if (sMaxThreads == 0)
+		sMaxThreads = 2 * info.cpu_count;
+
+	printf("%" B_PRIu32 " CPUs, %" B_PRId32 " pages per area, %" B_PRId32
+		" runs per thread\n", info.cpu_count, sPageCount, sRuns);
+	printf("threads        time       faults/s  per thread\n");
+
+	double singleThreadRate = 0;
+	for (int32 threadCount = 1; threadCount <= sMaxThreads;
+			threadCount *= 2) {
+		bigtime_t time;
+		if (!run_benchmark(threadCount, time))
+			return 1;
+
+		double faults = (double)threadCount * sRuns * sPageCount;
+		double rate = time > 0 ? faults * 1000000 / time : 0;
+		if (threadCount == 1)
+			singleThreadRate = rate;
+
+		printf("%7" B_PRId32 "  %7" B_PRId64 " ms  %13.0f  %9.1f%%\n",
+			threadCount, time / 1000, rate,
+			singleThreadRate > 0
+				? 100.0 * rate / threadCount / singleThreadRate : 0.0);
+	}
+
+	return 0;
+}
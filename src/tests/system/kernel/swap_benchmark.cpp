@@ -0,0 +1,240 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the latency of major faults under memory pressure. Fills an area
+	with data, pushes it out to swap by touching a second area about the size
+	of the physical memory, and then times the first access to each page of
+	the first area, once in sequential and once in random order.
+	This is done with data that compresses well, like most heap data, which
+	the compressed swap tier can keep in memory, if it is enabled, and with
+	random data, which always goes to the swap file.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <syscalls.h>
+#include <vm_defs.h>
+
+
+static size_t sSize = 0;
+	// 0 means a quarter of the physical memory
+static size_t sPressureSize = 0;
+	// 0 means the size of the physical memory
+static int32 sRuns = 1;
+
+
+static int
+compare_times(const void* _a, const void* _b)
+{
+	bigtime_t a = *(const bigtime_t*)_a;
+	bigtime_t b = *(const bigtime_t*)_b;
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+
+static void
+fill_area(uint8* address, bool compressible)
+{
+	uint32* words = (uint32*)address;
+	uint32 state = 0x9e3779b9;
+	for (size_t i = 0; i < sSize / sizeof(uint32); i++) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		if (!compressible)
+			words[i] = state;
+		else if (i % 4 == 0)
+			words[i] = 0;
+		else if (i % 4 == 1)
+			words[i] = state % 256;
+		else
+			words[i] = 0x10000000 + (state % 4096) * 16;
+	}
+}
+
+
+static bool
+apply_pressure()
+{
+	uint8* address;
+	area_id area = create_area("swap benchmark pressure", (void**)&address,
+		B_ANY_ADDRESS, sPressureSize, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (area < 0) {
+		fprintf(stderr, "Failed to create pressure area: %s\n",
+			strerror(area));
+		return false;
+	}
+
+	for (size_t offset = 0; offset < sPressureSize; offset += B_PAGE_SIZE)
+		address[offset] = (uint8)offset;
+
+	delete_area(area);
+	return true;
+}
+
+
+static bool
+run_benchmark(bool compressible, bool randomOrder, bigtime_t* times,
+	size_t* order, vm_stats& _stats)
+{
+	const size_t pageCount = sSize / B_PAGE_SIZE;
+
+	uint8* address;
+	area_id area = create_area("swap benchmark", (void**)&address,
+		B_ANY_ADDRESS, sSize, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (area < 0) {
+		fprintf(stderr, "Failed to create area: %s\n", strerror(area));
+		return false;
+	}
+
+	fill_area(address, compressible);
+
+	if (!apply_pressure()) {
+		delete_area(area);
+		return false;
+	}
+
+	for (size_t i = 0; i < pageCount; i++)
+		order[i] = i;
+	if (randomOrder) {
+		for (size_t i = pageCount - 1; i > 0; i--) {
+			size_t k = rand() % (i + 1);
+			size_t temp = order[i];
+			order[i] = order[k];
+			order[k] = temp;
+		}
+	}
+
+	vm_stats before;
+	_kern_get_vm_stats(&before, sizeof(before));
+
+	uint32 sum = 0;
+	for (size_t i = 0; i < pageCount; i++) {
+		bigtime_t startTime = system_time();
+		sum += address[order[i] * B_PAGE_SIZE];
+		times[i] = system_time() - startTime;
+	}
+
+	_kern_get_vm_stats(&_stats, sizeof(_stats));
+	_stats.swap_pages_read -= before.swap_pages_read;
+	_stats.swap_read_ahead_pages -= before.swap_read_ahead_pages;
+
+	delete_area(area);
+
+	// The compressed copies of the pages must have been released when they
+	// were swapped in
+	if (compressible && before.compressed_swap_pages > 0
+		&& _stats.compressed_swap_pages >= before.compressed_swap_pages) {
+		fprintf(stderr, "Compressed swap pages did not go down after swapping "
+			"in: %" B_PRIu64 " before, %" B_PRIu64 " after\n",
+			before.compressed_swap_pages, _stats.compressed_swap_pages);
+		return false;
+	}
+
+	// make sure the compiler doesn't optimize the accesses away
+	if (sum == 0xffffffff)
+		putchar(' ');
+
+	return true;
+}
+
+
+static void
+usage(const char* programName)
+{
+	fprintf(stderr, "usage: %s [-s <size in MB>] [-p <pressure size in MB>] "
+		"[-r <runs>]\n", programName);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "s:p:r:h")) != -1) {
+		switch (option) {
+			case 's':
+				sSize = (size_t)atol(optarg) * 1024 * 1024;
+				break;
+			case 'p':
+				sPressureSize = (size_t)atol(optarg) * 1024 * 1024;
+				break;
+			case 'r':
+				sRuns = atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc || sRuns < 1)
+		usage(argv[0]);
+
+	system_info info;
+	get_system_info(&info);
+	if (info.max_swap_pages == 0) {
+		fprintf(stderr, "This benchmark needs swap space.\n");
+		return 1;
+	}
+	if (sSize == 0)
+		sSize = info.max_pages * B_PAGE_SIZE / 4;
+	if (sPressureSize == 0)
+		sPressureSize = info.max_pages * B_PAGE_SIZE;
+	sSize = sSize / B_PAGE_SIZE * B_PAGE_SIZE;
+	if (sSize == 0)
+		usage(argv[0]);
+
+	const size_t pageCount = sSize / B_PAGE_SIZE;
+	bigtime_t* times = (bigtime_t*)malloc(pageCount * sizeof(bigtime_t));
+	size_t* order = (size_t*)malloc(pageCount * sizeof(size_t));
+	if (times == NULL || order == NULL) {
+		fprintf(stderr, "Out of memory!\n");
+		return 1;
+	}
+
+	printf("%zu MB area, %zu MB pressure\n", sSize / 1024 / 1024,
+		sPressureSize / 1024 / 1024);
+	printf("data        order       avg us  median us  99%% us   max us"
+		"  swapped in  read-ahead  compressed\n");
+
+	for (int32 run = 0; run < sRuns; run++) {
+		for (int32 i = 0; i < 4; i++) {
+			bool compressible = i < 2;
+			bool randomOrder = (i % 2) != 0;
+
+			vm_stats stats;
+			if (!run_benchmark(compressible, randomOrder, times, order,
+					stats)) {
+				return 1;
+			}
+
+			bigtime_t total = 0;
+			for (size_t k = 0; k < pageCount; k++)
+				total += times[k];
+			qsort(times, pageCount, sizeof(bigtime_t), &compare_times);
+
+			printf("%-10s  %-10s  %6.1f  %9" B_PRId64 "  %6" B_PRId64 "  %7"
+				B_PRId64 "  %10" B_PRIu64 "  %10" B_PRIu64 "  %10" B_PRIu64
+				"\n", compressible ? "compress" : "random",
+				randomOrder ? "random" : "sequential",
+				(double)total / pageCount, times[pageCount / 2],
+				times[pageCount * 99 / 100], times[pageCount - 1],
+				stats.swap_pages_read, stats.swap_read_ahead_pages,
+				stats.compressed_swap_pages);
+		}
+	}
+
+	free(order);
+	free(times);
+	return 0;
+}
@@ -6,7 +6,10 @@
 
 #include "fssh.h"
 
+#include "command_allocbench.h"
 #include "command_checkfs.h"
+#include "command_dirbench.h"
+#include "command_querybench.h"
 
 
 namespace FSShell {
@@ -17,6 +20,12 @@ register_additional_commands()
 {
 	CommandManager::Default()->AddCommand(command_checkfs, "checkfs",
 		"check file system");
+	CommandManager::Default()->AddCommand(command_allocbench, "allocbench",
+		"measure the write throughput of files growing together");
+	CommandManager::Default()->AddCommand(command_dirbench, "dirbench",
+		"measure creating and reading a large directory");
+	CommandManager::Default()->AddCommand(command_querybench, "querybench",
+		"measure queries that combine several indices");
 }
 
 
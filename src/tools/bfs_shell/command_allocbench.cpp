@@ -0,0 +1,216 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the write throughput of files that grow at the same time.
+	The FS shell cannot run threads, so the writes to the files are
+	interleaved instead, which results in the same allocation pattern.
+	With -v, the block bitmap is checked afterwards, which also serves as a
+	regression test for the allocator when the files fill up the volume.
+*/
+
+
+#include <stdlib.h>
+
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+static const int32 kMaxFiles = 256;
+static const char* kDirectory = "/myfs/allocbench";
+
+
+static void
+get_path(char* path, size_t size, int32 index)
+{
+	snprintf(path, size, "%s/file%" B_PRId32, kDirectory, index);
+}
+
+
+static void
+remove_files(int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), i);
+		_kern_unlink(-1, path);
+	}
+	_kern_remove_dir(-1, kDirectory);
+}
+
+
+static fssh_status_t
+write_files(int* files, int32 count, off_t fileSize, uint8* buffer,
+	size_t chunkSize)
+{
+	for (off_t pos = 0; pos < fileSize; pos += chunkSize) {
+		size_t length = chunkSize;
+		if (pos + (off_t)length > fileSize)
+			length = fileSize - pos;
+
+		for (int32 i = 0; i < count; i++) {
+			fssh_ssize_t written = _kern_write(files[i], pos, buffer, length);
+			if (written < 0)
+				return written;
+			if ((size_t)written != length)
+				return B_DEVICE_FULL;
+		}
+	}
+
+	return _kern_sync();
+}
+
+
+/*!	Runs the bitmap pass of checkfs without fixing anything, and fails if
+	the bitmap does not match the blocks the files are using.
+*/
+static fssh_status_t
+verify_bitmap()
+{
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0)
+		return rootDir;
+
+	struct check_control result;
+	memset(&result, 0, sizeof(result));
+	result.magic = BFS_IOCTL_CHECK_MAGIC;
+
+	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_START_CHECKING,
+		&result, sizeof(result));
+	if (status != B_OK) {
+		_kern_close(rootDir);
+		return status;
+	}
+
+	while (_kern_ioctl(rootDir, BFS_IOCTL_CHECK_NEXT_NODE, &result,
+			sizeof(result)) == B_OK) {
+	}
+
+	status = _kern_ioctl(rootDir, BFS_IOCTL_STOP_CHECKING, &result,
+		sizeof(result));
+	_kern_close(rootDir);
+	if (status != B_OK)
+		return status;
+
+	fssh_dprintf("bitmap: %" B_PRIu64 " blocks not allocated, %" B_PRIu64
+		" blocks already set, %" B_PRIu64 " blocks could be freed\n",
+		result.stats.missing, result.stats.already_set, result.stats.freed);
+
+	if (result.stats.missing != 0 || result.stats.already_set != 0
+		|| result.stats.freed != 0) {
+		fssh_dprintf("allocbench: the block bitmap is inconsistent\n");
+		return B_BAD_DATA;
+	}
+
+	return B_OK;
+}
+
+
+fssh_status_t
+command_allocbench(int argc, const char* const* argv)
+{
+	int32 count = 4;
+	off_t fileSize = 64LL * 1024 * 1024;
+	size_t chunkSize = 64 * 1024;
+	bool keep = false;
+	bool verify = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			count = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			fileSize = strtoll(argv[++i], NULL, 0) * 1024 * 1024;
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+			chunkSize = strtoul(argv[++i], NULL, 0) * 1024;
+		else if (!strcmp(argv[i], "-k"))
+			keep = true;
+		else if (!strcmp(argv[i], "-v"))
+			verify = true;
+		else {
+			fssh_dprintf("Usage: %s [-n <files>] [-s <file size in MB>] "
+				"[-c <write size in KB>] [-k] [-v]\n"
+				"Grows the files in %s at the same time, and prints the "
+				"throughput.\n"
+				"  -k  Keep the files; they are removed by default\n"
+				"  -v  Check the block bitmap afterwards; running out of "
+				"disk space is\n"
+				"      not an error then\n",
+				argv[0], kDirectory);
+			return B_OK;
+		}
+	}
+
+	if (count < 1 || count > kMaxFiles || fileSize <= 0 || chunkSize == 0)
+		return B_BAD_VALUE;
+
+	uint8* buffer = (uint8*)malloc(chunkSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+	memset(buffer, 0xaa, chunkSize);
+
+	fssh_status_t status = _kern_create_dir(-1, kDirectory, 0755);
+	if (status != B_OK && status != B_FILE_EXISTS) {
+		free(buffer);
+		return status;
+	}
+
+	int files[kMaxFiles];
+	int32 opened = 0;
+	status = B_OK;
+
+	for (; opened < count; opened++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), opened);
+
+		files[opened] = _kern_open(-1, path, O_CREAT | O_TRUNC | O_WRONLY,
+			0644);
+		if (files[opened] < 0) {
+			status = files[opened];
+			break;
+		}
+	}
+
+	bigtime_t time = 0;
+	if (status == B_OK) {
+		time = system_time();
+		status = write_files(files, count, fileSize, buffer, chunkSize);
+		time = system_time() - time;
+	}
+
+	for (int32 i = 0; i < opened; i++)
+		_kern_close(files[i]);
+	free(buffer);
+
+	if (status == B_OK) {
+		off_t total = fileSize * count;
+		fssh_dprintf("%" B_PRId32 " files of %" B_PRIdOFF " MB in %" B_PRIuSIZE
+			" KB writes: %" B_PRId64 " ms, %" B_PRIdOFF " KB/s\n", count,
+			fileSize / (1024 * 1024), chunkSize / 1024, time / 1000,
+			time > 0 ? total * 1000000 / time / 1024 : 0);
+	} else if (status != B_DEVICE_FULL || !verify)
+		fssh_dprintf("allocbench failed: %s\n", strerror(status));
+
+	if (verify && (status == B_OK || status == B_DEVICE_FULL))
+		status = verify_bitmap();
+
+	if (!keep)
+		remove_files(opened);
+
+	if (status == B_OK && verify && !keep) {
+		// all blocks must have been returned after removing the files
+		status = verify_bitmap();
+	}
+
+	return status;
+}
+
+
+}	// namespace FSShell
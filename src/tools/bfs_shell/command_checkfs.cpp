@@ -18,14 +18,25 @@ fssh_status_t
 command_checkfs(int argc, const char* const* argv)
 {
 	if (argc == 2 && !strcmp(argv[1], "--help")) {
-		fssh_dprintf("Usage: %s [-c]\n"
-			"  -c  Check only; don't perform any changes\n", argv[0]);
+		fssh_dprintf("Usage: %s [-c | -r [-f]]\n"
+			"  -c  Check only; don't perform any changes\n"
+			"  -r  Rebuild all indices, not only broken ones\n"
+			"  -f  Make bulk loading the indices fail halfway through, to test\n"
+			"      the fallback to inserting their entries\n", argv[0]);
 		return B_OK;
 	}
 
 	bool checkOnly = false;
-	if (argc == 2 && !strcmp(argv[1], "-c"))
-		checkOnly = true;
+	bool rebuildIndices = false;
+	bool failBulkLoad = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-c"))
+			checkOnly = true;
+		else if (!strcmp(argv[i], "-r"))
+			rebuildIndices = true;
+		else if (!strcmp(argv[i], "-f"))
+			failBulkLoad = true;
+	}
 
 	int rootDir = _kern_open_dir(-1, "/myfs");
 	if (rootDir < 0)
@@ -39,6 +50,10 @@ command_checkfs(int argc, const char* const* argv)
 		result.flags |= BFS_FIX_BITMAP_ERRORS | BFS_REMOVE_WRONG_TYPES
 			| BFS_REMOVE_INVALID | BFS_FIX_NAME_MISMATCHES | BFS_FIX_BPLUSTREES;
 	}
+	if (rebuildIndices)
+		result.flags |= BFS_REBUILD_INDICES;
+	if (failBulkLoad)
+		result.flags |= BFS_FAIL_BULK_LOAD;
 
 	// start checking
 	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_START_CHECKING,
@@ -50,6 +65,7 @@ command_checkfs(int argc, const char* const* argv)
 	uint64 files = 0, directories = 0, indices = 0;
 	uint64 counter = 0;
 	uint32 previousPass = result.pass;
+	bigtime_t indexStart = 0;
 
 	// check all files and report errors
 	while (_kern_ioctl(rootDir, BFS_IOCTL_CHECK_NEXT_NODE, &result,
@@ -92,8 +108,10 @@ command_checkfs(int argc, const char* const* argv)
 				files++;
 		} else if (result.pass == BFS_CHECK_PASS_INDEX) {
 			if (previousPass != result.pass) {
-				fssh_dprintf("Recreating broken index b+trees...\n");
+				fssh_dprintf(rebuildIndices ? "Recreating index b+trees...\n"
+					: "Recreating broken index b+trees...\n");
 				previousPass = result.pass;
+				indexStart = system_time();
 				counter = 0;
 			}
 		}
@@ -108,6 +126,11 @@ command_checkfs(int argc, const char* const* argv)
 
 	_kern_close(rootDir);
 
+	if (indexStart != 0) {
+		fssh_dprintf("Indices recreated in %" FSSH_B_PRId64 " ms\n",
+			(system_time() - indexStart) / 1000);
+	}
+
 	fssh_dprintf("        %" FSSH_B_PRIu64 " nodes checked,\n\t%" FSSH_B_PRIu64
 		" blocks not allocated,\n\t%" FSSH_B_PRIu64 " blocks already set,\n\t%"
 		B_PRIu64 " blocks could be freed\n\n", counter, result.stats.missing,
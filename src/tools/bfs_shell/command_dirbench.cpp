@@ -0,0 +1,155 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how long it takes to populate a large directory, and to read
+	it back from start to end.
+	Since the FS shell keeps all blocks it once read in its cache, a cold
+	read of the directory needs another shell: create the files with "-k"
+	first, and read them with "-r" after restarting the shell.
+*/
+
+
+#include <stdlib.h>
+
+#include "fssh_dirent.h"
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+
+
+namespace FSShell {
+
+
+static const char* kDirectory = "/myfs/dirbench";
+
+
+static void
+get_path(char* path, size_t size, int32 index)
+{
+	snprintf(path, size, "%s/file%" B_PRId32, kDirectory, index);
+}
+
+
+static fssh_status_t
+create_files(int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), i);
+
+		int fd = _kern_open(-1, path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0)
+			return fd;
+		_kern_close(fd);
+	}
+
+	return _kern_sync();
+}
+
+
+static void
+remove_files(int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), i);
+		_kern_unlink(-1, path);
+	}
+	_kern_remove_dir(-1, kDirectory);
+}
+
+
+static fssh_status_t
+read_directory(int32& _count)
+{
+	int fd = _kern_open_dir(-1, kDirectory);
+	if (fd < 0)
+		return fd;
+
+	char buffer[4096];
+	struct dirent* entry = (struct dirent*)buffer;
+	int32 count = 0;
+
+	while (true) {
+		fssh_ssize_t read = _kern_read_dir(fd, entry, sizeof(buffer), 64);
+		if (read <= 0) {
+			_kern_close(fd);
+			_count = count;
+			return read;
+		}
+
+		count += read;
+	}
+}
+
+
+fssh_status_t
+command_dirbench(int argc, const char* const* argv)
+{
+	int32 count = 100000;
+	bool keep = false;
+	bool readOnly = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			count = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-k"))
+			keep = true;
+		else if (!strcmp(argv[i], "-r"))
+			readOnly = true;
+		else {
+			fssh_dprintf("Usage: %s [-n <files>] [-k | -r]\n"
+				"Creates the files in %s, and reads the directory back.\n"
+				"  -k  Keep the files; they are removed by default\n"
+				"  -r  Only read the directory kept by an earlier run\n",
+				argv[0], kDirectory);
+			return B_OK;
+		}
+	}
+
+	if (count < 1)
+		return B_BAD_VALUE;
+
+	fssh_status_t status = B_OK;
+	if (!readOnly) {
+		status = _kern_create_dir(-1, kDirectory, 0755);
+		if (status != B_OK && status != B_FILE_EXISTS)
+			return status;
+
+		bigtime_t time = system_time();
+		status = create_files(count);
+		time = system_time() - time;
+
+		if (status == B_OK) {
+			fssh_dprintf("created %" B_PRId32 " files: %" B_PRId64 " ms\n",
+				count, time / 1000);
+		}
+	}
+
+	if (status == B_OK) {
+		int32 entries = 0;
+		bigtime_t time = system_time();
+		status = read_directory(entries);
+		time = system_time() - time;
+
+		if (status == B_OK) {
+			fssh_dprintf("read %" B_PRId32 " entries: %" B_PRId64 " ms\n",
+				entries, time / 1000);
+		}
+	}
+
+	if (status != B_OK)
+		fssh_dprintf("dirbench failed: %s\n", strerror(status));
+
+	if (!keep && !readOnly)
+		remove_files(count);
+
+	return status;
+}
+
+
+}	// namespace FSShell
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Creates files with indexed attributes, and measures how long queries
+	that combine several indices take. The plan of every query is printed
+	as well, before and after the index statistics have been updated.
+*/
+
+
+#include <stdlib.h>
+
+#include "fssh_dirent.h"
+#include "fssh_stat.h"
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+static const char* kDirectory = "/myfs/querybench";
+
+static const char* kQueries[] = {
+	"(qb:group==7)&&(qb:tag==\"tag0007\")",
+	"(qb:group==7)||(qb:tag==\"tag0008\")",
+	"(qb:group>=190)&&(qb:tag==\"tag1*\")",
+	"(name==\"file1*\")&&(qb:group<5)",
+	NULL
+};
+
+
+static void
+get_path(char* path, size_t size, int32 index)
+{
+	snprintf(path, size, "%s/file%" B_PRId32, kDirectory, index);
+}
+
+
+static fssh_status_t
+write_attribute(int fd, const char* name, uint32 type, const void* data,
+	size_t length)
+{
+	int attribute = _kern_create_attr(fd, name, type, O_TRUNC | O_WRONLY);
+	if (attribute < 0)
+		return attribute;
+
+	fssh_ssize_t written = _kern_write(attribute, 0, data, length);
+	_kern_close(attribute);
+
+	if (written < 0)
+		return written;
+	return written == (fssh_ssize_t)length ? B_OK : B_IO_ERROR;
+}
+
+
+static fssh_status_t
+create_files(fssh_dev_t device, int32 count)
+{
+	fssh_status_t status = _kern_create_index(device, "qb:group",
+		B_INT32_TYPE, 0);
+	if (status == B_OK || status == B_FILE_EXISTS)
+		status = _kern_create_index(device, "qb:tag", B_STRING_TYPE, 0);
+	if (status != B_OK && status != B_FILE_EXISTS)
+		return status;
+
+	for (int32 i = 0; i < count; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), i);
+
+		int fd = _kern_open(-1, path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0)
+			return fd;
+
+		int32 group = i % 200;
+		char tag[16];
+		snprintf(tag, sizeof(tag), "tag%04" B_PRId32, i % 4999);
+
+		status = write_attribute(fd, "qb:group", B_INT32_TYPE, &group,
+			sizeof(group));
+		if (status == B_OK) {
+			status = write_attribute(fd, "qb:tag", B_STRING_TYPE, tag,
+				strlen(tag) + 1);
+		}
+		_kern_close(fd);
+
+		if (status != B_OK)
+			return status;
+	}
+
+	return _kern_sync();
+}
+
+
+static void
+remove_files(int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		get_path(path, sizeof(path), i);
+		_kern_unlink(-1, path);
+	}
+	_kern_remove_dir(-1, kDirectory);
+}
+
+
+static void
+explain_query(int rootDir, const char* query)
+{
+	bfs_query_plan* plan = (bfs_query_plan*)malloc(sizeof(bfs_query_plan));
+	if (plan == NULL)
+		return;
+
+	strlcpy(plan->query, query, sizeof(plan->query));
+	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_EXPLAIN_QUERY, plan,
+		sizeof(bfs_query_plan));
+	if (status == B_OK)
+		fssh_dprintf("%s", plan->plan);
+	else
+		fssh_dprintf("could not explain query: %s\n", strerror(status));
+
+	free(plan);
+}
+
+
+static fssh_status_t
+run_query(fssh_dev_t device, const char* query, int32& _count)
+{
+	int fd = _kern_open_query(device, query, strlen(query), 0, -1, -1);
+	if (fd < 0)
+		return fd;
+
+	char buffer[4096];
+	struct dirent* entry = (struct dirent*)buffer;
+	int32 count = 0;
+
+	while (true) {
+		fssh_ssize_t read = _kern_read_dir(fd, entry, sizeof(buffer),
+			sizeof(buffer) / sizeof(struct dirent));
+		if (read <= 0) {
+			_kern_close(fd);
+			_count = count;
+			return read;
+		}
+
+		count += read;
+	}
+}
+
+
+static fssh_status_t
+run_queries(int rootDir, fssh_dev_t device, const char* const* queries)
+{
+	for (int32 i = 0; queries[i] != NULL; i++) {
+		fssh_dprintf("\n%s\n", queries[i]);
+		explain_query(rootDir, queries[i]);
+
+		int32 count = 0;
+		bigtime_t time = system_time();
+		fssh_status_t status = run_query(device, queries[i], count);
+		time = system_time() - time;
+
+		if (status != B_OK)
+			return status;
+
+		fssh_dprintf("-> %" B_PRId32 " entries: %" B_PRId64 " ms\n", count,
+			time / 1000);
+	}
+
+	return B_OK;
+}
+
+
+fssh_status_t
+command_querybench(int argc, const char* const* argv)
+{
+	int32 count = 100000;
+	bool keep = false;
+	bool reuse = false;
+	const char* queries[2] = {NULL, NULL};
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			count = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+			queries[0] = argv[++i];
+		else if (!strcmp(argv[i], "-k"))
+			keep = true;
+		else if (!strcmp(argv[i], "-r"))
+			reuse = true;
+		else {
+			fssh_dprintf("Usage: %s [-n <files>] [-k | -r] [-q <query>]\n"
+				"Creates the files in %s, and runs queries on them.\n"
+				"  -k  Keep the files; they are removed by default\n"
+				"  -r  Only run the queries on the files kept by an earlier "
+					"run\n"
+				"  -q  Only run the given query\n",
+				argv[0], kDirectory);
+			return B_OK;
+		}
+	}
+
+	if (count < 1)
+		return B_BAD_VALUE;
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0)
+		return rootDir;
+
+	struct stat info;
+	fssh_status_t status = _kern_read_stat(rootDir, NULL, false, &info,
+		sizeof(info));
+	if (status != B_OK) {
+		_kern_close(rootDir);
+		return status;
+	}
+
+	if (!reuse) {
+		status = _kern_create_dir(-1, kDirectory, 0755);
+		if (status == B_OK || status == B_FILE_EXISTS) {
+			bigtime_t time = system_time();
+			status = create_files(info.st_dev, count);
+			time = system_time() - time;
+
+			if (status == B_OK) {
+				fssh_dprintf("created %" B_PRId32 " files: %" B_PRId64
+					" ms\n", count, time / 1000);
+			}
+		}
+	}
+
+	const char* const* list = queries[0] != NULL ? queries : kQueries;
+
+	if (status == B_OK)
+		status = run_queries(rootDir, info.st_dev, list);
+
+	if (status == B_OK) {
+		bigtime_t time = system_time();
+		status = _kern_ioctl(rootDir, BFS_IOCTL_UPDATE_INDEX_STATISTICS, NULL,
+			0);
+		time = system_time() - time;
+
+		if (status == B_OK) {
+			fssh_dprintf("\nupdated index statistics: %" B_PRId64 " ms\n",
+				time / 1000);
+			status = run_queries(rootDir, info.st_dev, list);
+		}
+	}
+
+	if (status != B_OK)
+		fssh_dprintf("querybench failed: %s\n", strerror(status));
+
+	if (!keep && !reuse)
+		remove_files(count);
+
+	_kern_close(rootDir);
+	return status;
+}
+
+
+}	// namespace FSShell
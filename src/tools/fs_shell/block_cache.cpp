@@ -14,6 +14,7 @@
 #include "fssh_kernel_export.h"
 #include "fssh_lock.h"
 #include "fssh_string.h"
+#include "fssh_uio.h"
 #include "fssh_unistd.h"
 #include "hash.h"
 #include "vfs.h"
@@ -133,6 +134,7 @@ struct block_cache {
 };
 
 static const int32_t kMaxBlockCount = 1024;
+static const fssh_size_t kMaxPrefetchBlocks = 64;
 
 struct cache_listener;
 typedef DoublyLinkedListLink<cache_listener> listener_link;
@@ -1703,6 +1705,80 @@ fssh_block_cache_get(void* _cache, fssh_off_t blockNumber)
 }
 
 
+/*!	Reads the blocks starting at \a blockNumber into the cache, skipping
+	those at the start that are already cached, and stopping at the next cached
+	one. Unlike in the kernel, this is done synchronously, but with a single
+	read for all blocks.
+*/
+fssh_status_t
+fssh_block_cache_prefetch(void* _cache, fssh_off_t blockNumber,
+	fssh_size_t* _numBlocks)
+{
+	block_cache* cache = (block_cache*)_cache;
+	MutexLocker locker(&cache->lock);
+
+	fssh_size_t numBlocks = *_numBlocks;
+	*_numBlocks = 0;
+
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return FSSH_B_BAD_VALUE;
+	if (blockNumber + (fssh_off_t)numBlocks > cache->max_blocks)
+		numBlocks = cache->max_blocks - blockNumber;
+
+	fssh_size_t skipped = 0;
+	for (; skipped < numBlocks; skipped++, blockNumber++) {
+		if (hash_lookup(cache->hash, &blockNumber) == NULL)
+			break;
+	}
+	if (numBlocks - skipped > kMaxPrefetchBlocks)
+		numBlocks = skipped + kMaxPrefetchBlocks;
+
+	cached_block* blocks[kMaxPrefetchBlocks];
+	fssh_iovec vecs[kMaxPrefetchBlocks];
+	fssh_size_t count = 0;
+
+	for (; skipped + count < numBlocks; count++) {
+		fssh_off_t number = blockNumber + count;
+		if (hash_lookup(cache->hash, &number) != NULL)
+			break;
+
+		cached_block* block = cache->NewBlock(number);
+		if (block == NULL)
+			break;
+
+		hash_insert(cache->hash, block);
+		blocks[count] = block;
+		vecs[count].iov_base = block->current_data;
+		vecs[count].iov_len = cache->block_size;
+	}
+
+	fssh_ssize_t bytesRead = count > 0
+		? fssh_readv_pos(cache->fd, blockNumber * cache->block_size, vecs,
+			count)
+		: 0;
+	fssh_size_t readCount = bytesRead > 0 ? bytesRead / cache->block_size : 0;
+
+	for (fssh_size_t i = 0; i < count; i++) {
+		cached_block* block = blocks[i];
+		if (i >= readCount) {
+			cache->RemoveBlock(block);
+			continue;
+		}
+
+		block->unused = true;
+		cache->unused_blocks.Add(block);
+	}
+
+	if (cache->allocated_block_count > kMaxBlockCount) {
+		cache->RemoveUnusedBlocks(INT32_MAX,
+			cache->allocated_block_count - kMaxBlockCount);
+	}
+
+	*_numBlocks = skipped + readCount;
+	return readCount < count ? FSSH_B_IO_ERROR : FSSH_B_OK;
+}
+
+
 /*!	Changes the internal status of a writable block to \a dirty. This can be
 	helpful in case you realize you don't need to change that block anymore
 	for whatever reason.
@@ -33,6 +33,14 @@ fssh_suspend_thread(fssh_thread_id thread)
 }
 
 
+fssh_status_t
+fssh_wait_for_thread(fssh_thread_id thread, fssh_status_t *threadReturnValue)
+{
+	// fssh_spawn_kernel_thread() doesn't create any threads to wait for
+	return FSSH_B_BAD_THREAD_ID;
+}
+
+
 fssh_thread_id 
 fssh_find_thread(const char *name)
 {